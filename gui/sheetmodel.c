@@ -0,0 +1,464 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* A list-only GtkTreeModel for editing data series in the
+   spreadsheet window. Populating a GtkListStore with a formatted
+   string for every cell is prohibitively costly for big datasets;
+   here the strings are generated only when the view asks for
+   them, i.e. for the rows that are actually on screen.
+
+   The model's "columns" are the observation label (column 0)
+   followed by one column per series. Each row carries an ID:
+   for rows that correspond to observations in the dataset this
+   is the observation index, and rows added in the editor get
+   negative IDs. Edited cell contents are stored in a hash table
+   keyed by row ID and column, so that inserting rows doesn't
+   disturb them.
+*/
+
+#include "gretl.h"
+#include "sheetmodel.h"
+
+struct _SheetModel {
+    GObject parent;
+    const DATASET *dset; /* source of the data values */
+    int *list;           /* series IDs for the original columns */
+    int ncols;           /* number of data columns */
+    int nrows;           /* number of rows */
+    int norig;           /* number of rows backed by @dset */
+    int nnew;            /* number of rows added */
+    int *rowmap;         /* row IDs, once rows have been inserted */
+    GHashTable *cells;   /* strings for edited cells */
+    char numfmt[8];      /* format for numerical values */
+    int digits;          /* precision for the above */
+    gboolean blank;      /* ignore the original data values? */
+    gint stamp;          /* for validating iters */
+};
+
+struct _SheetModelClass {
+    GObjectClass parent_class;
+};
+
+static void sheet_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(SheetModel, sheet_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      sheet_model_tree_model_init))
+
+#define iter_row(i) GPOINTER_TO_INT((i)->user_data)
+
+static void sheet_model_init (SheetModel *model)
+{
+    model->dset = NULL;
+    model->list = NULL;
+    model->ncols = 0;
+    model->nrows = 0;
+    model->norig = 0;
+    model->nnew = 0;
+    model->rowmap = NULL;
+    model->cells = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+					 g_free, g_free);
+    model->numfmt[0] = '\0';
+    model->digits = 0;
+    model->blank = FALSE;
+    model->stamp = g_random_int();
+}
+
+static void sheet_model_finalize (GObject *object)
+{
+    SheetModel *model = SHEET_MODEL(object);
+
+    free(model->list);
+    free(model->rowmap);
+    g_hash_table_destroy(model->cells);
+
+    G_OBJECT_CLASS(sheet_model_parent_class)->finalize(object);
+}
+
+static void sheet_model_class_init (SheetModelClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = sheet_model_finalize;
+}
+
+static int sheet_model_row_id (SheetModel *model, int i)
+{
+    if (model->rowmap != NULL) {
+	return model->rowmap[i];
+    } else if (i < model->norig) {
+	return model->dset->t1 + i;
+    } else {
+	return -(i - model->norig + 1);
+    }
+}
+
+static gint64 cell_key (int id, int col)
+{
+    return (gint64) id * G_GINT64_CONSTANT(4294967296) + col;
+}
+
+static gchar *sheet_model_cell_string (SheetModel *model, int i, int j)
+{
+    const DATASET *dset = model->dset;
+    int id = sheet_model_row_id(model, i);
+    gint64 key = cell_key(id, j);
+    const gchar *s;
+
+    s = g_hash_table_lookup(model->cells, &key);
+    if (s != NULL) {
+	return g_strdup(s);
+    }
+
+    if (j == 0) {
+	/* observation label */
+	if (dataset_has_markers(dset)) {
+	    return g_strdup(id >= 0 ? dset->S[id] : "");
+	} else {
+	    char obs[OBSLEN];
+
+	    get_obs_string(obs, dset->t1 + i, dset);
+	    return g_strdup(obs);
+	}
+    } else if (model->blank || id < 0 || j > model->list[0]) {
+	return g_strdup("");
+    } else {
+	double x = dset->Z[model->list[j]][id];
+
+	if (na(x)) {
+	    return g_strdup("");
+	} else {
+	    return g_strdup_printf(model->numfmt, model->digits, x);
+	}
+    }
+}
+
+/* GtkTreeModel interface */
+
+static GtkTreeModelFlags sheet_model_get_flags (GtkTreeModel *tm)
+{
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint sheet_model_get_n_columns (GtkTreeModel *tm)
+{
+    return SHEET_MODEL(tm)->ncols + 1;
+}
+
+static GType sheet_model_get_column_type (GtkTreeModel *tm, gint col)
+{
+    return G_TYPE_STRING;
+}
+
+static gboolean sheet_model_get_iter (GtkTreeModel *tm,
+				      GtkTreeIter *iter,
+				      GtkTreePath *path)
+{
+    SheetModel *model = SHEET_MODEL(tm);
+    gint i;
+
+    if (gtk_tree_path_get_depth(path) != 1) {
+	return FALSE;
+    }
+
+    i = gtk_tree_path_get_indices(path)[0];
+    if (i < 0 || i >= model->nrows) {
+	return FALSE;
+    }
+
+    iter->stamp = model->stamp;
+    iter->user_data = GINT_TO_POINTER(i);
+
+    return TRUE;
+}
+
+static GtkTreePath *sheet_model_get_path (GtkTreeModel *tm,
+					  GtkTreeIter *iter)
+{
+    GtkTreePath *path = gtk_tree_path_new();
+
+    gtk_tree_path_append_index(path, iter_row(iter));
+
+    return path;
+}
+
+static void sheet_model_get_value (GtkTreeModel *tm,
+				   GtkTreeIter *iter,
+				   gint col,
+				   GValue *value)
+{
+    SheetModel *model = SHEET_MODEL(tm);
+
+    g_value_init(value, G_TYPE_STRING);
+    g_value_take_string(value, sheet_model_cell_string(model,
+						       iter_row(iter),
+						       col));
+}
+
+static gboolean sheet_model_iter_next (GtkTreeModel *tm,
+				       GtkTreeIter *iter)
+{
+    SheetModel *model = SHEET_MODEL(tm);
+    gint i = iter_row(iter) + 1;
+
+    if (i >= model->nrows) {
+	return FALSE;
+    }
+
+    iter->user_data = GINT_TO_POINTER(i);
+
+    return TRUE;
+}
+
+static gboolean sheet_model_iter_nth_child (GtkTreeModel *tm,
+					    GtkTreeIter *iter,
+					    GtkTreeIter *parent,
+					    gint n)
+{
+    SheetModel *model = SHEET_MODEL(tm);
+
+    if (parent != NULL || n < 0 || n >= model->nrows) {
+	return FALSE;
+    }
+
+    iter->stamp = model->stamp;
+    iter->user_data = GINT_TO_POINTER(n);
+
+    return TRUE;
+}
+
+static gboolean sheet_model_iter_children (GtkTreeModel *tm,
+					   GtkTreeIter *iter,
+					   GtkTreeIter *parent)
+{
+    return sheet_model_iter_nth_child(tm, iter, parent, 0);
+}
+
+static gboolean sheet_model_iter_has_child (GtkTreeModel *tm,
+					    GtkTreeIter *iter)
+{
+    return FALSE;
+}
+
+static gint sheet_model_iter_n_children (GtkTreeModel *tm,
+					 GtkTreeIter *iter)
+{
+    return iter == NULL ? SHEET_MODEL(tm)->nrows : 0;
+}
+
+static gboolean sheet_model_iter_parent (GtkTreeModel *tm,
+					 GtkTreeIter *iter,
+					 GtkTreeIter *child)
+{
+    return FALSE;
+}
+
+static void sheet_model_tree_model_init (GtkTreeModelIface *iface)
+{
+    iface->get_flags = sheet_model_get_flags;
+    iface->get_n_columns = sheet_model_get_n_columns;
+    iface->get_column_type = sheet_model_get_column_type;
+    iface->get_iter = sheet_model_get_iter;
+    iface->get_path = sheet_model_get_path;
+    iface->get_value = sheet_model_get_value;
+    iface->iter_next = sheet_model_iter_next;
+    iface->iter_children = sheet_model_iter_children;
+    iface->iter_has_child = sheet_model_iter_has_child;
+    iface->iter_n_children = sheet_model_iter_n_children;
+    iface->iter_nth_child = sheet_model_iter_nth_child;
+    iface->iter_parent = sheet_model_iter_parent;
+}
+
+/* public API */
+
+/**
+ * sheet_model_new:
+ * @dset: dataset from which values are to be read.
+ * @list: list of series to be shown, one per column.
+ * @numfmt: printf-type format for the values, taking a
+ * precision argument (e.g. "%.*g").
+ * @digits: the precision.
+ * @blank: if TRUE, show the data cells as empty regardless
+ * of the values in @dset (e.g. for a new dataset).
+ *
+ * Returns: a new model with one row per observation in the
+ * current sample range of @dset, or NULL on failure.
+ */
+
+SheetModel *sheet_model_new (const DATASET *dset, const int *list,
+			     const char *numfmt, int digits,
+			     gboolean blank)
+{
+    SheetModel *model;
+    int *mylist;
+
+    mylist = gretl_list_copy(list);
+    if (mylist == NULL) {
+	return NULL;
+    }
+
+    model = g_object_new(SHEET_TYPE_MODEL, NULL);
+
+    model->dset = dset;
+    model->list = mylist;
+    model->ncols = list[0];
+    model->nrows = model->norig = dset->t2 - dset->t1 + 1;
+    strcpy(model->numfmt, numfmt);
+    model->digits = digits;
+    model->blank = blank;
+
+    return model;
+}
+
+int sheet_model_get_n_rows (SheetModel *model)
+{
+    return model->nrows;
+}
+
+/**
+ * sheet_model_set_string:
+ * @model: the model.
+ * @iter: points to the row to modify.
+ * @col: the column.
+ * @s: the new string for the cell.
+ *
+ * Records @s as the content of the specified cell.
+ */
+
+void sheet_model_set_string (SheetModel *model, GtkTreeIter *iter,
+			     int col, const gchar *s)
+{
+    int i = iter_row(iter);
+    gint64 *key = g_new(gint64, 1);
+    GtkTreePath *path;
+
+    *key = cell_key(sheet_model_row_id(model, i), col);
+    g_hash_table_replace(model->cells, key, g_strdup(s));
+
+    path = sheet_model_get_path(GTK_TREE_MODEL(model), iter);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, iter);
+    gtk_tree_path_free(path);
+}
+
+/**
+ * sheet_model_insert_rows:
+ * @model: the model.
+ * @pos: 0-based position at which to insert rows; if this
+ * equals the current number of rows, the new rows are appended.
+ * @n: the number of rows to add.
+ *
+ * Adds @n empty rows to @model.
+ *
+ * Returns: 0 on success, non-zero on error.
+ */
+
+int sheet_model_insert_rows (SheetModel *model, int pos, int n)
+{
+    GtkTreePath *path;
+    GtkTreeIter iter;
+    int i;
+
+    if (pos < 0 || pos > model->nrows || n < 1) {
+	return E_INVARG;
+    }
+
+    if (model->rowmap != NULL || pos < model->nrows) {
+	/* we need an explicit mapping from rows to IDs */
+	int *map = realloc(model->rowmap, (model->nrows + n) * sizeof *map);
+
+	if (map == NULL) {
+	    return E_ALLOC;
+	}
+	if (model->rowmap == NULL) {
+	    model->rowmap = map;
+	    for (i=0; i<model->nrows; i++) {
+		map[i] = sheet_model_row_id(model, i);
+	    }
+	} else {
+	    model->rowmap = map;
+	}
+	memmove(map + pos + n, map + pos,
+		(model->nrows - pos) * sizeof *map);
+	for (i=0; i<n; i++) {
+	    map[pos+i] = -(model->nnew + i + 1);
+	}
+    }
+
+    model->nrows += n;
+    model->nnew += n;
+
+    iter.stamp = model->stamp;
+    for (i=0; i<n; i++) {
+	iter.user_data = GINT_TO_POINTER(pos + i);
+	path = sheet_model_get_path(GTK_TREE_MODEL(model), &iter);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+	gtk_tree_path_free(path);
+    }
+
+    return 0;
+}
+
+/**
+ * sheet_model_add_column:
+ * @model: the model.
+ *
+ * Adds a column for a new series, initially empty, at the
+ * right of @model.
+ */
+
+void sheet_model_add_column (SheetModel *model)
+{
+    model->ncols += 1;
+}
+
+/**
+ * sheet_model_rebase:
+ * @model: the model.
+ * @list: list of series now shown, one per column.
+ *
+ * To be called once the content of @model has been written
+ * back to the dataset, so that all rows and columns now have
+ * counterparts there: discards the record of edits and reverts
+ * to reading all values from the dataset.
+ *
+ * Returns: 0 on success, non-zero on error.
+ */
+
+int sheet_model_rebase (SheetModel *model, const int *list)
+{
+    int *mylist = gretl_list_copy(list);
+
+    if (mylist == NULL) {
+	return E_ALLOC;
+    }
+
+    free(model->list);
+    model->list = mylist;
+    model->ncols = list[0];
+
+    free(model->rowmap);
+    model->rowmap = NULL;
+    model->norig = model->nrows;
+    model->nnew = 0;
+    model->blank = FALSE;
+
+    g_hash_table_remove_all(model->cells);
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHEETMODEL_H
+#define SHEETMODEL_H
+
+/* A "virtual" GtkTreeModel for the data editor: cell strings are
+   produced on demand from the dataset, and only cells that have
+   been edited (or that belong to added rows or columns) are held
+   in the model itself.
+*/
+
+#define SHEET_TYPE_MODEL     (sheet_model_get_type())
+#define SHEET_MODEL(obj)     (G_TYPE_CHECK_INSTANCE_CAST((obj), SHEET_TYPE_MODEL, SheetModel))
+#define SHEET_IS_MODEL(obj)  (G_TYPE_CHECK_INSTANCE_TYPE((obj), SHEET_TYPE_MODEL))
+
+typedef struct _SheetModel SheetModel;
+typedef struct _SheetModelClass SheetModelClass;
+
+GType sheet_model_get_type (void);
+
+SheetModel *sheet_model_new (const DATASET *dset, const int *list,
+			     const char *numfmt, int digits,
+			     gboolean blank);
+
+int sheet_model_get_n_rows (SheetModel *model);
+
+void sheet_model_set_string (SheetModel *model, GtkTreeIter *iter,
+			     int col, const gchar *s);
+
+int sheet_model_insert_rows (SheetModel *model, int pos, int n);
+
+void sheet_model_add_column (SheetModel *model);
+
+int sheet_model_rebase (SheetModel *model, const int *list);
+
+#endif /* SHEETMODEL_H */
@@ -32,6 +32,7 @@
 #include "uservar.h"
 #include "matrix_extra.h"
 #include "gretl_cmatrix.h"
+#include "sheetmodel.h"
 
 #include <errno.h>
 #include <ctype.h>
@@ -108,6 +109,8 @@ typedef struct {
 static void set_up_sheet_column (GtkTreeViewColumn *column, gint width,
 				 gboolean expand);
 static gint get_data_col_width (void);
+static void fix_sheet_column_width (GtkTreeViewColumn *column,
+				    gint width);
 static int add_data_column (Spreadsheet *sheet);
 static void create_sheet_cell_renderers (Spreadsheet *sheet);
 
@@ -607,8 +610,13 @@ maybe_update_store (Spreadsheet *sheet, const gchar *new_text,
 #endif
 
     if (old_text == NULL || strcmp(old_text, new_text)) {
-	gtk_list_store_set(GTK_LIST_STORE(model), &iter,
-			   colnum, new_text, -1);
+	if (SHEET_IS_MODEL(model)) {
+	    sheet_model_set_string(SHEET_MODEL(model), &iter,
+				   colnum, new_text);
+	} else {
+	    gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+			       colnum, new_text, -1);
+	}
 
 	if (sheet->matrix != NULL) {
 	    update_sheet_matrix_element(sheet, new_text, path_string, colnum);
@@ -762,6 +770,9 @@ add_treeview_column_with_title (Spreadsheet *sheet, const char *name)
     column = gtk_tree_view_column_new();
     gtk_tree_view_column_set_title(column, name);
     set_up_sheet_column(column, get_data_col_width(), TRUE);
+    if (editing_series(sheet)) {
+	fix_sheet_column_width(column, 0);
+    }
 
     cols = gtk_tree_view_insert_column(GTK_TREE_VIEW(sheet->view), column, -1);
     colnum = cols - 1;
@@ -859,95 +870,53 @@ static void
 real_add_new_obs (Spreadsheet *sheet, const char *obsname, int n)
 {
     GtkTreeView *view = GTK_TREE_VIEW(sheet->view);
-    gint rownum = 0;
+    SheetModel *model;
     gint oldrows = sheet->datarows;
-    GtkListStore *store;
-    gchar *pstr = NULL;
-    GtkTreeIter iter;
-    gchar rowlabel[10];
-    gint i, j;
+    gint rownum, i;
 
-    store = GTK_LIST_STORE(gtk_tree_view_get_model(view));
+    model = SHEET_MODEL(gtk_tree_view_get_model(view));
 
     if (sheet->point == SHEET_AT_END) {
-	rownum = sheet->datarows - 1;
-	pstr = g_strdup_printf("%d", rownum);
-	for (i=0; i<n; i++) {
-	    gtk_list_store_append(store, &iter);
-	}
+	rownum = sheet->datarows;
     } else if (sheet->point == SHEET_AT_POINT) {
 	GtkTreePath *path;
 
 	gtk_tree_view_get_cursor(view, &path, NULL);
-	if (path != NULL) {
-	    rownum = gtk_tree_path_get_indices(path)[0];
-	    gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path);
-	    gtk_list_store_insert(store, &iter, rownum);
-	    gtk_tree_path_free(path);
+	if (path == NULL) {
+	    return;
 	}
+	rownum = gtk_tree_path_get_indices(path)[0];
+	gtk_tree_path_free(path);
+	n = 1;
     } else {
 	return;
     }
 
-    if (dataset->markers && obsname != NULL) {
-	gtk_list_store_set(store, &iter, 0, obsname, -1);
-    } else if (sheet->point == SHEET_AT_END) {
-	gtk_tree_model_get_iter_from_string(GTK_TREE_MODEL(store), &iter,
-					    pstr);
-	for (j=0; j<n; j++) {
-	    gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
-	    get_obs_string(rowlabel, sheet->datarows + j, dataset);
-	    gtk_list_store_set(store, &iter, 0, rowlabel, -1);
-	}
+    if (sheet_model_insert_rows(model, rownum, n)) {
+	nomem();
+	return;
     }
 
-    sheet->datarows += n;
+    if (dataset->markers && obsname != NULL) {
+	GtkTreeIter iter;
 
-    if (pstr != NULL) {
-	gtk_tree_model_get_iter_from_string(GTK_TREE_MODEL(store), &iter,
-					    pstr);
-	for (j=0; j<n; j++) {
-	    gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
-	    for (i=1; i<=sheet->datacols; i++) {
-		gtk_list_store_set(store, &iter, i, "", -1);
-	    }
-	}
-    } else {
-	for (i=1; i<=sheet->datacols; i++) {
-	    gtk_list_store_set(store, &iter, i, "", -1);
-	    sheet_push_edit(sheet, i, rownum);
-	}
+	gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(model), &iter,
+				      NULL, rownum);
+	sheet_model_set_string(model, &iter, 0, obsname);
     }
 
-    if (sheet->point == SHEET_AT_POINT) {
-	sheet_revise_edit_rows(sheet, rownum);
-	if (!dataset->markers) {
-	    for (i=rownum; i<sheet->datarows; i++) {
-		get_obs_string(rowlabel, i, dataset);
-		gtk_list_store_set(store, &iter, 0, rowlabel, -1);
-		gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
-	    }
-	}
-    }
+    sheet->datarows += n;
 
     if (sheet->point == SHEET_AT_END) {
 	spreadsheet_scroll_to_foot(sheet, oldrows, 1);
     } else {
-	GtkTreePath *path;
-	GtkTreeIter insiter;
-
-	pstr = g_strdup_printf("%d", rownum);
-	path = gtk_tree_path_new_from_string(pstr);
-	gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &insiter, path);
-	gtk_list_store_set(store, &insiter, 1, "", -1);
-	gtk_tree_path_free(path);
+	sheet_revise_edit_rows(sheet, rownum);
+	for (i=1; i<=sheet->datacols; i++) {
+	    sheet_push_edit(sheet, i, rownum);
+	}
 	sheet_push_insert(sheet, rownum);
     }
 
-    if (pstr != NULL) {
-	g_free(pstr);
-    }
-
     sheet_set_modified(sheet, TRUE);
 }
 
@@ -1096,57 +1065,17 @@ static GtkListStore *make_sheet_liststore (Spreadsheet *sheet)
     return store;
 }
 
-/* This is relatively complex because, so far as I can tell, you can't
-   append or insert additional columns in a GtkListStore: we have to
-   create a whole new liststore and copy the old info across.
-*/
+/* add an (empty) column for a new series */
 
 static int add_data_column (Spreadsheet *sheet)
 {
-    GtkListStore *old_store, *new_store;
-    GtkTreeIter old_iter, new_iter;
-    gint row;
-
-    sheet->datacols += 1;
-
-    /* get pointers to original and new stores */
-    new_store = make_sheet_liststore(sheet);
-    if (new_store == NULL) {
-	sheet->datacols -= 1;
-	sheet->totcols -= 1;
-	return E_ALLOC;
-    }
-
-    old_store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(sheet->view)));
-
-    /* go to start of old and new lists */
-    gtk_tree_model_get_iter_first(GTK_TREE_MODEL(old_store), &old_iter);
-    gtk_tree_model_get_iter_first(GTK_TREE_MODEL(new_store), &new_iter);
-
-    /* construct the new table */
-    for (row=0; row<sheet->datarows; row++) {
-	gchar *str;
-	int col;
-
-	gtk_list_store_append(new_store, &new_iter);
-
-	for (col=0; col<sheet->totcols; col++) {
-	    if (col < sheet->datacols) {
-		/* copy labels and original data */
-		gtk_tree_model_get(GTK_TREE_MODEL(old_store), &old_iter, col, &str, -1);
-		gtk_list_store_set(new_store, &new_iter, col, str, -1);
-		g_free(str);
-	    } else {
-		/* new data values: set blank */
-		gtk_list_store_set(new_store, &new_iter, col, "", -1);
-	    }
-	}
-	gtk_tree_model_iter_next(GTK_TREE_MODEL(old_store), &old_iter);
-    }
+    GtkTreeModel *model;
 
-    gtk_tree_view_set_model(GTK_TREE_VIEW(sheet->view), GTK_TREE_MODEL(new_store));
-    g_object_unref(G_OBJECT(new_store));
+    model = gtk_tree_view_get_model(GTK_TREE_VIEW(sheet->view));
+    sheet_model_add_column(SHEET_MODEL(model));
 
+    sheet->datacols += 1;
+    sheet->totcols += 1;
     sheet->added_vars += 1;
 
 #if SSDEBUG
@@ -1649,6 +1578,10 @@ static void update_dataset_from_sheet (Spreadsheet *sheet)
     sheet_set_modified(sheet, FALSE);
     sheet->added_vars -= newvars; /* record that these are handled */
     sheet->orig_nobs += newobs;   /* and these too */
+
+    /* the sheet's content is now all in the dataset */
+    sheet_model_rebase(SHEET_MODEL(model), sheet->varlist);
+    gtk_widget_queue_draw(sheet->view);
 }
 
 static void matrix_new_name (GtkWidget *w, dialog_t *dlg)
@@ -2085,72 +2018,76 @@ static void maybe_update_scalars_sheet (Spreadsheet *sheet)
     }
 }
 
+/* When sizing the columns of the data editor we don't want to
+   format every value in a big dataset, so we look at a sample of
+   observations spread evenly across the range (always including
+   the first and last).
+*/
+
+#define WIDTH_SAMPLE 500
+
 static int add_data_to_sheet (Spreadsheet *sheet, SheetCmd c)
 {
-    gchar rowlabel[OBSLEN];
     GtkTreeView *view = GTK_TREE_VIEW(sheet->view);
-    GtkTreeIter iter;
-    GtkListStore *store;
-    int i, t;
+    GtkTreeViewColumn *col;
+    char obs[OBSLEN], widest[OBSLEN];
+    char numstr[32];
+    int i, t, step;
 
 #if SSDEBUG
     fprintf(stderr, "Doing add_data_to_sheet\n");
 #endif
 
-    store = GTK_LIST_STORE(gtk_tree_view_get_model(view));
-
-    /* insert observation markers */
-
-    gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter);
-    for (t=dataset->t1; t<=dataset->t2; t++) {
-	get_obs_string(rowlabel, t, dataset);
-	gtk_list_store_append(store, &iter);
-	gtk_list_store_set(store, &iter, 0, rowlabel, -1);
-    }
+    /* the data values themselves are supplied on demand by
+       the sheet model: here we just size the columns
+    */
 
     sheet->datarows = dataset->t2 - dataset->t1 + 1;
+    step = sheet->datarows / WIDTH_SAMPLE;
+    if (step < 1) {
+	step = 1;
+    }
 
-    /* insert data values */
-
-    if (c == SHEET_NEW_DATASET) {
-	gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter);
-	for (t=dataset->t1; t<=dataset->t2; t++) {
-	    gtk_list_store_set(store, &iter, 1, "", -1);
+    *widest = '\0';
+    for (t=dataset->t1; t<=dataset->t2; t+=step) {
+	if (t > dataset->t2 - step) {
+	    /* make sure we get the last obs */
+	    t = dataset->t2;
 	}
-	gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
-    } else {
-	GtkTreeViewColumn *col;
-	int vi, numlen, maxwidth;
-	char numstr[32];
+	get_obs_string(obs, t, dataset);
+	if (strlen(obs) > strlen(widest)) {
+	    strcpy(widest, obs);
+	}
+    }
+    col = gtk_tree_view_get_column(view, 0);
+    fix_sheet_column_width(col, get_string_width(widest));
 
-	for (i=1; i<=sheet->varlist[0]; i++) {
-	    maxwidth = 0;
-	    vi = sheet->varlist[i];
-	    gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter);
-	    for (t=dataset->t1; t<=dataset->t2; t++) {
-		if (na(dataset->Z[vi][t])) {
-		    *numstr = '\0';
-		} else {
-		    sprintf(numstr, sheet->numfmt, sheet->digits,
-			    dataset->Z[vi][t]);
-		    numlen = strlen(numstr);
-		    if (numlen > maxwidth) {
-			maxwidth = numlen;
-		    }
+    for (i=1; i<=sheet->varlist[0]; i++) {
+	int vi = sheet->varlist[i];
+	int numlen, maxlen = 0;
+
+	if (c != SHEET_NEW_DATASET) {
+	    for (t=dataset->t1; t<=dataset->t2; t+=step) {
+		if (t > dataset->t2 - step) {
+		    t = dataset->t2;
+		}
+		if (!na(dataset->Z[vi][t])) {
+		    numlen = snprintf(numstr, sizeof numstr, sheet->numfmt,
+				      sheet->digits, dataset->Z[vi][t]);
+		    maxlen = MAX(maxlen, numlen);
 		}
-		gtk_list_store_set(store, &iter, i, numstr, -1);
-		gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
-	    }
-	    col = gtk_tree_view_get_column(view, i);
-	    memset(numstr, 0, sizeof numstr);
-	    for (t=0; t<maxwidth; t++) {
-		numstr[t] = '0';
 	    }
-	    maxwidth = get_string_width(numstr);
-	    gtk_tree_view_column_set_max_width(col, 4 + maxwidth);
 	}
+	col = gtk_tree_view_get_column(view, i);
+	memset(numstr, 0, sizeof numstr);
+	for (t=0; t<maxlen && t<31; t++) {
+	    numstr[t] = '0';
+	}
+	fix_sheet_column_width(col, get_string_width(numstr));
     }
 
+    gtk_tree_view_set_fixed_height_mode(view, TRUE);
+
     sheet->orig_main_v = dataset->v;
 
 #if SSDEBUG
@@ -2255,6 +2192,27 @@ set_up_sheet_column (GtkTreeViewColumn *column, gint width, gboolean expand)
     gtk_tree_view_column_set_expand(column, expand);
 }
 
+/* In the data editor the columns must have fixed sizing, so that
+   the view doesn't have to measure every row in the dataset: we
+   use the larger of the column's minimum width, the width of its
+   title and @width (the width of its content, if known).
+*/
+
+static void fix_sheet_column_width (GtkTreeViewColumn *column,
+				    gint width)
+{
+    const gchar *title = gtk_tree_view_column_get_title(column);
+    gint w = gtk_tree_view_column_get_min_width(column);
+
+    if (title != NULL && *title != '\0') {
+	w = MAX(w, get_string_width(title) + 12);
+    }
+    w = MAX(w, width + 8);
+
+    gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(column, w);
+}
+
 static void commit_and_move_right (Spreadsheet *sheet,
 				   const char *s)
 {
@@ -2646,9 +2604,23 @@ static int build_sheet_view (Spreadsheet *sheet)
 	sheet->flags |= SHEET_USE_COMMA;
     }
 
-    store = make_sheet_liststore(sheet);
-    view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
-    g_object_unref(G_OBJECT(store));
+    if (editing_series(sheet)) {
+	SheetModel *model;
+
+	sheet->totcols = sheet->datacols + 1;
+	model = sheet_model_new(dataset, sheet->varlist, sheet->numfmt,
+				sheet->digits,
+				sheet->cmd == SHEET_NEW_DATASET);
+	if (model == NULL) {
+	    return E_ALLOC;
+	}
+	view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+	g_object_unref(G_OBJECT(model));
+    } else {
+	store = make_sheet_liststore(sheet);
+	view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	g_object_unref(G_OBJECT(store));
+    }
 
     gtk_tree_view_set_rules_hint(GTK_TREE_VIEW(view), FALSE);
     gtk_tree_view_set_grid_lines(GTK_TREE_VIEW(view), GTK_TREE_VIEW_GRID_LINES_BOTH);
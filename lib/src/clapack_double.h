@@ -1422,6 +1422,12 @@ void dgemm_ (const char *TRANSA, const char *TRANSB,
 	     const double *B, const integer *LDB,
 	     const double *BETA, double *C, const integer *LDC);
 
+void sgemm_ (const char *TRANSA, const char *TRANSB,
+	     const integer *M, const integer *N, const integer *K,
+	     const float *ALPHA, const float *A, const integer *LDA,
+	     const float *B, const integer *LDB,
+	     const float *BETA, float *C, const integer *LDC);
+
 void dsyrk_ (const char *UPLO, const char *TRANS, const integer *N,
 	     const integer *K, const double *ALPHA, const double *A,
 	     const integer *LDA, const double *BETA, double *C,
@@ -1617,8 +1617,10 @@ static double *interpolate_db_series (const double *src,
     gretl_matrix_free(y);
 
     if (!*err) {
-	ret = yx->val;
-	yx->val = NULL;
+	ret = gretl_matrix_steal_data(yx);
+	if (ret == NULL) {
+	    *err = E_ALLOC;
+	}
     }
 
     gretl_matrix_free(yx);
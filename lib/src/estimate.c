@@ -34,6 +34,10 @@
 # include "gretl_win32.h"
 #endif
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 /**
  * SECTION:estimate
  * @short_description: estimation of regression models
@@ -645,6 +649,194 @@ void maybe_shift_ldepvar (MODEL *pmod, DATASET *dset)
     }
 }
 
+/* Blocked accumulation of X'X and X'y, for models with many
+   regressors and observations. Rather than making a pass through
+   the data for each (i,j) pair of regressors, we gather the
+   (transformed) data for a block of observations into a compact
+   panel -- sized to stay in cache -- and cumulate its
+   cross-product in a single matrix operation. Under OpenMP the
+   blocks are shared out among threads, each with its own
+   cumulator, and the partial sums are added at the end.
+*/
+
+#define XTX_KMIN 16        /* min. regressors for blocked method */
+#define XTX_PANEL 32768    /* target panel size, in doubles */
+
+static int XTX_XTy_blocked (const int *list, int lmin,
+			    int t1, int t2,
+			    const DATASET *dset,
+			    const double *w,
+			    double rho, int pwe, double pw1,
+			    double *xpx, double *xpy,
+			    const char *mask)
+{
+    int nx = list[0] - lmin + 1;
+    int nc = nx + (xpy != NULL);
+    int qdiff = (rho != 0.0);
+    const double **src;
+    gretl_matrix **S, **P;
+    int *idx;
+    int brows, nblocks;
+    int nt = 1;
+    int b, i, j, m;
+    double x;
+    int err = 0;
+
+    brows = XTX_PANEL / nc;
+    if (brows < 64) {
+	brows = 64;
+    } else if (brows > 4096) {
+	brows = 4096;
+    }
+    nblocks = (t2 - t1 + brows) / brows;
+
+#if defined(_OPENMP)
+    if (nblocks > 1 &&
+	libset_use_openmp((guint64) (t2 - t1 + 1) * nc * nc)) {
+	nt = get_omp_n_threads();
+	if (nt > nblocks) {
+	    nt = nblocks;
+	}
+    }
+#endif
+
+    src = malloc(nc * sizeof *src);
+    idx = malloc(nt * brows * sizeof *idx);
+    S = calloc(nt, sizeof *S);
+    P = calloc(nt, sizeof *P);
+
+    if (src == NULL || idx == NULL || S == NULL || P == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    for (i=0; i<nx; i++) {
+	src[i] = dset->Z[list[i+lmin]];
+    }
+    if (xpy != NULL) {
+	/* the dependent variable goes in the last column */
+	src[nx] = dset->Z[list[1]];
+    }
+
+    for (i=0; i<nt && !err; i++) {
+	S[i] = gretl_zero_matrix_new(nc, nc);
+	P[i] = gretl_matrix_alloc(brows, nc);
+	if (S[i] == NULL || P[i] == NULL) {
+	    err = E_ALLOC;
+	}
+    }
+
+    if (err) {
+	goto bailout;
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(b, i, j, x) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+    for (b=0; b<nblocks; b++) {
+	int tnum = 0;
+	int *bidx;
+	gretl_matrix *Pb;
+	int s, t, r = 0;
+	int bt2;
+
+#if defined(_OPENMP)
+	tnum = omp_get_thread_num();
+#endif
+	bidx = idx + tnum * brows;
+	Pb = P[tnum];
+
+	s = t1 + b * brows;
+	bt2 = s + brows - 1;
+	if (bt2 > t2) {
+	    bt2 = t2;
+	}
+
+	/* record the usable observations in this block; note that
+	   the mask is not applied when quasi-differencing */
+	for (t=s; t<=bt2; t++) {
+	    if (qdiff || !masked(mask, t)) {
+		bidx[r++] = t;
+	    }
+	}
+	if (r == 0) {
+	    continue;
+	}
+
+	gretl_matrix_reuse(Pb, r, nc);
+
+	for (j=0; j<nc; j++) {
+	    const double *xj = src[j];
+	    double *pj = Pb->val + j * r;
+
+	    for (i=0; i<r; i++) {
+		t = bidx[i];
+		if (qdiff) {
+		    if (pwe && t == t1) {
+			x = pw1 * xj[t];
+		    } else {
+			x = xj[t] - rho * xj[t-1];
+		    }
+		} else if (w != NULL) {
+		    x = sqrt(w[t]) * xj[t];
+		} else {
+		    x = xj[t];
+		}
+		pj[i] = x;
+	    }
+	}
+
+	if (nt > 1) {
+	    gretl_matrix_multiply_mod_single(Pb, GRETL_MOD_TRANSPOSE,
+					     Pb, GRETL_MOD_NONE,
+					     S[tnum], GRETL_MOD_CUMULATE);
+	} else {
+	    gretl_matrix_multiply_mod(Pb, GRETL_MOD_TRANSPOSE,
+				      Pb, GRETL_MOD_NONE,
+				      S[tnum], GRETL_MOD_CUMULATE);
+	}
+    }
+
+    for (i=1; i<nt; i++) {
+	gretl_matrix_add_to(S[0], S[i]);
+    }
+
+    /* transcribe into the packed X'X and X'y */
+    m = 0;
+    for (i=0; i<nx && !err; i++) {
+	for (j=i; j<nx; j++) {
+	    x = gretl_matrix_get(S[0], i, j);
+	    if (i == j && x < DBL_EPSILON) {
+		err = E_SINGULAR;
+		break;
+	    }
+	    xpx[m++] = x;
+	}
+	if (xpy != NULL) {
+	    xpy[i] = gretl_matrix_get(S[0], i, nx);
+	}
+    }
+
+ bailout:
+
+    if (S != NULL) {
+	for (i=0; i<nt; i++) {
+	    gretl_matrix_free(S[i]);
+	}
+    }
+    if (P != NULL) {
+	for (i=0; i<nt; i++) {
+	    gretl_matrix_free(P[i]);
+	}
+    }
+    free(S);
+    free(P);
+    free(src);
+    free(idx);
+
+    return err;
+}
+
 /*
  * XTX_XTy:
  * @list: list of variables in model.
@@ -733,6 +925,12 @@ static int XTX_XTy (const int *list, int t1, int t2,
 	}
     }
 
+    if (lmax - lmin + 1 >= XTX_KMIN && t2 - t1 + 1 >= XTX_PANEL / 16) {
+	/* many regressors and observations: use the blocked method */
+	return XTX_XTy_blocked(list, lmin, t1, t2, dset, w, rho,
+			       pwe, pw1, xpx, xpy, mask);
+    }
+
     m = 0;
 
     if (qdiff) {
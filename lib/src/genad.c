@@ -0,0 +1,990 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Forward-mode automatic differentiation of the syntax trees of
+   compiled genrs, with respect to a set of named scalar or vector
+   parameters. This is used by mle and nls in place of numerical
+   derivatives when the user has not supplied analytical ones.
+
+   Each node of a tree is evaluated to a value (scalar, series or
+   matrix) together with its derivatives with respect to all k
+   coefficients. We support a limited set of operators and
+   functions, namely those for which the derivatives are simple
+   and the semantics unambiguous; on encountering anything else
+   we return E_NOTIMP and the caller should revert to numerical
+   differentiation.
+*/
+
+#include "genparse.h"
+#include "usermat.h"
+#include "gretl_normal.h"
+#include "genad.h"
+
+#define ADDEBUG 0
+
+typedef struct adval_ adval;
+
+struct adval_ {
+    int rows;    /* rows of value */
+    int cols;    /* columns of value */
+    int series;  /* value is a series over the sample range */
+    double *x;   /* values, in column-major order */
+    double *dx;  /* derivatives: (rows * cols) x k, or NULL if
+		    the value does not depend on the parameters */
+};
+
+typedef struct adtrack_ adtrack;
+
+/* variable assigned by an auxiliary genr */
+struct adtrack_ {
+    char name[VNAMELEN];
+    adval val;
+};
+
+struct ad_info_ {
+    GENERATOR **genrs; /* auxiliary genrs, then criterion (not owned) */
+    int ngenrs;        /* number of generators */
+    char **pnames;     /* names of parameters */
+    GretlType *ptypes; /* types of parameters (scalar or matrix) */
+    int *pcol;         /* offset of each parameter in the full set */
+    int np;            /* number of parameters */
+    int k;             /* total number of coefficients */
+    int t1, t2;        /* sample range */
+    DATASET *dset;     /* the dataset */
+    adtrack *trk;      /* values of auxiliary variables */
+    int ntrk;          /* number of the above */
+};
+
+static void adval_clear (adval *v)
+{
+    free(v->x);
+    free(v->dx);
+    v->x = v->dx = NULL;
+    v->rows = v->cols = 0;
+    v->series = 0;
+}
+
+static int adval_alloc (adval *v, int rows, int cols,
+			int series, int k, int deriv)
+{
+    int n = rows * cols;
+
+    v->rows = rows;
+    v->cols = cols;
+    v->series = series;
+    v->x = malloc(n * sizeof *v->x);
+    v->dx = NULL;
+
+    if (v->x == NULL) {
+	return E_ALLOC;
+    }
+
+    if (deriv) {
+	v->dx = calloc(n * k, sizeof *v->dx);
+	if (v->dx == NULL) {
+	    free(v->x);
+	    v->x = NULL;
+	    return E_ALLOC;
+	}
+    }
+
+    return 0;
+}
+
+static int adval_copy (adval *targ, const adval *src, int k)
+{
+    int n = src->rows * src->cols;
+    int err;
+
+    err = adval_alloc(targ, src->rows, src->cols, src->series,
+		      k, src->dx != NULL);
+    if (!err) {
+	memcpy(targ->x, src->x, n * sizeof *src->x);
+	if (src->dx != NULL) {
+	    memcpy(targ->dx, src->dx, n * k * sizeof *src->dx);
+	}
+    }
+
+    return err;
+}
+
+static int is_scalar_val (const adval *v)
+{
+    return !v->series && v->rows == 1 && v->cols == 1;
+}
+
+static int param_index (ad_info *ad, const char *name, GretlType t)
+{
+    int i;
+
+    for (i=0; i<ad->np; i++) {
+	if (ad->ptypes[i] == t && !strcmp(name, ad->pnames[i])) {
+	    return i;
+	}
+    }
+
+    return -1;
+}
+
+static adval *tracked_value (ad_info *ad, const char *name)
+{
+    int i;
+
+    for (i=0; i<ad->ntrk; i++) {
+	if (!strcmp(name, ad->trk[i].name)) {
+	    return &ad->trk[i].val;
+	}
+    }
+
+    return NULL;
+}
+
+/* terminal nodes: parameters, other named variables and
+   constants */
+
+static int ad_leaf (NODE *n, ad_info *ad, adval *ret)
+{
+    int T = ad->t2 - ad->t1 + 1;
+    int k = ad->k;
+    adval *tv = NULL;
+    int i, j, err = 0;
+
+    if (n->vname != NULL) {
+	tv = tracked_value(ad, n->vname);
+	if (tv != NULL) {
+	    if ((n->t == SERIES && !tv->series) ||
+		(n->t != SERIES && tv->series)) {
+		return E_NOTIMP;
+	    }
+	    return adval_copy(ret, tv, k);
+	}
+    }
+
+    if (n->t == NUM) {
+	double x = n->v.xval;
+
+	if (n->vname != NULL) {
+	    i = param_index(ad, n->vname, GRETL_TYPE_DOUBLE);
+	    x = gretl_scalar_get_value(n->vname, &err);
+	    if (err) {
+		return E_NOTIMP;
+	    }
+	    err = adval_alloc(ret, 1, 1, 0, k, i >= 0);
+	    if (!err && i >= 0) {
+		ret->dx[ad->pcol[i]] = 1.0;
+	    }
+	} else {
+	    err = adval_alloc(ret, 1, 1, 0, k, 0);
+	}
+	if (!err) {
+	    ret->x[0] = x;
+	}
+    } else if (n->t == CON) {
+	double x = get_const_by_name(constname(n->v.idnum), &err);
+
+	if (err) {
+	    return E_NOTIMP;
+	}
+	err = adval_alloc(ret, 1, 1, 0, k, 0);
+	if (!err) {
+	    ret->x[0] = x;
+	}
+    } else if (n->t == SERIES) {
+	int v = n->vnum;
+
+	if (n->vname != NULL) {
+	    v = current_series_index(ad->dset, n->vname);
+	}
+	if (v < 0 || v >= ad->dset->v) {
+	    return E_NOTIMP;
+	}
+	err = adval_alloc(ret, T, 1, 1, k, 0);
+	if (!err) {
+	    memcpy(ret->x, ad->dset->Z[v] + ad->t1, T * sizeof(double));
+	}
+    } else if (n->t == MAT && n->vname != NULL) {
+	gretl_matrix *m = get_matrix_by_name(n->vname);
+	int nm;
+
+	if (m == NULL || m->is_complex) {
+	    return E_NOTIMP;
+	}
+	nm = m->rows * m->cols;
+	i = param_index(ad, n->vname, GRETL_TYPE_MATRIX);
+	err = adval_alloc(ret, m->rows, m->cols, 0, k, i >= 0);
+	if (!err) {
+	    memcpy(ret->x, m->val, nm * sizeof(double));
+	    if (i >= 0) {
+		/* derivative of element j wrt coefficient j */
+		for (j=0; j<nm; j++) {
+		    ret->dx[j + (ad->pcol[i] + j) * nm] = 1.0;
+		}
+	    }
+	}
+    } else {
+	err = E_NOTIMP;
+    }
+
+    return err;
+}
+
+enum {
+    AD_ADD,
+    AD_SUB,
+    AD_MUL,
+    AD_DIV,
+    AD_POW
+};
+
+/* element-by-element binary operation, where @a and @b are of
+   the same dimensions or one of them is a scalar */
+
+static int ad_elementwise (adval *a, adval *b, int op,
+			   adval *ret, int k)
+{
+    int na = a->rows * a->cols;
+    int nb = b->rows * b->cols;
+    const adval *shape;
+    double xa, xb, f, fa, fb, d;
+    int i, j, n, ia, ib;
+    int err;
+
+    if (a->rows == b->rows && a->cols == b->cols &&
+	a->series == b->series) {
+	shape = a;
+    } else if (is_scalar_val(a)) {
+	shape = b;
+    } else if (is_scalar_val(b)) {
+	shape = a;
+    } else {
+	/* series mixed with non-scalar matrix, or broadcasting */
+	return E_NOTIMP;
+    }
+
+    n = shape->rows * shape->cols;
+    err = adval_alloc(ret, shape->rows, shape->cols, shape->series,
+		      k, a->dx != NULL || b->dx != NULL);
+    if (err) {
+	return err;
+    }
+
+    for (i=0; i<n; i++) {
+	ia = (na == 1)? 0 : i;
+	ib = (nb == 1)? 0 : i;
+	xa = a->x[ia];
+	xb = b->x[ib];
+	switch (op) {
+	case AD_ADD:
+	    f = xa + xb;
+	    fa = 1.0;
+	    fb = 1.0;
+	    break;
+	case AD_SUB:
+	    f = xa - xb;
+	    fa = 1.0;
+	    fb = -1.0;
+	    break;
+	case AD_MUL:
+	    f = xa * xb;
+	    fa = xb;
+	    fb = xa;
+	    break;
+	case AD_DIV:
+	    f = xa / xb;
+	    fa = 1.0 / xb;
+	    fb = -f / xb;
+	    break;
+	default:
+	    /* AD_POW */
+	    f = pow(xa, xb);
+	    fa = (xb == 0.0)? 0.0 : xb * pow(xa, xb - 1.0);
+	    fb = (b->dx == NULL)? 0.0 : f * log(xa);
+	    break;
+	}
+	ret->x[i] = f;
+	if (ret->dx != NULL) {
+	    for (j=0; j<k; j++) {
+		d = 0.0;
+		if (a->dx != NULL) {
+		    d += fa * a->dx[ia + j*na];
+		}
+		if (b->dx != NULL) {
+		    d += fb * b->dx[ib + j*nb];
+		}
+		ret->dx[i + j*n] = d;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+/* matrix product: C = op(A) * B, where op(A) is either A or its
+   transpose. Writing dA_j and dB_j for the derivatives of A and B
+   with respect to coefficient j, we have dC_j = op(dA_j) * B +
+   op(A) * dB_j. Note that the array of derivatives of B, laid
+   out as (m * c) x k, can be treated as an m x (c * k) matrix,
+   so the second term can be computed for all j at once.
+*/
+
+static int ad_matmul (adval *a, adval *b, int tra,
+		      adval *ret, int k)
+{
+    GretlMatrixMod amod = tra ? GRETL_MOD_TRANSPOSE : GRETL_MOD_NONE;
+    gretl_matrix A, B, C, dA, dB, dC;
+    int r = tra ? a->cols : a->rows;
+    int m = tra ? a->rows : a->cols;
+    int c = b->cols;
+    int j, err;
+
+    if (a->series || b->series || m != b->rows) {
+	return E_NOTIMP;
+    }
+
+    err = adval_alloc(ret, r, c, 0, k, a->dx != NULL || b->dx != NULL);
+    if (err) {
+	return err;
+    }
+
+    gretl_matrix_init_full(&A, a->rows, a->cols, a->x);
+    gretl_matrix_init_full(&B, b->rows, b->cols, b->x);
+    gretl_matrix_init_full(&C, r, c, ret->x);
+    err = gretl_matrix_multiply_mod(&A, amod, &B, GRETL_MOD_NONE,
+				    &C, GRETL_MOD_NONE);
+
+    if (!err && b->dx != NULL) {
+	gretl_matrix_init_full(&dB, m, c * k, b->dx);
+	gretl_matrix_init_full(&dC, r, c * k, ret->dx);
+	err = gretl_matrix_multiply_mod(&A, amod, &dB, GRETL_MOD_NONE,
+					&dC, GRETL_MOD_CUMULATE);
+    }
+
+    if (!err && a->dx != NULL) {
+	int na = a->rows * a->cols;
+
+	for (j=0; j<k && !err; j++) {
+	    gretl_matrix_init_full(&dA, a->rows, a->cols, a->dx + j * na);
+	    gretl_matrix_init_full(&dC, r, c, ret->dx + j * r * c);
+	    err = gretl_matrix_multiply_mod(&dA, amod, &B, GRETL_MOD_NONE,
+					    &dC, GRETL_MOD_CUMULATE);
+	}
+    }
+
+    return err;
+}
+
+static int ad_binary (NODE *n, adval *a, adval *b, adval *ret, int k)
+{
+    int scalars = is_scalar_val(a) || is_scalar_val(b);
+    int matrices = !a->series && !b->series;
+
+    switch (n->t) {
+    case B_ADD:
+    case B_DOTADD:
+	return ad_elementwise(a, b, AD_ADD, ret, k);
+    case B_SUB:
+    case B_DOTSUB:
+	return ad_elementwise(a, b, AD_SUB, ret, k);
+    case B_MUL:
+	if (matrices && !scalars) {
+	    return ad_matmul(a, b, 0, ret, k);
+	}
+	return ad_elementwise(a, b, AD_MUL, ret, k);
+    case B_DOTMULT:
+	return ad_elementwise(a, b, AD_MUL, ret, k);
+    case B_TRMUL:
+	return ad_matmul(a, b, 1, ret, k);
+    case B_DIV:
+	if (matrices && !is_scalar_val(b)) {
+	    /* matrix "division" is not element-wise */
+	    return E_NOTIMP;
+	}
+	return ad_elementwise(a, b, AD_DIV, ret, k);
+    case B_DOTDIV:
+	return ad_elementwise(a, b, AD_DIV, ret, k);
+    case B_POW:
+	if (matrices && !is_scalar_val(a)) {
+	    /* matrix power */
+	    return E_NOTIMP;
+	}
+	return ad_elementwise(a, b, AD_POW, ret, k);
+    case B_DOTPOW:
+	return ad_elementwise(a, b, AD_POW, ret, k);
+    default:
+	return E_NOTIMP;
+    }
+}
+
+/* element-by-element function: we overwrite @v with f(v) and
+   scale its derivatives by f'(v) */
+
+static int ad_math_func (adval *v, int f, int k)
+{
+    int n = v->rows * v->cols;
+    double x, y, d;
+    int i, j;
+
+    for (i=0; i<n; i++) {
+	x = v->x[i];
+	switch (f) {
+	case U_NEG:
+	    y = -x;
+	    d = -1.0;
+	    break;
+	case U_POS:
+	    y = x;
+	    d = 1.0;
+	    break;
+	case F_ABS:
+	    y = fabs(x);
+	    d = (x > 0)? 1.0 : (x < 0)? -1.0 : 0.0;
+	    break;
+	case F_SIN:
+	    y = sin(x);
+	    d = cos(x);
+	    break;
+	case F_COS:
+	    y = cos(x);
+	    d = -sin(x);
+	    break;
+	case F_TAN:
+	    y = tan(x);
+	    d = 1.0 + y * y;
+	    break;
+	case F_ATAN:
+	    y = atan(x);
+	    d = 1.0 / (1.0 + x * x);
+	    break;
+	case F_SINH:
+	    y = sinh(x);
+	    d = cosh(x);
+	    break;
+	case F_COSH:
+	    y = cosh(x);
+	    d = sinh(x);
+	    break;
+	case F_TANH:
+	    y = tanh(x);
+	    d = 1.0 - y * y;
+	    break;
+	case F_LOG:
+	    y = log(x);
+	    d = 1.0 / x;
+	    break;
+	case F_LOG10:
+	    y = log10(x);
+	    d = 1.0 / (x * log(10.0));
+	    break;
+	case F_LOG2:
+	    y = log2(x);
+	    d = 1.0 / (x * log(2.0));
+	    break;
+	case F_EXP:
+	    y = d = exp(x);
+	    break;
+	case F_SQRT:
+	    y = sqrt(x);
+	    d = 0.5 / y;
+	    break;
+	case F_GAMMA:
+	    y = gammafun(x);
+	    d = y * digamma(x);
+	    break;
+	case F_LNGAMMA:
+	    y = lngamma(x);
+	    d = digamma(x);
+	    break;
+	case F_CNORM:
+	    y = normal_cdf(x);
+	    d = normal_pdf(x);
+	    break;
+	case F_DNORM:
+	    y = normal_pdf(x);
+	    d = -x * y;
+	    break;
+	case F_LOGISTIC:
+	    y = logistic_cdf(x);
+	    d = y * (1.0 - y);
+	    break;
+	case F_INVMILLS:
+	    y = invmills(x);
+	    d = y * (y - x);
+	    break;
+	default:
+	    return E_NOTIMP;
+	}
+	v->x[i] = y;
+	if (v->dx != NULL) {
+	    for (j=0; j<k; j++) {
+		v->dx[i + j*n] *= d;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+/* sum(), sumc(), sumr() */
+
+static int ad_sum (adval *a, int f, adval *ret, int k)
+{
+    int r = a->rows, c = a->cols;
+    int na = r * c;
+    int i, j, s, nr;
+    int err;
+
+    if (f == F_SUM) {
+	if (!a->series && r > 1 && c > 1) {
+	    return E_NOTIMP;
+	}
+	err = adval_alloc(ret, 1, 1, 0, k, a->dx != NULL);
+    } else if (a->series) {
+	return E_NOTIMP;
+    } else if (f == F_SUMC) {
+	err = adval_alloc(ret, 1, c, 0, k, a->dx != NULL);
+    } else {
+	err = adval_alloc(ret, r, 1, 0, k, a->dx != NULL);
+    }
+
+    if (err) {
+	return err;
+    }
+
+    nr = ret->rows * ret->cols;
+    for (i=0; i<nr; i++) {
+	ret->x[i] = 0.0;
+    }
+
+    /* element i of @a is (row i % r, col i / r) */
+    for (i=0; i<na; i++) {
+	s = (f == F_SUM)? 0 : (f == F_SUMC)? i / r : i % r;
+	ret->x[s] += a->x[i];
+	if (a->dx != NULL) {
+	    for (j=0; j<k; j++) {
+		ret->dx[s + j*nr] += a->dx[i + j*na];
+	    }
+	}
+    }
+
+    return 0;
+}
+
+static int ad_transpose (adval *a, adval *ret, int k)
+{
+    int r = a->rows, c = a->cols;
+    int n = r * c;
+    int i, j, s;
+    int err;
+
+    if (a->series) {
+	return E_NOTIMP;
+    }
+
+    err = adval_alloc(ret, c, r, 0, k, a->dx != NULL);
+
+    for (i=0; i<r && !err; i++) {
+	for (s=0; s<c; s++) {
+	    ret->x[s + i*c] = a->x[i + s*r];
+	    if (a->dx != NULL) {
+		for (j=0; j<k; j++) {
+		    ret->dx[s + i*c + j*n] = a->dx[i + s*r + j*n];
+		}
+	    }
+	}
+    }
+
+    return err;
+}
+
+static int ad_supported_func (int f)
+{
+    switch (f) {
+    case F_ABS:
+    case F_SIN:
+    case F_COS:
+    case F_TAN:
+    case F_ATAN:
+    case F_SINH:
+    case F_COSH:
+    case F_TANH:
+    case F_LOG:
+    case F_LOG10:
+    case F_LOG2:
+    case F_EXP:
+    case F_SQRT:
+    case F_GAMMA:
+    case F_LNGAMMA:
+    case F_CNORM:
+    case F_DNORM:
+    case F_LOGISTIC:
+    case F_INVMILLS:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+static int ad_eval (NODE *n, ad_info *ad, adval *ret)
+{
+    adval l = {0};
+    adval r = {0};
+    int k = ad->k;
+    int err = 0;
+
+    if (n == NULL) {
+	return E_NOTIMP;
+    }
+
+    if (n->t == NUM || n->t == SERIES || n->t == MAT || n->t == CON) {
+	return ad_leaf(n, ad, ret);
+    }
+
+    if (n->M != NULL || n->L == NULL) {
+	return E_NOTIMP;
+    }
+
+    if (n->t == U_NEG || n->t == U_POS || ad_supported_func(n->t)) {
+	if (n->R != NULL) {
+	    return E_NOTIMP;
+	}
+	err = ad_eval(n->L, ad, ret);
+	if (!err) {
+	    err = ad_math_func(ret, n->t, k);
+	}
+    } else if (n->t == F_SUM || n->t == F_SUMC || n->t == F_SUMR ||
+	       n->t == F_TRANSP) {
+	if (n->R != NULL && n->R->t != EMPTY) {
+	    return E_NOTIMP;
+	}
+	err = ad_eval(n->L, ad, &l);
+	if (!err && n->t == F_TRANSP) {
+	    err = ad_transpose(&l, ret, k);
+	} else if (!err) {
+	    err = ad_sum(&l, n->t, ret, k);
+	}
+    } else if (n->t > U_MAX && n->t < OP_MAX && n->R != NULL) {
+	err = ad_eval(n->L, ad, &l);
+	if (!err) {
+	    err = ad_eval(n->R, ad, &r);
+	}
+	if (!err) {
+	    err = ad_binary(n, &l, &r, ret, k);
+	}
+    } else {
+	err = E_NOTIMP;
+    }
+
+#if ADDEBUG
+    if (err) {
+	fprintf(stderr, "ad_eval: node %s, err = %d\n", getsymb(n->t), err);
+    }
+#endif
+
+    adval_clear(&l);
+    adval_clear(&r);
+
+    return err;
+}
+
+/* Bring @v into line with the type of the variable to which it
+   is assigned: a scalar or T-vector assigned to a series must be
+   treated as a series; and a series must not be assigned to
+   anything else.
+*/
+
+static int ad_coerce (adval *v, GretlType gtype, int T, int k)
+{
+    if (gtype == GRETL_TYPE_SERIES) {
+	if (v->series) {
+	    return 0;
+	} else if (v->rows == T && v->cols == 1) {
+	    v->series = 1;
+	    return 0;
+	} else if (is_scalar_val(v)) {
+	    adval s = {0};
+	    int i, j, err;
+
+	    err = adval_alloc(&s, T, 1, 1, k, v->dx != NULL);
+	    if (err) {
+		return err;
+	    }
+	    for (i=0; i<T; i++) {
+		s.x[i] = v->x[0];
+		if (v->dx != NULL) {
+		    for (j=0; j<k; j++) {
+			s.dx[i + j*T] = v->dx[j];
+		    }
+		}
+	    }
+	    adval_clear(v);
+	    *v = s;
+	    return 0;
+	}
+    } else if (gtype == GRETL_TYPE_MATRIX) {
+	return v->series ? E_NOTIMP : 0;
+    } else if (gtype == GRETL_TYPE_DOUBLE) {
+	return is_scalar_val(v) ? 0 : E_NOTIMP;
+    }
+
+    return E_NOTIMP;
+}
+
+static int ad_track (ad_info *ad, const char *name, adval *v)
+{
+    adval *tv = tracked_value(ad, name);
+
+    if (tv != NULL) {
+	adval_clear(tv);
+	*tv = *v;
+    } else {
+	adtrack *trk = realloc(ad->trk, (ad->ntrk + 1) * sizeof *trk);
+
+	if (trk == NULL) {
+	    return E_ALLOC;
+	}
+	ad->trk = trk;
+	strcpy(trk[ad->ntrk].name, name);
+	trk[ad->ntrk].val = *v;
+	ad->ntrk += 1;
+    }
+
+    return 0;
+}
+
+static void ad_clear_tracked (ad_info *ad)
+{
+    int i;
+
+    for (i=0; i<ad->ntrk; i++) {
+	adval_clear(&ad->trk[i].val);
+    }
+
+    free(ad->trk);
+    ad->trk = NULL;
+    ad->ntrk = 0;
+}
+
+/* Establish the number of coefficients associated with each
+   parameter, at current values */
+
+static int ad_set_param_offsets (ad_info *ad)
+{
+    gretl_matrix *m;
+    int i, k = 0;
+
+    for (i=0; i<ad->np; i++) {
+	ad->pcol[i] = k;
+	if (ad->ptypes[i] == GRETL_TYPE_DOUBLE) {
+	    k++;
+	} else {
+	    m = get_matrix_by_name(ad->pnames[i]);
+	    if (m == NULL || m->is_complex) {
+		return E_NOTIMP;
+	    }
+	    k += m->rows * m->cols;
+	}
+    }
+
+    ad->k = k;
+
+    return 0;
+}
+
+/* check that a given genr is a plain assignment to a named
+   variable */
+
+static int ad_genr_ok (GENERATOR *p)
+{
+    return p != NULL && p->tree != NULL && !p->err &&
+	p->op == B_ASN && p->lh.name[0] != '\0' &&
+	p->lh.expr == NULL && p->lhtree == NULL &&
+	!genr_no_assign(p);
+}
+
+/**
+ * genr_autodiff_new:
+ * @genrs: array of compiled generators: zero or more auxiliary
+ * assignments followed by the criterion function.
+ * @ngenrs: number of elements in @genrs.
+ * @pnames: names of the parameters.
+ * @ptypes: types of the parameters, %GRETL_TYPE_DOUBLE or
+ * %GRETL_TYPE_MATRIX (vector).
+ * @np: number of parameters.
+ * @err: location to receive error code.
+ *
+ * Sets up the apparatus for differentiating the last of @genrs
+ * with respect to the given parameters. An error code of
+ * %E_NOTIMP indicates that one of the generators is not of a
+ * suitable form; this is not an error as such, rather a signal
+ * to use numerical derivatives. Note that the generators are
+ * not copied, so the returned pointer must not outlive them.
+ *
+ * Returns: allocated info, or NULL on failure.
+ */
+
+ad_info *genr_autodiff_new (GENERATOR **genrs, int ngenrs,
+			    char **pnames, const GretlType *ptypes,
+			    int np, int *err)
+{
+    ad_info *ad;
+    int i;
+
+    for (i=0; i<ngenrs; i++) {
+	if (!ad_genr_ok(genrs[i])) {
+	    *err = E_NOTIMP;
+	    return NULL;
+	}
+	if (i < ngenrs - 1 &&
+	    strings_array_position(pnames, np, genrs[i]->lh.name) >= 0) {
+	    /* auxiliary genr should not overwrite a parameter */
+	    *err = E_NOTIMP;
+	    return NULL;
+	}
+    }
+
+    ad = calloc(1, sizeof *ad);
+    if (ad == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    ad->genrs = genrs;
+    ad->ngenrs = ngenrs;
+    ad->np = np;
+    ad->pnames = strings_array_dup(pnames, np);
+    ad->ptypes = malloc(np * sizeof *ad->ptypes);
+    ad->pcol = malloc(np * sizeof *ad->pcol);
+
+    if (ad->pnames == NULL || ad->ptypes == NULL || ad->pcol == NULL) {
+	genr_autodiff_destroy(ad);
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    for (i=0; i<np; i++) {
+	if (ptypes[i] != GRETL_TYPE_DOUBLE &&
+	    ptypes[i] != GRETL_TYPE_MATRIX) {
+	    *err = E_NOTIMP;
+	}
+	ad->ptypes[i] = ptypes[i];
+    }
+
+    if (*err) {
+	genr_autodiff_destroy(ad);
+	ad = NULL;
+    }
+
+    return ad;
+}
+
+/**
+ * genr_autodiff_jacobian:
+ * @ad: pointer obtained via genr_autodiff_new().
+ * @dset: dataset.
+ * @t1: first observation of sample range.
+ * @t2: last observation of sample range.
+ * @err: location to receive error code.
+ *
+ * Computes the derivatives of the criterion function with
+ * respect to the parameters, at their current values. If
+ * the criterion is a series, row t of the result holds the
+ * derivatives of observation @t1 + t; if it's a matrix, row i
+ * holds the derivatives of its i-th element (in column-major
+ * order); if it's a scalar there's a single row.
+ *
+ * Returns: newly allocated matrix with one column per
+ * coefficient, or NULL on failure.
+ */
+
+gretl_matrix *genr_autodiff_jacobian (ad_info *ad, DATASET *dset,
+				      int t1, int t2, int *err)
+{
+    gretl_matrix *J = NULL;
+    adval v = {0};
+    GENERATOR *p;
+    int T = t2 - t1 + 1;
+    int i, n;
+
+    ad->dset = dset;
+    ad->t1 = t1;
+    ad->t2 = t2;
+
+    *err = ad_set_param_offsets(ad);
+
+    for (i=0; i<ad->ngenrs && !*err; i++) {
+	p = ad->genrs[i];
+	*err = ad_eval(p->tree, ad, &v);
+	if (!*err) {
+	    *err = ad_coerce(&v, genr_get_output_type(p), T, ad->k);
+	}
+	if (!*err && i < ad->ngenrs - 1) {
+	    *err = ad_track(ad, p->lh.name, &v);
+	    if (*err) {
+		adval_clear(&v);
+	    } else {
+		/* ownership passed */
+		v.x = v.dx = NULL;
+	    }
+	}
+    }
+
+    if (!*err) {
+	n = v.rows * v.cols;
+	J = gretl_zero_matrix_new(n, ad->k);
+	if (J == NULL) {
+	    *err = E_ALLOC;
+	} else if (v.dx != NULL) {
+	    memcpy(J->val, v.dx, n * ad->k * sizeof(double));
+	    for (i=0; i<n * ad->k; i++) {
+		if (na(J->val[i])) {
+		    *err = E_NAN;
+		    break;
+		}
+	    }
+	}
+    }
+
+    adval_clear(&v);
+    ad_clear_tracked(ad);
+
+    if (*err) {
+	gretl_matrix_free(J);
+	J = NULL;
+    }
+
+    return J;
+}
+
+/**
+ * genr_autodiff_destroy:
+ * @ad: pointer obtained via genr_autodiff_new(), or NULL.
+ *
+ * Frees all resources associated with @ad.
+ */
+
+void genr_autodiff_destroy (ad_info *ad)
+{
+    if (ad != NULL) {
+	ad_clear_tracked(ad);
+	strings_array_free(ad->pnames, ad->np);
+	free(ad->ptypes);
+	free(ad->pcol);
+	free(ad);
+    }
+}
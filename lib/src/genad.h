@@ -0,0 +1,36 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* private header: automatic differentiation of compiled genrs */
+
+#ifndef GENAD_H
+#define GENAD_H
+
+typedef struct ad_info_ ad_info;
+
+ad_info *genr_autodiff_new (GENERATOR **genrs, int ngenrs,
+			    char **pnames, const GretlType *ptypes,
+			    int np, int *err);
+
+gretl_matrix *genr_autodiff_jacobian (ad_info *ad, DATASET *dset,
+				      int t1, int t2, int *err);
+
+void genr_autodiff_destroy (ad_info *ad);
+
+#endif /* GENAD_H */
@@ -0,0 +1,1016 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Translation of compiled genrs into a flat, register-based
+   program. This is used by mle, nls and gmm to evaluate the
+   auxiliary genrs and the criterion function, which have to be
+   recomputed many thousands of times in the course of estimation.
+   The regular genr machinery walks the syntax tree on each call,
+   dispatching on operand types and allocating a full-length
+   temporary series at each node; for simple expressions in the
+   parameters that overhead is most of the cost.
+
+   Here each tree is walked just once, to emit instructions into
+   two lists: a prologue of scalar operations, run once per call,
+   and a body of series operations, run over the sample range in
+   chunks short enough that intermediate values stay in cache.
+   Since everything in the body is elementwise the chunks are
+   independent, and they can be run in parallel.
+
+   We support only series and scalar values, the arithmetic,
+   comparison and logical operators, the ternary query operator
+   and the built-in functions of one real argument, with the
+   same treatment of NAs as genr. On encountering anything else
+   we return E_NOTIMP and the caller should stay with genr.
+*/
+
+#include "genparse.h"
+#include "uservar.h"
+#include "libset.h"
+#include "genbc.h"
+
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#define BCDEBUG 0
+
+#define BC_CHUNK 512 /* observations per chunk */
+
+/* kinds of register */
+enum {
+    BC_SCALAR,  /* scalar, set by the prologue */
+    BC_SERIES,  /* series in the dataset, read in place */
+    BC_VECTOR   /* chunk-length buffer, set by the body */
+};
+
+/* instruction codes */
+enum {
+    BC_CONST,   /* load constant */
+    BC_LOAD,    /* load named scalar */
+    BC_UNARY,   /* unary operator */
+    BC_FUNC,    /* function of one argument */
+    BC_BINARY,  /* binary operator */
+    BC_QUERY,   /* ternary query operator */
+    BC_STORE    /* store to named scalar or series */
+};
+
+typedef struct bc_reg_ bc_reg;
+typedef struct bc_instr_ bc_instr;
+
+struct bc_reg_ {
+    int kind;   /* BC_SCALAR, BC_SERIES or BC_VECTOR */
+    int v;      /* ID number of series, if BC_SERIES */
+    int slot;   /* position of buffer, if BC_VECTOR */
+    int name;   /* index into names of variable, or -1 */
+};
+
+struct bc_instr_ {
+    int code;              /* instruction code, BC_* */
+    int op;                /* genr operator, if applicable */
+    int dst;               /* destination register */
+    int a, b, c;           /* operand registers, or -1 */
+    double x;              /* value, for BC_CONST */
+    double (*f) (double);  /* function, for BC_FUNC */
+};
+
+struct bc_program_ {
+    GENERATOR **genrs; /* the generators (not owned) */
+    int ngenrs;        /* number of generators */
+    bc_instr *pro;     /* scalar instructions */
+    int npro;          /* number of the above */
+    bc_instr *body;    /* series instructions */
+    int nbody;         /* number of the above */
+    bc_reg *regs;      /* registers */
+    int nregs;         /* number of registers */
+    double *sval;      /* values of scalar registers */
+    double **sptr;     /* storage of named scalars, by register */
+    char **names;      /* names of variables referenced */
+    int nnames;        /* number of names */
+    int *outs;         /* registers assigned by the generators */
+    int nouts;         /* number of the above */
+    int nslots;        /* number of chunk buffers needed */
+    char *busy;        /* record of buffers in use, when compiling */
+    DATASET *dset;     /* dataset, when compiling */
+};
+
+/* Apart from the absence of the NA-test option, this follows
+   xy_calc() in geneval.c. Since @op is a compile-time constant
+   at each call site below, the tests on it drop out.
+*/
+
+static inline double bc_calc (double x, double y, int op)
+{
+    if (op == B_MUL && (x == 0 || y == 0)) {
+	return 0;
+    }
+
+    if (op == B_OR && ((!na(x) && x != 0) || (!na(y) && y != 0))) {
+	return 1.0;
+    }
+
+    if (op == B_AND && (x == 0 || y == 0)) {
+	return 0;
+    }
+
+    if (na(x) || na(y)) {
+	return NADBL;
+    }
+
+    switch (op) {
+    case B_ADD:
+	return x + y;
+    case B_SUB:
+	return x - y;
+    case B_MUL:
+	return x * y;
+    case B_DIV:
+	return x / y;
+    case B_MOD:
+	return fmod(x, y);
+    case B_AND:
+	return x != 0 && y != 0;
+    case B_OR:
+	return x != 0 || y != 0;
+    case B_EQ:
+	return x == y;
+    case B_NEQ:
+	return x != y;
+    case B_GT:
+	return x > y;
+    case B_LT:
+	return x < y;
+    case B_GTE:
+	return x >= y;
+    case B_LTE:
+	return x <= y;
+    case B_POW:
+	return pow(x, y);
+    default:
+	return NADBL;
+    }
+}
+
+/* as real_apply_func() in geneval.c, for the unary operators */
+
+static inline double bc_unary (double x, int op)
+{
+    if (na(x)) {
+	return NADBL;
+    } else if (op == U_NEG) {
+	return -x;
+    } else if (op == U_NOT) {
+	return x == 0;
+    } else {
+	return x;
+    }
+}
+
+static inline double bc_query (double c, double x, double y)
+{
+    return na(c) ? NADBL : (c != 0 ? x : y);
+}
+
+static int bc_binary_ok (int op)
+{
+    switch (op) {
+    case B_ADD:
+    case B_SUB:
+    case B_MUL:
+    case B_DIV:
+    case B_MOD:
+    case B_POW:
+    case B_AND:
+    case B_OR:
+    case B_EQ:
+    case B_NEQ:
+    case B_GT:
+    case B_LT:
+    case B_GTE:
+    case B_LTE:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+/* built-in function of one real argument, for which genr
+   has attached a function pointer to the node
+*/
+
+static int bc_func_ok (NODE *n)
+{
+    if (n->t > F1_MIN && n->t < FP_MAX && n->v.ptr != NULL) {
+	return n->t != F_CARG && n->t != F_CMOD &&
+	    n->t != F_REAL && n->t != F_IMAG;
+    } else {
+	return 0;
+    }
+}
+
+static int bc_add_reg (bc_program *bc, int kind, int *err)
+{
+    bc_reg *regs;
+    int r = bc->nregs;
+
+    regs = realloc(bc->regs, (r + 1) * sizeof *regs);
+    if (regs == NULL) {
+	*err = E_ALLOC;
+	return -1;
+    }
+
+    bc->regs = regs;
+    regs[r].kind = kind;
+    regs[r].v = -1;
+    regs[r].slot = -1;
+    regs[r].name = -1;
+    bc->nregs += 1;
+
+    return r;
+}
+
+static int bc_set_name (bc_program *bc, int r, const char *name)
+{
+    int err = strings_array_add(&bc->names, &bc->nnames, name);
+
+    if (!err) {
+	bc->regs[r].name = bc->nnames - 1;
+    }
+
+    return err;
+}
+
+static int bc_push (bc_instr **pS, int *n, const bc_instr *ins)
+{
+    bc_instr *S = realloc(*pS, (*n + 1) * sizeof *S);
+
+    if (S == NULL) {
+	return E_ALLOC;
+    }
+
+    S[*n] = *ins;
+    *pS = S;
+    *n += 1;
+
+    return 0;
+}
+
+/* Chunk buffers are allocated and released in stack-like order
+   as the tree is walked, so the number needed is of the order of
+   the depth of the tree rather than the number of nodes.
+*/
+
+static int bc_slot_alloc (bc_program *bc, int *err)
+{
+    char *busy;
+    int i;
+
+    for (i=0; i<bc->nslots; i++) {
+	if (!bc->busy[i]) {
+	    bc->busy[i] = 1;
+	    return i;
+	}
+    }
+
+    busy = realloc(bc->busy, bc->nslots + 1);
+    if (busy == NULL) {
+	*err = E_ALLOC;
+	return -1;
+    }
+
+    bc->busy = busy;
+    bc->busy[i] = 1;
+    bc->nslots += 1;
+
+    return i;
+}
+
+static void bc_slot_release (bc_program *bc, int r)
+{
+    if (r >= 0 && bc->regs[r].kind == BC_VECTOR) {
+	bc->busy[bc->regs[r].slot] = 0;
+    }
+}
+
+static int is_scalar_reg (bc_program *bc, int r)
+{
+    return r < 0 || bc->regs[r].kind == BC_SCALAR;
+}
+
+/* Append @ins to the prologue if all its operands are scalars,
+   otherwise to the body, and return its destination register.
+   Note that the destination may share a buffer with one of the
+   operands, since all operations are elementwise.
+*/
+
+static int bc_emit (bc_program *bc, bc_instr *ins, int *err)
+{
+    if (is_scalar_reg(bc, ins->a) && is_scalar_reg(bc, ins->b) &&
+	is_scalar_reg(bc, ins->c)) {
+	ins->dst = bc_add_reg(bc, BC_SCALAR, err);
+	if (!*err) {
+	    *err = bc_push(&bc->pro, &bc->npro, ins);
+	}
+    } else {
+	bc_slot_release(bc, ins->a);
+	bc_slot_release(bc, ins->b);
+	bc_slot_release(bc, ins->c);
+	ins->dst = bc_add_reg(bc, BC_VECTOR, err);
+	if (!*err) {
+	    bc->regs[ins->dst].slot = bc_slot_alloc(bc, err);
+	}
+	if (!*err) {
+	    *err = bc_push(&bc->body, &bc->nbody, ins);
+	}
+    }
+
+    return *err ? -1 : ins->dst;
+}
+
+static int bc_leaf (bc_program *bc, NODE *n, int *err)
+{
+    bc_instr ins = {0};
+    int r = -1;
+
+    ins.a = ins.b = ins.c = -1;
+
+    if (n->t == NUM && n->vname != NULL) {
+	if (get_user_var_of_type_by_name(n->vname, GRETL_TYPE_DOUBLE) == NULL) {
+	    *err = E_NOTIMP;
+	} else {
+	    ins.code = BC_LOAD;
+	    ins.dst = r = bc_add_reg(bc, BC_SCALAR, err);
+	    if (!*err) {
+		*err = bc_set_name(bc, r, n->vname);
+	    }
+	}
+    } else if (n->t == NUM || n->t == CON) {
+	ins.code = BC_CONST;
+	if (n->t == CON) {
+	    ins.x = get_const_by_name(constname(n->v.idnum), err);
+	    if (*err) {
+		*err = E_NOTIMP;
+	    }
+	} else {
+	    ins.x = n->v.xval;
+	}
+	if (!*err) {
+	    ins.dst = r = bc_add_reg(bc, BC_SCALAR, err);
+	}
+    } else if (n->t == SERIES) {
+	int v = n->vnum;
+
+	if (n->vname != NULL) {
+	    v = current_series_index(bc->dset, n->vname);
+	}
+	if (v < 0 || v >= bc->dset->v || is_string_valued(bc->dset, v)) {
+	    *err = E_NOTIMP;
+	} else {
+	    r = bc_add_reg(bc, BC_SERIES, err);
+	    if (!*err) {
+		bc->regs[r].v = v;
+		if (n->vname != NULL) {
+		    *err = bc_set_name(bc, r, n->vname);
+		}
+	    }
+	}
+	return *err ? -1 : r;
+    } else {
+	*err = E_NOTIMP;
+    }
+
+    if (!*err) {
+	*err = bc_push(&bc->pro, &bc->npro, &ins);
+    }
+
+    return *err ? -1 : r;
+}
+
+/* compile the subtree at @n, returning the register that
+   will hold its value
+*/
+
+static int bc_node (bc_program *bc, NODE *n, int *err)
+{
+    bc_instr ins = {0};
+
+    if (n == NULL) {
+	*err = E_NOTIMP;
+	return -1;
+    }
+
+    if (n->t == NUM || n->t == CON || n->t == SERIES) {
+	return bc_leaf(bc, n, err);
+    }
+
+    ins.op = n->t;
+    ins.a = ins.b = ins.c = -1;
+
+    if (n->t == QUERY) {
+	/* L: condition, M: true value, R: false value */
+	ins.code = BC_QUERY;
+	ins.a = bc_node(bc, n->L, err);
+	if (!*err) {
+	    ins.b = bc_node(bc, n->M, err);
+	}
+	if (!*err) {
+	    ins.c = bc_node(bc, n->R, err);
+	}
+	if (!*err && is_scalar_reg(bc, ins.a) &&
+	    is_scalar_reg(bc, ins.b) != is_scalar_reg(bc, ins.c)) {
+	    /* genr's result would be of indeterminate type */
+	    *err = E_NOTIMP;
+	}
+    } else if (n->M != NULL || n->L == NULL) {
+	*err = E_NOTIMP;
+    } else if (n->t == U_NEG || n->t == U_POS || n->t == U_NOT ||
+	       bc_func_ok(n)) {
+	if (n->R != NULL) {
+	    *err = E_NOTIMP;
+	} else {
+	    ins.code = n->t < U_MAX ? BC_UNARY : BC_FUNC;
+	    ins.f = n->t < U_MAX ? NULL : n->v.ptr;
+	    ins.a = bc_node(bc, n->L, err);
+	}
+    } else if (bc_binary_ok(n->t) && n->R != NULL) {
+	ins.code = BC_BINARY;
+	ins.a = bc_node(bc, n->L, err);
+	if (!*err && (n->t == B_AND || n->t == B_OR) &&
+	    is_scalar_reg(bc, ins.a)) {
+	    /* genr short-circuits on a scalar left operand */
+	    *err = E_NOTIMP;
+	}
+	if (!*err) {
+	    ins.b = bc_node(bc, n->R, err);
+	}
+    } else {
+	*err = E_NOTIMP;
+    }
+
+#if BCDEBUG
+    if (*err) {
+	fprintf(stderr, "bc_node: node %s, err = %d\n", getsymb(n->t), *err);
+    }
+#endif
+
+    return *err ? -1 : bc_emit(bc, &ins, err);
+}
+
+static int bc_genr_ok (GENERATOR *p)
+{
+    return p != NULL && p->tree != NULL && !p->err &&
+	p->op == B_ASN && p->lh.name[0] != '\0' &&
+	p->lh.expr == NULL && p->lhtree == NULL &&
+	!genr_no_assign(p) && !(p->flags & P_AUTOREG);
+}
+
+static int bc_add_output (bc_program *bc, int r)
+{
+    int *outs = realloc(bc->outs, (bc->nouts + 1) * sizeof *outs);
+
+    if (outs == NULL) {
+	return E_ALLOC;
+    }
+
+    outs[bc->nouts] = r;
+    bc->outs = outs;
+    bc->nouts += 1;
+
+    return 0;
+}
+
+static int bc_compile_genr (bc_program *bc, GENERATOR *p)
+{
+    int gtype = genr_get_output_type(p);
+    bc_instr ins = {0};
+    int err = 0;
+
+    ins.code = BC_STORE;
+    ins.a = bc_node(bc, p->tree, &err);
+    ins.b = ins.c = -1;
+
+    if (err) {
+	return err;
+    }
+
+    if (gtype == GRETL_TYPE_SERIES) {
+	int v = genr_get_output_varnum(p);
+
+	if (v <= 0 || v >= bc->dset->v) {
+	    return E_NOTIMP;
+	}
+	ins.dst = bc_add_reg(bc, BC_SERIES, &err);
+	if (!err) {
+	    bc->regs[ins.dst].v = v;
+	    err = bc_set_name(bc, ins.dst, p->lh.name);
+	}
+	if (!err) {
+	    bc_slot_release(bc, ins.a);
+	    err = bc_push(&bc->body, &bc->nbody, &ins);
+	}
+    } else if (gtype == GRETL_TYPE_DOUBLE && is_scalar_reg(bc, ins.a)) {
+	ins.dst = bc_add_reg(bc, BC_SCALAR, &err);
+	if (!err) {
+	    err = bc_set_name(bc, ins.dst, p->lh.name);
+	}
+	if (!err) {
+	    err = bc_push(&bc->pro, &bc->npro, &ins);
+	}
+    } else {
+	err = E_NOTIMP;
+    }
+
+    if (!err) {
+	err = bc_add_output(bc, ins.dst);
+    }
+
+    return err;
+}
+
+/**
+ * genr_bytecode_new:
+ * @genrs: array of compiled generators, each of which must
+ * assign to a named scalar or series.
+ * @ngenrs: number of elements in @genrs.
+ * @dset: dataset.
+ * @err: location to receive error code.
+ *
+ * Translates @genrs into a program which can be run in their
+ * place via genr_bytecode_exec(). An error code of %E_NOTIMP
+ * indicates that one of the generators is not of a suitable
+ * form; this is not an error as such, rather a signal to stay
+ * with the generators. Note that the generators are not
+ * copied, so the returned pointer must not outlive them.
+ *
+ * Returns: allocated program, or NULL on failure.
+ */
+
+bc_program *genr_bytecode_new (GENERATOR **genrs, int ngenrs,
+			       DATASET *dset, int *err)
+{
+    bc_program *bc;
+    int i;
+
+    for (i=0; i<ngenrs; i++) {
+	if (!bc_genr_ok(genrs[i])) {
+	    *err = E_NOTIMP;
+	    return NULL;
+	}
+    }
+
+    bc = calloc(1, sizeof *bc);
+    if (bc == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    bc->genrs = genrs;
+    bc->ngenrs = ngenrs;
+    bc->dset = dset;
+
+    for (i=0; i<ngenrs && !*err; i++) {
+	*err = bc_compile_genr(bc, genrs[i]);
+    }
+
+    if (!*err && bc->nbody == 0) {
+	/* the prologue alone would gain little */
+	*err = E_NOTIMP;
+    }
+
+    if (!*err) {
+	bc->sval = malloc(bc->nregs * sizeof *bc->sval);
+	bc->sptr = calloc(bc->nregs, sizeof *bc->sptr);
+	if (bc->sval == NULL || bc->sptr == NULL) {
+	    *err = E_ALLOC;
+	}
+    }
+
+    free(bc->busy);
+    bc->busy = NULL;
+    bc->dset = NULL;
+
+#if BCDEBUG
+    fprintf(stderr, "genr_bytecode_new: npro = %d, nbody = %d, "
+	    "nregs = %d, nslots = %d, err = %d\n", bc->npro,
+	    bc->nbody, bc->nregs, bc->nslots, *err);
+#endif
+
+    if (*err) {
+	genr_bytecode_destroy(bc);
+	bc = NULL;
+    }
+
+    return bc;
+}
+
+/* Look up the named variables afresh on each call, since a
+   series may be renumbered or a scalar reallocated between
+   calls.
+*/
+
+static int bc_resolve (bc_program *bc, const DATASET *dset)
+{
+    bc_reg *reg;
+    const char *name;
+    user_var *uv;
+    int r;
+
+    for (r=0; r<bc->nregs; r++) {
+	reg = &bc->regs[r];
+	if (reg->name < 0) {
+	    continue;
+	}
+	name = bc->names[reg->name];
+	if (reg->kind == BC_SCALAR) {
+	    uv = get_user_var_of_type_by_name(name, GRETL_TYPE_DOUBLE);
+	    if (uv == NULL) {
+		gretl_errmsg_sprintf("%s: no such scalar", name);
+		return E_DATA;
+	    }
+	    bc->sptr[r] = user_var_get_value(uv);
+	} else if (reg->v >= dset->v ||
+		   strcmp(dset->varname[reg->v], name)) {
+	    reg->v = current_series_index(dset, name);
+	    if (reg->v < 0) {
+		gretl_errmsg_sprintf(_("Unknown variable '%s'"), name);
+		return E_DATA;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+static void bc_run_prologue (bc_program *bc)
+{
+    double *s = bc->sval;
+    bc_instr *ins;
+    int i;
+
+    for (i=0; i<bc->npro; i++) {
+	ins = &bc->pro[i];
+	switch (ins->code) {
+	case BC_CONST:
+	    s[ins->dst] = ins->x;
+	    break;
+	case BC_LOAD:
+	    s[ins->dst] = *bc->sptr[ins->dst];
+	    break;
+	case BC_UNARY:
+	    s[ins->dst] = bc_unary(s[ins->a], ins->op);
+	    break;
+	case BC_FUNC:
+	    s[ins->dst] = ins->f(s[ins->a]);
+	    break;
+	case BC_BINARY:
+	    s[ins->dst] = bc_calc(s[ins->a], s[ins->b], ins->op);
+	    break;
+	case BC_QUERY:
+	    s[ins->dst] = bc_query(s[ins->a], s[ins->b], s[ins->c]);
+	    break;
+	case BC_STORE:
+	    *bc->sptr[ins->dst] = s[ins->a];
+	    break;
+	}
+    }
+}
+
+/* Get the values of register @r for the chunk starting at
+   observation @t0: for a scalar we return NULL and write the
+   value to @px.
+*/
+
+static const double *bc_operand (const bc_program *bc, int r,
+				 double **Z, double *buf,
+				 int t0, double *px)
+{
+    const bc_reg *reg = &bc->regs[r];
+
+    if (reg->kind == BC_SCALAR) {
+	*px = bc->sval[r];
+	return NULL;
+    } else if (reg->kind == BC_SERIES) {
+	return Z[reg->v] + t0;
+    } else {
+	return buf + (size_t) reg->slot * BC_CHUNK;
+    }
+}
+
+#define bc_loop(z,x,xs,y,ys,n,OP)		       \
+    do {					       \
+	if (x != NULL && y != NULL) {		       \
+	    for (i=0; i<n; i++) {		       \
+		z[i] = bc_calc(x[i], y[i], OP);	       \
+	    }					       \
+	} else if (x != NULL) {			       \
+	    for (i=0; i<n; i++) {		       \
+		z[i] = bc_calc(x[i], ys, OP);	       \
+	    }					       \
+	} else {				       \
+	    for (i=0; i<n; i++) {		       \
+		z[i] = bc_calc(xs, y[i], OP);	       \
+	    }					       \
+	}					       \
+    } while (0)
+
+static void bc_binary (int op, double *z, const double *x, double xs,
+		       const double *y, double ys, int n)
+{
+    int i;
+
+    switch (op) {
+    case B_ADD:
+	bc_loop(z, x, xs, y, ys, n, B_ADD);
+	break;
+    case B_SUB:
+	bc_loop(z, x, xs, y, ys, n, B_SUB);
+	break;
+    case B_MUL:
+	bc_loop(z, x, xs, y, ys, n, B_MUL);
+	break;
+    case B_DIV:
+	bc_loop(z, x, xs, y, ys, n, B_DIV);
+	break;
+    case B_MOD:
+	bc_loop(z, x, xs, y, ys, n, B_MOD);
+	break;
+    case B_POW:
+	bc_loop(z, x, xs, y, ys, n, B_POW);
+	break;
+    case B_AND:
+	bc_loop(z, x, xs, y, ys, n, B_AND);
+	break;
+    case B_OR:
+	bc_loop(z, x, xs, y, ys, n, B_OR);
+	break;
+    case B_EQ:
+	bc_loop(z, x, xs, y, ys, n, B_EQ);
+	break;
+    case B_NEQ:
+	bc_loop(z, x, xs, y, ys, n, B_NEQ);
+	break;
+    case B_GT:
+	bc_loop(z, x, xs, y, ys, n, B_GT);
+	break;
+    case B_LT:
+	bc_loop(z, x, xs, y, ys, n, B_LT);
+	break;
+    case B_GTE:
+	bc_loop(z, x, xs, y, ys, n, B_GTE);
+	break;
+    case B_LTE:
+	bc_loop(z, x, xs, y, ys, n, B_LTE);
+	break;
+    }
+}
+
+/* run the body for the @n observations starting at @t0 */
+
+static void bc_run_chunk (const bc_program *bc, double **Z,
+			  double *buf, int t0, int n)
+{
+    const bc_instr *ins;
+    const double *x, *y, *c;
+    double xs = 0, ys = 0, cs = 0;
+    double *z;
+    int i, k;
+
+    for (k=0; k<bc->nbody; k++) {
+	ins = &bc->body[k];
+	x = bc_operand(bc, ins->a, Z, buf, t0, &xs);
+	if (ins->code == BC_STORE) {
+	    z = Z[bc->regs[ins->dst].v] + t0;
+	} else {
+	    z = buf + (size_t) bc->regs[ins->dst].slot * BC_CHUNK;
+	}
+	switch (ins->code) {
+	case BC_UNARY:
+	    for (i=0; i<n; i++) {
+		z[i] = bc_unary(x[i], ins->op);
+	    }
+	    break;
+	case BC_FUNC:
+	    for (i=0; i<n; i++) {
+		z[i] = ins->f(x[i]);
+	    }
+	    break;
+	case BC_BINARY:
+	    y = bc_operand(bc, ins->b, Z, buf, t0, &ys);
+	    bc_binary(ins->op, z, x, xs, y, ys, n);
+	    break;
+	case BC_QUERY:
+	    c = x;
+	    cs = xs;
+	    x = bc_operand(bc, ins->b, Z, buf, t0, &xs);
+	    y = bc_operand(bc, ins->c, Z, buf, t0, &ys);
+	    for (i=0; i<n; i++) {
+		z[i] = bc_query(c != NULL ? c[i] : cs,
+				x != NULL ? x[i] : xs,
+				y != NULL ? y[i] : ys);
+	    }
+	    break;
+	case BC_STORE:
+	    if (x == NULL) {
+		for (i=0; i<n; i++) {
+		    z[i] = xs;
+		}
+	    } else if (x != z) {
+		memcpy(z, x, n * sizeof *z);
+	    }
+	    break;
+	}
+    }
+}
+
+static int bc_run_body (bc_program *bc, DATASET *dset)
+{
+    int T = dset->t2 - dset->t1 + 1;
+    int nc = (T + BC_CHUNK - 1) / BC_CHUNK;
+    size_t bsize = (size_t) bc->nslots * BC_CHUNK;
+    int err = 0;
+#if defined(_OPENMP)
+    int nt = 1;
+
+    if (nc > 1 && libset_use_openmp((guint64) T * bc->nbody)) {
+	nt = get_omp_n_threads();
+	if (nt > nc) {
+	    nt = nc;
+	}
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	double *buf = NULL;
+	int j, t0, n;
+
+	if (bsize > 0) {
+	    buf = malloc(bsize * sizeof *buf);
+	    if (buf == NULL) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+		err = E_ALLOC;
+	    }
+	}
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+	for (j=0; j<nc; j++) {
+	    if (buf != NULL || bsize == 0) {
+		t0 = dset->t1 + j * BC_CHUNK;
+		n = MIN(BC_CHUNK, dset->t2 - t0 + 1);
+		bc_run_chunk(bc, dset->Z, buf, t0, n);
+	    }
+	}
+
+	free(buf);
+    }
+
+    return err;
+}
+
+/**
+ * genr_bytecode_exec:
+ * @bc: pointer obtained via genr_bytecode_new().
+ * @dset: dataset.
+ *
+ * Runs the program @bc over the current sample range of
+ * @dset, with the same effect as executing the generators
+ * from which it was compiled.
+ *
+ * Returns: 0 on success, non-zero code on error.
+ */
+
+int genr_bytecode_exec (bc_program *bc, DATASET *dset)
+{
+    int err = bc_resolve(bc, dset);
+
+    if (!err) {
+	bc_run_prologue(bc);
+	err = bc_run_body(bc, dset);
+    }
+
+    return err;
+}
+
+static const double *bc_output_values (bc_program *bc, int r,
+				       const DATASET *dset,
+				       int *n)
+{
+    if (bc->regs[r].kind == BC_SERIES) {
+	*n = sample_size(dset);
+	return dset->Z[bc->regs[r].v] + dset->t1;
+    } else {
+	*n = 1;
+	return bc->sptr[r];
+    }
+}
+
+/**
+ * genr_bytecode_check:
+ * @bc: pointer obtained via genr_bytecode_new().
+ * @dset: dataset.
+ * @prn: printing struct, for the generators.
+ *
+ * Executes the generators from which @bc was compiled, then
+ * runs @bc itself, and checks that the two give identical
+ * results. Returns %E_NOTIMP if they do not, although that
+ * should not happen; in any case a non-zero return means that
+ * the caller should not use @bc.
+ *
+ * Returns: 0 on success, non-zero code on failure.
+ */
+
+int genr_bytecode_check (bc_program *bc, DATASET *dset, PRN *prn)
+{
+    const double *x;
+    double *x0 = NULL;
+    int i, j, k, n, ntot = 0;
+    int err = 0;
+
+    for (i=0; i<bc->ngenrs && !err; i++) {
+	err = execute_genr(bc->genrs[i], dset, prn);
+    }
+
+    if (!err) {
+	err = bc_resolve(bc, dset);
+    }
+
+    if (err) {
+	return err;
+    }
+
+    for (k=0; k<bc->nouts; k++) {
+	bc_output_values(bc, bc->outs[k], dset, &n);
+	ntot += n;
+    }
+
+    x0 = malloc(ntot * sizeof *x0);
+    if (x0 == NULL) {
+	return E_ALLOC;
+    }
+
+    for (k=0, j=0; k<bc->nouts; k++) {
+	x = bc_output_values(bc, bc->outs[k], dset, &n);
+	memcpy(x0 + j, x, n * sizeof *x);
+	j += n;
+    }
+
+    err = genr_bytecode_exec(bc, dset);
+
+    for (k=0, j=0; k<bc->nouts && !err; k++) {
+	x = bc_output_values(bc, bc->outs[k], dset, &n);
+	for (i=0; i<n && !err; i++, j++) {
+	    if (x[i] != x0[j] && !(isnan(x[i]) && isnan(x0[j]))) {
+#if BCDEBUG
+		fprintf(stderr, "genr_bytecode_check: output %d, "
+			"obs %d: %.17g vs %.17g\n", k, i, x[i], x0[j]);
+#endif
+		err = E_NOTIMP;
+	    }
+	}
+    }
+
+    free(x0);
+
+    return err;
+}
+
+/**
+ * genr_bytecode_destroy:
+ * @bc: pointer obtained via genr_bytecode_new(), or NULL.
+ *
+ * Frees all resources associated with @bc.
+ */
+
+void genr_bytecode_destroy (bc_program *bc)
+{
+    if (bc != NULL) {
+	free(bc->pro);
+	free(bc->body);
+	free(bc->regs);
+	free(bc->sval);
+	free(bc->sptr);
+	free(bc->outs);
+	free(bc->busy);
+	strings_array_free(bc->names, bc->nnames);
+	free(bc);
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* private header: flat evaluation of compiled elementwise genrs */
+
+#ifndef GENBC_H
+#define GENBC_H
+
+typedef struct bc_program_ bc_program;
+
+bc_program *genr_bytecode_new (GENERATOR **genrs, int ngenrs,
+			       DATASET *dset, int *err);
+
+int genr_bytecode_exec (bc_program *bc, DATASET *dset);
+
+int genr_bytecode_check (bc_program *bc, DATASET *dset, PRN *prn);
+
+void genr_bytecode_destroy (bc_program *bc);
+
+#endif /* GENBC_H */
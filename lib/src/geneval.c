@@ -36,6 +36,7 @@
 #include "uservar_priv.h"
 #include "genr_optim.h"
 #include "gretl_cmatrix.h"
+#include "gretl_fmatrix.h"
 #include "gretl_btree.h"
 #include "qr_estimate.h"
 #include "gretl_foreign.h"
@@ -106,7 +107,7 @@ enum {
 			f == F_VEC || f == F_VECH || f == F_UNVECH ||	\
 			f == F_CHOL || f == F_UPPER || f == F_LOWER ||	\
 			f == F_SORT || f == F_DSORT || f == F_VALUES || \
-			f == F_MREV)
+			f == F_MREV || f == F_MSINGLE)
 
 #define dataset_dum(n) (n->t == DUM && n->v.idnum == DUM_DATASET)
 
@@ -2239,6 +2240,13 @@ static NODE *mpi_barrier_node (parser *p)
     return NULL;
 }
 
+static NODE *mpi_task_node (NODE *l, NODE *r, parser *p)
+{
+    gretl_errmsg_set(_("MPI is not supported in this gretl build"));
+    p->err = 1;
+    return NULL;
+}
+
 #endif /* !HAVE_MPI */
 
 static NODE *scalar_calc (NODE *x, NODE *y, int f, parser *p)
@@ -2706,6 +2714,13 @@ static int real_matrix_calc (const gretl_matrix *A,
 	    C = calc_get_matrix(pM, r, c);
 	    if (C == NULL) {
 		err = E_ALLOC;
+	    } else if (libset_get_bool(MATMUL_F32)) {
+		err = gretl_matrix_multiply_mod_f32(A, GRETL_MOD_NONE,
+						    B, GRETL_MOD_NONE,
+						    C, GRETL_MOD_NONE);
+		if (!err) {
+		    gretl_matrix_transcribe_obs_info(C, A);
+		}
 	    } else {
 		err = gretl_matrix_multiply(A, B, C);
 		if (!err) {
@@ -2729,6 +2744,10 @@ static int real_matrix_calc (const gretl_matrix *A,
 	    C = calc_get_matrix(pM, r, c);
 	    if (C == NULL) {
 		err = E_ALLOC;
+	    } else if (libset_get_bool(MATMUL_F32)) {
+		err = gretl_matrix_multiply_mod_f32(A, GRETL_MOD_TRANSPOSE,
+						    B, GRETL_MOD_NONE,
+						    C, GRETL_MOD_NONE);
 	    } else {
 		err = gretl_matrix_multiply_mod(A, GRETL_MOD_TRANSPOSE,
 						B, GRETL_MOD_NONE,
@@ -4109,7 +4128,8 @@ static void matrix_minmax_indices (int f, int *mm, int *rc, int *idx)
 			     f==F_CUM || f==F_DIFF || f==F_SUMC || \
 			     f==F_SUMR || f==F_PRODC || f==F_PRODR || \
 			     f==F_MEANC || f==F_MEANR || f==F_GINV || \
-			     f==F_MLOG || f==F_MEXP || f==F_CHOL)
+			     f==F_MLOG || f==F_MEXP || f==F_CHOL || \
+			     f==F_MSINGLE)
 
 static NODE *matrix_to_matrix_func (NODE *n, NODE *r, int f, parser *p)
 {
@@ -4288,6 +4308,9 @@ static NODE *matrix_to_matrix_func (NODE *n, NODE *r, int f, parser *p)
 	case F_MLOG:
 	    ret->v.m = gretl_matrix_log(m, &p->err);
 	    break;
+	case F_MSINGLE:
+	    ret->v.m = gretl_matrix_round_to_float(m, &p->err);
+	    break;
 	case F_FFT:
 	    ret->v.m = gretl_matrix_fft(m, 0, &p->err);
 	    break;
@@ -11879,6 +11902,41 @@ static NODE *eval_3args_func (NODE *l, NODE *m, NODE *r,
 	    p->err = ret->v.xval = geoplot_driver(mapfile, mapbun, plm, plx,
 						  p->dset, opts);
 	}
+    } else if (f == F_OLSFILE) {
+	gretl_bundle *opts = NULL;
+	char **S = NULL;
+	int ns = 0;
+
+	post_process = 0;
+	if (l->t != STR) {
+	    p->err = E_TYPES;
+	} else if (m->t == STR) {
+	    S = gretl_string_split(m->v.str, &ns, NULL);
+	    if (S == NULL) {
+		p->err = E_DATA;
+	    }
+	} else if (m->t == ARRAY &&
+		   gretl_array_get_type(m->v.a) == GRETL_TYPE_STRINGS) {
+	    S = gretl_array_get_strings(m->v.a, &ns);
+	} else {
+	    p->err = E_TYPES;
+	}
+	if (!p->err) {
+	    if (r->t == BUNDLE) {
+		opts = r->v.b;
+	    } else if (r->t != EMPTY) {
+		p->err = E_TYPES;
+	    }
+	}
+	if (!p->err) {
+	    ret = aux_bundle_node(p);
+	}
+	if (!p->err) {
+	    ret->v.b = olsfile_bundle(l->v.str, S, ns, opts, &p->err);
+	}
+	if (m->t == STR) {
+	    strings_array_free(S, ns);
+	}
     }
 
     if (!p->err && post_process) {
@@ -16370,6 +16428,7 @@ static NODE *eval (NODE *t, parser *p)
     case F_NULLSPC:
     case F_MEXP:
     case F_MLOG:
+    case F_MSINGLE:
     case F_MINC:
     case F_MAXC:
     case F_MINR:
@@ -16591,6 +16650,7 @@ static NODE *eval (NODE *t, parser *p)
     case F_STACK:
     case HF_REGLS:
     case F_GEOPLOT:
+    case F_OLSFILE:
 	/* built-in functions taking three args */
 	if (t->t == F_REPLACE) {
 	    ret = replace_value(l, m, r, p);
@@ -16970,6 +17030,15 @@ static NODE *eval (NODE *t, parser *p)
 	    ret = mpi_transfer_node(l, r, NULL, t->t, p);
 	}
 	break;
+    case F_MPITASK:
+	if (!scalar_node(l)) {
+	    node_type_error(t->t, 1, NUM, l, p);
+	} else if (!null_or_scalar(r)) {
+	    node_type_error(t->t, 2, NUM, r, p);
+	} else {
+	    ret = mpi_task_node(l, r, p);
+	}
+	break;
     case F_REDUCE:
     case F_SCATTER:
 	if (m->t != STR) {
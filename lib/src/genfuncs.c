@@ -33,6 +33,10 @@
 
 #include <errno.h>
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 int sort_series (const double *x, double *y, int f,
 		 const DATASET *dset)
 {
@@ -6414,6 +6418,20 @@ static double nw_kernel (double x)
     return ret;
 }
 
+struct nw_point {
+    double x;
+    double y;
+    int t;
+};
+
+static int compare_nw_points (const void *a, const void *b)
+{
+    const struct nw_point *pa = a;
+    const struct nw_point *pb = b;
+
+    return (pa->x > pb->x) - (pa->x < pb->x);
+}
+
 /**
  * nadaraya_watson:
  * @y: array with "dependent variable"
@@ -6430,10 +6448,7 @@ static double nw_kernel (double x)
  * \widehat{m}_h(x)=\frac{\sum_{i=1}^n K_h(x-X_i)
  * Y_i}{\sum_{i=1}^nK_h(x-X_i)}
  *
- * and computes it for all elements of @x. Note that, in principle,
- * the kernel K(X_i-X_j) must be computed for every combination of i
- * and j, but since the function K() is assumed to be symmetric, we
- * compute it once to save time.
+ * and computes it for all elements of @x.
  *
  * The scalar @h holds the kernel bandwidth; if @LOO is non-zero the
  * "leave-one-out" variant of the estimator (essentially a jackknife
@@ -6443,7 +6458,11 @@ static double nw_kernel (double x)
  * A rudimentary form of trimming is implemented: the kernel function
  * is set to 0 when the product of the @trim parameter times the
  * bandwidth @h exceeds |X_i - X_j|, so as to speed computation and
- * enhance numerical stability.
+ * enhance numerical stability. The observations are sorted by @x,
+ * so that the non-zero terms for each point form a contiguous
+ * window; the cost is then proportional to the total size of the
+ * windows rather than the square of the sample size, and the
+ * points are processed in parallel if OpenMP is available.
  *
  * Returns: 0 on successful completion, non-zero code on error.
  */
@@ -6452,11 +6471,15 @@ int nadaraya_watson (const double *y, const double *x, double h,
 		     DATASET *dset, int LOO, double trim,
 		     double *m)
 {
-    int t, s, err = 0;
+    struct nw_point *pts;
+    int *wlo, *whi;
     int t1 = dset->t1, t2 = dset->t2;
-    double xt, xs, ys, yt, k;
-    double *num, *den;
-    int n = t2 + 1; /* really? */
+    guint64 work = 0;
+    int n, p, lo, hi;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+    int t;
 
     if (h < 0.0) {
 	return E_DATA;
@@ -6468,64 +6491,83 @@ int nadaraya_watson (const double *y, const double *x, double h,
 	h = kernel_bandwidth(sampx, n);
     }
 
-    num = malloc(2 * n * sizeof *num);
-    if (num == NULL) {
+    pts = malloc((t2 - t1 + 1) * sizeof *pts);
+    wlo = malloc(2 * (t2 - t1 + 1) * sizeof *wlo);
+    if (pts == NULL || wlo == NULL) {
+	free(pts);
+	free(wlo);
 	return E_ALLOC;
     }
 
-    den = num + n;
+    whi = wlo + (t2 - t1 + 1);
     trim *= h;
 
-    /* here we initialize numerator and denominator; we use the
-       "diagonal" in the standard case and 0 in the leave-one-out
-       case
-    */
+    /* sort the points with valid x */
+    n = 0;
+    for (t=t1; t<=t2; t++) {
+	if (na(x[t])) {
+	    m[t] = NADBL;
+	} else {
+	    pts[n].x = x[t];
+	    pts[n].y = y[t];
+	    pts[n].t = t;
+	    n++;
+	}
+    }
 
-    if (LOO) {
-	for (t=t1; t<=t2; t++) {
-	    num[t] = den[t] = 0.0;
+    qsort(pts, n, sizeof *pts, compare_nw_points);
+
+    /* find the window of points within the trimming distance of
+       each point (self included)
+    */
+    lo = hi = 0;
+    for (p=0; p<n; p++) {
+	while (lo < p && !(pts[p].x - pts[lo].x < trim)) {
+	    lo++;
 	}
-    } else {
-	k = nw_kernel(0);
-	for (t=t1; t<=t2; t++) {
-	    if (!na(y[t])) {
-		num[t] = k * y[t];
-		den[t] = k;
-	    } else {
-		num[t] = 0;
-		den[t] = 0;
-	    }
+	if (hi < p) {
+	    hi = p;
+	}
+	while (hi < n - 1 && pts[hi+1].x - pts[p].x < trim) {
+	    hi++;
 	}
+	wlo[p] = lo;
+	whi[p] = hi;
+	work += hi - lo + 1;
     }
 
-    for (t=t1; t<=t2; t++) {
-	xt = x[t];
-	if (!na(xt)) {
-	    yt = y[t];
-	    for (s=t+1; s<=t2; s++) {
-		xs = x[s];
-		if (!na(xs) && fabs(xs-xt) < trim) {
-		    k = nw_kernel((xt - xs)/h);
-		    if (!na(yt)) {
-			num[s] += k * yt;
-			den[s] += k;
-		    }
-		    ys = y[s];
-		    if (!na(ys)) {
-			num[t] += k * ys;
-			den[t] += k;
-		    }
-		}
+#if defined(_OPENMP)
+    if (libset_use_openmp(work)) {
+	nt = get_omp_n_threads();
+    }
+#pragma omp parallel for private(p) schedule(dynamic, 64) if (nt > 1) num_threads(nt)
+#endif
+    for (p=0; p<n; p++) {
+	double xp = pts[p].x;
+	double num = 0, den = 0;
+	double k;
+	int q;
+
+	/* the "diagonal" term, except in the leave-one-out case */
+	if (!LOO && !na(pts[p].y)) {
+	    k = nw_kernel(0);
+	    num = k * pts[p].y;
+	    den = k;
+	}
+	for (q=wlo[p]; q<=whi[p]; q++) {
+	    if (q != p && !na(pts[q].y)) {
+		k = nw_kernel((xp - pts[q].x)/h);
+		num += k * pts[q].y;
+		den += k;
 	    }
-	    m[t] = num[t] / den[t];
-	} else {
-	    m[t] = NADBL;
 	}
+	m[pts[p].t] = num / den;
     }
 
-    free(num);
+    free(pts);
+    free(wlo);
 
-    return err;
+    return 0;
 }
 
 static int xy_get_sample (const double *y, const double *x,
@@ -375,6 +375,7 @@ struct str_table funcs[] = {
     { F_PRINCOMP, "princomp" },
     { F_MEXP,     "mexp" },
     { F_MLOG,     "mlog" },
+    { F_MSINGLE,  "msingle" },
     { F_FDJAC,    "fdjac" },
     { F_BFGSMAX,  "BFGSmax" },
     { F_BFGSCMAX, "BFGScmax" },
@@ -508,6 +509,7 @@ struct str_table funcs[] = {
     { F_ALLREDUCE, "mpiallred" },
     { F_SCATTER,   "mpiscatter" },
     { F_BARRIER,   "mpibarrier" },
+    { F_MPITASK,   "mpitask" },
     { F_EASTER,    "easterday" },
     { F_GENSERIES, "genseries" },
     { F_CURL,      "curl" },
@@ -569,6 +571,7 @@ struct str_table funcs[] = {
     { F_STDIZE,    "stdize" },
     { F_STACK,     "stack" },
     { F_GEOPLOT,   "geoplot" },
+    { F_OLSFILE,   "olsfile" },
     { 0,           NULL }
 };
 
@@ -77,6 +77,8 @@ static Gretl_MPI_Op real_get_reduce_op (const char *s)
 	return GRETL_MPI_VCAT;
     } else if (!strcmp(s, "acat")) {
 	return GRETL_MPI_ACAT;
+    } else if (!strcmp(s, "amerge")) {
+	return GRETL_MPI_AMERGE;
     } else {
 	return 0;
     }
@@ -186,8 +188,8 @@ static NODE *mpi_transfer_node (NODE *l, NODE *r, NODE *r2,
 	    } else if (ubundle_node(l) && f == F_BCAST) {
 		/* bundle: only broadcast OK */
 		type = GRETL_TYPE_BUNDLE;
-	    } else if (uarray_node(l) && (f == F_REDUCE || f == F_BCAST)) {
-		/* array: reduce and broadcast OK */
+	    } else if (uarray_node(l) && f != F_SCATTER) {
+		/* array: reduce, allreduce and broadcast OK */
 		type = GRETL_TYPE_ARRAY;
 	    } else if (uscalar_node(l) && f != F_SCATTER) {
 		/* scalar: all ops OK apart from scatter */
@@ -319,7 +321,7 @@ static NODE *mpi_transfer_node (NODE *l, NODE *r, NODE *r2,
 	    double x = NADBL;
 
 	    if (type == GRETL_TYPE_ARRAY) {
-		p->err = gretl_array_mpi_reduce(l->v.a, &a, op, root);
+		p->err = gretl_array_mpi_reduce(l->v.a, &a, op, root, opt);
 	    } else if (type == GRETL_TYPE_MATRIX) {
 		lm = get_transfer_matrix(l, f, p);
 		if (!p->err) {
@@ -379,3 +381,29 @@ static NODE *mpi_barrier_node (parser *p)
 
     return ret;
 }
+
+static NODE *mpi_task_node (NODE *l, NODE *r, parser *p)
+{
+    NODE *ret = NULL;
+    int ntasks, root = 0;
+
+    if (!gretl_mpi_initialized()) {
+	gretl_errmsg_set(_("The MPI library is not loaded"));
+	p->err = 1;
+	return NULL;
+    }
+
+    ntasks = node_get_int(l, p);
+    if (!p->err && !null_node(r)) {
+	root = node_get_int(r, p);
+    }
+
+    if (!p->err) {
+	ret = aux_scalar_node(p);
+    }
+    if (!p->err) {
+	ret->v.xval = gretl_mpi_next_task(ntasks, root, &p->err);
+    }
+
+    return ret;
+}
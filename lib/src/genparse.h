@@ -291,6 +291,7 @@ enum {
     F_CTRANS,
     F_MLOG,
     F_BARRIER,
+    F_MSINGLE,
     HF_JBTERMS,
     F1_MAX,	  /* SEPARATOR: end of single-arg functions */
     HF_LISTINFO,
@@ -368,6 +369,7 @@ enum {
     F_MPI_SEND,
     F_BCAST,
     F_ALLREDUCE,
+    F_MPITASK,
     F_GENSERIES,
     F_KPSSCRIT,
     F_STRINGIFY,
@@ -464,6 +466,7 @@ enum {
     F_RESAMPLE,
     F_STACK,
     F_GEOPLOT,
+    F_OLSFILE,
     HF_REGLS,
     F3_MAX,       /* SEPARATOR: end of three-arg functions */
     F_BKFILT,
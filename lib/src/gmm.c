@@ -23,11 +23,16 @@
 #include "libset.h"
 #include "qr_estimate.h"
 #include "gretl_bfgs.h"
+#include "gretl_cmatrix.h"
 
 #include "../../minpack/minpack.h"
 
 #include <errno.h>
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 #define GMM_DEBUG 0
 
 typedef struct colsrc_ colsrc;
@@ -53,6 +58,7 @@ struct ocset_ {
     gretl_matrix *tmp;    /* holds columnwise product of e and Z */
     gretl_matrix *sum;    /* holds column sums of tmp */
     gretl_matrix *S;      /* selector matrix for computing tmp */
+    int *ocidx;           /* e and Z columns for each column of tmp */
     colsrc *ecols;        /* info on provenance of columns of 'e' */
     int noc;              /* total number of orthogonality conds. */
     int step;             /* number of estimation steps */
@@ -81,6 +87,7 @@ void oc_set_destroy (ocset *oc)
     gretl_matrix_free(oc->sum);
     gretl_matrix_free(oc->S);
 
+    free(oc->ocidx);
     free(oc->ecols);
 
     if (oc->lnames != NULL) {
@@ -112,6 +119,7 @@ static ocset *oc_set_new (void)
 	oc->tmp = NULL;
 	oc->sum = NULL;
 	oc->S = NULL;
+	oc->ocidx = NULL;
 	oc->ecols = NULL;
 	oc->noc = 0;
 	oc->step = 0;
@@ -956,8 +964,8 @@ int check_gmm_requirements (nlspec *spec)
 static int gmm_update_e (nlspec *s)
 {
     gretl_matrix *e;
-    double etj;
-    int j, t, v;
+    size_t csize = s->nobs * sizeof(double);
+    int j, v;
     int err = 0;
 
     for (j=0; j<s->oc->e->cols && !err; j++) {
@@ -968,10 +976,8 @@ static int gmm_update_e (nlspec *s)
 		    j, v);
 #endif
 	    /* transcribe from series */
-	    for (t=0; t<s->nobs; t++) {
-		etj = s->dset->Z[v][t + s->t1];
-		gretl_matrix_set(s->oc->e, t, j, etj);
-	    }
+	    memcpy(s->oc->e->val + (size_t) j * s->nobs,
+		   s->dset->Z[v] + s->t1, csize);
 	} else {
 #if GMM_DEBUG > 1
 	    fprintf(stderr, "gmm_update_e: updating col %d from matrix %s\n",
@@ -982,10 +988,9 @@ static int gmm_update_e (nlspec *s)
 	    if (e == NULL) {
 		err = 1;
 	    } else if (e != s->oc->e) {
-		for (t=0; t<s->nobs; t++) {
-		    etj = gretl_matrix_get(e, t, s->oc->ecols[j].j);
-		    gretl_matrix_set(s->oc->e, t, j, etj);
-		}
+		memcpy(s->oc->e->val + (size_t) j * s->nobs,
+		       e->val + (size_t) s->oc->ecols[j].j * e->rows,
+		       csize);
 	    }
 	} 
     }
@@ -993,54 +998,123 @@ static int gmm_update_e (nlspec *s)
     return err;
 }
 
-/* Carry out the required O.C. columnwise multiplications:
-   e_i * Z_j */
+/* Record, for each O.C., the columns of e and Z whose product
+   it represents, following the selector matrix if present.
+*/
 
-static int gmm_multiply_ocs (nlspec *s)
+static int gmm_set_oc_index (ocset *oc)
 {
-    int err;
+    int m = oc->tmp->cols;
+    int i, j, p = 0;
+
+    oc->ocidx = malloc(2 * m * sizeof *oc->ocidx);
+    if (oc->ocidx == NULL) {
+	return E_ALLOC;
+    }
+
+    for (i=0; i<oc->e->cols; i++) {
+	for (j=0; j<oc->Z->cols; j++) {
+	    if (oc->S == NULL || gretl_matrix_get(oc->S, i, j) != 0) {
+		if (p < m) {
+		    oc->ocidx[2*p] = i;
+		    oc->ocidx[2*p+1] = j;
+		}
+		p++;
+	    }
+	}
+    }
+
+    if (p != m) {
+	free(oc->ocidx);
+	oc->ocidx = NULL;
+	return E_NONCONF;
+    }
+
+    return 0;
+}
+
+/* Carry out the required O.C. columnwise multiplications,
+   e_i * Z_j, and sum the products over the observations into
+   @sum. If @keep is non-zero the products themselves are also
+   written into s->oc->tmp, for use in computing the weights or
+   the covariance matrix; otherwise (as in the Jacobian
+   calculation) we skip the T x noc store. The O.C.s are shared
+   out among threads.
+*/
+
+static int gmm_multiply_ocs (nlspec *s, double *sum, int keep)
+{
+    ocset *oc = s->oc;
+    int T = oc->tmp->rows;
+    int m = oc->tmp->cols;
+    int p, err = 0;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+
+    if (oc->e->rows != T || oc->Z->rows != T) {
+	err = E_NONCONF;
+    } else if (oc->ocidx == NULL) {
+	err = gmm_set_oc_index(oc);
+    }
 
-    err = gretl_matrix_columnwise_product(s->oc->e,
-					  s->oc->Z,
-					  s->oc->S,
-					  s->oc->tmp);
     if (err) {
-	fprintf(stderr, "gmm_multiply_ocs: err = %d from "
-		"gretl_matrix_columnwise_product\n", err);
+	fprintf(stderr, "gmm_multiply_ocs: err = %d\n", err);
+	return err;
+    }
+
+#if defined(_OPENMP)
+    if (m > 1 && libset_use_openmp((guint64) T * m)) {
+	nt = get_omp_n_threads();
+	if (nt > m) {
+	    nt = m;
+	}
+    }
+#pragma omp parallel for private(p) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+    for (p=0; p<m; p++) {
+	const double *ei = oc->e->val + (size_t) oc->ocidx[2*p] * T;
+	const double *zj = oc->Z->val + (size_t) oc->ocidx[2*p+1] * T;
+	double *tp = oc->tmp->val + (size_t) p * T;
+	double x, sp = 0.0;
+	int t;
+
+	if (keep) {
+	    for (t=0; t<T; t++) {
+		x = ei[t] * zj[t];
+		tp[t] = x;
+		sp += x;
+	    }
+	} else {
+	    for (t=0; t<T; t++) {
+		sp += ei[t] * zj[t];
+	    }
+	}
+	sum[p] = sp;
     }
 
 #if GMM_DEBUG > 1
     gretl_matrix_print(s->oc->e, "gmm_multiply_ocs: s->oc->e");
     gretl_matrix_print(s->oc->Z, "gmm_multiply_ocs: s->oc->Z");
-    gretl_matrix_print(s->oc->tmp, "gmm_multiply_ocs: s->oc->tmp");
-    fprintf(stderr, "err = %d\n", err);
+    if (keep) {
+	gretl_matrix_print(s->oc->tmp, "gmm_multiply_ocs: s->oc->tmp");
+    }
 #endif
 
-    return err;
+    return 0;
 }
 
 static double gmm_criterion (nlspec *s)
 {
     double crit = 0.0;
-    gretl_matrix *sum = s->oc->sum;
-    gretl_matrix *W = s->oc->W;
-    int k = s->oc->noc;
-    int i, j, err;
+    int err;
 
-    err = gmm_multiply_ocs(s);
+    err = gmm_multiply_ocs(s, s->oc->sum->val, 1);
     if (err) {
 	return NADBL;
     }
 
-    /* compute column sums */
-    for (i=0; i<k; i++) {
-	sum->val[i] = 0.0;
-	for (j=0; j<s->nobs; j++) {
-	    sum->val[i] += gretl_matrix_get(s->oc->tmp, j, i);
-	}
-    }
-
-    crit = gretl_scalar_qform(sum, W, &err);
+    crit = gretl_scalar_qform(s->oc->sum, s->oc->W, &err);
     if (!err) {
 	crit = -crit;
     }
@@ -1085,7 +1159,7 @@ static int gmm_jacobian_calc (int m, int n, double *x, double *f,
 {
     nlspec *s = (nlspec *) p;
     double fac;
-    int i, t, T;
+    int i;
 
     update_coeff_values(x, p);
 
@@ -1099,72 +1173,81 @@ static int gmm_jacobian_calc (int m, int n, double *x, double *f,
 	return 1;
     }
 
-    if (gmm_multiply_ocs(s)) {
+    /* we need only the sums here, not the products */
+    if (gmm_multiply_ocs(s, f, 0)) {
 	*iflag = -1;
 	return 1;
     }
-    
-    T = s->nobs;
-    fac = sqrt((double) T) / T;
+
+    fac = sqrt((double) s->nobs) / s->nobs;
 
     for (i=0; i<m; i++) {
-	f[i] = 0.0;
-	for (t=0; t<T; t++) {
-	    f[i] += gretl_matrix_get(s->oc->tmp, t, i);
-	}
 	f[i] *= fac;
     }
 
     return 0;
 }
 
+/* Copy the columns of @src, starting at row @r0, into the
+   columns of @targ, which has fewer rows */
+
+static void copy_rows_from (gretl_matrix *targ, const gretl_matrix *src,
+			   int r0)
+{
+    size_t csize = targ->rows * sizeof(double);
+    int j;
+
+    for (j=0; j<targ->cols; j++) {
+	memcpy(targ->val + (size_t) j * targ->rows,
+	       src->val + (size_t) j * src->rows + r0, csize);
+    }
+}
+
+/* Fit a VAR(1) to the columns of @E, placing the coefficients in
+   @A, and replace rows 2 to T of @E by the VAR residuals. The
+   regressions share a single Cholesky factorization and the
+   residuals for all periods are formed as one product.
+*/
+
 static int HAC_prewhiten (gretl_matrix *E, gretl_matrix *A)
 {
     gretl_matrix_block *B;
-    gretl_matrix *y, *X, *XTX;
-    gretl_matrix *b, *e;
+    gretl_matrix *Y, *X, *XTX, *C;
+    gretl_matrix b;
     int T = E->rows;
     int k = E->cols;
-    double xtj, eti;
-    int i, j, t;
+    int i, j;
     int err = 0;
 
-    B = gretl_matrix_block_new(&y, T-1, 1,
+    B = gretl_matrix_block_new(&Y, T-1, k,
 			       &X, T-1, k,
 			       &XTX, k, k,
-			       &b, k, 1,
-			       &e, k, 1,
+			       &C, k, k,
 			       NULL);
     if (B == NULL) {
 	return E_ALLOC;
     }
 
-    /* make matrix of RHS vars */
-    for (j=0; j<k; j++) {
-	for (t=1; t<T; t++) {
-	    xtj = gretl_matrix_get(E, t-1, j);
-	    gretl_matrix_set(X, t-1, j, xtj);
-	}
-    }   
+    /* current and lagged values */
+    copy_rows_from(Y, E, 1);
+    copy_rows_from(X, E, 0);
 
     gretl_matrix_multiply_mod(X, GRETL_MOD_TRANSPOSE,
 			      X, GRETL_MOD_NONE,
 			      XTX, GRETL_MOD_NONE);
+    gretl_matrix_multiply_mod(X, GRETL_MOD_TRANSPOSE,
+			      Y, GRETL_MOD_NONE,
+			      C, GRETL_MOD_NONE);
 
     err = gretl_matrix_cholesky_decomp(XTX);
 
     /* loop across LHS vars and compute coeffs */
     for (i=0; i<k && !err; i++) {
-	for (t=1; t<T; t++) {
-	    y->val[t-1] = gretl_matrix_get(E, t, i);
-	}
-	gretl_matrix_multiply_mod(X, GRETL_MOD_TRANSPOSE,
-				  y, GRETL_MOD_NONE,
-				  b, GRETL_MOD_NONE);
-	err = gretl_cholesky_solve(XTX, b);
+	gretl_matrix_init_full(&b, k, 1, C->val + (size_t) i * k);
+	err = gretl_cholesky_solve(XTX, &b);
 	if (!err) {
 	    for (j=0; j<k; j++) {
-		gretl_matrix_set(A, i, j, b->val[j]);
+		gretl_matrix_set(A, i, j, b.val[j]);
 	    }
 	}
     }
@@ -1185,23 +1268,14 @@ static int HAC_prewhiten (gretl_matrix *E, gretl_matrix *A)
 	gretl_matrix_print(A, "A~");
 #endif
 
-	for (i=0; i<k; i++) {
-	    /* get starting E values */
-	    e->val[i] = gretl_matrix_get(E, 0, i);
-	}	
-
-	/* Now "whiten" E using A~ */
-	for (t=1; t<T; t++) {
-	    /* re-use @b for fitted values */
-	    gretl_matrix_multiply(A, e, b);
-	    for (i=0; i<k; i++) {
-		/* retrieve current value */
-		eti = gretl_matrix_get(E, t, i);
-		/* save lagged value for next round */
-		e->val[i] = eti;
-		/* substitute prediction error */
-		gretl_matrix_set(E, t, i, eti - b->val[i]);
-	    }
+	/* Now "whiten" E using A~: e_t - A~ e_{t-1} */
+	gretl_matrix_multiply_mod(X, GRETL_MOD_NONE,
+				  A, GRETL_MOD_TRANSPOSE,
+				  Y, GRETL_MOD_DECREMENT);
+	for (j=0; j<k; j++) {
+	    memcpy(E->val + (size_t) j * T + 1,
+		   Y->val + (size_t) j * (T-1),
+		   (T-1) * sizeof(double));
 	}
     }
 
@@ -1212,15 +1286,141 @@ static int HAC_prewhiten (gretl_matrix *E, gretl_matrix *A)
     return err;
 }
 
+#define HAC_FFT_MIN 256 /* min. lags for computing lag sums via FFT */
+
+/* Lag sums by FFT: the (linear) convolution of each column of @E
+   with the weights in @a is computed on a grid long enough to
+   avoid wrap-around. The columns are taken one at a time to
+   bound the memory requirement.
+*/
+
+static int HAC_lag_sum_fft (gretl_matrix *W, const gretl_matrix *E,
+			    const double *a, int h)
+{
+    gretl_matrix *x = NULL, *fa = NULL;
+    gretl_matrix *fx = NULL, *cx = NULL;
+    double ar, ai, br, bi;
+    int T = E->rows;
+    int i, j, P = 2;
+    int err = 0;
+
+    while (P < T + h) {
+	P *= 2;
+    }
+
+    x = gretl_zero_matrix_new(P, 1);
+    if (x == NULL) {
+	return E_ALLOC;
+    }
+
+    memcpy(x->val, a, (h + 1) * sizeof(double));
+    fa = gretl_matrix_fft(x, 0, &err);
+
+    for (j=0; j<E->cols && !err; j++) {
+	gretl_matrix_zero(x);
+	memcpy(x->val, E->val + (size_t) j * T, T * sizeof(double));
+	fx = gretl_matrix_fft(x, 0, &err);
+	if (!err) {
+	    /* complex product, written into fx */
+	    for (i=0; i<P; i++) {
+		ar = gretl_matrix_get(fx, i, 0);
+		ai = gretl_matrix_get(fx, i, 1);
+		br = gretl_matrix_get(fa, i, 0);
+		bi = gretl_matrix_get(fa, i, 1);
+		gretl_matrix_set(fx, i, 0, ar * br - ai * bi);
+		gretl_matrix_set(fx, i, 1, ar * bi + ai * br);
+	    }
+	    cx = gretl_matrix_ffti(fx, &err);
+	}
+	if (!err) {
+	    memcpy(W->val + (size_t) j * T, cx->val, T * sizeof(double));
+	}
+	gretl_matrix_free(fx);
+	gretl_matrix_free(cx);
+	fx = cx = NULL;
+    }
+
+    gretl_matrix_free(x);
+    gretl_matrix_free(fa);
+
+    return err;
+}
+
+/* Write into @W the lag sums E_t + sum_{i=1}^h 2 w_i E_{t-i},
+   where the w_i are the HAC kernel weights, so that the long-run
+   covariance can be had from the single product E'W (after
+   symmetrization) rather than one product per lag. For the
+   direct calculation the columns are shared out among threads;
+   for long lag truncations we switch to FFT convolution.
+*/
+
+static int HAC_lag_sum (gretl_matrix *W, const gretl_matrix *E,
+			const hac_info *hinfo)
+{
+    int T = E->rows;
+    int k = E->cols;
+    int h = MIN(hinfo->h, T - 1);
+    double *a;
+    int i, j;
+    int err = 0;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+
+    a = malloc((h + 1) * sizeof *a);
+    if (a == NULL) {
+	return E_ALLOC;
+    }
+
+    a[0] = 1.0;
+    for (i=1; i<=h; i++) {
+	if (hinfo->kern == KERNEL_QS) {
+	    a[i] = 2 * qs_hac_weight(hinfo->bt, i);
+	} else {
+	    a[i] = 2 * hac_weight(hinfo->kern, hinfo->h, i);
+	}
+    }
+
+    if (h >= HAC_FFT_MIN) {
+	err = HAC_lag_sum_fft(W, E, a, h);
+	free(a);
+	return err;
+    }
+
+#if defined(_OPENMP)
+    if (k > 1 && libset_use_openmp((guint64) T * k * (h + 1))) {
+	nt = get_omp_n_threads();
+	if (nt > k) {
+	    nt = k;
+	}
+    }
+#pragma omp parallel for private(i, j) schedule(static) if (nt > 1) num_threads(nt)
+#endif
+    for (j=0; j<k; j++) {
+	const double *ej = E->val + (size_t) j * T;
+	double *wj = W->val + (size_t) j * T;
+	int t;
+
+	memcpy(wj, ej, T * sizeof(double));
+	for (i=1; i<=h; i++) {
+	    for (t=i; t<T; t++) {
+		wj[t] += a[i] * ej[t-i];
+	    }
+	}
+    }
+
+    free(a);
+
+    return err;
+}
+
 static int gmm_HAC (gretl_matrix *E, gretl_matrix *V, hac_info *hinfo)
 {
     static gretl_matrix *W;
     static gretl_matrix *Tmp;
     static gretl_matrix *A;
     static gretl_matrix *E2;
-    int T, k;
-    double w;
-    int i, err = 0;
+    int k, err = 0;
 
     if (E == NULL) {
 	/* cleanup signal */
@@ -1232,18 +1432,17 @@ static int gmm_HAC (gretl_matrix *E, gretl_matrix *V, hac_info *hinfo)
 	return 0;
     }
 
-    T = E->rows;
     k = E->cols;
 
     if (W == NULL) {
-	W = gretl_matrix_alloc(T, k);
+	W = gretl_matrix_alloc(E->rows, k);
 	Tmp = gretl_matrix_alloc(k, k);
 	if (W == NULL || Tmp == NULL) {
 	    return E_ALLOC;
 	}
 	if (hinfo->whiten) {
 	    A = gretl_matrix_alloc(k, k);
-	    E2 = gretl_matrix_alloc(T, k);
+	    E2 = gretl_matrix_alloc(E->rows, k);
 	    if (A == NULL || E2 == NULL) {
 		return E_ALLOC;
 	    }
@@ -1266,35 +1465,22 @@ static int gmm_HAC (gretl_matrix *E, gretl_matrix *V, hac_info *hinfo)
 	}
     }
 
-    gretl_matrix_multiply_mod(E, GRETL_MOD_TRANSPOSE,
-			      E, GRETL_MOD_NONE,
-			      V, GRETL_MOD_NONE);
-
-    for (i=1; i<=hinfo->h; i++) {
-	if (hinfo->kern == KERNEL_QS) {
-	    w = qs_hac_weight(hinfo->bt, i);
-	} else {
-	    w = hac_weight(hinfo->kern, hinfo->h, i);
-	}
-	gretl_matrix_inplace_lag(W, E, i);
-	gretl_matrix_multiply_by_scalar(W, 2*w);
-	gretl_matrix_multiply_mod(E, GRETL_MOD_TRANSPOSE,
-				  W, GRETL_MOD_NONE,
-				  Tmp, GRETL_MOD_NONE);
-	gretl_matrix_xtr_symmetric(Tmp);
-	gretl_matrix_add_to(V, Tmp);
+    /* V = E'E + sum_i w_i (G_i + G_i'), G_i = E'L^iE */
+    err = HAC_lag_sum(W, E, hinfo);
+    if (!err) {
+	err = gretl_matrix_multiply_mod(E, GRETL_MOD_TRANSPOSE,
+					W, GRETL_MOD_NONE,
+					V, GRETL_MOD_NONE);
     }
-
-    if (!gretl_matrix_is_symmetric(V)) {
-	/* should we do this? */
-	fprintf(stderr, "gmm_HAC: V is not symmetric\n");
-	gretl_matrix_xtr_symmetric(V);
+    if (err) {
+	return err;
     }
+    gretl_matrix_xtr_symmetric(V);
 
     if (hinfo->whiten) {
 	/* now we have to recolor */
 	double aij;
-	int j;
+	int i, j;
 
 	/* make A into (I - A) */
 	for (i=0; i<k; i++) {
@@ -1336,7 +1522,7 @@ int gmm_add_vcv (MODEL *pmod, nlspec *s)
     gretl_matrix_block *B;
     gretl_matrix *V, *J, *S;
     gretl_matrix *m1, *m2, *m3;
-    int i, j, k = s->ncoeff;
+    int i, k = s->ncoeff;
     int T = s->nobs;
     double *wa4;
     int m, n;
@@ -1379,11 +1565,8 @@ int gmm_add_vcv (MODEL *pmod, nlspec *s)
 	gretl_matrix_divide_by_scalar(S, T);
 	f = s->oc->sum->val;
 
+	/* the column sums of tmp are already in place */
 	for (i=0; i<m; i++) {
-	    f[i] = 0.0;
-	    for (j=0; j<T; j++) {
-		f[i] += gretl_matrix_get(s->oc->tmp, j, i);
-	    }
 	    f[i] *= Tfac;
 	}
 
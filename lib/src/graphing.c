@@ -87,6 +87,10 @@ struct gnuplot_info_ {
     int *withlist;
     int band;
     double ybase;
+    FILE *binfp;
+    double *binbuf;
+    int binrows;
+    int *binrec;
 };
 
 enum {
@@ -1806,6 +1810,9 @@ static int this_term_type;
 /* recorder for filename given via --output=foo */
 static char gnuplot_outname[FILENAME_MAX];
 
+/* sidecar file for binary plot data, if applicable */
+static char gp_binfile[FILENAME_MAX];
+
 static int set_term_type_from_fname (const char *fname)
 {
     if (has_suffix(fname, ".eps")) {
@@ -2114,6 +2121,7 @@ FILE *open_plot_input_file (PlotType ptype, GptFlags flags, int *err)
     /* initialize */
     this_term_type = GP_TERM_NONE;
     *gnuplot_outname = '\0';
+    *gp_binfile = '\0';
 
     /* check for --output=whatever option */
     optname = plot_output_option(ptype, &ci);
@@ -2282,6 +2290,9 @@ static int gnuplot_make_graph (void)
 	} else {
 	    /* remove the temporary input file */
 	    gretl_remove(fname);
+	    if (*gp_binfile != '\0') {
+		gretl_remove(gp_binfile);
+	    }
 	    gretl_set_path_by_name("plotfile", gnuplot_outname);
 	    graph_file_written = 1;
 	}
@@ -3105,15 +3116,21 @@ static int print_gp_dummy_data (gnuplot_info *gi,
 /* for printing panel time-series graph: insert a discontinuity
    between the panel units */
 
-static void
-maybe_print_panel_jot (int t, const DATASET *dset, FILE *fp)
+static int panel_jot_wanted (int t, const DATASET *dset)
 {
     char obs[OBSLEN];
     int maj, min;
 
     ntodate(obs, t, dset);
     sscanf(obs, "%d:%d", &maj, &min);
-    if (maj > 1 && min == 1) {
+
+    return maj > 1 && min == 1;
+}
+
+static void
+maybe_print_panel_jot (int t, const DATASET *dset, FILE *fp)
+{
+    if (panel_jot_wanted(t, dset)) {
 	fprintf(fp, "%g %s\n", t + 0.5, gpna);
     }
 }
@@ -3168,6 +3185,274 @@ static int use_lines (gnuplot_info *gi)
    with NAs when printing the plot data */
 static int *na_skiplist;
 
+static int gp_skip_obs (gnuplot_info *gi, const DATASET *dset,
+			const int *datlist, int ynum, int t)
+{
+    if (in_gretl_list(na_skiplist, datlist[ynum]) &&
+	na(dset->Z[datlist[ynum]][t])) {
+	return 1;
+    } else if (gi->x == NULL &&
+	       all_graph_data_missing(gi->list, t, (const double **) dset->Z)) {
+	return 1;
+    } else {
+	return 0;
+    }
+}
+
+/* Binary data transport: when the gnuplot input file is just
+   a temporary one, to be deleted once gnuplot has written the
+   graphics file the user asked for, there's no point in having
+   the data printed as text. In that case we write the (x, y)
+   records for each plotted series into a "sidecar" file of
+   native doubles, one block per series, and the plot lines
+   reference that file rather than inline data. Plot files that
+   are to be saved, or parsed by the GUI, always get text.
+*/
+
+static void gp_binary_record (gnuplot_info *gi, double x, double y)
+{
+    double *rec = gi->binbuf + 2 * gi->binrows;
+
+    rec[0] = na(x) ? NADBL : x;
+    rec[1] = na(y) ? NADBL : y;
+    gi->binrows += 1;
+}
+
+static void gp_binary_obs (gnuplot_info *gi, const DATASET *dset,
+			   const int *datlist, int t, double xoff)
+{
+    double xt, yt;
+
+    if ((gi->flags & GPT_TS) && dset->structure == STACKED_TIME_SERIES &&
+	panel_jot_wanted(t, dset)) {
+	gp_binary_record(gi, t + 0.5, NADBL);
+    }
+
+    if (gi->x != NULL) {
+	xt = gi->x[t] + xoff;
+	yt = dset->Z[datlist[1]][t];
+    } else {
+	xt = dset->Z[datlist[1]][t];
+	if (!na(xt)) {
+	    xt += xoff;
+	}
+	yt = dset->Z[datlist[2]][t];
+    }
+
+    gp_binary_record(gi, xt, yt);
+}
+
+/* terminate the data block for the i-th plotted series */
+
+static void gp_end_block (gnuplot_info *gi, int i, FILE *fp)
+{
+    if (gi->binfp != NULL) {
+	if (gi->binrows == 0) {
+	    /* gnuplot won't accept an empty record */
+	    gp_binary_record(gi, NADBL, NADBL);
+	}
+	fwrite(gi->binbuf, 2 * sizeof(double), gi->binrows, gi->binfp);
+	gi->binrec[i-1] = gi->binrows;
+	gi->binrows = 0;
+    } else {
+	fputs("e\n", fp);
+    }
+}
+
+static void print_gp_obs (gnuplot_info *gi, const DATASET *dset,
+			  const int *datlist, int i, int t,
+			  int nomarkers, double xoff, FILE *fp)
+{
+    const char *label = NULL;
+    char obs[OBSLEN];
+
+    if (gi->binfp != NULL) {
+	gp_binary_obs(gi, dset, datlist, t, xoff);
+	return;
+    }
+
+    if (!(gi->flags & GPT_TS) && i == 1) {
+	if (dset->markers) {
+	    label = dset->S[t];
+	} else if (!nomarkers && dataset_is_time_series(dset)) {
+	    ntodate(obs, t, dset);
+	    label = obs;
+	}
+    }
+    if ((gi->flags & GPT_TS) && dset->structure == STACKED_TIME_SERIES) {
+	maybe_print_panel_jot(t, dset, fp);
+    }
+    printvars(fp, t, datlist, dset, gi, label, xoff);
+}
+
+/* Data reduction for plots with very many observations (more
+   than the "plot_maxpoints" setting). For line plots against
+   time we split the sample into buckets and print only the
+   first and last observations in each, plus those at which the
+   minimum and maximum occur: at screen resolution the result is
+   indistinguishable from the full line. For scatter plots we
+   lay a fine grid over the data and print just the first point
+   falling into each cell, since the others would be overplotted
+   anyway.
+*/
+
+#define GP_REDUCE_LINES   1
+#define GP_REDUCE_SCATTER 2
+#define GP_GRID           1024
+
+static int gp_reduce_method (gnuplot_info *gi, const DATASET *dset,
+			     int n)
+{
+    int maxpts = libset_get_int(PLOT_MAXPOINTS);
+
+    if (maxpts <= 0 || n <= maxpts || (gi->flags & GPT_DATA_STYLE)) {
+	return 0;
+    } else if (dset->structure == STACKED_TIME_SERIES) {
+	return 0;
+    } else if (gi->x != NULL && (gi->flags & GPT_TS)) {
+	return GP_REDUCE_LINES;
+    } else if (gi->x == NULL && !(gi->flags & GPT_TS) &&
+	       !use_lines(gi) && !use_impulses(gi)) {
+	return GP_REDUCE_SCATTER;
+    } else {
+	return 0;
+    }
+}
+
+static void insert_obs_index (int *idx, int *k, int t)
+{
+    int j, m;
+
+    if (t < 0) {
+	return;
+    }
+    for (j=0; j<*k; j++) {
+	if (idx[j] == t) {
+	    return;
+	} else if (idx[j] > t) {
+	    break;
+	}
+    }
+    for (m=*k; m>j; m--) {
+	idx[m] = idx[m-1];
+    }
+    idx[j] = t;
+    *k += 1;
+}
+
+static void print_gp_data_lines (gnuplot_info *gi, const DATASET *dset,
+				 const int *datlist, int ynum, int i,
+				 double xoff, FILE *fp)
+{
+    const double *y = dset->Z[datlist[ynum]];
+    guint64 n = gi->t2 - gi->t1 + 1;
+    int nb = libset_get_int(PLOT_MAXPOINTS) / 4;
+    int first, last, imin, imax, inan;
+    int idx[5];
+    int b, s, e, t, j, k;
+
+    if (nb < 1) {
+	nb = 1;
+    }
+
+    for (b=0; b<nb; b++) {
+	s = gi->t1 + (int) (n * b / nb);
+	e = gi->t1 + (int) (n * (b + 1) / nb) - 1;
+	first = last = imin = imax = inan = -1;
+	for (t=s; t<=e; t++) {
+	    if (gp_skip_obs(gi, dset, datlist, ynum, t)) {
+		continue;
+	    } else if (na(y[t])) {
+		/* print one NA per bucket, to preserve gaps */
+		if (inan < 0) {
+		    inan = t;
+		}
+		continue;
+	    }
+	    if (first < 0) {
+		first = t;
+	    }
+	    last = t;
+	    if (imin < 0 || y[t] < y[imin]) {
+		imin = t;
+	    }
+	    if (imax < 0 || y[t] > y[imax]) {
+		imax = t;
+	    }
+	}
+	k = 0;
+	insert_obs_index(idx, &k, first);
+	insert_obs_index(idx, &k, imin);
+	insert_obs_index(idx, &k, imax);
+	insert_obs_index(idx, &k, last);
+	insert_obs_index(idx, &k, inan);
+	for (j=0; j<k; j++) {
+	    print_gp_obs(gi, dset, datlist, i, idx[j], 1, xoff, fp);
+	}
+    }
+}
+
+static int print_gp_data_scatter (gnuplot_info *gi, const DATASET *dset,
+				  const int *datlist, int ynum, int i,
+				  int nomarkers, double xoff, FILE *fp)
+{
+    const double *x = dset->Z[datlist[1]];
+    const double *y = dset->Z[datlist[ynum]];
+    double xmin = NADBL, xmax = NADBL;
+    double ymin = NADBL, ymax = NADBL;
+    double xscale, yscale;
+    unsigned char *cells;
+    size_t cell;
+    int ix, iy, t;
+
+    for (t=gi->t1; t<=gi->t2; t++) {
+	if (na(x[t]) || na(y[t])) {
+	    continue;
+	}
+	if (na(xmin)) {
+	    xmin = xmax = x[t];
+	    ymin = ymax = y[t];
+	} else {
+	    if (x[t] < xmin) xmin = x[t];
+	    if (x[t] > xmax) xmax = x[t];
+	    if (y[t] < ymin) ymin = y[t];
+	    if (y[t] > ymax) ymax = y[t];
+	}
+    }
+
+    if (na(xmin)) {
+	/* nothing to plot */
+	return 0;
+    }
+
+    /* bitmap recording the occupied grid cells */
+    cells = calloc((size_t) GP_GRID * GP_GRID / 8, 1);
+    if (cells == NULL) {
+	return E_ALLOC;
+    }
+
+    xscale = (xmax > xmin)? (GP_GRID - 1) / (xmax - xmin) : 0;
+    yscale = (ymax > ymin)? (GP_GRID - 1) / (ymax - ymin) : 0;
+
+    for (t=gi->t1; t<=gi->t2; t++) {
+	if (gp_skip_obs(gi, dset, datlist, ynum, t) ||
+	    na(x[t]) || na(y[t])) {
+	    continue;
+	}
+	ix = (int) ((x[t] - xmin) * xscale);
+	iy = (int) ((y[t] - ymin) * yscale);
+	cell = (size_t) ix * GP_GRID + iy;
+	if (!(cells[cell / 8] & (1 << (cell % 8)))) {
+	    cells[cell / 8] |= (1 << (cell % 8));
+	    print_gp_obs(gi, dset, datlist, i, t, nomarkers, xoff, fp);
+	}
+    }
+
+    free(cells);
+
+    return 0;
+}
+
 static void print_gp_data (gnuplot_info *gi, const DATASET *dset,
 			   FILE *fp)
 {
@@ -3176,6 +3461,7 @@ static void print_gp_data (gnuplot_info *gi, const DATASET *dset,
     int datlist[3];
     int lmax, ynum = 2;
     int nomarkers = 0;
+    int reduce;
     int i, t;
 
     /* multi impulse plot? calculate offset for lines */
@@ -3197,6 +3483,8 @@ static void print_gp_data (gnuplot_info *gi, const DATASET *dset,
 	nomarkers = 1;
     }
 
+    reduce = gp_reduce_method(gi, dset, n);
+
     /* loop across the variables, printing x then y[i] for each i */
 
     for (i=1; i<=lmax; i++) {
@@ -3204,35 +3492,125 @@ static void print_gp_data (gnuplot_info *gi, const DATASET *dset,
 
 	datlist[ynum] = gi->list[i];
 
-	for (t=gi->t1; t<=gi->t2; t++) {
-	    const char *label = NULL;
-	    char obs[OBSLEN];
+	if (reduce == GP_REDUCE_LINES) {
+	    print_gp_data_lines(gi, dset, datlist, ynum, i, xoff, fp);
+	    gp_end_block(gi, i, fp);
+	    continue;
+	} else if (reduce == GP_REDUCE_SCATTER &&
+		   print_gp_data_scatter(gi, dset, datlist, ynum, i,
+					 nomarkers, xoff, fp) == 0) {
+	    gp_end_block(gi, i, fp);
+	    continue;
+	}
 
-	    if (in_gretl_list(na_skiplist, datlist[ynum]) &&
-		na(dset->Z[datlist[ynum]][t])) {
-		continue;
-	    } else if (gi->x == NULL &&
-		all_graph_data_missing(gi->list, t, (const double **) dset->Z)) {
+	for (t=gi->t1; t<=gi->t2; t++) {
+	    if (gp_skip_obs(gi, dset, datlist, ynum, t)) {
 		continue;
 	    }
-	    if (!(gi->flags & GPT_TS) && i == 1) {
-		if (dset->markers) {
-		    label = dset->S[t];
-		} else if (!nomarkers && dataset_is_time_series(dset)) {
-		    ntodate(obs, t, dset);
-		    label = obs;
-		}
-	    }
-	    if ((gi->flags & GPT_TS) && dset->structure == STACKED_TIME_SERIES) {
-		maybe_print_panel_jot(t, dset, fp);
-	    }
-	    printvars(fp, t, datlist, dset, gi, label, xoff);
+	    print_gp_obs(gi, dset, datlist, i, t, nomarkers, xoff, fp);
 	}
 
-	fputs("e\n", fp);
+	gp_end_block(gi, i, fp);
     }
 }
 
+static int gp_binary_ok (gnuplot_info *gi)
+{
+    int fmt = specified_gp_output_format();
+
+    if (!libset_get_bool(PLOT_BINARY)) {
+	return 0;
+    } else if (fmt == GP_TERM_NONE || fmt == GP_TERM_PLT) {
+	/* the plot file is displayed, parsed or saved */
+	return 0;
+    } else if (gi->flags & (GPT_DUMMY | GPT_TIMEFMT)) {
+	return 0;
+    } else if ((gi->flags & GPT_Y2AXIS) && (gi->flags & GPT_IDX)) {
+	return 0;
+    } else {
+	return 1;
+    }
+}
+
+/* Write the data for the plot into a binary sidecar file, ahead
+   of the plot lines which will refer to it. If anything goes
+   wrong here we just fall back to printing text.
+*/
+
+static void write_gp_binary_data (gnuplot_info *gi, const DATASET *dset)
+{
+    int n = gi->t2 - gi->t1 + 1;
+    int nb = gi->list[0] - 1;
+    int err = 0;
+
+    *gp_binfile = '\0';
+    if (!gp_binary_ok(gi) || nb < 1) {
+	return;
+    }
+
+    /* allow for an extra record per obs in the panel case */
+    gi->binbuf = malloc(4 * (size_t) n * sizeof *gi->binbuf);
+    gi->binrec = malloc(nb * sizeof *gi->binrec);
+    if (gi->binbuf == NULL || gi->binrec == NULL) {
+	err = E_ALLOC;
+    } else {
+	sprintf(gp_binfile, "%s.bin", gretl_plotfile());
+	gi->binfp = gretl_fopen(gp_binfile, "wb");
+	if (gi->binfp == NULL) {
+	    err = E_FOPEN;
+	}
+    }
+
+    if (!err) {
+	gi->binrows = 0;
+	print_gp_data(gi, dset, NULL);
+	if (ferror(gi->binfp)) {
+	    err = E_FOPEN;
+	}
+	if (fclose(gi->binfp) != 0) {
+	    err = E_FOPEN;
+	}
+	gi->binfp = NULL;
+	if (err) {
+	    gretl_remove(gp_binfile);
+	}
+    }
+
+    free(gi->binbuf);
+    gi->binbuf = NULL;
+
+    if (err) {
+	free(gi->binrec);
+	gi->binrec = NULL;
+	*gp_binfile = '\0';
+    }
+}
+
+/* Write the data source for the i-th plotted series into @targ:
+   either a reference to a block in the binary sidecar file or
+   the standard gnuplot notation for inline data.
+*/
+
+static const char *gp_data_source (gnuplot_info *gi, int i,
+				   char *targ)
+{
+    if (gi->binrec != NULL) {
+	long skip = 0;
+	int j;
+
+	for (j=0; j<i-1; j++) {
+	    skip += gi->binrec[j] * 2 * sizeof(double);
+	}
+	sprintf(targ, "'%s' binary skip=%ld record=%d "
+		"format='%%double%%double'", gp_binfile, skip,
+		gi->binrec[i-1]);
+    } else {
+	strcpy(targ, "'-'");
+    }
+
+    return targ;
+}
+
 static int
 gpinfo_init (gnuplot_info *gi, gretlopt opt, const int *list,
 	     const char *literal, const DATASET *dset)
@@ -3246,6 +3624,10 @@ gpinfo_init (gnuplot_info *gi, gretlopt opt, const int *list,
     gi->list = NULL;
     gi->dvals = NULL;
     gi->band = 0;
+    gi->binfp = NULL;
+    gi->binbuf = NULL;
+    gi->binrows = 0;
+    gi->binrec = NULL;
 
     err = get_gp_flags(gi, opt, list, dset);
     if (err) {
@@ -3322,6 +3704,7 @@ static void clear_gpinfo (gnuplot_info *gi)
     free(gi->list);
     gretl_matrix_free(gi->dvals);
     free(gi->withlist);
+    free(gi->binrec);
 }
 
 #if GP_DEBUG
@@ -3945,6 +4328,7 @@ int gnuplot (const int *plotlist, const char *literal,
     char lwstr[8] = {0};
     char keystr[48] = {0};
     char fit_line[128] = {0};
+    char src[FILENAME_MAX + 64];
     int time_fit = 0;
     int oddman = 0;
     int many = 0;
@@ -4182,6 +4566,19 @@ int gnuplot (const int *plotlist, const char *literal,
 	print_gnuplot_literal_lines(literal, GNUPLOT, opt, fp);
     }
 
+    if ((gi.flags & GPT_FA) && gi.yformula == NULL &&
+	!(gi.flags & (GPT_Y2AXIS | GPT_DUMMY))) {
+	/* this is a fitted vs actual plot */
+	/* try reversing here: 2014-09-22 */
+	int tmp = list[1];
+
+	list[1] = list[2];
+	list[2] = tmp;
+    }
+
+    /* write the data to a sidecar file, if appropriate */
+    write_gp_binary_data(&gi, dset);
+
     /* now print the 'plot' lines */
     fputs("plot \\\n", fp);
     if (gi.flags & GPT_Y2AXIS) {
@@ -4194,7 +4591,8 @@ int gnuplot (const int *plotlist, const char *literal,
 	for (i=1; i<lmax; i++) {
 	    set_lwstr(dset, list[i], lwstr);
 	    set_withstr(&gi, i, withstr);
-	    fprintf(fp, " '-' using 1:2 axes %s title \"%s (%s)\" %s%s%s",
+	    fprintf(fp, " %s using 1:2 axes %s title \"%s (%s)\" %s%s%s",
+		    gp_data_source(&gi, i, src),
 		    (i == oddman)? "x1y2" : "x1y1",
 		    series_get_graph_name(dset, list[i]),
 		    (i == oddman)? _("right") : _("left"),
@@ -4231,18 +4629,16 @@ int gnuplot (const int *plotlist, const char *literal,
 	}
     } else if (gi.yformula != NULL) {
 	/* we have a formula to plot, not just data */
-	fprintf(fp, " '-' using 1:2 title \"%s\" w points, \\\n", _("actual"));
+	fprintf(fp, " %s using 1:2 title \"%s\" w points, \\\n",
+		gp_data_source(&gi, 1, src), _("actual"));
 	fprintf(fp, "%s title '%s' w lines\n", gi.yformula, _("fitted"));
     } else if (gi.flags & GPT_FA) {
-	/* this is a fitted vs actual plot */
-	/* try reversing here: 2014-09-22 */
-	int tmp = list[1];
-
-	list[1] = list[2];
-	list[2] = tmp;
+	/* this is a fitted vs actual plot (reversed above) */
 	set_withstr(&gi, 1, withstr);
-	fprintf(fp, " '-' using 1:2 title \"%s\" %s, \\\n", _("actual"), withstr);
-	fprintf(fp, " '-' using 1:2 title \"%s\" %s\n", _("fitted"), withstr);
+	fprintf(fp, " %s using 1:2 title \"%s\" %s, \\\n",
+		gp_data_source(&gi, 1, src), _("actual"), withstr);
+	fprintf(fp, " %s using 1:2 title \"%s\" %s\n",
+		gp_data_source(&gi, 2, src), _("fitted"), withstr);
     } else {
 	/* all other cases */
 	int lmax = list[0] - 1;
@@ -4255,7 +4651,8 @@ int gnuplot (const int *plotlist, const char *literal,
 		strcpy(s1, series_get_graph_name(dset, list[i]));
 	    }
 	    set_withstr(&gi, i, withstr);
-	    fprintf(fp, " '-' using 1:2 title \"%s\" %s%s", s1, withstr, lwstr);
+	    fprintf(fp, " %s using 1:2 title \"%s\" %s%s",
+		    gp_data_source(&gi, i, src), s1, withstr, lwstr);
 	    if (i < lmax || (gi.flags & GPT_AUTO_FIT)) {
 	        fputs(", \\\n", fp);
 	    } else {
@@ -4271,7 +4668,7 @@ int gnuplot (const int *plotlist, const char *literal,
     /* print the data to be graphed */
     if (gi.flags & GPT_DUMMY) {
 	print_gp_dummy_data(&gi, dset, fp);
-    } else {
+    } else if (gi.binrec == NULL) {
 	print_gp_data(&gi, dset, fp);
     }
 
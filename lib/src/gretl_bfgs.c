@@ -31,6 +31,10 @@
 #include <float.h>
 #include <errno.h>
 
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+
 #define BFGS_DEBUG 0
 
 #define BFGS_MAXITER_DEFAULT 600
@@ -758,6 +762,428 @@ int numeric_gradient (double *b, double *g, int n,
     return err;
 }
 
+/* Multi-threaded numerical derivatives. The serial functions above
+   perturb @b in place and call the criterion once per perturbed
+   point; here we first set out all the points that are needed,
+   evaluate them concurrently, then combine the results exactly as
+   the serial code does, so the two paths give the same answers.
+   This requires that the caller supply a means of making a private
+   copy of @data for each thread (@clone) and of disposing of it
+   (@cfree): the criterion function typically writes into its @data
+   (e.g. per-observation loglikelihood) so it cannot simply be
+   shared. If @clone is NULL, or OpenMP is not available or not
+   enabled, we fall back to the serial code.
+*/
+
+typedef struct perturb_ perturb;
+
+struct perturb_ {
+    int i, j;      /* indices of perturbed elements (j may be -1) */
+    double di, dj; /* the perturbations */
+};
+
+/* Note: each point costs a full evaluation of the criterion,
+   so we don't apply the usual flop-count threshold here.
+*/
+
+static int use_parallel_deriv (BFGS_CLONE_FUNC clone, int npts)
+{
+#if defined(_OPENMP)
+    return clone != NULL && npts > 1 &&
+	libset_get_bool(USE_OPENMP) && get_omp_n_threads() > 1;
+#else
+    return 0;
+#endif
+}
+
+/* Evaluate the criterion at the @npts points given by @P, relative
+   to @b, writing the results into @f.
+*/
+
+static int crit_eval_points (const double *b, int n,
+			     const perturb *P, int npts,
+			     double *f, BFGS_CRIT_FUNC func,
+			     void *data, BFGS_CLONE_FUNC clone,
+			     BFGS_CLONE_FREE cfree)
+{
+    int err = 0;
+
+#if defined(_OPENMP)
+    #pragma omp parallel
+    {
+	double *bk = malloc(n * sizeof *bk);
+	void *tdata = NULL;
+	int k, terr = 0;
+
+	if (bk == NULL) {
+	    terr = E_ALLOC;
+	} else {
+	    tdata = clone(data, &terr);
+	}
+
+	#pragma omp for schedule(dynamic)
+	for (k=0; k<npts; k++) {
+	    if (terr) {
+		continue;
+	    }
+	    /* start from a fresh copy of @b each time: the criterion
+	       may adjust its argument (e.g. ARMA's MA check) */
+	    memcpy(bk, b, n * sizeof *b);
+	    bk[P[k].i] += P[k].di;
+	    if (P[k].j >= 0) {
+		bk[P[k].j] += P[k].dj;
+	    }
+	    f[k] = func(bk, tdata);
+	}
+
+	if (terr) {
+	    #pragma omp critical
+	    err = terr;
+	}
+	if (tdata != NULL) {
+	    cfree(tdata);
+	}
+	free(bk);
+    }
+#else
+    err = E_DATA;
+#endif
+
+    return err;
+}
+
+static void set_perturb (perturb *p, int i, double di,
+			 int j, double dj)
+{
+    p->i = i;
+    p->di = di;
+    p->j = j;
+    p->dj = dj;
+}
+
+static int parallel_gradient (double *b, double *g, int n,
+			      BFGS_CRIT_FUNC func, void *data,
+			      BFGS_CLONE_FUNC clone,
+			      BFGS_CLONE_FREE cfree,
+			      int richardson)
+{
+    double df[RSTEPS];
+    double eps = 1.0e-4;
+    double d = 0.0001;
+    double h, p4m;
+    int r = richardson ? RSTEPS : 1;
+    int npts = 2 * n * r;
+    perturb *P;
+    double *f;
+    int i, k, m, u;
+    int err = 0;
+
+    P = malloc(npts * sizeof *P);
+    f = malloc(npts * sizeof *f);
+    if (P == NULL || f == NULL) {
+	free(P);
+	free(f);
+	return E_ALLOC;
+    }
+
+    for (i=0, u=0; i<n; i++) {
+	if (richardson) {
+	    h = fabs(d * b[i]) + eps * (floateq(b[i], 0.0));
+	} else {
+	    h = 1.0e-8;
+	}
+	for (k=0; k<r; k++) {
+	    set_perturb(&P[u++], i, -h, -1, 0);
+	    set_perturb(&P[u++], i, h, -1, 0);
+	    h /= 2.0;
+	}
+    }
+
+    err = crit_eval_points(b, n, P, npts, f, func, data, clone, cfree);
+
+    for (i=0, u=0; i<n && !err; i++) {
+	for (k=0; k<r; k++) {
+	    if (na(f[u]) || na(f[u+1])) {
+		err = 1;
+		break;
+	    }
+	    df[k] = (f[u+1] - f[u]) / (2 * P[u+1].di);
+	    u += 2;
+	}
+	if (!err) {
+	    p4m = 4.0;
+	    for (m=0; m<r-1; m++) {
+		for (k=0; k<r-m-1; k++) {
+		    df[k] = (df[k+1] * p4m - df[k]) / (p4m - 1.0);
+		}
+		p4m *= 4.0;
+	    }
+	    g[i] = df[0];
+	}
+    }
+
+    free(P);
+    free(f);
+
+    return err;
+}
+
+/**
+ * numeric_gradient_mt:
+ * @b: array of parameter values.
+ * @g: array in which to write the gradient.
+ * @n: the number of elements in @b and @g.
+ * @func: function to compute the criterion.
+ * @data: data to be passed to @func.
+ * @clone: function to make a private copy of @data for use by
+ * a given thread, or NULL.
+ * @cfree: function to free a copy of @data made by @clone.
+ *
+ * Works like the default numerical gradient used by BFGS_max(),
+ * including its "bfgs_richardson" option, except that the
+ * criterion is evaluated at the perturbed points in parallel
+ * if @clone is non-NULL and OpenMP is enabled.
+ *
+ * Returns: 0 on success, non-zero on error.
+ */
+
+int numeric_gradient_mt (double *b, double *g, int n,
+			 BFGS_CRIT_FUNC func, void *data,
+			 BFGS_CLONE_FUNC clone,
+			 BFGS_CLONE_FREE cfree)
+{
+    int rich = libset_get_bool(BFGS_RSTEP);
+    int err = 0;
+
+    if (!use_parallel_deriv(clone, 2 * n)) {
+	return numeric_gradient(b, g, n, func, data);
+    }
+
+    if (!rich) {
+	int i;
+
+	/* the serial code switches to Richardson if the
+	   simple step is swamped by the magnitude of b */
+	for (i=0; i<n && !rich; i++) {
+	    if (b[i] != 0.0 &&
+		fabs(((b[i] - 1.0e-8) - b[i]) / b[i]) < B_RELMIN) {
+		rich = 1;
+	    }
+	}
+    }
+
+    err = parallel_gradient(b, g, n, func, data, clone, cfree, rich);
+
+    return err;
+}
+
+/* Parallel counterpart to numerical_hessian(): see the comments
+   on the latter for the method. All the required evaluations,
+   for the diagonal and off-diagonal elements alike, depend only
+   on @b and the initial steps, so we can lay them all out at once.
+*/
+
+static int parallel_hessian (double *b, gretl_matrix *H,
+			     BFGS_CRIT_FUNC func, void *data,
+			     BFGS_CLONE_FUNC clone,
+			     BFGS_CLONE_FREE cfree,
+			     int neg, double d)
+{
+    double Dx[RSTEPS];
+    double Hx[RSTEPS];
+    double *h0, *h, *Hd, *D;
+    double *wspace, *f;
+    perturb *P;
+    int r = RSTEPS;
+    double dsmall = 0.0001;
+    double ztol = 0.01, eps = 1e-4;
+    double v = 2.0;
+    double f0, f1, f2;
+    double p4m, hij;
+    int n = gretl_matrix_rows(H);
+    int vn = (n * (n + 1)) / 2;
+    int dn = vn + n;
+    int npts = 2 * r * vn;
+    int i, j, k, m, u, q;
+    int err = 0;
+
+    if (d == 0.0) {
+	d = numhess_d;
+    }
+
+    wspace = malloc((3 * n + dn + npts) * sizeof *wspace);
+    P = malloc(npts * sizeof *P);
+    if (wspace == NULL || P == NULL) {
+	free(wspace);
+	free(P);
+	return E_ALLOC;
+    }
+
+    h0 = wspace;
+    h = h0 + n;
+    Hd = h + n;
+    D = Hd + n;
+    f = D + dn;
+
+ try_again:
+
+    for (i=0; i<n; i++) {
+	h0[i] = fabs(d*b[i]) + eps * (fabs(b[i]) < ztol);
+    }
+
+    f0 = func(b, data);
+
+    /* lay out the points: first the diagonal, then the
+       lower triangle, in the order used below */
+    q = 0;
+    for (i=0; i<n; i++) {
+	hess_h_init(h, h0, n);
+	for (k=0; k<r; k++) {
+	    set_perturb(&P[q++], i, h[i], -1, 0);
+	    set_perturb(&P[q++], i, -h[i], -1, 0);
+	    hess_h_reduce(h, v, n);
+	}
+    }
+    for (i=0; i<n; i++) {
+	for (j=0; j<i; j++) {
+	    hess_h_init(h, h0, n);
+	    for (k=0; k<r; k++) {
+		set_perturb(&P[q++], i, h[i], j, h[j]);
+		set_perturb(&P[q++], i, -h[i], j, -h[j]);
+		hess_h_reduce(h, v, n);
+	    }
+	}
+    }
+
+    err = crit_eval_points(b, n, P, q, f, func, data, clone, cfree);
+    if (err) {
+	goto bailout;
+    }
+
+    for (k=0; k<q; k++) {
+	if (na(f[k])) {
+	    err = E_NAN;
+	    break;
+	}
+    }
+
+    if (err == E_NAN && d > dsmall) {
+	err = 0;
+	gretl_error_clear();
+	d /= 10;
+	goto try_again;
+    } else if (err) {
+	goto bailout;
+    }
+
+    /* first derivatives and Hessian diagonal */
+    q = 0;
+    for (i=0; i<n; i++) {
+	hess_h_init(h, h0, n);
+	for (k=0; k<r; k++) {
+	    f1 = f[q++];
+	    f2 = f[q++];
+	    Dx[k] = (f1 - f2) / (2 * h[i]);
+	    Hx[k] = (f1 - 2*f0 + f2) / (h[i] * h[i]);
+	    hess_h_reduce(h, v, n);
+	}
+	p4m = 4.0;
+	for (m=0; m<r-1; m++) {
+	    for (k=0; k<r-m-1; k++) {
+		Dx[k] = (Dx[k+1] * p4m - Dx[k]) / (p4m - 1);
+		Hx[k] = (Hx[k+1] * p4m - Hx[k]) / (p4m - 1);
+	    }
+	    p4m *= 4.0;
+	}
+	D[i] = Dx[0];
+	Hd[i] = Hx[0];
+    }
+
+    /* second derivatives: lower half of Hessian only */
+    u = n;
+    for (i=0; i<n; i++) {
+	for (j=0; j<=i; j++) {
+	    if (i == j) {
+		D[u] = Hd[i];
+	    } else {
+		hess_h_init(h, h0, n);
+		for (k=0; k<r; k++) {
+		    f1 = f[q++];
+		    f2 = f[q++];
+		    Dx[k] = (f1 - 2*f0 + f2 - Hd[i]*h[i]*h[i]
+			     - Hd[j]*h[j]*h[j]) / (2*h[i]*h[j]);
+		    hess_h_reduce(h, v, n);
+		}
+		p4m = 4.0;
+		for (m=0; m<r-1; m++) {
+		    for (k=0; k<r-m-1; k++) {
+			Dx[k] = (Dx[k+1] * p4m - Dx[k]) / (p4m - 1);
+		    }
+		    p4m *= 4.0;
+		}
+		D[u] = Dx[0];
+	    }
+	    u++;
+	}
+    }
+
+    u = n;
+    for (i=0; i<n; i++) {
+	for (j=0; j<=i; j++) {
+	    hij = neg ? -D[u] : D[u];
+	    gretl_matrix_set(H, i, j, hij);
+	    gretl_matrix_set(H, j, i, hij);
+	    u++;
+	}
+    }
+
+ bailout:
+
+    if (err && err != E_ALLOC) {
+	gretl_errmsg_set(_("Failed to compute numerical Hessian"));
+    }
+
+    free(wspace);
+    free(P);
+
+    return err;
+}
+
+/**
+ * numerical_hessian_mt:
+ * @b: array of parameter values.
+ * @H: matrix to receive the Hessian, correctly sized.
+ * @func: function to compute the criterion.
+ * @data: data to be passed to @func.
+ * @clone: function to make a private copy of @data for use by
+ * a given thread, or NULL.
+ * @cfree: function to free a copy of @data made by @clone.
+ * @neg: if non-zero, write the negative of the Hessian.
+ * @d: step size (give 0.0 for automatic).
+ *
+ * Works like numerical_hessian(), except that the criterion is
+ * evaluated at the perturbed points in parallel if @clone is
+ * non-NULL and OpenMP is enabled. Note that in the parallel case
+ * @data itself is used only for evaluation at @b.
+ *
+ * Returns: 0 on success, non-zero on error.
+ */
+
+int numerical_hessian_mt (double *b, gretl_matrix *H,
+			  BFGS_CRIT_FUNC func, void *data,
+			  BFGS_CLONE_FUNC clone,
+			  BFGS_CLONE_FREE cfree,
+			  int neg, double d)
+{
+    int n = gretl_matrix_rows(H);
+
+    if (use_parallel_deriv(clone, n * (n + 1) * RSTEPS)) {
+	return parallel_hessian(b, H, func, data, clone, cfree, neg, d);
+    } else {
+	return numerical_hessian(b, H, func, data, neg, d);
+    }
+}
+
 #define STEPFRAC	0.2
 #define acctol		1.0e-7 /* alt: 0.0001 or 1.0e-7 (?) */
 #define reltest		10.0
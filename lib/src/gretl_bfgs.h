@@ -37,6 +37,8 @@ typedef double (*BFGS_COMBO_FUNC) (double *, double *, int, void *);
 typedef const double *(*BFGS_LLT_FUNC) (const double *, int, void *);
 typedef int (*HESS_FUNC) (double *, gretl_matrix *, void *);
 typedef double (*ZFUNC) (double, void *);
+typedef void *(*BFGS_CLONE_FUNC) (void *, int *);
+typedef void (*BFGS_CLONE_FREE) (void *);
 
 int BFGS_max (double *b, int n, int maxit, double reltol,
 	      int *fncount, int *grcount, BFGS_CRIT_FUNC cfunc, 
@@ -83,6 +85,17 @@ gretl_matrix *numerical_hessian_inverse (const double *b, int n,
 					 void *data, double d,
 					 int *err);
 
+int numeric_gradient_mt (double *b, double *g, int n,
+			 BFGS_CRIT_FUNC func, void *data,
+			 BFGS_CLONE_FUNC clone,
+			 BFGS_CLONE_FREE cfree);
+
+int numerical_hessian_mt (double *b, gretl_matrix *H,
+			  BFGS_CRIT_FUNC func, void *data,
+			  BFGS_CLONE_FUNC clone,
+			  BFGS_CLONE_FREE cfree,
+			  int neg, double d);
+
 double user_BFGS (gretl_matrix *b, 
 		  const char *fncall,
 		  const char *gradcall,
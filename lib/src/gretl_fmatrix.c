@@ -0,0 +1,370 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Single-precision matrices, for use in bandwidth-bound work where
+   the full precision of double is not required. Data are converted
+   to and from gretl_matrix at the boundaries; in between,
+   multiplication works on float.
+*/
+
+#include "libgretl.h"
+#include "libset.h"
+#include "gretl_f2c.h"
+#include "clapack_double.h"
+#include "gretl_fmatrix.h"
+
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+
+/* below this value of m*n*k it's not worth converting double
+   operands to float for multiplication, even via the BLAS */
+#define F32_MNK_MIN 200000
+
+/**
+ * gretl_fmatrix_new:
+ * @r: number of rows.
+ * @c: number of columns.
+ *
+ * Returns: a newly allocated single-precision matrix, with
+ * uninitialized data, or NULL on failure.
+ */
+
+gretl_fmatrix *gretl_fmatrix_new (int r, int c)
+{
+    gretl_fmatrix *F;
+    size_t n;
+
+    if (r < 0 || c < 0) {
+	return NULL;
+    }
+
+    n = (size_t) r * c;
+    if (n > G_MAXSIZE / sizeof(float)) {
+	return NULL;
+    }
+
+    F = malloc(sizeof *F);
+    if (F == NULL) {
+	return NULL;
+    }
+
+    if (n == 0) {
+	F->val = NULL;
+    } else {
+	F->val = malloc(n * sizeof *F->val);
+	if (F->val == NULL) {
+	    free(F);
+	    return NULL;
+	}
+    }
+
+    F->rows = r;
+    F->cols = c;
+
+    return F;
+}
+
+/**
+ * gretl_fmatrix_free:
+ * @F: matrix to be freed.
+ *
+ * Frees the allocated storage in @F, then @F itself.
+ */
+
+void gretl_fmatrix_free (gretl_fmatrix *F)
+{
+    if (F != NULL) {
+	free(F->val);
+	free(F);
+    }
+}
+
+static void doubles_to_floats (float *targ, const double *src,
+			       size_t n)
+{
+    size_t i;
+
+#if defined(_OPENMP)
+    if (libset_use_openmp(n)) {
+#pragma omp parallel for private(i)
+	for (i=0; i<n; i++) {
+	    targ[i] = (float) src[i];
+	}
+	return;
+    }
+#endif
+
+    for (i=0; i<n; i++) {
+	targ[i] = (float) src[i];
+    }
+}
+
+static void floats_to_doubles (double *targ, const float *src,
+			       size_t n)
+{
+    size_t i;
+
+#if defined(_OPENMP)
+    if (libset_use_openmp(n)) {
+#pragma omp parallel for private(i)
+	for (i=0; i<n; i++) {
+	    targ[i] = src[i];
+	}
+	return;
+    }
+#endif
+
+    for (i=0; i<n; i++) {
+	targ[i] = src[i];
+    }
+}
+
+/**
+ * gretl_fmatrix_from_matrix:
+ * @m: source matrix.
+ * @err: location to receive error code.
+ *
+ * Returns: a single-precision copy of @m, or NULL on failure.
+ * Complex matrices are not supported.
+ */
+
+gretl_fmatrix *gretl_fmatrix_from_matrix (const gretl_matrix *m,
+					  int *err)
+{
+    gretl_fmatrix *F;
+
+    if (m == NULL) {
+	*err = E_DATA;
+	return NULL;
+    } else if (m->is_complex) {
+	*err = E_CMPLX;
+	return NULL;
+    }
+
+    F = gretl_fmatrix_new(m->rows, m->cols);
+
+    if (F == NULL) {
+	*err = E_ALLOC;
+    } else {
+	doubles_to_floats(F->val, m->val, (size_t) m->rows * m->cols);
+    }
+
+    return F;
+}
+
+/**
+ * gretl_fmatrix_copy_to_matrix:
+ * @F: source matrix.
+ * @m: target matrix.
+ *
+ * Copies the values in @F into @m, which must be a real
+ * matrix of the same dimensions.
+ *
+ * Returns: 0 on success, non-zero code on error.
+ */
+
+int gretl_fmatrix_copy_to_matrix (const gretl_fmatrix *F,
+				  gretl_matrix *m)
+{
+    if (m->is_complex) {
+	return E_CMPLX;
+    } else if (m->rows != F->rows || m->cols != F->cols) {
+	return E_NONCONF;
+    }
+
+    floats_to_doubles(m->val, F->val, (size_t) F->rows * F->cols);
+
+    return 0;
+}
+
+/**
+ * gretl_fmatrix_multiply_mod:
+ * @a: left-hand matrix.
+ * @amod: modifier: %GRETL_MOD_NONE or %GRETL_MOD_TRANSPOSE.
+ * @b: right-hand matrix.
+ * @bmod: modifier: %GRETL_MOD_NONE or %GRETL_MOD_TRANSPOSE.
+ * @c: matrix to hold the product.
+ * @cmod: modifier: %GRETL_MOD_NONE, or %GRETL_MOD_CUMULATE to
+ * add the result to the existing value of @c, or
+ * %GRETL_MOD_DECREMENT to subtract from the existing value of @c.
+ *
+ * Single-precision counterpart to gretl_matrix_multiply_mod(),
+ * using the BLAS function sgemm.
+ *
+ * Returns: 0 on success, or %E_NONCONF if the matrices are
+ * not conformable for the operation.
+ */
+
+int gretl_fmatrix_multiply_mod (const gretl_fmatrix *a,
+				GretlMatrixMod amod,
+				const gretl_fmatrix *b,
+				GretlMatrixMod bmod,
+				gretl_fmatrix *c,
+				GretlMatrixMod cmod)
+{
+    int atr = (amod == GRETL_MOD_TRANSPOSE);
+    int btr = (bmod == GRETL_MOD_TRANSPOSE);
+    int lrows, lcols;
+    int rrows, rcols;
+    char TransA = atr ? 'T' : 'N';
+    char TransB = btr ? 'T' : 'N';
+    float alpha = 1.0f;
+    float beta = 0.0f;
+
+    lrows = atr ? a->cols : a->rows;
+    lcols = atr ? a->rows : a->cols;
+    rrows = btr ? b->cols : b->rows;
+    rcols = btr ? b->rows : b->cols;
+
+    if (lcols != rrows || c->rows != lrows || c->cols != rcols) {
+	return E_NONCONF;
+    }
+
+    if (lrows == 0 || rcols == 0) {
+	return 0;
+    }
+
+    if (cmod == GRETL_MOD_CUMULATE) {
+	beta = 1.0f;
+    } else if (cmod == GRETL_MOD_DECREMENT) {
+	alpha = -1.0f;
+	beta = 1.0f;
+    }
+
+    sgemm_(&TransA, &TransB, &lrows, &rcols, &lcols,
+	   &alpha, a->val, &a->rows, b->val, &b->rows, &beta,
+	   c->val, &c->rows);
+
+    return 0;
+}
+
+/**
+ * gretl_matrix_multiply_mod_f32:
+ * @a: left-hand matrix.
+ * @amod: modifier: %GRETL_MOD_NONE or %GRETL_MOD_TRANSPOSE.
+ * @b: right-hand matrix.
+ * @bmod: modifier: %GRETL_MOD_NONE or %GRETL_MOD_TRANSPOSE.
+ * @c: matrix to hold the product.
+ * @cmod: modifier: %GRETL_MOD_NONE, %GRETL_MOD_CUMULATE or
+ * %GRETL_MOD_DECREMENT.
+ *
+ * Has the same effect as gretl_matrix_multiply_mod(), except
+ * that when the product is large enough to repay the cost of
+ * conversion, and large enough to go to the BLAS, the operands
+ * are narrowed to single precision and the product is computed
+ * by sgemm. The result is then accurate to about 7 significant
+ * digits only. Smaller products are computed in double precision
+ * as usual.
+ *
+ * Returns: 0 on success, non-zero code on error.
+ */
+
+int gretl_matrix_multiply_mod_f32 (const gretl_matrix *a,
+				   GretlMatrixMod amod,
+				   const gretl_matrix *b,
+				   GretlMatrixMod bmod,
+				   gretl_matrix *c,
+				   GretlMatrixMod cmod)
+{
+    gretl_fmatrix *fa = NULL;
+    gretl_fmatrix *fb = NULL;
+    gretl_fmatrix *fc = NULL;
+    guint64 mnk_min;
+    int m, n, k;
+    int err = 0;
+
+    if (get_blas_mnk_min() < 0 ||
+	gretl_is_null_matrix(a) || gretl_is_null_matrix(b) ||
+	a->is_complex || b->is_complex ||
+	gretl_matrix_is_scalar(a) || gretl_matrix_is_scalar(b)) {
+	return gretl_matrix_multiply_mod(a, amod, b, bmod, c, cmod);
+    }
+
+    m = (amod == GRETL_MOD_TRANSPOSE)? a->cols : a->rows;
+    k = (amod == GRETL_MOD_TRANSPOSE)? a->rows : a->cols;
+    n = (bmod == GRETL_MOD_TRANSPOSE)? b->rows : b->cols;
+
+    mnk_min = MAX(F32_MNK_MIN, get_blas_mnk_min());
+
+    if ((guint64) m * n * k < mnk_min) {
+	return gretl_matrix_multiply_mod(a, amod, b, bmod, c, cmod);
+    }
+
+    fa = gretl_fmatrix_from_matrix(a, &err);
+    if (!err) {
+	fb = (b == a)? fa : gretl_fmatrix_from_matrix(b, &err);
+    }
+    if (!err) {
+	if (cmod == GRETL_MOD_NONE) {
+	    fc = gretl_fmatrix_new(c->rows, c->cols);
+	    if (fc == NULL) {
+		err = E_ALLOC;
+	    }
+	} else {
+	    fc = gretl_fmatrix_from_matrix(c, &err);
+	}
+    }
+
+    if (!err) {
+	err = gretl_fmatrix_multiply_mod(fa, amod, fb, bmod, fc, cmod);
+    }
+    if (!err) {
+	err = gretl_fmatrix_copy_to_matrix(fc, c);
+    }
+
+    if (fb != fa) {
+	gretl_fmatrix_free(fb);
+    }
+    gretl_fmatrix_free(fa);
+    gretl_fmatrix_free(fc);
+
+    return err;
+}
+
+/**
+ * gretl_matrix_round_to_float:
+ * @m: source matrix.
+ * @err: location to receive error code.
+ *
+ * Returns: a copy of @m in which each element is rounded to
+ * the nearest value representable in single precision, or
+ * NULL on failure.
+ */
+
+gretl_matrix *gretl_matrix_round_to_float (const gretl_matrix *m,
+					   int *err)
+{
+    gretl_matrix *ret = gretl_matrix_copy(m);
+
+    if (ret == NULL) {
+	*err = E_ALLOC;
+    } else {
+	size_t i, n = (size_t) m->rows * m->cols;
+
+	if (m->is_complex) {
+	    n *= 2;
+	}
+	for (i=0; i<n; i++) {
+	    ret->val[i] = (float) ret->val[i];
+	}
+    }
+
+    return ret;
+}
@@ -0,0 +1,63 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GRETL_FMATRIX_H
+#define GRETL_FMATRIX_H
+
+/* single-precision matrix: storage is column-major, as with
+   gretl_matrix, but there's no complex or metadata support
+*/
+
+typedef struct gretl_fmatrix_ {
+    int rows;
+    int cols;
+    float *val;
+} gretl_fmatrix;
+
+#define gretl_fmatrix_get(m,i,j) (m->val[(size_t)(j)*m->rows+(i)])
+#define gretl_fmatrix_set(m,i,j,x) ((m)->val[(size_t)(j)*(m)->rows+(i)]=x)
+
+gretl_fmatrix *gretl_fmatrix_new (int r, int c);
+
+void gretl_fmatrix_free (gretl_fmatrix *F);
+
+gretl_fmatrix *gretl_fmatrix_from_matrix (const gretl_matrix *m,
+					  int *err);
+
+int gretl_fmatrix_copy_to_matrix (const gretl_fmatrix *F,
+				  gretl_matrix *m);
+
+int gretl_fmatrix_multiply_mod (const gretl_fmatrix *a,
+				GretlMatrixMod amod,
+				const gretl_fmatrix *b,
+				GretlMatrixMod bmod,
+				gretl_fmatrix *c,
+				GretlMatrixMod cmod);
+
+int gretl_matrix_multiply_mod_f32 (const gretl_matrix *a,
+				   GretlMatrixMod amod,
+				   const gretl_matrix *b,
+				   GretlMatrixMod bmod,
+				   gretl_matrix *c,
+				   GretlMatrixMod cmod);
+
+gretl_matrix *gretl_matrix_round_to_float (const gretl_matrix *m,
+					   int *err);
+
+#endif /* GRETL_FMATRIX_H */
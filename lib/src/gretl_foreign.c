@@ -23,6 +23,7 @@
 #include "gretl_foreign.h"
 #include "matrix_extra.h"
 #include "gretl_typemap.h"
+#include "swap_bytes.h"
 #include <unistd.h>
 
 #ifdef HAVE_MPI
@@ -72,25 +73,26 @@ struct fmap {
     const char *scriptname;
     const char *iofile;
     gchar *scriptpath;
+    int io_written;
 };
 
 static void write_R_io_file (FILE *fp, const char *ddir);
 
 static struct fmap foreign_map[] = {
-     { LANG_OX,     "gretltmp.ox", "gretl_io.ox", NULL },
-     { LANG_OCTAVE, "gretltmp.m",  "gretl_io.m", NULL },
-     { LANG_STATA,  "gretltmp.do", "gretl_export.ado", NULL },
-     { LANG_PYTHON, "gretltmp.py", "gretl_io.py", NULL },
-     { LANG_JULIA,  "gretltmp.jl", "gretl_io.jl", NULL }
+     { LANG_OX,     "gretltmp.ox", "gretl_io.ox", NULL, 0 },
+     { LANG_OCTAVE, "gretltmp.m",  "gretl_io.m", NULL, 0 },
+     { LANG_STATA,  "gretltmp.do", "gretl_export.ado", NULL, 0 },
+     { LANG_PYTHON, "gretltmp.py", "gretl_io.py", NULL, 0 },
+     { LANG_JULIA,  "gretltmp.jl", "gretl_io.jl", NULL, 0 }
 };
 
-static const char *get_io_filename (int lang)
+static struct fmap *get_foreign_map (int lang)
 {
     int i, n = G_N_ELEMENTS(foreign_map);
 
     for (i=0; i<n; i++) {
 	if (foreign_map[i].lang == lang) {
-	    return foreign_map[i].iofile;
+	    return &foreign_map[i];
 	}
     }
 
@@ -1042,13 +1044,8 @@ static void write_octave_io_file (FILE *fp, const char *ddir)
     fputs("      fwrite(fd, 'gretl_binar_cmatrix', \"uchar\");\n", fp);
     fputs("      fwrite(fd, 2*rows(X), \"int32\", 0, \"l\");\n", fp);
     fputs("      fwrite(fd, columns(X), \"int32\", 0, \"l\");\n", fp);
-    fputs("      A = real(X);\n", fp);
-    fputs("      B = imag(X);\n", fp);
-    fputs("      N = rows(X) * columns(X);\n", fp);
-    fputs("      for i = 1:N\n", fp);
-    fputs("        fwrite(fd, A(i), \"double\", 0, \"l\");\n", fp);
-    fputs("        fwrite(fd, B(i), \"double\", 0, \"l\");\n", fp);
-    fputs("      endfor\n", fp);
+    fputs("      A = [real(X(:))'; imag(X(:))'];\n", fp);
+    fputs("      fwrite(fd, A, \"double\", 0, \"l\");\n", fp);
     fputs("    else\n", fp);
     fputs("      fwrite(fd, 'gretl_binary_matrix', \"uchar\");\n", fp);
     fputs("      fwrite(fd, rows(X), \"int32\", 0, \"l\");\n", fp);
@@ -1149,7 +1146,7 @@ static void write_python_io_file (FILE *fp, const char *ddir)
     fputs("  if autodot and not os.path.isabs(fname):\n", fp);
     fputs("    fname = gretl_dotdir + fname\n", fp);
     fputs("  if fname[-4:] == '.bin':\n", fp);
-    fputs("    from numpy import ndarray, asmatrix\n", fp);
+    fputs("    from numpy import fromfile, dtype, asmatrix\n", fp);
     fputs("    from struct import unpack\n", fp);
     fputs("    f = open(fname, 'rb')\n", fp);
     fputs("    buf = f.read(19)\n", fp);
@@ -1161,10 +1158,8 @@ static void write_python_io_file (FILE *fp, const char *ddir)
     fputs("      raise ValueError('Not a gretl binary matrix')\n", fp);
     fputs("    r = unpack('<i', f.read(4))[0]\n", fp);
     fputs("    c = unpack('<i', f.read(4))[0]\n", fp);
-    fputs("    M = ndarray(shape=(r,c), dtype=float, order='F')\n", fp);
-    fputs("    for j in range(0, c):\n", fp);
-    fputs("      for i in range(0, r):\n", fp);
-    fputs("        M[i,j] = unpack('<d', f.read(8))[0]\n", fp);
+    fputs("    M = fromfile(f, dtype=dtype('<f8'), count=r*c)\n", fp);
+    fputs("    M = M.astype(float).reshape((r,c), order='F')\n", fp);
     fputs("    f.close()\n", fp);
     fputs("    if cmplx == 1:\n", fp);
     fputs("      M.dtype = complex\n", fp);
@@ -1204,15 +1199,13 @@ static void write_julia_io_file (FILE *fp, const char *ddir)
     fputs("    end\n", fp);
     fputs("    write(f, htol(Int32(rr)))\n", fp);
     fputs("    write(f, htol(Int32(c)))\n", fp);
-    fputs("    for j=1:c\n", fp);
-    fputs("      for i=1:r\n", fp);
-    fputs("        if cmplx\n", fp);
-    fputs("          write(f, htol(Float64(real(M[i,j]))))\n", fp);
-    fputs("          write(f, htol(Float64(imag(M[i,j]))))\n", fp);
-    fputs("        else\n", fp);
-    fputs("          write(f, htol(Float64(M[i,j])))\n", fp);
-    fputs("        end\n", fp);
-    fputs("      end\n", fp);
+    fputs("    if cmplx\n", fp);
+    fputs("      A = Array{Float64, 2}(undef, rr, c)\n", fp);
+    fputs("      A[1:2:end,:] = real(M)\n", fp);
+    fputs("      A[2:2:end,:] = imag(M)\n", fp);
+    fputs("      write(f, htol.(A))\n", fp);
+    fputs("    else\n", fp);
+    fputs("      write(f, htol.(Array{Float64, 2}(M)))\n", fp);
     fputs("    end\n", fp);
     fputs("  else\n", fp);
     fputs("    # text mode\n", fp);
@@ -1249,23 +1242,13 @@ static void write_julia_io_file (FILE *fp, const char *ddir)
     fputs("    end\n", fp);
     fputs("    r = ltoh(read(f, Int32))\n", fp);
     fputs("    c = ltoh(read(f, Int32))\n", fp);
+    fputs("    A = Array{Float64, 2}(undef, r, c)\n", fp);
+    fputs("    read!(f, A)\n", fp);
+    fputs("    A .= ltoh.(A)\n", fp);
     fputs("    if cmplx\n", fp);
-    fputs("      r::Int64 = floor(r/2)\n", fp);
-    fputs("      M = Array{Complex{Float64}, 2}(undef, r, c)\n", fp);
-    fputs("      for j=1:c\n", fp);
-    fputs("        for i=1:r\n", fp);
-    fputs("          x = ltoh(read(f, Float64))\n", fp);
-    fputs("          y = ltoh(read(f, Float64))\n", fp);
-    fputs("          M[i,j] = x + y*im\n", fp);
-    fputs("        end\n", fp);
-    fputs("      end\n", fp);
+    fputs("      M = complex.(A[1:2:end,:], A[2:2:end,:])\n", fp);
     fputs("    else\n", fp);
-    fputs("      M = Array{Float64, 2}(undef, r, c)\n", fp);
-    fputs("      for j=1:c\n", fp);
-    fputs("        for i=1:r\n", fp);
-    fputs("          M[i,j] = ltoh(read(f, Float64))\n", fp);
-    fputs("        end\n", fp);
-    fputs("      end\n", fp);
+    fputs("      M = A\n", fp);
     fputs("    end\n", fp);
     fputs("    close(f)\n", fp);
     fputs("  else\n", fp);
@@ -1306,16 +1289,19 @@ static int ensure_foreign_io_file (int lang, const char *fname)
     if (fname != NULL) {
 	fp = gretl_fopen(fname, "wb");
     } else {
-	const char *iofile = get_io_filename(lang);
+	struct fmap *fm = get_foreign_map(lang);
 
-	if (iofile == NULL) {
+	if (fm == NULL) {
 	    return E_DATA;
 	}
-	if (dotfile_exists(iofile)) {
-	    /* already present */
+	if (fm->io_written && dotfile_exists(fm->iofile)) {
+	    /* already present and up to date */
 	    return 0;
 	} else {
-	    fp = write_open_dotfile(iofile);
+	    /* don't rely on a copy left by another gretl version,
+	       which may lack the current binary I/O functions */
+	    fp = write_open_dotfile(fm->iofile);
+	    fm->io_written = (fp != NULL);
 	}
     }
 
@@ -1485,6 +1471,107 @@ static int *get_send_data_list (int ci, const DATASET *dset,
     return list;
 }
 
+/* Datasets bigger than this (in terms of the number of values
+   to be sent) are passed to R and Octave in binary form rather
+   than as text.
+*/
+
+#define FOREIGN_BIN_MIN 10000
+
+static int use_binary_send (const int *list, const DATASET *dset)
+{
+    int i;
+
+    if (list == NULL ||
+	(double) sample_size(dset) * list[0] <= FOREIGN_BIN_MIN) {
+	return 0;
+    }
+
+    /* the binary format carries only numeric values, so the
+       text route must be used for markers and string values */
+    if (dset->S != NULL) {
+	return 0;
+    }
+    for (i=1; i<=list[0]; i++) {
+	if (is_string_valued(dset, list[i])) {
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+/* Write the series in @list over the current sample range as a
+   "gretl_binary_matrix" file, as used by mwrite() and friends: a
+   19-byte header, the dimensions as two little-endian 32-bit
+   integers, then the data as little-endian doubles in column-major
+   order. Since that is the layout of the dataset itself, each
+   series can be written directly from dset->Z with a single call
+   to fwrite() (on little-endian hosts). The names of the series
+   are written, one per line, to the plain-text file @namefile.
+*/
+
+static int write_data_binary (const char *datafile,
+			      const char *namefile,
+			      const int *list,
+			      const DATASET *dset)
+{
+    const char *header = "gretl_binary_matrix";
+    size_t n = sample_size(dset);
+    gint32 dim[2];
+    FILE *fp, *fn;
+    int i, v, nvars = list[0];
+    int err = 0;
+
+    fp = gretl_fopen(datafile, "wb");
+    if (fp == NULL) {
+	return E_FOPEN;
+    }
+
+    fn = gretl_fopen(namefile, "w");
+    if (fn == NULL) {
+	fclose(fp);
+	return E_FOPEN;
+    }
+
+    dim[0] = n;
+    dim[1] = nvars;
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+    reverse_int(dim[0]);
+    reverse_int(dim[1]);
+#endif
+    fwrite(header, 1, strlen(header), fp);
+    fwrite(dim, sizeof *dim, 2, fp);
+
+    for (i=0; i<nvars && !err; i++) {
+	v = list[i+1];
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	{
+	    double x;
+	    int t;
+
+	    for (t=dset->t1; t<=dset->t2 && !err; t++) {
+		x = dset->Z[v][t];
+		reverse_double(x);
+		if (fwrite(&x, sizeof x, 1, fp) < 1) {
+		    err = E_FOPEN;
+		}
+	    }
+	}
+#else
+	if (fwrite(dset->Z[v] + dset->t1, sizeof(double), n, fp) < n) {
+	    err = E_FOPEN;
+	}
+#endif
+	fprintf(fn, "%s\n", dset->varname[v]);
+    }
+
+    fclose(fp);
+    fclose(fn);
+
+    return err;
+}
+
 #ifdef HAVE_MPI
 
 static int mpi_send_data_setup (const DATASET *dset, FILE *fp)
@@ -1659,6 +1746,9 @@ static int write_data_for_octave (const DATASET *dset,
 				  FILE *fp)
 {
     int *list = NULL;
+    int *blist = NULL;
+    int *flist = NULL;
+    int binary = 0;
     int err;
 
     err = no_data_check(dset);
@@ -1669,19 +1759,47 @@ static int write_data_for_octave (const DATASET *dset,
     list = get_send_data_list(FOREIGN, dset, &err);
 
     if (!err) {
-	gchar *mdata = gretl_make_dotpath("mdata.tmp");
+	/* the binary route needs an explicit list of series,
+	   matching the one used by the text route */
+	if (list == NULL) {
+	    blist = flist = full_var_list(dset, NULL);
+	} else {
+	    blist = list;
+	}
+	binary = use_binary_send(blist, dset);
+	if (binary) {
+	    gchar *mdata = gretl_make_dotpath("mdata.bin");
+	    gchar *mnames = gretl_make_dotpath("mdata.names");
+
+	    err = write_data_binary(mdata, mnames, blist, dset);
+	    g_free(mdata);
+	    g_free(mnames);
+	} else {
+	    gchar *mdata = gretl_make_dotpath("mdata.tmp");
 
-	err = write_data(mdata, list, dset, OPT_M, NULL);
-	g_free(mdata);
+	    err = write_data(mdata, list, dset, OPT_M, NULL);
+	    g_free(mdata);
+	}
     }
 
     if (err) {
 	gretl_errmsg_sprintf("write_data_for_octave: failed with err = %d\n", err);
+    } else if (binary) {
+	int i;
+
+	fputs("% load data from gretl\n", fp);
+	fputs("gretl_data__ = gretl_loadmat(\"mdata.bin\");\n", fp);
+	for (i=1; i<=blist[0]; i++) {
+	    fprintf(fp, "%s = gretl_data__(:,%d);\n", dset->varname[blist[i]], i);
+	}
+	fputs("clear gretl_data__\n", fp);
     } else {
 	fputs("% load data from gretl\n", fp);
 	fprintf(fp, "load '%smdata.tmp'\n", get_export_dotdir());
     }
 
+    free(flist);
+
     return err;
 }
 
@@ -1822,6 +1940,9 @@ static int write_data_for_R (const DATASET *dset,
 {
     gretl_matrix *coded = NULL;
     int *list = NULL;
+    int *blist = NULL;
+    int *flist = NULL;
+    int binary = 0;
     int ts, err;
 
     err = no_data_check(dset);
@@ -1835,11 +1956,29 @@ static int write_data_for_R (const DATASET *dset,
     list = get_send_data_list(FOREIGN, dset, &err);
 
     if (!err) {
-	gchar *Rdata = gretl_make_dotpath("Rdata.tmp");
-
 	coded = make_coded_vec(list, dset);
-	err = write_data(Rdata, list, dset, OPT_R, NULL);
-	g_free(Rdata);
+	/* the binary route needs an explicit list of series,
+	   matching the one used by the text route */
+	if (list == NULL) {
+	    blist = flist = full_var_list(dset, NULL);
+	} else {
+	    blist = list;
+	}
+	binary = use_binary_send(blist, dset);
+	if (binary) {
+	    gchar *Rdata = gretl_make_dotpath("Rdata.bin");
+	    gchar *Rnames = gretl_make_dotpath("Rdata.names");
+
+	    err = write_data_binary(Rdata, Rnames, blist, dset);
+	    g_free(Rdata);
+	    g_free(Rnames);
+	} else {
+	    gchar *Rdata = gretl_make_dotpath("Rdata.tmp");
+
+	    err = write_data(Rdata, list, dset, OPT_R, NULL);
+	    g_free(Rdata);
+	}
+	free(flist);
     }
 
     if (err) {
@@ -1863,8 +2002,14 @@ static int write_data_for_R (const DATASET *dset,
     }
 
     fputs("# load data from gretl\n", fp);
-    fprintf(fp, "gretldata <- read.table(\"%sRdata.tmp\", header=TRUE)\n",
-	    get_export_dotdir());
+    if (binary) {
+	fputs("gretldata <- as.data.frame(gretl.loadmat(\"Rdata.bin\"))\n", fp);
+	fprintf(fp, "names(gretldata) <- scan(\"%sRdata.names\", what=\"character\", "
+		"quiet=TRUE)\n", get_export_dotdir());
+    } else {
+	fprintf(fp, "gretldata <- read.table(\"%sRdata.tmp\", header=TRUE)\n",
+		get_export_dotdir());
+    }
 
     if (ts) {
 	char *p, datestr[OBSLEN];
@@ -1934,6 +2079,14 @@ static void write_R_io_file (FILE *fp, const char *ddir)
 	"    fname <- paste(prefix, sx, \".csv\", sep=\"\")\n"
 	"    write.csv(x, file=fname, row.names=F)\n"
 	"    gretlmsg <- paste(\"wrote CSV data\", fname, \"\\n\")\n"
+	"  } else if (is.matrix(x) && binary) {\n"
+	"    fname <- paste(prefix, sx, \".bin\", sep=\"\")\n"
+	"    con <- file(fname, \"wb\")\n"
+	"    writeChar(\"gretl_binary_matrix\", con, eos=NULL)\n"
+	"    writeBin(as.integer(dim(x)), con, size=4, endian=\"little\")\n"
+	"    writeBin(as.double(x), con, size=8, endian=\"little\")\n"
+	"    close(con)\n"
+	"    gretlmsg <- paste(\"wrote matrix\", fname, \"\\n\")\n"
 	"  } else if (is.matrix(x)) {\n"
 	"    fname <- paste(prefix, sx, \".mat\", sep=\"\")\n"
 	"    write(dim(x), fname)\n"
@@ -1956,14 +2109,27 @@ static void write_R_io_file (FILE *fp, const char *ddir)
     fputs("}\n", fp);
 #endif
 
-    fputs("gretl.export <- function(x, sx, quiet=0) {\n", fp);
+    fputs("gretl.export <- function(x, sx, quiet=0, binary=0) {\n", fp);
     fprintf(fp, "  prefix <- \"%s\"\n", ddir);
     fputs(export_body, fp);
 
     fputs("gretl.loadmat <- function(mname) {\n", fp);
     fprintf(fp, "  prefix <- \"%s\"\n", ddir);
     fputs("  fname <- paste(prefix, mname, sep=\"\")\n", fp);
-    fputs("  m <- as.matrix(read.table(fname, skip=1))\n", fp);
+    fputs("  if (grepl(\"\\\\.bin$\", fname)) {\n", fp);
+    fputs("    con <- file(fname, \"rb\")\n", fp);
+    fputs("    hdr <- readChar(con, 19, useBytes=TRUE)\n", fp);
+    fputs("    if (hdr != \"gretl_binary_matrix\") {\n", fp);
+    fputs("      close(con)\n", fp);
+    fputs("      stop(\"not a real gretl binary matrix\")\n", fp);
+    fputs("    }\n", fp);
+    fputs("    d <- readBin(con, \"integer\", n=2, size=4, endian=\"little\")\n", fp);
+    fputs("    m <- matrix(readBin(con, \"double\", n=d[1]*d[2], size=8, "
+	  "endian=\"little\"), nrow=d[1], ncol=d[2])\n", fp);
+    fputs("    close(con)\n", fp);
+    fputs("  } else {\n", fp);
+    fputs("    m <- as.matrix(read.table(fname, skip=1))\n", fp);
+    fputs("  }\n", fp);
     fputs("  return(m)\n", fp);
     fputs("}\n", fp);
 }
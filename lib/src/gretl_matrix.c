@@ -75,13 +75,13 @@ struct gretl_matrix_block_ {
 #define gretl_is_vector(v) (v->rows == 1 || v->cols == 1)
 #define matrix_is_scalar(m) (m->rows == 1 && m->cols == 1)
 
-#define mdx(a,i,j) ((j)*a->rows+(i))
+#define mdx(a,i,j) ((size_t)(j)*a->rows+(i))
 
-#define matrix_transp_get(m,i,j) (m->val[(i)*m->rows+(j)])
-#define matrix_transp_set(m,i,j,x) (m->val[(i)*m->rows+(j)]=x)
+#define matrix_transp_get(m,i,j) (m->val[(size_t)(i)*m->rows+(j)])
+#define matrix_transp_set(m,i,j,x) (m->val[(size_t)(i)*m->rows+(j)]=x)
 
-#define cmatrix_transp_get(m,i,j) (m->z[(i)*m->rows+(j)])
-#define cmatrix_transp_set(m,i,j,x) (m->z[(i)*m->rows+(j)]=x)
+#define cmatrix_transp_get(m,i,j) (m->z[(size_t)(i)*m->rows+(j)])
+#define cmatrix_transp_set(m,i,j,x) (m->z[(size_t)(i)*m->rows+(j)]=x)
 
 #define INFO_INVALID 0xdeadbeef
 #define is_block_matrix(m) (m->info == (matrix_info *) INFO_INVALID)
@@ -90,30 +90,230 @@ struct gretl_matrix_block_ {
 
 #define no_metadata(m) (m->info == NULL || is_block_matrix(m))
 
-static inline void *mval_malloc (size_t sz)
+/* Storage for matrix data comes from a pool allocator. Requests
+   of up to MPOOL_MAXSZ bytes are rounded up to a power of two, and
+   when such blocks are freed they are kept on a per-thread free
+   list for reuse (up to a limit), which saves a great deal of
+   malloc/free traffic when genr evaluates matrix expressions
+   within loops. All blocks are aligned on MPOOL_ALIGN bytes for
+   the benefit of the SIMD code. Each block is preceded by a small
+   header recording its capacity and the address obtained from
+   malloc, so storage of this sort must be released via
+   mval_free(), never free().
+*/
+
+#define MPOOL_ALIGN 32
+#define MPOOL_MINSHIFT 6     /* smallest class, 64 bytes */
+#define MPOOL_NCLASS 16      /* largest class, 2 MB */
+#define MPOOL_MAXSZ ((size_t) 1 << (MPOOL_MINSHIFT + MPOOL_NCLASS - 1))
+#define MPOOL_KEEP 16        /* max. cached blocks per class */
+#define MPOOL_MAXCACHE (16 << 20) /* max. cached bytes per thread */
+
+#if defined(_OPENMP) && defined(OS_OSX)
+/* no TLS: see the note on lapack_malloc() below */
+# define MPOOL_CACHE 0
+#else
+# define MPOOL_CACHE 1
+#endif
+
+typedef struct mblock_ mblock;
+typedef struct mpool_ mpool;
+
+struct mblock_ {
+    void *raw;   /* address from malloc() */
+    size_t cap;  /* capacity in bytes */
+    int cls;     /* size class, or -1 if not pooled */
+};
+
+struct mpool_ {
+    void *head[MPOOL_NCLASS]; /* free lists, per class */
+    int n[MPOOL_NCLASS];      /* lengths of free lists */
+    size_t bytes;             /* total bytes cached */
+};
+
+#if MPOOL_CACHE
+static mpool mpool_cache;
+# if defined(_OPENMP)
+#  pragma omp threadprivate(mpool_cache)
+# endif
+#endif
+
+/* For tuning only: define MPOOL_STATS as 1 to count pool traffic.
+   The counters are shared across threads, so this is too costly
+   to leave on in production builds.
+*/
+#define MPOOL_STATS 0
+
+#if MPOOL_STATS
+
+static struct {
+    guint64 alloc;   /* requests for storage */
+    guint64 hit;     /* requests met from the cache */
+    guint64 big;     /* requests too big to pool */
+    guint64 free;    /* blocks released */
+    guint64 kept;    /* released blocks kept for reuse */
+} mpool_stats;
+
+static inline void mpool_count (guint64 *c)
 {
-#if 0 /* ifdef USE_SIMD */
-    void *mem = NULL;
-    int err;
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+    *c += 1;
+}
 
-    err = posix_memalign(&mem, 32, sz);
-    if (err) {
-	fprintf(stderr, "posix_memalign: failed\n");
-    }
-    return mem;
 #else
-    /* forestall "invalid reads" by OpenBLAS */
-    return malloc(sz % 16 ? sz + 8 : sz);
+# define mpool_count(c)
+#endif
+
+static inline mblock *mval_header (void *p)
+{
+    return (mblock *) p - 1;
+}
+
+static void *mval_malloc (size_t sz)
+{
+    char *raw, *p;
+    size_t cap;
+    int c = -1;
+
+    mpool_count(&mpool_stats.alloc);
+
+    if (sz <= MPOOL_MAXSZ) {
+	for (c=0, cap=(1 << MPOOL_MINSHIFT); cap < sz; c++) {
+	    cap <<= 1;
+	}
+#if MPOOL_CACHE
+	if (mpool_cache.head[c] != NULL) {
+	    p = mpool_cache.head[c];
+	    mpool_cache.head[c] = *(void **) p;
+	    mpool_cache.n[c] -= 1;
+	    mpool_cache.bytes -= cap;
+	    mpool_count(&mpool_stats.hit);
+	    return p;
+	}
 #endif
+    } else {
+	/* forestall "invalid reads" by OpenBLAS */
+	cap = sz % 16 ? sz + 8 : sz;
+	mpool_count(&mpool_stats.big);
+    }
+
+    raw = malloc(cap + sizeof(mblock) + MPOOL_ALIGN - 1);
+    if (raw == NULL) {
+	return NULL;
+    }
+
+    p = (char *) (((guintptr) raw + sizeof(mblock) + MPOOL_ALIGN - 1) &
+		  ~((guintptr) MPOOL_ALIGN - 1));
+    mval_header(p)->raw = raw;
+    mval_header(p)->cap = cap;
+    mval_header(p)->cls = c;
+
+    return p;
 }
 
-static inline void *mval_realloc (void *ptr, size_t sz)
+static void mval_free (void *p)
 {
-    /* comment as for mval_malloc() */
-    return realloc(ptr, sz % 16 ? sz + 8 : sz);
+    mblock *h;
+
+    if (p == NULL) {
+	return;
+    }
+
+    h = mval_header(p);
+    mpool_count(&mpool_stats.free);
+
+#if MPOOL_CACHE
+    if (h->cls >= 0 && mpool_cache.n[h->cls] < MPOOL_KEEP &&
+	mpool_cache.bytes + h->cap <= MPOOL_MAXCACHE) {
+	*(void **) p = mpool_cache.head[h->cls];
+	mpool_cache.head[h->cls] = p;
+	mpool_cache.n[h->cls] += 1;
+	mpool_cache.bytes += h->cap;
+	mpool_count(&mpool_stats.kept);
+	return;
+    }
+#endif
+
+    free(h->raw);
 }
 
-#define mval_free(m) free(m)
+static void *mval_realloc (void *p, size_t sz)
+{
+    void *q;
+
+    if (p == NULL) {
+	return mval_malloc(sz);
+    } else if (sz <= mval_header(p)->cap) {
+	return p;
+    }
+
+    q = mval_malloc(sz);
+    if (q != NULL) {
+	memcpy(q, p, mval_header(p)->cap);
+	mval_free(p);
+    }
+
+    return q;
+}
+
+/**
+ * gretl_matrix_pool_cleanup:
+ *
+ * Cleanup function, called by libgretl_cleanup(). Frees any
+ * matrix storage held for reuse by the calling thread.
+ */
+
+void gretl_matrix_pool_cleanup (void)
+{
+#if MPOOL_CACHE
+    void *p;
+    int c;
+
+    for (c=0; c<MPOOL_NCLASS; c++) {
+	while ((p = mpool_cache.head[c]) != NULL) {
+	    mpool_cache.head[c] = *(void **) p;
+	    free(mval_header(p)->raw);
+	}
+	mpool_cache.n[c] = 0;
+    }
+    mpool_cache.bytes = 0;
+#endif
+}
+
+/**
+ * gretl_matrix_pool_stats:
+ * @prn: gretl printing struct.
+ *
+ * Prints statistics on the allocation of matrix storage: the
+ * number of bytes currently cached by the calling thread and,
+ * if libgretl was built with MPOOL_STATS defined as 1, the
+ * number of requests, the proportion met by reusing storage
+ * from the pool, the number of requests too large to be
+ * pooled, and the number of blocks released and kept for
+ * reuse. Intended for tuning.
+ */
+
+void gretl_matrix_pool_stats (PRN *prn)
+{
+#if MPOOL_STATS
+    guint64 a = mpool_stats.alloc;
+
+    pprintf(prn, "matrix storage requests: %" G_GUINT64_FORMAT "\n", a);
+    pprintf(prn, "  met from pool: %" G_GUINT64_FORMAT " (%.1f%%)\n",
+	    mpool_stats.hit, a > 0 ? 100.0 * mpool_stats.hit / a : 0.0);
+    pprintf(prn, "  too big to pool: %" G_GUINT64_FORMAT "\n",
+	    mpool_stats.big);
+    pprintf(prn, "blocks released: %" G_GUINT64_FORMAT
+	    ", kept for reuse: %" G_GUINT64_FORMAT "\n",
+	    mpool_stats.free, mpool_stats.kept);
+#endif
+#if MPOOL_CACHE
+    pprintf(prn, "bytes cached (this thread): %" G_GSIZE_FORMAT "\n",
+	    mpool_cache.bytes);
+#endif
+}
 
 #ifdef USE_SIMD
 # include "matrix_simd.c"
@@ -327,7 +527,7 @@ static int matrix_block_error (const char *f)
 gretl_matrix *gretl_matrix_alloc (int rows, int cols)
 {
     gretl_matrix *m;
-    int n;
+    size_t n;
 
     if (rows < 0 || cols < 0) {
 	fprintf(stderr, "gretl error: gretl_matrix_alloc: rows=%d, cols=%d\n",
@@ -335,14 +535,23 @@ gretl_matrix *gretl_matrix_alloc (int rows, int cols)
 	return NULL;
     }
 
+    /* the element count must be computed in 64 bits, and the
+       byte count must not overflow size_t on 32-bit systems
+    */
+    n = (size_t) rows * cols;
+    if (n > G_MAXSIZE / (2 * sizeof(double))) {
+	fprintf(stderr, "gretl error: gretl_matrix_alloc: %d x %d is "
+		"too large\n", rows, cols);
+	set_gretl_matrix_err(E_ALLOC);
+	return NULL;
+    }
+
     m = malloc(sizeof *m);
     if (m == NULL) {
 	set_gretl_matrix_err(E_ALLOC);
 	return NULL;
     }
 
-    n = rows * cols;
-
     if (n == 0) {
 	m->val = NULL;
     } else {
@@ -365,7 +574,14 @@ gretl_matrix *gretl_matrix_alloc (int rows, int cols)
 
 gretl_matrix *gretl_cmatrix_new (int r, int c)
 {
-    gretl_matrix *m = gretl_matrix_alloc(2*r, c);
+    gretl_matrix *m;
+
+    if (r > INT_MAX / 2) {
+	set_gretl_matrix_err(E_ALLOC);
+	return NULL;
+    }
+
+    m = gretl_matrix_alloc(2*r, c);
 
     if (m != NULL) {
 	m->is_complex = 1;
@@ -377,7 +593,14 @@ gretl_matrix *gretl_cmatrix_new (int r, int c)
 
 gretl_matrix *gretl_cmatrix_new0 (int r, int c)
 {
-    gretl_matrix *m = gretl_zero_matrix_new(2*r, c);
+    gretl_matrix *m;
+
+    if (r > INT_MAX / 2) {
+	set_gretl_matrix_err(E_ALLOC);
+	return NULL;
+    }
+
+    m = gretl_zero_matrix_new(2*r, c);
 
     if (m != NULL) {
 	m->is_complex = 1;
@@ -434,20 +657,17 @@ int gretl_matrix_set_complex_full (gretl_matrix *m, int c)
 
 void gretl_matrix_block_destroy (gretl_matrix_block *B)
 {
-    int i;
-
     if (B == NULL) {
 	return;
     }
 
     if (B->matrix != NULL) {
-	for (i=0; i<B->n; i++) {
-	    free(B->matrix[i]);
-	}
+	/* the headers were allocated as a single array */
+	free(B->matrix[0]);
 	free(B->matrix);
     }
 
-    free(B->val);
+    mval_free(B->val);
     free(B);
 }
 
@@ -514,19 +734,16 @@ gretl_matrix_block *gretl_matrix_block_new (gretl_matrix **pm, ...)
 	return NULL;
     }
 
-    /* NULL everything in case we fail */
+    /* now allocate and initialize the matrices */
     B->val = NULL;
-    for (i=0; i<B->n; i++) {
-	B->matrix[i] = NULL;
+    B->matrix[0] = malloc(B->n * sizeof **B->matrix);
+    if (B->matrix[0] == NULL) {
+	free(B->matrix);
+	free(B);
+	return NULL;
     }
-
-    /* now allocate and initialize the matrices */
     for (i=0; i<B->n; i++) {
-	B->matrix[i] = malloc(sizeof **B->matrix);
-	if (B->matrix[i] == NULL) {
-	    gretl_matrix_block_destroy(B);
-	    return NULL;
-	}
+	B->matrix[i] = B->matrix[0] + i;
 	B->matrix[i]->info = (matrix_info *) INFO_INVALID;
 	B->matrix[i]->val = NULL;
 	B->matrix[i]->z = NULL;
@@ -551,14 +768,15 @@ gretl_matrix_block *gretl_matrix_block_new (gretl_matrix **pm, ...)
 	    err = 1;
 	    break;
 	}
-	vsize += m->rows * m->cols;
+	/* keep each member aligned for SIMD */
+	vsize += ((size_t) m->rows * m->cols + 3) & ~(size_t) 3;
     }
 
     va_end(ap);
 
     if (!err && vsize > 0) {
 	/* allocate combined data block */
-	B->val = malloc(vsize * sizeof *B->val);
+	B->val = mval_malloc(vsize * sizeof *B->val);
 	if (B->val == NULL) {
 	    err = 1;
 	}
@@ -570,14 +788,14 @@ gretl_matrix_block *gretl_matrix_block_new (gretl_matrix **pm, ...)
     } else {
 	/* set the val pointers */
 	double *val = B->val;
-	int n;
+	size_t n;
 
 	for (i=0; i<B->n; i++) {
 	    m = B->matrix[i];
-	    n = m->rows * m->cols;
+	    n = (size_t) m->rows * m->cols;
 	    if (n > 0) {
 		m->val = val;
-		val += n;
+		val += (n + 3) & ~(size_t) 3;
 	    }
 	}
     }
@@ -603,7 +821,7 @@ gretl_matrix *gretl_matrix_block_get_matrix (gretl_matrix_block *B,
 int gretl_matrix_na_check (const gretl_matrix *m)
 {
     if (m != NULL) {
-	int i, n = m->rows * m->cols;
+	size_t i, n = (size_t) m->rows * m->cols;
 
 	for (i=0; i<n; i++) {
 	    if (na(m->val[i])) {
@@ -738,7 +956,7 @@ gretl_matrix *gretl_matrix_reuse (gretl_matrix *m, int rows, int cols)
 
 int gretl_matrix_realloc (gretl_matrix *m, int rows, int cols)
 {
-    int n = rows * cols;
+    size_t n = (size_t) rows * cols;
     int oldrows, oldcols;
     double *x = NULL;
 
@@ -751,7 +969,7 @@ int gretl_matrix_realloc (gretl_matrix *m, int rows, int cols)
 	return 0;
     }
 
-    if (m->rows * m->cols == n) {
+    if ((size_t) m->rows * m->cols == n) {
 	/* no need to reallocate storage */
 	m->rows = rows;
 	m->cols = cols;
@@ -880,7 +1098,7 @@ int gretl_matrix_replace_content (gretl_matrix *targ,
 	return E_DATA;
     } else {
 	gretl_matrix_destroy_info(targ);
-	free(targ->val);
+	mval_free(targ->val);
 	targ->rows = donor->rows;
 	targ->cols = donor->cols;
 	targ->val = donor->val;
@@ -972,7 +1190,7 @@ static gretl_matrix *gretl_filled_matrix_new (int r, int c,
 	    m->cols = c;
 	}
     } else {
-	int i, n = r * c;
+	size_t i, n = (size_t) r * c;
 
 	m = gretl_matrix_alloc(r, c);
 	if (m != NULL) {
@@ -1123,7 +1341,7 @@ gretl_matrix *gretl_matrix_seq (double start, double end,
 void gretl_matrix_fill (gretl_matrix *m, double x)
 {
     if (m != NULL) {
-	int i, n = m->rows * m->cols;
+	size_t i, n = (size_t) m->rows * m->cols;
 
 	if (m->is_complex) {
 	    for (i=0; i<n; i++) {
@@ -1162,7 +1380,7 @@ gretl_matrix_copy_mod (const gretl_matrix *m, int mod)
     }
 
     if (mod == GRETL_MOD_TRANSPOSE) {
-	int k = 0;
+	size_t k = 0;
 
 	if (m->is_complex) {
 	    /* we'll do the conjugate transpose */
@@ -1186,7 +1404,7 @@ gretl_matrix_copy_mod (const gretl_matrix *m, int mod)
 	}
     } else {
 	/* not transposing */
-	int n = rows * cols;
+	size_t n = (size_t) rows * cols;
 
 	if (m->is_complex) {
 	    memcpy(c->z, m->z, n * sizeof *m->z);
@@ -1210,7 +1428,7 @@ static gretl_matrix *matrix_copy_plain (const gretl_matrix *m)
     c = gretl_matching_matrix_new(m->rows, m->cols, m);
 
     if (c != NULL) {
-	int n = c->rows * c->cols;
+	size_t n = (size_t) c->rows * c->cols;
 
 	if (m->is_complex) n *= 2;
 	memcpy(c->val, m->val, n * sizeof *m->val);
@@ -1251,7 +1469,7 @@ gretl_matrix *gretl_matrix_copy_transpose (const gretl_matrix *m)
 
 static gretl_matrix *gretl_matrix_copy_tmp (const gretl_matrix *a)
 {
-    size_t sz = a->rows * a->cols * sizeof(double);
+    size_t sz = (size_t) a->rows * a->cols * sizeof(double);
     gretl_matrix *b = calloc(1, sizeof *b);
 
     if (a->is_complex) sz *= 2;
@@ -1574,10 +1792,10 @@ void gretl_matrix_free (gretl_matrix *m)
 
 void gretl_matrix_zero (gretl_matrix *m)
 {
-    int i, n = m->rows * m->cols;
+    size_t n = (size_t) m->rows * m->cols;
 
-    for (i=0; i<n; i++) {
-	m->val[i] = 0.0;
+    if (n > 0) {
+	memset(m->val, 0, n * sizeof *m->val);
     }
 }
 
@@ -1903,20 +2121,26 @@ double gretl_matrix_trace (const gretl_matrix *m)
 
 int gretl_matrix_random_fill (gretl_matrix *m, int dist)
 {
-    int n;
+    size_t n, done = 0;
+    int k;
 
     if (m == NULL || (dist != D_UNIFORM && dist != D_NORMAL)) {
 	return 1;
     }
 
-    n = m->rows * m->cols;
+    n = (size_t) m->rows * m->cols;
 
-    if (n > 0) {
+    /* the RNG fill functions take int indices, so a very
+       large matrix is filled in chunks
+    */
+    while (done < n) {
+	k = (n - done > INT_MAX)? INT_MAX : (int) (n - done);
 	if (dist == D_NORMAL) {
-	    gretl_rand_normal(m->val, 0, n - 1);
-	} else if (dist == D_UNIFORM) {
-	    gretl_rand_uniform(m->val, 0, n - 1);
+	    gretl_rand_normal(m->val + done, 0, k - 1);
+	} else {
+	    gretl_rand_uniform(m->val + done, 0, k - 1);
 	}
+	done += k;
     }
 
     return 0;
@@ -2335,7 +2559,7 @@ int gretl_matrix_zero_lower (gretl_matrix *m)
 
 void gretl_matrix_multiply_by_scalar (gretl_matrix *m, double x)
 {
-    int i, n = m->rows * m->cols;
+    size_t i, n = (size_t) m->rows * m->cols;
 
 #if defined(USE_SIMD)
     if (simd_add_sub(n)) {
@@ -2379,7 +2603,7 @@ int gretl_matrix_divide_by_scalar (gretl_matrix *m, double x)
 void gretl_matrix_switch_sign (gretl_matrix *m)
 {
     if (!gretl_is_null_matrix(m)) {
-	int i, n = m->rows * m->cols;
+	size_t i, n = (size_t) m->rows * m->cols;
 
 	for (i=0; i<n; i++) {
 	    m->val[i] = -m->val[i];
@@ -2398,7 +2622,7 @@ void gretl_matrix_switch_sign (gretl_matrix *m)
 void gretl_matrix_raise (gretl_matrix *m, double x)
 {
     if (!gretl_is_null_matrix(m)) {
-	int i, n = m->rows * m->cols;
+	size_t i, n = (size_t) m->rows * m->cols;
 
 	for (i=0; i<n; i++) {
 	    m->val[i] = pow(m->val[i], x);
@@ -2697,7 +2921,7 @@ int gretl_vector_copy_values (gretl_vector *targ,
 int gretl_matrix_copy_values (gretl_matrix *targ,
 			      const gretl_matrix *src)
 {
-    int n;
+    size_t n;
 
     if (src == NULL) {
 	fprintf(stderr, "gretl_matrix_copy_values: src is NULL\n");
@@ -2715,7 +2939,7 @@ int gretl_matrix_copy_values (gretl_matrix *targ,
 	return E_NONCONF;
     }
 
-    n = src->rows * src->cols;
+    n = (size_t) src->rows * src->cols;
     if (n > 0) {
 	if (src->is_complex) {
 	    n *= 2;
@@ -2769,9 +2993,9 @@ int gretl_matrix_copy_data (gretl_matrix *targ,
 int gretl_matrix_copy_values_shaped (gretl_matrix *targ,
 				     const gretl_matrix *src)
 {
-    int n = targ->rows * targ->cols;
+    size_t n = (size_t) targ->rows * targ->cols;
 
-    if (src->rows * src->cols != n) {
+    if ((size_t) src->rows * src->cols != n) {
 	fprintf(stderr, "gretl_matrix_copy_values_shaped: targ is %d x %d but src is %d x %d\n",
 		targ->rows, targ->cols, src->rows, src->cols);
 	return E_NONCONF;
@@ -2786,7 +3010,7 @@ int gretl_matrix_copy_values_shaped (gretl_matrix *targ,
 
 static int add_scalar_to_matrix (gretl_matrix *targ, double x)
 {
-    int i, n = targ->rows * targ->cols;
+    size_t i, n = (size_t) targ->rows * targ->cols;
 
     for (i=0; i<n; i++) {
 	targ->val[i] += x;
@@ -2797,7 +3021,7 @@ static int add_scalar_to_matrix (gretl_matrix *targ, double x)
 
 static int subtract_scalar_from_matrix (gretl_matrix *targ, double x)
 {
-    int i, n = targ->rows * targ->cols;
+    size_t i, n = (size_t) targ->rows * targ->cols;
 
     for (i=0; i<n; i++) {
 	targ->val[i] -= x;
@@ -2824,7 +3048,7 @@ static int subtract_scalar_from_matrix (gretl_matrix *targ, double x)
 int
 gretl_matrix_add_to (gretl_matrix *targ, const gretl_matrix *src)
 {
-    int i, n;
+    size_t i, n;
 
     if (targ->rows != src->rows || targ->cols != src->cols) {
 	if (matrix_is_scalar(src)) {
@@ -2836,7 +3060,7 @@ gretl_matrix_add_to (gretl_matrix *targ, const gretl_matrix *src)
 	}
     }
 
-    n = src->rows * src->cols;
+    n = (size_t) src->rows * src->cols;
 
 #if defined(_OPENMP)
     if (!libset_use_openmp(n)) {
@@ -2881,7 +3105,7 @@ gretl_matrix_add (const gretl_matrix *a, const gretl_matrix *b,
 		  gretl_matrix *c)
 {
     int rows = a->rows, cols = a->cols;
-    int i, n;
+    size_t i, n;
 
     if (a->is_complex || b->is_complex) {
 	fprintf(stderr, "E_CMPLX in gretl_matrix_add\n");
@@ -2892,7 +3116,7 @@ gretl_matrix_add (const gretl_matrix *a, const gretl_matrix *b,
 	return E_NONCONF;
     }
 
-    n = rows * cols;
+    n = (size_t) rows * cols;
 
 #if defined(USE_SIMD)
     if (simd_add_sub(n)) {
@@ -2922,7 +3146,8 @@ gretl_matrix_add (const gretl_matrix *a, const gretl_matrix *b,
 int gretl_matrix_add_transpose_to (gretl_matrix *targ,
 				   const gretl_matrix *src)
 {
-    int i, j, k = 0;
+    size_t k = 0;
+    int i, j;
 
     if (targ->is_complex || src->is_complex) {
 	fprintf(stderr, "E_CMPLX in gretl_matrix_add_transpose_to\n");
@@ -2962,7 +3187,7 @@ int gretl_matrix_add_transpose_to (gretl_matrix *targ,
 int
 gretl_matrix_subtract_from (gretl_matrix *targ, const gretl_matrix *src)
 {
-    int i, n;
+    size_t i, n;
 
     if (targ->is_complex || src->is_complex) {
 	fprintf(stderr, "E_CMPLX in gretl_matrix_subtract_from\n");
@@ -2975,7 +3200,7 @@ gretl_matrix_subtract_from (gretl_matrix *targ, const gretl_matrix *src)
 	}
     }
 
-    n = src->rows * src->cols;
+    n = (size_t) src->rows * src->cols;
 
 #if defined(_OPENMP)
     if (!libset_use_openmp(n)) {
@@ -3021,7 +3246,7 @@ gretl_matrix_subtract (const gretl_matrix *a, const gretl_matrix *b,
 		       gretl_matrix *c)
 {
     int rows = a->rows, cols = a->cols;
-    int i, n;
+    size_t i, n;
 
     if (a->is_complex || b->is_complex) {
 	fprintf(stderr, "E_CMPLX in gretl_matrix_subtract\n");
@@ -3032,7 +3257,7 @@ gretl_matrix_subtract (const gretl_matrix *a, const gretl_matrix *b,
 	return E_NONCONF;
     }
 
-    n = rows * cols;
+    n = (size_t) rows * cols;
 
 #if defined(USE_SIMD)
     if (simd_add_sub(n)) {
@@ -3061,13 +3286,13 @@ gretl_matrix_subtract (const gretl_matrix *a, const gretl_matrix *b,
 int
 gretl_matrix_subtract_reversed (const gretl_matrix *a, gretl_matrix *b)
 {
-    int i, n;
+    size_t i, n;
 
     if (a->rows != b->rows || a->cols != b->cols) {
 	return E_NONCONF;
     }
 
-    n = a->rows * b->cols;
+    n = (size_t) a->rows * a->cols;
 
 #if defined(_OPENMP)
     if (!libset_use_openmp(n)) {
@@ -3203,9 +3428,9 @@ int gretl_matrix_transpose_in_place (gretl_matrix *m)
 	    }
 	}
     } else {
-	size_t sz = r * c * sizeof(double);
+	size_t sz = (size_t) r * c * sizeof(double);
 	double *val;
-	int k = 0;
+	size_t k = 0;
 
 	val = mval_malloc(sz);
 	if (val == NULL) {
@@ -3271,7 +3496,7 @@ int gretl_matrix_transpose (gretl_matrix *targ, const gretl_matrix *src)
 int gretl_square_matrix_transpose (gretl_matrix *m)
 {
     double x, y;
-    int mij, mji;
+    size_t mij, mji;
     int i, j;
 
     if (m->rows != m->cols) {
@@ -3305,7 +3530,7 @@ int gretl_square_matrix_transpose (gretl_matrix *m)
 void gretl_matrix_xtr_symmetric (gretl_matrix *m)
 {
     double x;
-    int mij, mji;
+    size_t mij, mji;
     int i, j;
 
     for (i=0; i<m->rows; i++) {
@@ -3333,7 +3558,7 @@ void gretl_matrix_xtr_symmetric (gretl_matrix *m)
 int gretl_matrix_add_self_transpose (gretl_matrix *m)
 {
     double x;
-    int mij, mji;
+    size_t mij, mji;
     int i, j;
 
     if (m->rows != m->cols) {
@@ -3704,7 +3929,8 @@ int gretl_matrix_extract_matrix (gretl_matrix *targ,
  * "Steals" the allocated data from @m, which is left with a
  * NULL data pointer.
  *
- * Returns: a pointer to the "stolen" data.
+ * Returns: a pointer to the "stolen" data, which should be
+ * freed using free().
  */
 
 double *gretl_matrix_steal_data (gretl_matrix *m)
@@ -3716,7 +3942,20 @@ double *gretl_matrix_steal_data (gretl_matrix *m)
 	    matrix_block_error("gretl_matrix_steal_data");
 	    return NULL;
 	}
-	vals = m->val;
+	if (m->val != NULL) {
+	    /* the pooled storage can't be handed over as is,
+	       since the recipient will call free() on it */
+	    size_t sz = (size_t) m->rows * m->cols * sizeof *vals;
+
+	    if (m->is_complex) {
+		sz *= 2;
+	    }
+	    vals = malloc(sz);
+	    if (vals != NULL) {
+		memcpy(vals, m->val, sz);
+	    }
+	    mval_free(m->val);
+	}
 	m->val = NULL;
 	m->z = NULL;
     }
@@ -5072,7 +5311,7 @@ gretl_vector *gretl_toeplitz_solve (const gretl_vector *c,
     return y;
 }
 
-#define gretl_matrix_cum(m,i,j,x) (m->val[(j)*m->rows+(i)]+=x)
+#define gretl_matrix_cum(m,i,j,x) (m->val[mdx(m,i,j)]+=x)
 
 #define BLAS_DEBUG 0
 
@@ -5190,11 +5429,11 @@ static void gretl_blas_dsyrk (const gretl_matrix *a, int atr,
 #define gretl_st_result(c,i,j,x,m)			\
     do {						\
 	if (m==GRETL_MOD_CUMULATE) {			\
-	    c->val[(j)*c->rows+(i)]+=x;			\
-	    if (i!=j) c->val[(i)*c->rows+(j)]+=x;	\
+	    c->val[mdx(c,i,j)]+=x;			\
+	    if (i!=j) c->val[mdx(c,j,i)]+=x;		\
 	} else if (m==GRETL_MOD_DECREMENT) {		\
-	    c->val[(j)*c->rows+(i)]-=x;			\
-	    if (i!=j) c->val[(i)*c->rows+(j)]-=x;	\
+	    c->val[mdx(c,i,j)]-=x;			\
+	    if (i!=j) c->val[mdx(c,j,i)]-=x;		\
 	} else {					\
 	    gretl_matrix_set(c,i,j,x);			\
 	    gretl_matrix_set(c,j,i,x);			\
@@ -5504,9 +5743,10 @@ static void gretl_dgemm (const gretl_matrix *a, int atr,
     double * restrict C = c->val;
     double x, alpha = 1.0;
     int beta = 0;
-    int ar = a->rows;
-    int br = b->rows;
-    int cr = c->rows;
+    /* element offsets are formed in 64 bits */
+    size_t ar = a->rows;
+    size_t br = b->rows;
+    size_t cr = c->rows;
 #if defined(_OPENMP)
     guint64 fpm;
 #endif
@@ -5695,9 +5935,10 @@ static void gretl_dgemm_single (const gretl_matrix *a, int atr,
     double *C = c->val;
     double x, alpha = 1.0;
     int beta = 0;
-    int ar = a->rows;
-    int br = b->rows;
-    int cr = c->rows;
+    /* element offsets are formed in 64 bits */
+    size_t ar = a->rows;
+    size_t br = b->rows;
+    size_t cr = c->rows;
     int i, j, l;
 
     if (cmod == GRETL_MOD_CUMULATE) {
@@ -7441,7 +7682,7 @@ int gretl_matrix_center (gretl_matrix *m)
     int i, j;
 
 #if defined(_OPENMP)
-    if (m->cols == 1 || m->rows * m->cols < 4096) {
+    if (m->cols == 1 || (size_t) m->rows * m->cols < 4096) {
 	goto st_mode;
     }
 #pragma omp parallel for private(i, j, x, xbar)
@@ -7495,7 +7736,7 @@ int gretl_matrix_standardize (gretl_matrix *m, int dfcorr)
     }
 
 #if defined(_OPENMP)
-    if (m->cols == 1 || m->rows * m->cols < 4096) {
+    if (m->cols == 1 || (size_t) m->rows * m->cols < 4096) {
 	goto st_mode;
     }
 #pragma omp parallel for private(i, j, x, xbar, sdc)
@@ -7747,7 +7988,7 @@ gretl_matrix *gretl_matrix_multiply_new (const gretl_matrix *a,
 static int matrix_divide_by_scalmat (gretl_matrix *num,
 				     const gretl_matrix *den)
 {
-    int i, n = num->rows * num->cols;
+    size_t i, n = (size_t) num->rows * num->cols;
 
     if (num->is_complex) {
 	double complex zden;
@@ -11040,8 +11281,8 @@ gretl_matrix_col_concat (const gretl_matrix *a, const gretl_matrix *b,
 	int cmplx_c = cmplx_a || cmplx_b;
 	int scalar_a = 0;
 	int scalar_b = 0;
-	int n_a = a->rows * a->cols;
-	int n_b = b->rows * b->cols;
+	size_t n_a = (size_t) a->rows * a->cols;
+	size_t n_b = (size_t) b->rows * b->cols;
 	size_t xsize = sizeof(double);
 	size_t zsize = sizeof(double complex);
 	double complex z;
@@ -11267,9 +11508,9 @@ int gretl_matrix_inplace_colcat (gretl_matrix *a,
     }
 
     if (mask == NULL) {
-	size_t bsize = b->rows * b->cols * sizeof *b->val;
+	size_t bsize = (size_t) b->rows * b->cols * sizeof *b->val;
 
-	memcpy(a->val + a->rows * k, b->val, bsize);
+	memcpy(a->val + (size_t) a->rows * k, b->val, bsize);
     } else {
 	for (j=0; j<b->cols; j++) {
 	    if (mask[j]) {
@@ -13446,13 +13687,13 @@ int gretl_is_identity_matrix (const gretl_matrix *m)
 
 int gretl_is_zero_matrix (const gretl_matrix *m)
 {
-    int i, n;
+    size_t i, n;
 
     if (gretl_is_null_matrix(m)) {
 	return 0;
     }
 
-    n = m->rows * m->cols;
+    n = (size_t) m->rows * m->cols;
 
     for (i=0; i<n; i++) {
 	if (m->val[i] != 0.0) {
@@ -13486,7 +13727,7 @@ gretl_matrix *gretl_matrix_isfinite (const gretl_matrix *m, int *err)
     if (f == NULL) {
 	*err = E_ALLOC;
     } else {
-	int i, n = m->rows * m->cols;
+	size_t i, n = (size_t) m->rows * m->cols;
 
 	for (i=0; i<n; i++) {
 	    f->val[i] = (na(m->val[i]))? 0 : 1;
@@ -105,8 +105,8 @@ typedef struct gretl_matrix_block_ gretl_matrix_block;
  * Returns: the @i, @j element of @m.
  */
 
-#define gretl_matrix_get(m,i,j) (m->val[(j)*m->rows+(i)])
-#define gretl_cmatrix_get(m,i,j) (m->z[(j)*m->rows+(i)])
+#define gretl_matrix_get(m,i,j) (m->val[(size_t)(j)*m->rows+(i)])
+#define gretl_cmatrix_get(m,i,j) (m->z[(size_t)(j)*m->rows+(i)])
 
 /**
  * gretl_vector_get:
@@ -128,8 +128,8 @@ typedef struct gretl_matrix_block_ gretl_matrix_block;
  * Sets the @i, @j element of @m to @x.
  */
 
-#define gretl_matrix_set(m,i,j,x) ((m)->val[(j)*(m)->rows+(i)]=x)
-#define gretl_cmatrix_set(m,i,j,x) ((m)->z[(j)*(m)->rows+(i)]=x)
+#define gretl_matrix_set(m,i,j,x) ((m)->val[(size_t)(j)*(m)->rows+(i)]=x)
+#define gretl_cmatrix_set(m,i,j,x) ((m)->z[(size_t)(j)*(m)->rows+(i)]=x)
 
 /**
  * gretl_vector_set:
@@ -883,6 +883,10 @@ void gretl_matrix_destroy_info (gretl_matrix *m);
 
 void lapack_mem_free (void);
 
+void gretl_matrix_pool_cleanup (void);
+
+void gretl_matrix_pool_stats (PRN *prn);
+
 void set_blas_mnk_min (int mnk);
 
 int get_blas_mnk_min (void);
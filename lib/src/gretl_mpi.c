@@ -89,7 +89,9 @@ enum {
     TAG_STR_VAL,
     TAG_BMEMB_INFO,
     TAG_ARRAY_INFO,
-    TAG_BUNDLE_SIZE
+    TAG_BUNDLE_SIZE,
+    TAG_TASK_REQ,
+    TAG_TASK_ID
 };
 
 #define MI_LEN 5 /* matrix info length */
@@ -304,6 +306,65 @@ static int matrix_dims_check (int *rows, int *cols, int n,
     return err;
 }
 
+/* MPI element counts are of type int, so the data of very large
+   matrices must be transferred in chunks */
+
+#define MPI_CHUNK (1 << 30)
+
+static int mpi_send_doubles (double *x, size_t n, int dest, int tag)
+{
+    size_t done = 0;
+    int k, err = 0;
+
+    while (!err && done < n) {
+	k = (n - done > MPI_CHUNK)? MPI_CHUNK : (int) (n - done);
+	err = mpi_send(x + done, k, mpi_double, dest, tag,
+		       mpi_comm_world);
+	done += k;
+    }
+
+    return err;
+}
+
+static int mpi_recv_doubles (double *x, size_t n, int source, int tag)
+{
+    size_t done = 0;
+    int k, err = 0;
+
+    while (!err && done < n) {
+	k = (n - done > MPI_CHUNK)? MPI_CHUNK : (int) (n - done);
+	err = mpi_recv(x + done, k, mpi_double, source, tag,
+		       mpi_comm_world, MPI_STATUS_IGNORE);
+	done += k;
+    }
+
+    return err;
+}
+
+static int mpi_bcast_doubles (double *x, size_t n, int root)
+{
+    size_t done = 0;
+    int k, err = 0;
+
+    while (!err && done < n) {
+	k = (n - done > MPI_CHUNK)? MPI_CHUNK : (int) (n - done);
+	err = mpi_bcast(x + done, k, mpi_double, root, mpi_comm_world);
+	done += k;
+    }
+
+    return err;
+}
+
+/* the number of doubles in the data array of a matrix of the
+   dimensions given in @rc */
+
+static size_t matrix_info_size (const int *rc)
+{
+    size_t n = (size_t) rc[0] * rc[1];
+
+    return rc[2] ? 2 * n : n;
+}
+
 static void fill_matrix_info (int *rc, const gretl_matrix *m)
 {
     rc[0] = m->rows;
@@ -369,7 +430,7 @@ static int matrix_reduce_alloc (int *rows, int *cols,
     if (*pm == NULL) {
 	err = E_ALLOC;
     } else {
-	size_t xsize = rows[n] * cols[n];
+	size_t xsize = (size_t) rows[n] * cols[n];
 
 	*px = malloc(xsize * sizeof **px);
 	if (*px == NULL) {
@@ -384,11 +445,11 @@ static int matrix_reduce_alloc (int *rows, int *cols,
 
 static int matrix_reduce_step (gretl_matrix *mtarg,
 			       double * restrict src,
-			       int n, Gretl_MPI_Op op,
-			       int *offset)
+			       size_t n, Gretl_MPI_Op op,
+			       size_t *offset)
 {
     double * restrict targ = mtarg->val;
-    int i;
+    size_t i;
 
     if (op == GRETL_MPI_SUM) {
 	for (i=0; i<n; i++) {
@@ -399,7 +460,7 @@ static int matrix_reduce_step (gretl_matrix *mtarg,
 	    targ[i] *= src[i];
 	}
     } else if (op == GRETL_MPI_HCAT) {
-	int k = *offset;
+	size_t k = *offset;
 
 	for (i=0; i<n; i++) {
 	    targ[k++] = src[i];
@@ -409,11 +470,12 @@ static int matrix_reduce_step (gretl_matrix *mtarg,
 	int rmin = *offset;
 	int nrows = n / mtarg->cols;
 	int rmax = rmin + nrows;
-	int j, k = 0;
+	size_t k = 0;
+	int j, r;
 
 	for (j=0; j<mtarg->cols; j++) {
-	    for (i=rmin; i<rmax; i++) {
-		gretl_matrix_set(mtarg, i, j, src[k++]);
+	    for (r=rmin; r<rmax; r++) {
+		gretl_matrix_set(mtarg, r, j, src[k++]);
 	    }
 	}
 	*offset += nrows;
@@ -525,18 +587,19 @@ int gretl_matrix_mpi_reduce (gretl_matrix *sm,
     if (!err) {
 	if (id != root) {
 	    /* send data to root */
-	    int sendsize = rc[0] * rc[1];
+	    size_t sendsize = (size_t) rc[0] * rc[1];
 
 	    if (sendsize > 0) {
-		err = mpi_send(sm->val, sendsize, mpi_double, root,
-			       TAG_MATRIX_VAL, mpi_comm_world);
+		err = mpi_send_doubles(sm->val, sendsize, root,
+				       TAG_MATRIX_VAL);
 	    }
 	} else {
 	    /* root gathers and processes data */
-	    int i, recvsize, offset = 0;
+	    size_t recvsize, offset = 0;
+	    int i;
 
 	    for (i=0; i<np && !err; i++) {
-		recvsize = rows[i] * cols[i];
+		recvsize = (size_t) rows[i] * cols[i];
 		if (recvsize == 0) {
 		    continue;
 		}
@@ -546,9 +609,8 @@ int gretl_matrix_mpi_reduce (gretl_matrix *sm,
 						 &offset);
 		    }
 		} else {
-		    err = mpi_recv(val, recvsize, mpi_double, i,
-				   TAG_MATRIX_VAL,  mpi_comm_world,
-				   MPI_STATUS_IGNORE);
+		    err = mpi_recv_doubles(val, recvsize, i,
+					   TAG_MATRIX_VAL);
 		    if (!err) {
 			err = matrix_reduce_step(rm, val, recvsize, op,
 						 &offset);
@@ -578,19 +640,150 @@ int gretl_matrix_mpi_reduce (gretl_matrix *sm,
     return err;
 }
 
+/* Support for the "amerge" reduction of arrays of matrices: each
+   process sends to root only those elements of its array that are
+   non-empty, along with their positions, and root slots them into
+   an array of the common length. This is designed for the case
+   where tasks are farmed out by index and each process fills in
+   the elements for the tasks it was given.
+*/
+
+static int matrix_element_is_filled (gretl_array *a, int i)
+{
+    gretl_matrix *m = gretl_array_get_data(a, i);
+
+    return m != NULL && m->rows > 0 && m->cols > 0;
+}
+
+static int array_merge_send (gretl_array *sa, int n, int root)
+{
+    int nm[2];
+    int i, err = 0;
+
+    nm[0] = n;
+    nm[1] = 0;
+    for (i=0; i<n; i++) {
+	nm[1] += matrix_element_is_filled(sa, i);
+    }
+
+    err = mpi_send(nm, 2, mpi_int, root, TAG_ARRAY_LEN,
+		   mpi_comm_world);
+
+    /* each filled element goes with its position, so that root
+       needs no workspace to receive them */
+    for (i=0; i<n && !err; i++) {
+	if (matrix_element_is_filled(sa, i)) {
+	    err = mpi_send(&i, 1, mpi_int, root, TAG_LIST_VAL,
+			   mpi_comm_world);
+	    if (!err) {
+		err = gretl_matrix_mpi_send(gretl_array_get_data(sa, i),
+					    root);
+	    }
+	}
+    }
+
+    return err;
+}
+
+/* Note: once the counts are in hand we receive everything @src
+   sends, even after an error, so as not to leave unmatched
+   messages behind; the first error is the one reported.
+*/
+
+static int array_merge_receive (gretl_array *a, int n, int src)
+{
+    gretl_matrix *m;
+    int nm[2];
+    int j, idx;
+    int err, rerr = 0;
+
+    err = mpi_recv(nm, 2, mpi_int, src, TAG_ARRAY_LEN,
+		   mpi_comm_world, MPI_STATUS_IGNORE);
+    if (err) {
+	return err;
+    }
+
+    if (nm[0] != n) {
+	gretl_errmsg_sprintf(_("mpireduce: array length %d at rank %d "
+			       "does not match %d at root"), nm[0], src, n);
+	err = E_NONCONF;
+    }
+
+    for (j=0; j<nm[1] && !rerr; j++) {
+	rerr = mpi_recv(&idx, 1, mpi_int, src, TAG_LIST_VAL,
+			mpi_comm_world, MPI_STATUS_IGNORE);
+	if (!rerr) {
+	    m = gretl_matrix_mpi_receive(src, &rerr);
+	}
+	if (rerr) {
+	    /* communication failure: can't go on */
+	    break;
+	} else if (!err && idx >= 0 && idx < n) {
+	    err = gretl_array_set_matrix(a, idx, m, 0);
+	} else {
+	    gretl_matrix_free(m);
+	}
+    }
+
+    return err ? err : rerr;
+}
+
+static int gretl_array_mpi_merge (gretl_array *sa,
+				  gretl_array **pa,
+				  int id, int np,
+				  int root)
+{
+    gretl_array *a = NULL;
+    int n = gretl_array_get_length(sa);
+    int i, err = 0;
+
+    if (id != root) {
+	return array_merge_send(sa, n, root);
+    }
+
+    a = gretl_array_new(GRETL_TYPE_MATRICES, n, &err);
+
+    for (i=0; i<n && !err; i++) {
+	if (matrix_element_is_filled(sa, i)) {
+	    err = gretl_array_set_matrix(a, i, gretl_array_get_data(sa, i), 1);
+	}
+    }
+
+    /* receive from all other processes regardless of @err */
+    for (i=0; i<np; i++) {
+	if (i != root) {
+	    int rerr = array_merge_receive(a, n, i);
+
+	    if (!err) {
+		err = rerr;
+	    }
+	}
+    }
+
+    if (!err) {
+	*pa = a;
+    } else {
+	gretl_array_destroy(a);
+    }
+
+    return err;
+}
+
 int gretl_array_mpi_reduce (gretl_array *sa,
 			    gretl_array **pa,
 			    Gretl_MPI_Op op,
-			    int root)
+			    int root,
+			    gretlopt opt)
 {
     gretl_array *a = NULL;
     gretl_matrix *mij;
     int *nmvec = NULL;
     int id, np, nm;
+    int ntotal = 0;
     int i, j;
     int err = 0;
 
-    if (op != GRETL_MPI_ACAT) {
+    if (op != GRETL_MPI_ACAT && op != GRETL_MPI_AMERGE) {
 	return E_DATA;
     } else if (gretl_array_get_type(sa) != GRETL_TYPE_MATRICES) {
 	return E_TYPES;
@@ -601,18 +794,18 @@ int gretl_array_mpi_reduce (gretl_array *sa,
 	return err;
     }
 
-    nm = gretl_array_get_length(sa);
+    if (op == GRETL_MPI_AMERGE) {
+	err = gretl_array_mpi_merge(sa, pa, id, np, root);
+	goto finish;
+    }
 
+    nm = gretl_array_get_length(sa);
     if (id != root) {
 	/* send size of our array to root */
 	err = mpi_send(&nm, 1, mpi_int, root, TAG_ARRAY_LEN,
 		       mpi_comm_world);
     } else {
-	/* root: gather and record array sizes from other processes;
-	   allocate composite array
-	*/
-	int ntotal = 0;
-
+	/* root: gather and record array sizes from other processes */
 	nmvec = malloc(np * sizeof *nmvec);
 	if (nmvec == NULL) {
 	    err = E_ALLOC;
@@ -627,39 +820,47 @@ int gretl_array_mpi_reduce (gretl_array *sa,
 	    }
 	    ntotal += nmvec[i];
 	}
-
-	if (!err) {
-	    a = gretl_array_new(GRETL_TYPE_MATRICES, ntotal, &err);
-	}
     }
 
-    if (!err) {
-	if (id != root) {
-	    /* send our member matrices to root */
-	    for (j=0; j<nm; j++) {
-		mij = gretl_array_get_element(sa, j, NULL, &err);
+    if (id != root) {
+	/* send our member matrices to root */
+	for (j=0; j<nm && !err; j++) {
+	    mij = gretl_array_get_element(sa, j, NULL, &err);
+	    if (!err) {
 		err = gretl_matrix_mpi_send(mij, root);
 	    }
-	} else {
-	    /* root: gather matrices from other processes
-	       and pack into big array
-	    */
-	    int k = 0;
+	}
+    } else if (!err) {
+	/* root: gather matrices from other processes and pack
+	   into big array; if we can't store them we still have
+	   to receive them, so as not to leave messages behind
+	*/
+	int rerr = 0, k = 0;
 
-	    for (i=0; i<np && !err; i++) {
-		for (j=0; j<nmvec[i] && !err; j++) {
-		    if (i == root) {
+	a = gretl_array_new(GRETL_TYPE_MATRICES, ntotal, &err);
+
+	for (i=0; i<np && !rerr; i++) {
+	    for (j=0; j<nmvec[i] && !rerr; j++) {
+		if (i == root) {
+		    if (!err) {
 			mij = gretl_array_get_element(sa, j, NULL, &err);
+		    }
+		    if (!err) {
 			err = gretl_array_set_matrix(a, k++, mij, 1);
+		    }
+		} else {
+		    mij = gretl_matrix_mpi_receive(i, &rerr);
+		    if (!rerr && !err) {
+			err = gretl_array_set_matrix(a, k++, mij, 0);
 		    } else {
-			mij = gretl_matrix_mpi_receive(i, &err);
-			if (!err) {
-			    err = gretl_array_set_matrix(a, k++, mij, 0);
-			}
+			gretl_matrix_free(mij);
 		    }
 		}
 	    }
 	}
+	if (!err) {
+	    err = rerr;
+	}
     }
 
     if (id == root) {
@@ -672,6 +873,25 @@ int gretl_array_mpi_reduce (gretl_array *sa,
 	}
     }
 
+ finish:
+
+    if (opt & OPT_A) {
+	/* "allgather": everyone gets the composite array, provided
+	   all went well everywhere; all processes must agree on
+	   that, so that either all or none take part in the bcast
+	*/
+	int lerr = (err != 0), gerr = 0;
+
+	mpi_allreduce(&lerr, &gerr, 1, mpi_int, mpi_max, mpi_comm_world);
+	if (!err && gerr) {
+	    gretl_errmsg_set("mpireduce: failed on another process");
+	    err = E_DATA;
+	}
+	if (!err) {
+	    err = gretl_array_bcast(pa, id, root);
+	}
+    }
+
     return err;
 }
 
@@ -754,19 +974,14 @@ static int gretl_matrix_bcast (gretl_matrix **pm, int id, int root)
 
     if (!err) {
 	/* broadcast the matrix content */
-	int n = rc[0] * rc[1];
-
-	if (rc[2]) {
-	    n *= 2;
-	}
+	size_t n = matrix_info_size(rc);
 
 	/* FIXME we can get a hang here with 100% CPU if
 	   a worker bombs out on bcast(); in that case
 	   it seems that root's call never returns --
 	   or maybe not before some looong time-out.
 	*/
-	err = mpi_bcast(m->val, n, mpi_double, root,
-			mpi_comm_world);
+	err = mpi_bcast_doubles(m->val, n, root);
     }
 
     if (err) {
@@ -1252,6 +1467,115 @@ int gretl_mpi_barrier (void)
     return mpi_barrier(mpi_comm_world) != MPI_SUCCESS;
 }
 
+/* State for the degenerate case of a task farm run with a single
+   process, in which root has to hand out tasks to itself. */
+
+static int self_task_next = 1;
+
+static int self_next_task (int ntasks)
+{
+    int k = 0;
+
+    if (self_task_next <= ntasks) {
+	k = self_task_next++;
+    } else {
+	/* ready for another farm */
+	self_task_next = 1;
+    }
+
+    return k;
+}
+
+/* Root's side of the task farm: serve requests for work from the
+   other processes, in whatever order they arrive, until each of
+   them has been told (by a zero task id) that the queue is empty.
+*/
+
+static int task_farm_dispatch (int ntasks, int np)
+{
+    MPI_Status status;
+    int next = 1;
+    int nstopped = 0;
+    int req, k;
+    int err = 0;
+
+    while (nstopped < np - 1 && !err) {
+	err = mpi_recv(&req, 1, mpi_int, MPI_ANY_SOURCE, TAG_TASK_REQ,
+		       mpi_comm_world, &status);
+	if (!err) {
+	    if (next <= ntasks) {
+		k = next++;
+	    } else {
+		k = 0;
+		nstopped++;
+	    }
+	    err = mpi_send(&k, 1, mpi_int, status.MPI_SOURCE, TAG_TASK_ID,
+			   mpi_comm_world);
+	}
+    }
+
+    return err;
+}
+
+/**
+ * gretl_mpi_next_task:
+ * @ntasks: the total number of tasks to be distributed.
+ * @root: the rank of the process that acts as dispatcher.
+ * @err: location to receive error code.
+ *
+ * Implements a dynamically scheduled "task farm": the tasks,
+ * indexed from 1 to @ntasks, are handed out one at a time to
+ * whichever process asks for work next, so that processes
+ * that happen to get quick tasks come back for more rather
+ * than sitting idle. On processes other than @root the return
+ * value is the (1-based) index of the next task to perform,
+ * or 0 once the task queue is exhausted; these processes
+ * should call this function repeatedly until it returns 0.
+ * The @root process acts as dispatcher: its single call
+ * returns 0 once all tasks have been handed out and all
+ * other processes have been notified of completion. In the
+ * special case of a single process, root hands out all tasks
+ * to itself in sequence.
+ *
+ * Returns: task index or 0.
+ **/
+
+int gretl_mpi_next_task (int ntasks, int root, int *err)
+{
+    int id, np;
+    int k = 0;
+
+    *err = gretl_comm_check(root, &id, &np);
+    if (*err) {
+	return 0;
+    } else if (ntasks < 0) {
+	*err = E_INVARG;
+	return 0;
+    }
+
+    if (np == 1) {
+	return self_next_task(ntasks);
+    } else if (id == root) {
+	*err = task_farm_dispatch(ntasks, np);
+    } else {
+	int req = id;
+
+	*err = mpi_send(&req, 1, mpi_int, root, TAG_TASK_REQ,
+			mpi_comm_world);
+	if (!*err) {
+	    *err = mpi_recv(&k, 1, mpi_int, root, TAG_TASK_ID,
+			    mpi_comm_world, MPI_STATUS_IGNORE);
+	}
+    }
+
+    if (*err) {
+	gretl_mpi_error(err);
+	k = 0;
+    }
+
+    return k;
+}
+
 /**
  * gretl_mpi_bcast:
  * @p: the location of the object to be broadcast.
@@ -1313,13 +1637,8 @@ int gretl_matrix_mpi_send (const gretl_matrix *m, int dest)
 		   mpi_comm_world);
 
     if (!err) {
-	int n = m->rows * m->cols;
-
-	if (m->is_complex) {
-	    n *= 2;
-	}
-	err = mpi_send(m->val, n, mpi_double, dest, TAG_MATRIX_VAL,
-		       mpi_comm_world);
+	err = mpi_send_doubles(m->val, matrix_info_size(rc), dest,
+			       TAG_MATRIX_VAL);
     }
 
     if (err) {
@@ -1483,11 +1802,9 @@ gretl_matrix *gretl_matrix_mpi_receive (int source,
 	int r = rc[0];
 	int c = rc[1];
 	int cmplx = rc[2];
-	int n = r * c;
 
 	if (cmplx) {
 	    m = gretl_cmatrix_new(r, c);
-	    n *= 2;
 	} else {
 	    m = gretl_matrix_alloc(r, c);
 	}
@@ -1496,9 +1813,8 @@ gretl_matrix *gretl_matrix_mpi_receive (int source,
 	    *err = E_ALLOC;
 	    return NULL;
 	} else {
-	    *err = mpi_recv(m->val, n, mpi_double, source,
-			    TAG_MATRIX_VAL, mpi_comm_world,
-			    MPI_STATUS_IGNORE);
+	    *err = mpi_recv_doubles(m->val, matrix_info_size(rc),
+				    source, TAG_MATRIX_VAL);
 	    if (*err) {
 		maybe_date_matrix(m, rc);
 	    }
@@ -1529,12 +1845,10 @@ int gretl_matrix_mpi_fill (gretl_matrix **pm, int source)
 	int r = rc[0];
 	int c = rc[1];
 	int cmplx = rc[2];
-	int n = r * c;
 
 	if (m == NULL) {
 	    if (cmplx) {
 		m = gretl_cmatrix_new(r, c);
-		n *= 2;
 	    } else {
 		m = gretl_matrix_alloc(r, c);
 	    }
@@ -1549,9 +1863,8 @@ int gretl_matrix_mpi_fill (gretl_matrix **pm, int source)
 	}
 
 	if (!err) {
-	    err = mpi_recv(m->val, n, mpi_double, source,
-			   TAG_MATRIX_VAL, mpi_comm_world,
-			   MPI_STATUS_IGNORE);
+	    err = mpi_recv_doubles(m->val, matrix_info_size(rc),
+				   source, TAG_MATRIX_VAL);
 	    if (err) {
 		maybe_date_matrix(m, rc);
 	    }
@@ -1999,7 +2312,8 @@ static void fill_tmp (double * restrict tmp,
     double x;
     int imin = *offset;
     int imax = imin + nr;
-    int i, j, k = 0;
+    size_t k = 0;
+    int i, j;
 
     for (j=0; j<m->cols; j++) {
 	for (i=imin; i<imax; i++) {
@@ -2021,7 +2335,7 @@ static int scatter_to_self (int *rc, double *val,
     if (*pm == NULL) {
 	err = E_ALLOC;
     } else {
-	size_t n = rc[0] * rc[1] * sizeof *val;
+	size_t n = (size_t) rc[0] * rc[1] * sizeof *val;
 
 	memcpy((*pm)->val, val, n);
     }
@@ -2047,7 +2361,8 @@ int gretl_matrix_mpi_scatter (const gretl_matrix *m,
     }
 
     if (id == root) {
-	int i, n;
+	size_t n;
+	int i;
 
 	if (op == GRETL_MPI_VSPLIT) {
 	    /* scatter by rows */
@@ -2056,19 +2371,19 @@ int gretl_matrix_mpi_scatter (const gretl_matrix *m,
 	    int offset = 0;
 
 	    /* we'll need a working buffer */
-	    tmp = malloc(m->cols * (nr + rem) * sizeof *tmp);
+	    tmp = malloc((size_t) m->cols * (nr + rem) * sizeof *tmp);
 	    if (tmp == NULL) {
 		err = E_ALLOC;
 	    }
 
-	    n = nr * m->cols;
+	    n = (size_t) nr * m->cols;
 	    rc[0] = nr;
 	    rc[1] = m->cols;
 
 	    for (i=0; i<np; i++) {
 		if (i == np - 1 && rem > 0) {
 		    rc[0] += rem;
-		    n += m->cols * rem;
+		    n += (size_t) m->cols * rem;
 		}
 		fill_tmp(tmp, m, rc[0], &offset);
 		if (i == root) {
@@ -2076,8 +2391,7 @@ int gretl_matrix_mpi_scatter (const gretl_matrix *m,
 		} else {
 		    err = mpi_send(rc, MI_LEN, mpi_int, i, TAG_MATRIX_INFO,
 				   mpi_comm_world);
-		    err = mpi_send(tmp, n, mpi_double, i, TAG_MATRIX_VAL,
-				   mpi_comm_world);
+		    err = mpi_send_doubles(tmp, n, i, TAG_MATRIX_VAL);
 		}
 	    }
 	} else {
@@ -2086,21 +2400,20 @@ int gretl_matrix_mpi_scatter (const gretl_matrix *m,
 	    int rem = m->cols % np;
 	    double *val = m->val;
 
-	    n = m->rows * nc;
+	    n = (size_t) m->rows * nc;
 	    fill_matrix_info(rc, m);
 
 	    for (i=0; i<np; i++) {
 		if (i == np - 1 && rem > 0) {
 		    rc[1] += rem;
-		    n += m->rows * rem;
+		    n += (size_t) m->rows * rem;
 		}
 		if (i == root) {
 		    err = scatter_to_self(rc, val, recvm);
 		} else {
 		    err = mpi_send(rc, MI_LEN, mpi_int, i, TAG_MATRIX_INFO,
 				   mpi_comm_world);
-		    err = mpi_send(val, n, mpi_double, i, TAG_MATRIX_VAL,
-				   mpi_comm_world);
+		    err = mpi_send_doubles(val, n, i, TAG_MATRIX_VAL);
 		}
 		val += n;
 	    }
@@ -28,6 +28,7 @@ typedef enum {
     GRETL_MPI_HCAT,
     GRETL_MPI_VCAT,
     GRETL_MPI_ACAT,
+    GRETL_MPI_AMERGE,
     GRETL_MPI_HSPLIT,
     GRETL_MPI_VSPLIT
 } Gretl_MPI_Op;
@@ -72,7 +73,10 @@ int gretl_matrix_mpi_scatter (const gretl_matrix *m,
 int gretl_array_mpi_reduce (gretl_array *sa,
 			    gretl_array **pa,
 			    Gretl_MPI_Op op,
-			    int root);
+			    int root,
+			    gretlopt opt);
+
+int gretl_mpi_next_task (int ntasks, int root, int *err);
 
 int gretl_mpi_receive (int source,
 		       GretlType *type,
@@ -3403,6 +3403,10 @@ int gretl_set_paths (ConfigPaths *cpaths)
     set_builtin_path_strings(0);
     set_gretl_tex_preamble();
 
+    if (!cpaths->no_dotdir && !err0) {
+	libset_thresholds_init();
+    }
+
     retval = (err0)? err0 : err1;
 
 #if CFG_DEBUG
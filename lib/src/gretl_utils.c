@@ -2495,6 +2495,14 @@ void libgretl_cleanup (void)
     builtin_strings_cleanup();
     last_result_cleanup();
 
+    if (getenv("GRETL_MPOOL_STATS") != NULL) {
+	PRN *prn = gretl_print_new(GRETL_PRINT_STDERR, NULL);
+
+	gretl_matrix_pool_stats(prn);
+	gretl_print_destroy(prn);
+    }
+    gretl_matrix_pool_cleanup();
+
 #ifdef HAVE_MPI
     if (!gretl_mpi_initialized()) {
 	dotdir_cleanup();
@@ -4409,6 +4409,50 @@ int gretl_read_gdt_varnames (const char *fname,
     return err;
 }
 
+/**
+ * gretl_read_gdt_nobs:
+ * @fname: name of XML data file to open for reading (for a
+ * .gdtb file, the data.xml member extracted from it).
+ * @nobs: location to receive the number of observations.
+ *
+ * Reads the number of observations recorded in the header of
+ * the specified file. In the case of panel data saved with
+ * padding skipped this is the number of rows actually stored.
+ *
+ * Returns: 0 on successful completion, non-zero otherwise.
+ */
+
+int gretl_read_gdt_nobs (const char *fname, int *nobs)
+{
+    xmlDocPtr doc = NULL;
+    xmlNodePtr cur = NULL;
+    int found = 0;
+    int err;
+
+    err = gretl_xml_open_doc_root(fname, "gretldata", &doc, &cur);
+    if (err) {
+	return err;
+    }
+
+    cur = cur->xmlChildrenNode;
+    while (cur != NULL && !found) {
+	if (!xmlStrcmp(cur->name, (XUC) "observations")) {
+	    found = gretl_xml_get_prop_as_int(cur, "count", nobs);
+	    break;
+	}
+	cur = cur->next;
+    }
+
+    if (!found || *nobs <= 0) {
+	gretl_errmsg_set(_("Failed to parse number of observations"));
+	err = E_DATA;
+    }
+
+    xmlFreeDoc(doc);
+
+    return err;
+}
+
 /**
  * gretl_get_gdt_description:
  * @fname: name of file to try.
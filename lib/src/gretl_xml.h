@@ -169,6 +169,8 @@ int gretl_read_gdt_varnames (const char *fname,
 			     char ***vnames,
 			     int *nvars);
 
+int gretl_read_gdt_nobs (const char *fname, int *nobs);
+
 char *gretl_get_gdt_description (const char *fname, int *err);
 
 int load_XML_functions_file (const char *fname, gretlopt opt, PRN *prn);
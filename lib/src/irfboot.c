@@ -43,8 +43,6 @@ struct irfboot_ {
     gretl_matrix *Xt;   /* row t of X matrix */
     gretl_matrix *Yt;   /* yhat at t */
     gretl_matrix *Et;   /* residuals at t */
-    gretl_matrix *rtmp; /* temporary storage */
-    gretl_matrix *ctmp; /* temporary storage */
     gretl_matrix *resp; /* impulse response matrix */
     gretl_matrix *C0;   /* initial coefficient estimates (VECM only) */
     int *sample;        /* resampling array */
@@ -74,11 +72,7 @@ static void irf_boot_free (irfboot *b)
 
 static int boot_allocate (irfboot *b, const GRETL_VAR *v)
 {
-    int n = v->neqns * effective_order(v);
-
-    b->MB = gretl_matrix_block_new(&b->rtmp, n, v->neqns,
-				   &b->ctmp, n, v->neqns,
-				   &b->rE, v->T, v->neqns,
+    b->MB = gretl_matrix_block_new(&b->rE, v->T, v->neqns,
 				   &b->resp, b->horizon, b->iters,
 				   NULL);
     if (b->MB == NULL) {
@@ -157,35 +151,9 @@ static int
 recalculate_impulse_responses (irfboot *b, GRETL_VAR *var,
 			       int targ, int shock, int iter)
 {
-    gretl_matrix *C = var->C;
-    double x;
-    int t, err = 0;
-
-    if (var->ord != NULL) {
-	C = reorder_responses(var, &err);
-	if (err) {
-	    return err;
-	}
-    }
-
-    for (t=0; t<b->horizon; t++) {
-	if (t == 0) {
-	    /* initial estimated responses */
-	    gretl_matrix_copy_values(b->rtmp, C);
-	} else {
-	    /* calculate further estimated responses */
-	    gretl_matrix_multiply(var->A, b->rtmp, b->ctmp);
-	    gretl_matrix_copy_values(b->rtmp, b->ctmp);
-	}
-	x = gretl_matrix_get(b->rtmp, targ, shock);
-	gretl_matrix_set(b->resp, t, iter, x);
-    }
+    double *resp = b->resp->val + (size_t) iter * b->horizon;
 
-    if (C != var->C) {
-	gretl_matrix_free(C);
-    }
-
-    return err;
+    return VAR_shock_response(var, targ, shock, b->horizon, resp);
 }
 
 static void maybe_resize_vecm_matrices (GRETL_VAR *v)
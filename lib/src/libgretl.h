@@ -411,6 +411,7 @@ typedef struct MODEL_ {
 #include "genfuncs.h"
 #include "compare.h"
 #include "gretl_bundle.h"
+#include "streamols.h"
 #include "gretl_array.h"    
 #include "gretl_intl.h"
 #include "gretl_list.h"
@@ -77,7 +77,8 @@ enum {
     STATE_MWRITE_G        = 1 << 19, /* use %g format with mwrite() */
     STATE_ECHO_SPACE      = 1 << 20, /* preserve vertical space in output */
     STATE_STRSUB_ON       = 1 << 21, /* string substitution activated */
-    STATE_MPI_SMT         = 1 << 22  /* MPI: use hyperthreads by default */
+    STATE_MPI_SMT         = 1 << 22, /* MPI: use hyperthreads by default */
+    STATE_MATMUL_F32      = 1 << 23  /* single-precision matrix products */
 };
 
 /* for values that really want a non-negative integer */
@@ -164,6 +165,9 @@ struct set_vars_ {
 			   !strcmp(s, MWRITE_G) || \
 			   !strcmp(s, STRSUB_ON) || \
 			   !strcmp(s, GEOJSON_FAST) || \
+			   !strcmp(s, MATMUL_F32) || \
+			   !strcmp(s, PLOT_BINARY) || \
+			   !strcmp(s, KDENSITY_BINNED) || \
 			   !strcmp(s, MPI_USE_SMT) || \
 			   !strcmp(s, USE_OPENMP))
 
@@ -200,6 +204,7 @@ struct set_vars_ {
 		       !strcmp(s, SIMD_K_MAX) || \
 		       !strcmp(s, SIMD_MN_MIN) || \
 		       !strcmp(s, FDJAC_QUAL) || \
+		       !strcmp(s, PLOT_MAXPOINTS) || \
 		       !strcmp(s, WILDBOOT_DIST))
 
 /* global state */
@@ -210,6 +215,7 @@ static int user_mp_bits;
 static int R_functions;
 static int R_lib = 1;
 static int csv_digits = UNSET_INT;
+static int plot_maxpoints = 50000; /* 0 = no data reduction */
 static int comments_on = 0;
 static char data_delim = ',';
 static char data_export_decpoint = '.';
@@ -630,6 +636,456 @@ int get_omp_n_threads (void)
     return omp_n_threads;
 }
 
+/* Calibration of the thresholds that govern the choice between
+   native, SIMD, OpenMP and BLAS code for matrix operations. The
+   best values differ greatly between machines, so we time the
+   competing kernels over a grid of shapes and store the results
+   in a per-host profile in the user's dot directory.
+*/
+
+#define TUNE_DEBUG 0
+
+typedef struct tune_point_ tune_point;
+
+struct tune_point_ {
+    guint64 mnk; /* size of problem */
+    int win;     /* did the alternative kernel win? */
+};
+
+static double time_matmul (const gretl_matrix *A, GretlMatrixMod amod,
+			   const gretl_matrix *B, gretl_matrix *C,
+			   int reps)
+{
+    double t, tmin = 0;
+    gint64 t0;
+    int i, j;
+
+    for (j=0; j<3; j++) {
+	t0 = g_get_monotonic_time();
+	for (i=0; i<reps; i++) {
+	    gretl_matrix_multiply_mod(A, amod, B, GRETL_MOD_NONE,
+				      C, GRETL_MOD_NONE);
+	}
+	t = (double) (g_get_monotonic_time() - t0);
+	if (j == 0 || t < tmin) {
+	    tmin = t;
+	}
+    }
+
+    return tmin;
+}
+
+/* Note: we don't use random matrices here, so as not to
+   disturb the state of the PRNG */
+
+static gretl_matrix *tune_matrix_new (int r, int c)
+{
+    gretl_matrix *m = gretl_matrix_alloc(r, c);
+    int i, n = r * c;
+
+    if (m != NULL) {
+	for (i=0; i<n; i++) {
+	    m->val[i] = 0.5 + ((i * 7 + 3) % 13) / 13.0;
+	}
+    }
+
+    return m;
+}
+
+/* Time a product of dimension @m x @n x @k under the current
+   thresholds, either as an ordinary product or (if @xtx is
+   non-zero) as X'X with X of dimension @k x @m.
+*/
+
+static double tune_time_product (int m, int n, int k, int xtx)
+{
+    gretl_matrix *A, *B, *C;
+    guint64 mnk = (guint64) m * n * k;
+    int reps = (int) (2000000 / mnk) + 1;
+    double t = 0;
+
+    if (xtx) {
+	A = tune_matrix_new(k, m);
+	B = A;
+    } else {
+	A = tune_matrix_new(m, k);
+	B = tune_matrix_new(k, n);
+    }
+    C = gretl_matrix_alloc(m, n);
+
+    if (A != NULL && B != NULL && C != NULL) {
+	t = time_matmul(A, xtx ? GRETL_MOD_TRANSPOSE : GRETL_MOD_NONE,
+			B, C, reps) / reps;
+    }
+
+    if (B != A) {
+	gretl_matrix_free(B);
+    }
+    gretl_matrix_free(A);
+    gretl_matrix_free(C);
+
+    return t;
+}
+
+/* The shapes used for calibrating the OpenMP and BLAS
+   thresholds: square products, and cross-products of
+   tall matrices.
+*/
+
+static const int tune_sizes[] = {8, 12, 16, 24, 32, 48, 64, 96, 128};
+
+#define N_TUNE_SIZES (sizeof tune_sizes / sizeof tune_sizes[0])
+#define N_TUNE_POINTS (2 * N_TUNE_SIZES)
+
+/* Given outcomes sorted by problem size, return the smallest
+   size such that the alternative won at that size and every
+   larger one, or -1 if it didn't win at the largest size. In
+   the latter case the calibration is inconclusive (the grid
+   may just not reach the crossover) and the caller should
+   stay with the prior setting.
+*/
+
+static int threshold_from_points (tune_point *tp, int n)
+{
+    tune_point tmp;
+    int i, j, ret = -1;
+
+    for (i=1; i<n; i++) {
+	tmp = tp[i];
+	for (j=i; j>0 && tp[j-1].mnk > tmp.mnk; j--) {
+	    tp[j] = tp[j-1];
+	}
+	tp[j] = tmp;
+    }
+
+    for (i=n-1; i>=0 && tp[i].win; i--) {
+	ret = (tp[i].mnk > INT_MAX)? INT_MAX : (int) tp[i].mnk;
+    }
+
+    return ret;
+}
+
+static void set_omp_mnk_min (int k)
+{
+    omp_mnk_min = k;
+}
+
+/* Compare the default kernel with the alternative obtained
+   by setting its threshold to 0 via @setmin, over the grid
+   of shapes.
+*/
+
+static int calibrate_mnk_threshold (void (*setmin) (int))
+{
+    tune_point tp[N_TUNE_POINTS];
+    int i, s, np = 0;
+    double t0, t1;
+
+    for (i=0; i<N_TUNE_SIZES; i++) {
+	s = tune_sizes[i];
+	setmin(-1);
+	t0 = tune_time_product(s, s, s, 0);
+	setmin(0);
+	t1 = tune_time_product(s, s, s, 0);
+	tp[np].mnk = (guint64) s * s * s;
+	tp[np++].win = t1 < t0;
+	setmin(-1);
+	t0 = tune_time_product(s, s, 16 * s, 1);
+	setmin(0);
+	t1 = tune_time_product(s, s, 16 * s, 1);
+	tp[np].mnk = (guint64) s * s * 16 * s;
+	tp[np++].win = t1 < t0;
+#if TUNE_DEBUG
+	fprintf(stderr, "s=%d: win = %d, %d\n", s, tp[np-2].win,
+		tp[np-1].win);
+#endif
+    }
+
+    setmin(-1);
+
+    return threshold_from_points(tp, np);
+}
+
+#if defined(USE_AVX)
+
+static int calibrate_simd_k_max (void)
+{
+    static const int kvals[] = {1, 2, 4, 8, 16, 32};
+    int save = get_simd_k_max();
+    int i, k, ret = -1;
+    double t0, t1;
+
+    for (i=0; i<6; i++) {
+	k = kvals[i];
+	set_simd_k_max(0);
+	t0 = tune_time_product(64, 64, k, 0);
+	set_simd_k_max(k);
+	t1 = tune_time_product(64, 64, k, 0);
+	if (t1 < t0) {
+	    ret = k;
+	} else {
+	    break;
+	}
+    }
+
+    set_simd_k_max(save);
+
+    return ret;
+}
+
+static double time_add_to (int n, int reps)
+{
+    gretl_matrix *a = tune_matrix_new(n, 1);
+    gretl_matrix *b = tune_matrix_new(n, 1);
+    double t, tmin = 0;
+    gint64 t0;
+    int i, j;
+
+    if (a == NULL || b == NULL) {
+	reps = 0;
+    }
+
+    for (j=0; j<3 && reps > 0; j++) {
+	t0 = g_get_monotonic_time();
+	for (i=0; i<reps; i++) {
+	    gretl_matrix_add_to(a, b);
+	}
+	t = (double) (g_get_monotonic_time() - t0);
+	if (j == 0 || t < tmin) {
+	    tmin = t;
+	}
+    }
+
+    gretl_matrix_free(a);
+    gretl_matrix_free(b);
+
+    return tmin;
+}
+
+static int calibrate_simd_mn_min (void)
+{
+    tune_point tp[11];
+    int save = get_simd_mn_min();
+    int i, n = 4;
+    double t0, t1;
+
+    for (i=0; i<11; i++, n *= 2) {
+	set_simd_mn_min(-1);
+	t0 = time_add_to(n, 200000 / n + 1);
+	set_simd_mn_min(n);
+	t1 = time_add_to(n, 200000 / n + 1);
+	tp[i].mnk = n;
+	tp[i].win = t1 < t0;
+    }
+
+    set_simd_mn_min(save);
+
+    return threshold_from_points(tp, 11);
+}
+
+#endif /* USE_AVX */
+
+static gchar *thresholds_profile_name (void)
+{
+    const char *host = g_get_host_name();
+    gchar *fname, *ret;
+
+    fname = g_strdup_printf("thresholds-%s.txt", host);
+    ret = g_build_filename(gretl_dotdir(), fname, NULL);
+    g_free(fname);
+
+    return ret;
+}
+
+static int write_thresholds_profile (void)
+{
+    gchar *fname = thresholds_profile_name();
+    FILE *fp = gretl_fopen(fname, "w");
+
+    if (fp == NULL) {
+	g_free(fname);
+	return E_FOPEN;
+    }
+
+    fprintf(fp, "# gretl matrix thresholds for host %s\n",
+	    g_get_host_name());
+    fprintf(fp, "%s = %d\n", OMP_N_THREADS, omp_n_threads);
+    fprintf(fp, "blas = %s\n", blas_variant_string());
+    fprintf(fp, "%s = %d\n", OMP_MNK_MIN, omp_mnk_min);
+    fprintf(fp, "%s = %d\n", BLAS_MNK_MIN, get_blas_mnk_min());
+    fprintf(fp, "%s = %d\n", SIMD_K_MAX, get_simd_k_max());
+    fprintf(fp, "%s = %d\n", SIMD_MN_MIN, get_simd_mn_min());
+
+    fclose(fp);
+    g_free(fname);
+
+    return 0;
+}
+
+/* Apply the thresholds stored in the profile for this host,
+   provided it was made with the current number of threads and
+   BLAS variant. Returns 0 on success, E_FOPEN if there's no
+   profile, or E_DATA if it doesn't match.
+*/
+
+static int read_thresholds_profile (void)
+{
+    gchar *fname = thresholds_profile_name();
+    FILE *fp = gretl_fopen(fname, "r");
+    int vals[4] = {0};
+    int got[4] = {0};
+    char line[128], key[32];
+    char sval[32];
+    int v, i, err = 0;
+
+    g_free(fname);
+
+    if (fp == NULL) {
+	return E_FOPEN;
+    }
+
+    while (fgets(line, sizeof line, fp) != NULL && !err) {
+	if (*line == '#' || sscanf(line, "%31s = %31s", key, sval) != 2) {
+	    continue;
+	}
+	v = atoi(sval);
+	if (!strcmp(key, OMP_N_THREADS)) {
+	    err = (v != omp_n_threads);
+	} else if (!strcmp(key, "blas")) {
+	    err = strcmp(sval, blas_variant_string()) != 0;
+	} else if (!strcmp(key, OMP_MNK_MIN)) {
+	    vals[0] = v;
+	    got[0] = 1;
+	} else if (!strcmp(key, BLAS_MNK_MIN)) {
+	    vals[1] = v;
+	    got[1] = 1;
+	} else if (!strcmp(key, SIMD_K_MAX)) {
+	    vals[2] = v;
+	    got[2] = 1;
+	} else if (!strcmp(key, SIMD_MN_MIN)) {
+	    vals[3] = v;
+	    got[3] = 1;
+	}
+    }
+
+    fclose(fp);
+
+    for (i=0; i<4 && !err; i++) {
+	err = !got[i];
+    }
+
+    if (err) {
+	return E_DATA;
+    }
+
+    omp_mnk_min = vals[0];
+    set_blas_mnk_min(vals[1]);
+    set_simd_k_max(vals[2]);
+    set_simd_mn_min(vals[3]);
+
+    return 0;
+}
+
+/**
+ * libset_calibrate_thresholds:
+ * @prn: printing struct, or NULL.
+ *
+ * Times the alternative kernels for matrix multiplication
+ * and addition (native code, SIMD, OpenMP, BLAS) over a grid
+ * of matrix shapes, sets the thresholds %simd_k_max,
+ * %simd_mn_min, %omp_mnk_min and %blas_mnk_min accordingly, and
+ * saves them as a profile for the current host in the user's
+ * dot directory, from where they are read on subsequent
+ * start-ups.
+ *
+ * Returns: 0 on success, non-zero code on error.
+ */
+
+int libset_calibrate_thresholds (PRN *prn)
+{
+    int omp_min = omp_mnk_min;
+    int blas_min = get_blas_mnk_min();
+#if defined(USE_AVX)
+    int k_max = get_simd_k_max();
+    int mn_min = get_simd_mn_min();
+#endif
+    int val, err = 0;
+
+    if (check_for_state()) {
+	return E_ALLOC;
+    }
+
+    /* Note: where a comparison finds no crossover we keep the
+       setting that was in force beforehand (at start-up, the
+       built-in default) rather than recording -1.
+    */
+
+#if defined(USE_AVX)
+    /* SIMD versus plain code, single-threaded */
+    omp_mnk_min = -1;
+    set_blas_mnk_min(-1);
+    val = calibrate_simd_k_max();
+    set_simd_k_max(val < 0 ? k_max : val);
+    val = calibrate_simd_mn_min();
+    set_simd_mn_min(val < 0 ? mn_min : val);
+#endif
+
+    /* OpenMP versus single-threaded native code */
+    set_blas_mnk_min(-1);
+    if ((state->flags & STATE_OPENMP_ON) && omp_n_threads > 1) {
+	val = calibrate_mnk_threshold(set_omp_mnk_min);
+	if (val >= 0) {
+	    omp_min = val;
+	}
+    }
+    omp_mnk_min = omp_min;
+
+    /* BLAS versus the best native code */
+    val = calibrate_mnk_threshold(set_blas_mnk_min);
+    set_blas_mnk_min(val < 0 ? blas_min : val);
+
+    if (*gretl_dotdir() != '\0') {
+	err = write_thresholds_profile();
+    }
+
+    if (prn != NULL) {
+	pprintf(prn, "%s = %d\n", OMP_MNK_MIN, omp_mnk_min);
+	pprintf(prn, "%s = %d\n", BLAS_MNK_MIN, get_blas_mnk_min());
+	pprintf(prn, "%s = %d\n", SIMD_K_MAX, get_simd_k_max());
+	pprintf(prn, "%s = %d\n", SIMD_MN_MIN, get_simd_mn_min());
+    }
+
+    return err;
+}
+
+/**
+ * libset_thresholds_init:
+ *
+ * Called once the user's dot directory is known: applies the
+ * stored matrix thresholds for the current host if a matching
+ * profile is found, otherwise runs libset_calibrate_thresholds()
+ * to create one. The calibration is skipped in tool mode, in
+ * MPI mode, or if the environment variable GRETL_NO_CALIBRATE
+ * is set; in those cases the built-in defaults are retained.
+ */
+
+void libset_thresholds_init (void)
+{
+    static int done;
+
+    if (done || gretl_in_tool_mode() || *gretl_dotdir() == '\0') {
+	return;
+    }
+
+    done = 1;
+
+    if (read_thresholds_profile() != 0 &&
+	getenv("GRETL_NO_CALIBRATE") == NULL &&
+	!gretl_mpi_initialized()) {
+	libset_calibrate_thresholds(NULL);
+    }
+}
+
 #if defined(_OPENMP)
 
 static int openmp_by_default (void)
@@ -1662,6 +2118,10 @@ static int print_settings (PRN *prn, gretlopt opt)
     libset_print_int(OMP_N_THREADS, prn, opt);
     libset_print_int(SIMD_K_MAX, prn, opt);
     libset_print_int(SIMD_MN_MIN, prn, opt);
+    libset_print_bool(MATMUL_F32, prn, opt);
+    libset_print_int(PLOT_MAXPOINTS, prn, opt);
+    libset_print_bool(PLOT_BINARY, prn, opt);
+    libset_print_bool(KDENSITY_BINNED, prn, opt);
 
     if (opt & OPT_D) {
 	/* display only */
@@ -1883,6 +2343,8 @@ int execute_set (const char *setobj, const char *setarg,
 	if (!strcmp(setobj, "stopwatch")) {
 	    gretl_stopwatch();
 	    return 0;
+	} else if (!strcmp(setobj, "calibrate")) {
+	    return libset_calibrate_thresholds(prn);
 	} else {
 	    return libset_query_settings(setobj, prn);
 	}
@@ -2177,6 +2639,8 @@ int libset_get_int (const char *key)
 	return state->bfgs_verbskip;
     } else if (!strcmp(key, CSV_DIGITS)) {
 	return csv_digits;
+    } else if (!strcmp(key, PLOT_MAXPOINTS)) {
+	return plot_maxpoints;
     } else if (!strcmp(key, FDJAC_QUAL)) {
 	return state->fdjac_qual;
     } else if (!strcmp(key, WILDBOOT_DIST)) {
@@ -2250,6 +2714,10 @@ static int intvar_min_max (const char *s, int *min, int *max,
     } else if (!strcmp(s, GRETL_DEBUG)) {
 	*min = 0;
 	*var = &gretl_debug;
+    } else if (!strcmp(s, PLOT_MAXPOINTS)) {
+	*min = 0;
+	*max = INT_MAX - 1;
+	*var = &plot_maxpoints;
     } else if (!strcmp(s, FDJAC_QUAL)) {
 	*min = 0;
 	*max = 4;
@@ -2346,6 +2814,8 @@ static int boolvar_get_flag (const char *s)
 	return STATE_STRSUB_ON;
     } else if (!strcmp(s, MPI_USE_SMT)) {
 	return STATE_MPI_SMT;
+    } else if (!strcmp(s, MATMUL_F32)) {
+	return STATE_MATMUL_F32;
     } else {
 	fprintf(stderr, "libset_get_bool: unrecognized "
 		"variable '%s'\n", s);
@@ -2385,6 +2855,8 @@ static void maybe_check_env (const char *s)
 }
 
 static int geojson_fast; /* should be temporary! */
+static int plot_binary = 1; /* binary data for transient plot files */
+static int kdensity_binned = 1; /* binned kernel density for big samples */
 
 int libset_get_bool (const char *key)
 {
@@ -2400,6 +2872,10 @@ int libset_get_bool (const char *key)
         return gretl_rand_get_dcmt();
     } else if (!strcmp(key, GEOJSON_FAST)) {
 	return geojson_fast;
+    } else if (!strcmp(key, PLOT_BINARY)) {
+	return plot_binary;
+    } else if (!strcmp(key, KDENSITY_BINNED)) {
+	return kdensity_binned;
     }
 
     if (check_for_state()) {
@@ -2504,6 +2980,12 @@ int libset_set_bool (const char *key, int val)
     } else if (!strcmp(key, GEOJSON_FAST)) {
 	geojson_fast = val;
 	return 0;
+    } else if (!strcmp(key, PLOT_BINARY)) {
+	plot_binary = val;
+	return 0;
+    } else if (!strcmp(key, KDENSITY_BINNED)) {
+	kdensity_binned = val;
+	return 0;
     }
 
     flag = boolvar_get_flag(key);
@@ -94,6 +94,10 @@ typedef enum {
 #define STRSUB_ON        "string_subst"
 #define MPI_USE_SMT      "mpi_use_smt"
 #define GEOJSON_FAST     "geojson_fast"
+#define MATMUL_F32       "matmul_f32"
+#define PLOT_MAXPOINTS   "plot_maxpoints"
+#define PLOT_BINARY      "plot_binary"
+#define KDENSITY_BINNED  "kdensity_binned"
 
 typedef void (*SHOW_ACTIVITY_FUNC) (void);
 typedef int (*DEBUG_READLINE) (void *);
@@ -130,6 +134,9 @@ int gretl_n_physical_cores (void);
 void num_threads_init (int blas_type);
 int get_omp_n_threads (void);
 
+int libset_calibrate_thresholds (PRN *prn);
+void libset_thresholds_init (void);
+
 /* GUI setter functions */
 void set_xsect_hccme (const char *s);
 void set_tseries_hccme (const char *s);
@@ -1149,7 +1149,7 @@ static int skip_matrix_comment (FILE *fp, int *rows, int *cols,
 
 static void matrix_swap_endianness (gretl_matrix *A)
 {
-    int i, n = A->rows * A->cols;
+    size_t i, n = (size_t) A->rows * A->cols;
 
     for (i=0; i<n; i++) {
 	reverse_double(A->val[i]);
@@ -1195,7 +1195,7 @@ static gretl_matrix *read_binary_matrix_file (FILE *fp, int *err)
     }
 
     if (!*err) {
-	size_t n = dim[0] * dim[1];
+	size_t n = (size_t) dim[0] * dim[1];
 
 	if (fread(A->val, sizeof *A->val, n, fp) < n) {
 	    *err = E_DATA;
@@ -1438,6 +1438,9 @@ static int matrix_to_csv (const gretl_matrix *A, const char *fname)
     return 0;
 }
 
+/* number of doubles per fwrite() call when writing binary */
+#define MAT_WCHUNK ((size_t) 1 << 24)
+
 /**
  * gretl_matrix_write_to_file:
  * @A: matrix to write.
@@ -1512,7 +1515,7 @@ int gretl_matrix_write_to_file (gretl_matrix *A, const char *fname,
 	const char *header = is_complex ? "gretl_binar_cmatrix" :
 	    "gretl_binary_matrix";
 	gint32 dim[2] = {r, c};
-	size_t n = r * c;
+	size_t t, n = (size_t) r * c;
 
 #if G_BYTE_ORDER == G_BIG_ENDIAN
 	double x;
@@ -1524,15 +1527,26 @@ int gretl_matrix_write_to_file (gretl_matrix *A, const char *fname,
 	    reverse_int(k);
 	    fwrite(&k, sizeof k, 1, fp);
 	}
-	for (i=0; i<n; i++) {
-	    x = A->val[i];
+	for (t=0; t<n && !err; t++) {
+	    x = A->val[t];
 	    reverse_double(x);
-	    fwrite(&x, sizeof x, 1, fp);
+	    if (fwrite(&x, sizeof x, 1, fp) < 1) {
+		err = E_FOPEN;
+	    }
 	}
 #else
 	fwrite(header, 1, strlen(header), fp);
 	fwrite(dim, sizeof *dim, 2, fp);
-	fwrite(A->val, sizeof *A->val, n, fp);
+	/* write in chunks, and check for a short write, since the
+	   data for a large matrix may run to many gigabytes
+	*/
+	for (t=0; t<n && !err; t+=MAT_WCHUNK) {
+	    size_t nt = (n - t > MAT_WCHUNK)? MAT_WCHUNK : n - t;
+
+	    if (fwrite(A->val + t, sizeof *A->val, nt, fp) < nt) {
+		err = E_FOPEN;
+	    }
+	}
 #endif
 	fclose(fp);
     } else {
@@ -23,29 +23,44 @@
 
 #define SHOW_SIMD 0
 
+/* storage obtained via mval_malloc() is 32-byte aligned, which
+   permits the use of aligned loads and stores */
+#define avx_aligned(p) (((guintptr) (p) & 31) == 0)
+
 static int gretl_matrix_simd_add_to (gretl_matrix *a,
 				     const gretl_matrix *b,
-				     int n)
+				     size_t n)
 {
     double *ax = a->val;
     const double *bx = b->val;
-    int i, imax = n / 4;
-    int rem = n % 4;
+    size_t i, imax = n / 4;
+    size_t rem = n % 4;
 
 #if SHOW_SIMD
     fprintf(stderr, "AVX: gretl_matrix_simd_add_to (%d x %d)\n",
 	    a->rows, a->cols);
 #endif
 
-    for (i=0; i<imax; i++) {
-	/* add 4 doubles in parallel */
-	__m256d Ymm_A = _mm256_loadu_pd(ax);
-	__m256d Ymm_B = _mm256_loadu_pd(bx);
-	__m256d Ymm_C = _mm256_add_pd(Ymm_A, Ymm_B);
+    if (avx_aligned(ax) && avx_aligned(bx)) {
+	for (i=0; i<imax; i++) {
+	    __m256d Ymm_A = _mm256_load_pd(ax);
+	    __m256d Ymm_B = _mm256_load_pd(bx);
 
-	_mm256_storeu_pd(ax, Ymm_C);
-	ax += 4;
-	bx += 4;
+	    _mm256_store_pd(ax, _mm256_add_pd(Ymm_A, Ymm_B));
+	    ax += 4;
+	    bx += 4;
+	}
+    } else {
+	for (i=0; i<imax; i++) {
+	    /* add 4 doubles in parallel */
+	    __m256d Ymm_A = _mm256_loadu_pd(ax);
+	    __m256d Ymm_B = _mm256_loadu_pd(bx);
+	    __m256d Ymm_C = _mm256_add_pd(Ymm_A, Ymm_B);
+
+	    _mm256_storeu_pd(ax, Ymm_C);
+	    ax += 4;
+	    bx += 4;
+	}
     }
 
     for (i=0; i<rem; i++) {
@@ -57,27 +72,38 @@ static int gretl_matrix_simd_add_to (gretl_matrix *a,
 
 static int gretl_matrix_simd_subt_from (gretl_matrix *a,
 					const gretl_matrix *b,
-					int n)
+					size_t n)
 {
     double *ax = a->val;
     const double *bx = b->val;
-    int i, imax = n / 4;
-    int rem = n % 4;
+    size_t i, imax = n / 4;
+    size_t rem = n % 4;
 
 #if SHOW_SIMD
     fprintf(stderr, "AVX: gretl_matrix_simd_subt_from (%d x %d, rem=%d)\n",
-	    a->rows, a->cols, rem);
+	    a->rows, a->cols, (int) rem);
 #endif
 
-    for (i=0; i<imax; i++) {
-	/* subtract 4 doubles in parallel */
-	__m256d Ymm_A = _mm256_loadu_pd(ax);
-	__m256d Ymm_B = _mm256_loadu_pd(bx);
-	__m256d Ymm_C = _mm256_sub_pd(Ymm_A, Ymm_B);
+    if (avx_aligned(ax) && avx_aligned(bx)) {
+	for (i=0; i<imax; i++) {
+	    __m256d Ymm_A = _mm256_load_pd(ax);
+	    __m256d Ymm_B = _mm256_load_pd(bx);
 
-	_mm256_storeu_pd(ax, Ymm_C);
-	ax += 4;
-	bx += 4;
+	    _mm256_store_pd(ax, _mm256_sub_pd(Ymm_A, Ymm_B));
+	    ax += 4;
+	    bx += 4;
+	}
+    } else {
+	for (i=0; i<imax; i++) {
+	    /* subtract 4 doubles in parallel */
+	    __m256d Ymm_A = _mm256_loadu_pd(ax);
+	    __m256d Ymm_B = _mm256_loadu_pd(bx);
+	    __m256d Ymm_C = _mm256_sub_pd(Ymm_A, Ymm_B);
+
+	    _mm256_storeu_pd(ax, Ymm_C);
+	    ax += 4;
+	    bx += 4;
+	}
     }
 
     for (i=0; i<rem; i++) {
@@ -90,26 +116,38 @@ static int gretl_matrix_simd_subt_from (gretl_matrix *a,
 static int gretl_matrix_simd_add (const double *ax,
 				  const double *bx,
 				  double *cx,
-				  int n)
+				  size_t n)
 {
-    int i, imax = n / 4;
-    int rem = n % 4;
+    size_t i, imax = n / 4;
+    size_t rem = n % 4;
 
 #if SHOW_SIMD
     fprintf(stderr, "AVX: gretl_matrix_simd_add (%d x %d)\n",
 	    a->rows, a->cols);
 #endif
 
-    for (i=0; i<imax; i++) {
-	/* process 4 doubles in parallel */
-	__m256d Ymm_A = _mm256_loadu_pd(ax);
-	__m256d Ymm_B = _mm256_loadu_pd(bx);
-	__m256d Ymm_C = _mm256_add_pd(Ymm_A, Ymm_B);
+    if (avx_aligned(ax) && avx_aligned(bx) && avx_aligned(cx)) {
+	for (i=0; i<imax; i++) {
+	    __m256d Ymm_A = _mm256_load_pd(ax);
+	    __m256d Ymm_B = _mm256_load_pd(bx);
 
-	_mm256_storeu_pd(cx, Ymm_C);
-	ax += 4;
-	bx += 4;
-	cx += 4;
+	    _mm256_store_pd(cx, _mm256_add_pd(Ymm_A, Ymm_B));
+    	ax += 4;
+    	bx += 4;
+    	cx += 4;
+	}
+    } else {
+	for (i=0; i<imax; i++) {
+	    /* process 4 doubles in parallel */
+	    __m256d Ymm_A = _mm256_loadu_pd(ax);
+	    __m256d Ymm_B = _mm256_loadu_pd(bx);
+	    __m256d Ymm_C = _mm256_add_pd(Ymm_A, Ymm_B);
+
+	    _mm256_storeu_pd(cx, Ymm_C);
+    	ax += 4;
+    	bx += 4;
+    	cx += 4;
+	}
     }
 
     for (i=0; i<rem; i++) {
@@ -122,26 +160,38 @@ static int gretl_matrix_simd_add (const double *ax,
 static int gretl_matrix_simd_subtract (const double *ax,
 				       const double *bx,
 				       double *cx,
-				       int n)
+				       size_t n)
 {
-    int i, imax = n / 4;
-    int rem = n % 4;
+    size_t i, imax = n / 4;
+    size_t rem = n % 4;
 
 #if SHOW_SIMD
-    fprintf(stderr, "AVX: gretl_matrix_simd_subtract (n = %d, rem = %d)\n",
-	    n, rem);
+    fprintf(stderr, "AVX: gretl_matrix_simd_subtract (n = %lu, rem = %d)\n",
+	    (unsigned long) n, (int) rem);
 #endif
 
-    for (i=0; i<imax; i++) {
-	/* process 4 doubles in parallel */
-	__m256d Ymm_A = _mm256_loadu_pd(ax);
-	__m256d Ymm_B = _mm256_loadu_pd(bx);
-	__m256d Ymm_C = _mm256_sub_pd(Ymm_A, Ymm_B);
+    if (avx_aligned(ax) && avx_aligned(bx) && avx_aligned(cx)) {
+	for (i=0; i<imax; i++) {
+	    __m256d Ymm_A = _mm256_load_pd(ax);
+	    __m256d Ymm_B = _mm256_load_pd(bx);
 
-	_mm256_storeu_pd(cx, Ymm_C);
-	cx += 4;
-	ax += 4;
-	bx += 4;
+	    _mm256_store_pd(cx, _mm256_sub_pd(Ymm_A, Ymm_B));
+    	cx += 4;
+    	ax += 4;
+    	bx += 4;
+	}
+    } else {
+	for (i=0; i<imax; i++) {
+	    /* process 4 doubles in parallel */
+	    __m256d Ymm_A = _mm256_loadu_pd(ax);
+	    __m256d Ymm_B = _mm256_loadu_pd(bx);
+	    __m256d Ymm_C = _mm256_sub_pd(Ymm_A, Ymm_B);
+
+	    _mm256_storeu_pd(cx, Ymm_C);
+    	cx += 4;
+    	ax += 4;
+    	bx += 4;
+	}
     }
 
     for (i=0; i<rem; i++) {
@@ -399,11 +449,11 @@ double gretl_vector_simd_dot_product (const gretl_vector *a,
     return ret;
 }
 
-void gretl_matrix_simd_scalar_mul (double *mx, double x, int n)
+void gretl_matrix_simd_scalar_mul (double *mx, double x, size_t n)
 {
     __m256d mxi, mul, res;
-    int i, imax = n / 4;
-    int rem = n % 4;
+    size_t i, imax = n / 4;
+    size_t rem = n % 4;
 
     mul = _mm256_broadcast_sd(&x);
 
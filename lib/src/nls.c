@@ -103,6 +103,12 @@ static void destroy_genrs_array (nlspec *s)
 {
     int i;
 
+    /* this depends on the genrs */
+    genr_autodiff_destroy(s->ad);
+    s->ad = NULL;
+    genr_bytecode_destroy(s->bc);
+    s->bc = NULL;
+
     for (i=0; i<s->ngenrs; i++) {
 	destroy_genr(s->genrs[i]);
     }
@@ -471,6 +477,12 @@ static int nls_auto_genr (nlspec *s, int i)
 	return s->generr;
     }
 
+    if (i == 0 && s->bc != NULL) {
+	/* aux genrs and criterion in one go */
+	s->generr = genr_bytecode_exec(s->bc, s->dset);
+	return s->generr;
+    }
+
     for (j=0; j<s->naux; j++) {
 #if NLS_DEBUG
 	fprintf(stderr, " generating aux var %d (%p):\n %s\n",
@@ -1331,6 +1343,34 @@ static int get_mle_gradient (double *b, double *g, int n,
     return err;
 }
 
+/* gradient of the loglikelihood via automatic differentiation */
+
+static int get_mle_ad_gradient (double *b, double *g, int n,
+				BFGS_CRIT_FUNC llfunc,
+				void *p)
+{
+    nlspec *spec = (nlspec *) p;
+    gretl_matrix *J;
+    int i, t, err = 0;
+
+    update_coeff_values(b, spec);
+
+    J = genr_autodiff_jacobian(spec->ad, spec->dset, spec->t1,
+			       spec->t2, &err);
+
+    if (!err) {
+	for (i=0; i<n; i++) {
+	    g[i] = 0.0;
+	    for (t=0; t<J->rows; t++) {
+		g[i] += gretl_matrix_get(J, t, i);
+	    }
+	}
+	gretl_matrix_free(J);
+    }
+
+    return err;
+}
+
 static int get_mle_hessian (double *b, gretl_matrix *H, void *p)
 {
     nlspec *spec = (nlspec *) p;
@@ -1450,7 +1490,11 @@ static gretl_matrix *ml_gradient_matrix (nlspec *spec, int *err)
     int k = spec->ncoeff;
     int T = spec->nobs;
 
-    if (numeric_mode(spec)) {
+    if (spec->ad != NULL && !scalar_loglik(spec)) {
+	update_coeff_values(spec->coeff, spec);
+	G = genr_autodiff_jacobian(spec->ad, spec->dset, spec->t1,
+				   spec->t2, err);
+    } else if (numeric_mode(spec)) {
 	G = numerical_score_matrix(spec->coeff, T, k, mle_llt_callback,
 				   (void *) spec, err);
     } else {
@@ -2307,6 +2351,11 @@ static void clear_nlspec (nlspec *spec)
     }
     spec->naux = 0;
 
+    genr_autodiff_destroy(spec->ad);
+    spec->ad = NULL;
+    genr_bytecode_destroy(spec->bc);
+    spec->bc = NULL;
+
     if (spec->genrs != NULL) {
 	for (i=0; i<spec->ngenrs; i++) {
 	    destroy_genr(spec->genrs[i]);
@@ -2389,6 +2438,30 @@ static void clear_nlspec (nlspec *spec)
    results back into the fvec and jac arrays.
 */
 
+/* Jacobian of the NLS residual via automatic differentiation,
+   written into the m x n array @jac */
+
+static int get_nls_ad_derivs (int m, int n, double *jac,
+			      nlspec *spec)
+{
+    gretl_matrix *J;
+    int err = 0;
+
+    J = genr_autodiff_jacobian(spec->ad, spec->dset, spec->t1,
+			       spec->t2, &err);
+
+    if (!err) {
+	if (J->rows != m || J->cols != n) {
+	    err = E_NONCONF;
+	} else {
+	    memcpy(jac, J->val, m * n * sizeof *jac);
+	}
+	gretl_matrix_free(J);
+    }
+
+    return err;
+}
+
 /* callback for lm_calculate (below) to be used by minpack */
 
 static int nls_calc (int m, int n, double *x, double *fvec,
@@ -2415,7 +2488,11 @@ static int nls_calc (int m, int n, double *x, double *fvec,
 	}
     } else if (*iflag == 2) {
 	/* calculate jacobian at x, results into jac */
-	err = get_nls_derivs(m, jac, NULL, p);
+	if (s->ad != NULL) {
+	    err = get_nls_ad_derivs(m, n, jac, s);
+	} else {
+	    err = get_nls_derivs(m, jac, NULL, p);
+	}
 	if (err) {
 	    fprintf(stderr, "get_nls_derivs: err = %d\n", err);
 	    *iflag = -1;
@@ -2604,6 +2681,8 @@ static int mle_calculate (nlspec *s, PRN *prn)
     if (!err) {
 	if (analytic_mode(s)) {
 	    gradfunc = get_mle_gradient;
+	} else if (s->ad != NULL) {
+	    gradfunc = get_mle_ad_gradient;
 	}
 	if (s->hesscall != NULL) {
 	    hessfunc = get_mle_hessian;
@@ -2647,7 +2726,7 @@ static int mle_calculate (nlspec *s, PRN *prn)
 	       a scalar). But it seems the latter requirement,
 	       !scalar_loglik(s), is not really necessary.
 	    */
-	    if (analytic_mode(s)) {
+	    if (gradfunc != NULL) {
 		s->Hinv = hessian_inverse_from_score(s->coeff, s->ncoeff,
 						     gradfunc, get_mle_ll,
 						     s, &err);
@@ -2698,7 +2777,7 @@ static int lm_calculate (nlspec *spec, PRN *prn)
 	goto nls_cleanup;
     }
 
-    if (!suppress_grad_check(spec)) {
+    if (spec->ad == NULL && !suppress_grad_check(spec)) {
 	err = check_derivatives(spec, prn);
 	if (err) {
 	    goto nls_cleanup;
@@ -2748,6 +2827,13 @@ static int lm_calculate (nlspec *spec, PRN *prn)
 	break;
     }
 
+    if (!err && spec->ad != NULL) {
+	/* minpack has overwritten the Jacobian: we want it at
+	   the final parameter values, for the GNR */
+	update_coeff_values(spec->coeff, spec);
+	err = get_nls_ad_derivs(m, n, spec->J->val, spec);
+    }
+
  nls_cleanup:
 
     free(wa);
@@ -3325,6 +3411,112 @@ static void nls_run_GNR (MODEL *pmod, nlspec *spec, PRN *prn)
 /* static function providing the real content for the two public
    wrapper functions below: does NLS, MLE or GMM */
 
+/* In the absence of analytical derivatives, see if we're able
+   to differentiate the criterion function (and any auxiliary
+   genrs on which it depends) automatically. If not, that's not
+   an error: we just stay with numerical derivatives.
+*/
+
+static void nl_autodiff_setup (nlspec *spec)
+{
+    gretl_matrix *J = NULL;
+    GretlType *ptypes = NULL;
+    char **pnames = NULL;
+    int nrows, i, err = 0;
+
+    if (spec->genrs == NULL || spec->nlfunc == NULL ||
+	(spec->flags & NL_AUTOREG)) {
+	return;
+    }
+
+    for (i=0; i<spec->nparam; i++) {
+	if (spec->params[i].bundle != NULL) {
+	    /* not handled */
+	    return;
+	}
+    }
+
+    pnames = malloc(spec->nparam * sizeof *pnames);
+    ptypes = malloc(spec->nparam * sizeof *ptypes);
+
+    if (pnames == NULL || ptypes == NULL) {
+	err = E_ALLOC;
+    } else {
+	for (i=0; i<spec->nparam; i++) {
+	    pnames[i] = spec->params[i].name;
+	    ptypes[i] = spec->params[i].type;
+	}
+	spec->ad = genr_autodiff_new(spec->genrs, spec->naux + 1,
+				     pnames, ptypes, spec->nparam,
+				     &err);
+    }
+
+    if (!err) {
+	/* trial run at the initial values */
+	J = genr_autodiff_jacobian(spec->ad, spec->dset, spec->t1,
+				   spec->t2, &err);
+	nrows = scalar_loglik(spec) ? 1 : spec->nobs;
+	if (!err && (J->rows != nrows || J->cols != spec->ncoeff)) {
+	    err = E_NONCONF;
+	}
+	gretl_matrix_free(J);
+    }
+
+#if NLS_DEBUG
+    fprintf(stderr, "nl_autodiff_setup: err = %d\n", err);
+#endif
+
+    if (err) {
+	genr_autodiff_destroy(spec->ad);
+	spec->ad = NULL;
+    }
+
+    free(pnames);
+    free(ptypes);
+}
+
+/* See if the auxiliary genrs and the criterion function can be
+   run as a flat program (see genbc.c) rather than via genr; if
+   not, that's not an error, we just carry on with genr.
+*/
+
+static void nl_bytecode_setup (nlspec *spec)
+{
+    int i, n, err = 0;
+
+    if (spec->genrs == NULL || (spec->flags & NL_AUTOREG)) {
+	return;
+    }
+
+    for (i=0; i<spec->nparam; i++) {
+	if (spec->params[i].bundle != NULL) {
+	    /* not handled */
+	    return;
+	}
+    }
+
+    n = spec->naux + (spec->nlfunc != NULL);
+    if (n == 0) {
+	return;
+    }
+
+    spec->bc = genr_bytecode_new(spec->genrs, n, spec->dset, &err);
+
+    if (!err) {
+	/* trial run at the initial values */
+	err = genr_bytecode_check(spec->bc, spec->dset, spec->prn);
+    }
+
+#if NLS_DEBUG
+    fprintf(stderr, "nl_bytecode_setup: err = %d\n", err);
+#endif
+
+    if (err) {
+	genr_bytecode_destroy(spec->bc);
+	spec->bc = NULL;
+    }
+}
+
 static MODEL real_nl_model (nlspec *spec, DATASET *dset,
 			    gretlopt opt, PRN *prn)
 {
@@ -3429,10 +3621,20 @@ static MODEL real_nl_model (nlspec *spec, DATASET *dset,
 	spec->tol = libset_get_double(NLS_TOLER);
     }
 
+    if (numeric_mode(spec) && spec->ci != GMM && !(spec->opt & OPT_N)) {
+	nl_autodiff_setup(spec);
+    }
+
+    nl_bytecode_setup(spec);
+
     if (spec->ci != GMM && !(spec->opt & (OPT_Q | OPT_M))) {
-	pputs(prn, (numeric_mode(spec))?
-	      _("Using numerical derivatives\n") :
-	      _("Using analytical derivatives\n"));
+	if (spec->ad != NULL) {
+	    pputs(prn, _("Using automatic differentiation\n"));
+	} else {
+	    pputs(prn, (numeric_mode(spec))?
+		  _("Using numerical derivatives\n") :
+		  _("Using analytical derivatives\n"));
+	}
     }
 
     /* now start the actual calculations */
@@ -3447,7 +3649,7 @@ static MODEL real_nl_model (nlspec *spec, DATASET *dset,
     } else {
 	/* NLS: invoke the appropriate minpack driver function */
 	gretl_iteration_push();
-	if (numeric_mode(spec)) {
+	if (numeric_mode(spec) && spec->ad == NULL) {
 	    err = lm_approximate(spec, prn);
 	} else {
 	    err = lm_calculate(spec, prn);
@@ -3625,6 +3827,8 @@ nlspec *nlspec_new (int ci, const DATASET *dset)
 
     spec->oc = NULL;
     spec->missmask = NULL;
+    spec->ad = NULL;
+    spec->bc = NULL;
 
     return spec;
 }
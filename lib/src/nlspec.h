@@ -20,6 +20,8 @@
 /* Private header for sharing info between nls.c and gmm.c */
 
 #include "libgretl.h" 
+#include "genad.h"
+#include "genbc.h"
 
 typedef struct parm_ parm;
 typedef struct ocset_ ocset;
@@ -75,6 +77,8 @@ struct nlspec_ {
     PRN *prn;           /* printing aparatus */
     ocset *oc;          /* orthogonality info (GMM) */
     char *missmask;     /* mask for missing observations */
+    ad_info *ad;        /* automatic differentiation apparatus */
+    bc_program *bc;     /* flat program for the aux genrs and criterion */
 };
 
 void nlspec_destroy_arrays (nlspec *s);
@@ -18,6 +18,11 @@
  */
 
 #include "libgretl.h"
+#include "libset.h"
+
+#ifdef _OPENMP
+# include <omp.h>
+#endif
 
 /**
  * SECTION:nonparam
@@ -427,26 +432,108 @@ static int compare_pairs_x (const void *a, const void *b)
     return ret;
 }
 
-static int compare_pairs_y (const void *a, const void *b)
+/* Count the inversions in @y (pairs i < j with y[i] > y[j])
+   via a bottom-up merge sort, using @tmp as workspace. On
+   return @y is sorted in ascending order. Equal values do
+   not count as inversions.
+*/
+
+static gint64 count_inversions (double *y, double *tmp, int n)
 {
-    const struct xy_pair *pa = a;
-    const struct xy_pair *pb = b;
+    double *src = y, *dst = tmp, *p;
+    gint64 swaps = 0;
+    int w, lo, mid, hi;
+    int i, j, k;
+
+    for (w=1; w<n; w*=2) {
+	for (lo=0; lo<n; lo+=2*w) {
+	    mid = MIN(lo + w, n);
+	    hi = MIN(lo + 2*w, n);
+	    i = k = lo;
+	    j = mid;
+	    while (i < mid && j < hi) {
+		if (src[j] < src[i]) {
+		    swaps += mid - i;
+		    dst[k++] = src[j++];
+		} else {
+		    dst[k++] = src[i++];
+		}
+	    }
+	    while (i < mid) {
+		dst[k++] = src[i++];
+	    }
+	    while (j < hi) {
+		dst[k++] = src[j++];
+	    }
+	}
+	p = src;
+	src = dst;
+	dst = p;
+    }
+
+    if (src != y) {
+	memcpy(y, src, n * sizeof *y);
+    }
+
+    return swaps;
+}
+
+/* Accumulate the tie statistics for the runs of equal values
+   in the sorted array @v: for each run of length t we add
+   t(t-1)/2 to the count of tied pairs and t(t-1)(t-2),
+   t(t-1)(2t+5) to @T2 and @T25 respectively.
+*/
+
+static gint64 tie_sums (const double *v, int n,
+			double *T2, double *T25)
+{
+    gint64 r, npairs = 0;
+    double t;
+    int i, i0 = 0;
+
+    for (i=1; i<=n; i++) {
+	if (i == n || v[i] != v[i-1]) {
+	    r = i - i0;
+	    if (r > 1) {
+		t = r;
+		npairs += r * (r - 1) / 2;
+		*T2 += t * (t - 1) * (t - 2);
+		*T25 += t * (t - 1) * (2 * t + 5);
+	    }
+	    i0 = i;
+	}
+    }
 
-    return (pa->y > pb->y) - (pa->y < pb->y);
+    return npairs;
 }
 
+/* Kendall's tau, via Knight's algorithm (JASA, 1966): with the
+   pairs sorted by x (then y), the discordant pairs are the
+   inversions in the sequence of y values, which can be counted
+   by merge sort in O(n log n) time. The tie corrections are
+   computed from the runs of equal values in x, in y, and in
+   both jointly.
+*/
+
 static int real_kendall_tau (const double *x, const double *y,
 			     int n, struct xy_pair *xy, int nn,
 			     double *ptau, double *pz)
 {
     double tau, nn1, s2, z;
-    int tt1, tx = 0, ty = 0;
-    int Tx = 0, Ty = 0;
-    int Tx2 = 0, Ty2 = 0;
-    int Tx25 = 0, Ty25 = 0;
-    int tie, N0, N1, S;
+    double Tx, Ty;
+    double Tx2 = 0, Ty2 = 0;
+    double Tx25 = 0, Ty25 = 0;
+    double *ys, *tmp;
+    gint64 n0, n1, n2, n3 = 0;
+    gint64 swaps, S;
     int i, j;
 
+    ys = malloc(2 * (size_t) nn * sizeof *ys);
+    if (ys == NULL) {
+	return E_ALLOC;
+    }
+    tmp = ys + nn;
+
     /* populate sorter */
     j = 0;
     for (i=0; i<n; i++) {
@@ -457,65 +544,42 @@ static int real_kendall_tau (const double *x, const double *y,
 	}
     }
 
-    /* sort pairs by x */
+    /* sort pairs by x, then y */
     qsort(xy, nn, sizeof *xy, compare_pairs_x);
 
-    /* make order counts */
-    N0 = N1 = 0;
-    for (i=0; i<nn; i++) {
-	for (j=i+1; j<nn; j++) {
-	    if (xy[j].y == xy[i].y) {
-		Ty++;
-	    } else if (xy[j].x != xy[i].x) {
-		if (xy[j].y > xy[i].y) {
-		    N0++;
-		} else if (xy[j].y < xy[i].y) {
-		    N1++;
-		}
-	    }
-	}
-	if (i > 0) {
-	    /* account for ties in x */
-	    tie = (xy[i].x == xy[i-1].x);
-	    if (tie) {
-		tx++;
-	    }
-	    if (tx > 0 && (!tie || i == nn - 1)) {
-		tx++;
-		tt1 = tx * (tx - 1);
-		Tx += tt1;
-		Tx2 += tt1 * (tx - 2);
-		Tx25 += tt1 * (2 * tx + 5);
-		tx = 0;
-	    }
+    /* ties in x, and joint ties in x and y */
+    j = 0;
+    for (i=1; i<=nn; i++) {
+	if (i == nn || xy[i].x != xy[j].x || xy[i].y != xy[j].y) {
+	    n3 += (gint64) (i - j) * (i - j - 1) / 2;
+	    j = i;
 	}
     }
+    for (i=0; i<nn; i++) {
+	ys[i] = xy[i].x;
+    }
+    n1 = tie_sums(ys, nn, &Tx2, &Tx25);
 
-    if (Ty > 0) {
-	/* account for ties in y */
-	Ty = 0;
-	qsort(xy, nn, sizeof *xy, compare_pairs_y);
-	for (i=1; i<nn; i++) {
-	    tie = (xy[i].y == xy[i-1].y);
-	    if (tie) {
-		ty++;
-	    }
-	    if (ty > 0 && (!tie || i == nn - 1)) {
-		ty++;
-		tt1 = ty * (ty - 1);
-		Ty += tt1;
-		Ty2 += tt1 * (ty - 2);
-		Ty25 += tt1 * (2 * ty + 5);
-		ty = 0;
-	    }
-	}
+    /* discordant pairs; this leaves ys sorted */
+    for (i=0; i<nn; i++) {
+	ys[i] = xy[i].y;
     }
+    swaps = count_inversions(ys, tmp, nn);
 
-    S = N0 - N1;
+    /* ties in y */
+    n2 = tie_sums(ys, nn, &Ty2, &Ty25);
+
+    free(ys);
+
+    n0 = (gint64) nn * (nn - 1) / 2;
+    S = n0 - n1 - n2 + n3 - 2 * swaps;
+    Tx = 2.0 * n1;
+    Ty = 2.0 * n2;
 
 #if 0
-    fprintf(stderr, "N0 = %d, N1 = %d, S = %d\n", N0, N1, S);
-    fprintf(stderr, "Tx = %d, Ty = %d\n", Tx, Ty);
+    fprintf(stderr, "n0 = %" G_GINT64_FORMAT ", swaps = %" G_GINT64_FORMAT
+	    ", S = %" G_GINT64_FORMAT "\n", n0, swaps, S);
+    fprintf(stderr, "Tx = %g, Ty = %g\n", Tx, Ty);
 #endif
 
     nn1 = nn * (nn - 1.0);
@@ -752,9 +816,11 @@ double lockes_test (const double *x, int t1, int t2)
 {
     struct xy_pair *uv = NULL;
     double *sx = NULL, *u = NULL, *v = NULL;
-    double zj, z;
+    double zj[NREPEAT];
+    double z = NADBL;
     int m = t2 - t1 + 1;
-    int i, j, t;
+    int nt = 1;
+    int i, j, b, t;
     int err;
 
     err = locke_shuffle_init(x + t1, &m, &sx);
@@ -763,43 +829,81 @@ double lockes_test (const double *x, int t1, int t2)
     }
 
     m /= 2;
-    u = malloc(m * sizeof *u);
-    v = malloc(m * sizeof *v);
-    uv = malloc(m * sizeof *uv);
+
+#if defined(_OPENMP)
+    if (libset_use_openmp((guint64) m * NREPEAT)) {
+	nt = get_omp_n_threads();
+	if (nt > NREPEAT) {
+	    nt = NREPEAT;
+	}
+    }
+#endif
+
+    /* one block of workspace per thread */
+    u = malloc((size_t) nt * m * sizeof *u);
+    v = malloc((size_t) nt * m * sizeof *v);
+    uv = malloc((size_t) nt * m * sizeof *uv);
 
     if (u == NULL || v == NULL || uv == NULL) {
-	z = NADBL;
 	goto bailout;
     }
 
-    z = 0.0;
-
     /* repeat the shuffling of the series NREPEAT times, since the
-       test statistic is sensitive to the ordering under the null
+       test statistic is sensitive to the ordering under the null.
+       The shuffles are done serially, in batches of @nt, so that
+       the sequence of random draws doesn't depend on the number
+       of threads; the Kendall statistics for each batch can then
+       be computed in parallel.
     */
 
-    for (j=0; j<NREPEAT; j++) {
-#if LOCKE_DEBUG
-	fprintf(stderr, "locke's test: j = %d\n", j);
-#endif	
-	qsort(sx, 2 * m, sizeof *sx, randomize_doubles);
-	t = 0;
-	for (i=0; i<m; i++) {
-	    u[i] = sx[t] + sx[t+1];
-	    v[i] = sx[t] / sx[t+1];
-	    if (sx[t+1] / sx[t] > v[i]) {
-		v[i] = sx[t+1] / sx[t];
+    for (j=0; j<NREPEAT && !err; j+=nt) {
+	int nb = MIN(nt, NREPEAT - j);
+
+	for (b=0; b<nb; b++) {
+	    double *ub = u + (size_t) b * m;
+	    double *vb = v + (size_t) b * m;
+
+	    qsort(sx, 2 * m, sizeof *sx, randomize_doubles);
+	    t = 0;
+	    for (i=0; i<m; i++) {
+		ub[i] = sx[t] + sx[t+1];
+		vb[i] = sx[t] / sx[t+1];
+		if (sx[t+1] / sx[t] > vb[i]) {
+		    vb[i] = sx[t+1] / sx[t];
+		}
+		t += 2;
 	    }
-	    t += 2;
 	}
-	real_kendall_tau(u, v, m, uv, m, NULL, &zj);
-	z += zj;
-#if LOCKE_DEBUG
-	fprintf(stderr, "z[%d] = %g\n", j, zj);
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(b) schedule(static) if (nb > 1) num_threads(nb)
+#endif
+	for (b=0; b<nb; b++) {
+	    size_t off = (size_t) b * m;
+	    int berr;
+
+	    berr = real_kendall_tau(u + off, v + off, m, uv + off, m,
+				    NULL, &zj[j+b]);
+	    if (berr) {
+#if defined(_OPENMP)
+#pragma omp atomic write
 #endif
+		err = berr;
+	    }
+	}
     }
 
-    z /= (double) NREPEAT;
+    if (!err) {
+	/* sum in a fixed order, for reproducibility */
+	z = 0.0;
+	for (j=0; j<NREPEAT; j++) {
+#if LOCKE_DEBUG
+	    fprintf(stderr, "z[%d] = %g\n", j, zj[j]);
+#endif
+	    z += zj[j];
+	}
+	z /= (double) NREPEAT;
+    }
 
 #if LOCKE_DEBUG
     fprintf(stderr, "Kendall's tau: average z = %g\n", z);
@@ -1464,14 +1568,30 @@ static int data_pre_sorted (const gretl_matrix *x)
 
 #define LDEBUG 0
 
+/* For samples of at least LOESS_INTERP_MIN observations (and
+   unless leave-one-out is wanted) the loess fit is computed
+   only at the vertices of a partition of the x-axis, and then
+   interpolated, as in Cleveland and Grosse's "lowesd": the
+   range of x is split at the median recursively until each
+   cell holds no more than LOESS_CELL times the number of
+   points in a local neighborhood, and the fitted values at the
+   data points are obtained by cubic Hermite interpolation of
+   the values and slopes of the local fits at the vertices.
+*/
+
+#define LOESS_INTERP_MIN 10000
+#define LOESS_CELL 0.2
+
 /* convenience struct for passing loess data */
 
 struct loess_info {
     const gretl_matrix *y;
     const gretl_matrix *x;
+    const int *ok;    /* indices of obs with valid y */
     gretl_matrix *Xi;
     gretl_matrix *yi;
     gretl_matrix *wt;
+    gretl_matrix *b;
     int d;
     int n;
     int N;
@@ -1529,23 +1649,18 @@ static int make_robustness_weights (gretl_matrix *rw, int N)
 }
 
 /* Multiply the robustness weights, @rw, into the regular
-   weights, @wt, taking care to register the two vectors
-   (rw is full-length while wt is local), and to skip any
-   missing values in rw.
+   weights, @wt, taking care to register the two vectors:
+   rw is full-length while wt is local, and @ok holds the
+   full-sample indices of the local observations.
 */
 
 static void adjust_weights (const gretl_matrix *rw,
-			    gretl_matrix *wt, int a)
+			    gretl_matrix *wt, const int *ok)
 {
     int k, n = gretl_vector_get_length(wt);
-    int t = a;
 
     for (k=0; k<n; k++) {
-	wt->val[k] *= rw->val[t];
-	if (k < n - 1) {
-	    t++;
-	    while (na(rw->val[t])) t++;
-	}
+	wt->val[k] *= rw->val[ok[k]];
     }
 }
 
@@ -1574,74 +1689,58 @@ static void weight_local_data (struct loess_info *lo)
 #endif
 }
 
-static int next_ok_obs (const double *y, int i)
-{
-    i++;
-    while (na(y[i])) i++;
-    return i;
-}
+/* Assemble the local data for a fit at @x0, which is the
+   x-value of observation @i, or an arbitrary point if @i
+   is negative. On input *@pp is the leftmost possible
+   position in lo->ok for starting to read the n nearest
+   neighbors of x0; on output it's the actual position.
+   Since the window only ever moves rightward, successive
+   calls must have non-decreasing x0.
+*/
 
-static int loess_get_local_data (int i, int *pa,
+static int loess_get_local_data (double x0, int i, int *pp,
 				 struct loess_info *lo,
 				 int *xconst)
 {
     const double *x = lo->x->val;
     const double *y = lo->y->val;
+    const int *ok = lo->ok;
     double xk, xk1, xds, h = 0;
-    int n = lo->n, n_ok = lo->n_ok;
+    int n = lo->n, p = *pp;
     int k_skip = -1;
-    int a, b, k, m, t;
-    int err = 0;
+    int k, t;
 
     gretl_matrix_zero(lo->Xi);
     gretl_matrix_zero(lo->yi);
     gretl_matrix_zero(lo->wt);
 
-    a = *pa;
-
-#if LDEBUG
-    fprintf(stderr, "\ni=%d, a=%d, n_ok=%d\n", i, a, n_ok);
-#endif
-
     /* First determine where we should start reading the
-       neighbors of xi: search rightward from a, so far as
-       this is feasible.
+       neighbors of x0: move the window rightward so long
+       as doing so doesn't increase the max distance.
     */
-
-    while (n_ok > n) {
-	/* find b, the next point that would be included if
-	   we move the neighbor set one place to the right:
-	   start at a+1 and proceed until we have n points
-	   with valid y-values
-	*/
-	for (m=0, b=a+1; ; b++) {
-	    if (!na(y[b]) && ++m == n) {
-		break;
-	    }
-	}
-	if (fabs(x[i] - x[a]) < fabs(x[i] - x[b])) {
-	    /* the max distance increased: get out */
-	    break;
-	}
-	/* shift one (valid) place to the right */
-	a = next_ok_obs(y, a);
-	n_ok--;
+    while (p + n < lo->n_ok &&
+	   fabs(x0 - x[ok[p]]) >= fabs(x0 - x[ok[p+n]])) {
+	p++;
     }
 
     /* record status for next round */
-    *pa = a;
-    lo->n_ok = n_ok;
+    *pp = p;
+
+#if LDEBUG
+    fprintf(stderr, "\nx0=%g, i=%d, p=%d\n", x0, i, p);
+#endif
 
-    /* Having found the starting index for the n nearest neighbors
-       of xi, transcribe the relevant data into Xi and yi. As we
-       go, check whether x is constant in this sub-sample.
+    /* Having found the starting position for the n nearest
+       neighbors of x0, transcribe the relevant data into Xi
+       and yi. As we go, check whether x is constant in this
+       sub-sample.
     */
 
     *xconst = 1;
     xk1 = 0;
-    t = a;
 
     for (k=0; k<n; k++) {
+	t = ok[p+k];
 	if (lo->loo && t == i) {
 	    /* leave-one-out: mark this observation */
 	    k_skip = k;
@@ -1657,22 +1756,13 @@ static int loess_get_local_data (int i, int *pa,
 	    *xconst = 0;
 	}
 	xk1 = xk;
-	if (k < n - 1) {
-	    t = next_ok_obs(y, t);
-	}
     }
 
-#if LDEBUG
-    fprintf(stderr, " -> a=%d, n_ok=%d (xconst = %d)\n",
-	    a, n_ok, *xconst);
-#endif
-
-    if (!err) {
-	/* find the max(abs) distance from xi */
-	double h0 = fabs(x[i] - gretl_matrix_get(lo->Xi, 0, 1));
-	double hn = fabs(x[i] - gretl_matrix_get(lo->Xi, n-1, 1));
-
-	h = (h0 > hn)? h0 : hn;
+    /* find the max(abs) distance from x0 */
+    xds = fabs(x0 - gretl_matrix_get(lo->Xi, 0, 1));
+    h = fabs(x0 - gretl_matrix_get(lo->Xi, n-1, 1));
+    if (xds > h) {
+	h = xds;
     }
 
     /* compute scaled distances and tricube weights */
@@ -1686,14 +1776,14 @@ static int loess_get_local_data (int i, int *pa,
 	if (h == 0.0) {
 	    lo->wt->val[k] = 1.0;
 	} else {
-	    xds = fabs(x[i] - xk) / h;
+	    xds = fabs(x0 - xk) / h;
 	    if (xds < 1.0) {
 		lo->wt->val[k] = pow(1.0 - pow(xds, 3.0), 3.0);
 	    }
 	}
 #if LDEBUG > 1
 	fprintf(stderr, "y=%10g, x=%10g, dist=%10g\n",
-		lo->yi->val[k], xk, fabs(x[i] - xk));
+		lo->yi->val[k], xk, fabs(x0 - xk));
 #endif
     }
 
@@ -1703,25 +1793,316 @@ static int loess_get_local_data (int i, int *pa,
     gretl_matrix_print(lo->wt, "wt");
 #endif
 
+    return 0;
+}
+
+/* Run the local weighted regression for the point @x0 (see
+   loess_get_local_data() for @i and @pp), writing the fitted
+   value into @f and, if @fd is non-NULL, the slope of the
+   local polynomial at x0 into @fd. If @rw is non-NULL it holds
+   robustness weights from a previous round.
+*/
+
+static int loess_local_fit (struct loess_info *lo, double x0,
+			    int i, int *pp, const gretl_matrix *rw,
+			    double *f, double *fd)
+{
+    gretl_matrix *Xi = lo->Xi;
+    gretl_matrix *b = lo->b;
+    int Xic = Xi->cols;
+    int xconst = 0;
+    int err;
+
+    err = loess_get_local_data(x0, i, pp, lo, &xconst);
+    if (err) {
+	return err;
+    }
+
+    if (rw != NULL) {
+	/* We have robustness weights, rw, based on the residuals
+	   from the last round, which should be used to adjust
+	   the wt as computed in loess_get_local_data().
+	*/
+	adjust_weights(rw, lo->wt, lo->ok + *pp);
+    }
+
+    /* apply weights to the local data */
+    weight_local_data(lo);
+
+    if (lo->d == 0 || xconst) {
+	/* not using x in the regressions: mask the x column(s) */
+	gretl_matrix_reuse(Xi, -1, 1);
+	if (b->rows > 1) {
+	    gretl_matrix_reuse(b, 1, 1);
+	}
+    }
+
+    /* run local WLS */
+    err = gretl_matrix_SVD_ols(lo->yi, Xi, b, NULL, NULL, NULL);
+
+    if (!err) {
+	/* evaluate the polynomial, and its slope, at x0 */
+	*f = b->val[0];
+	if (fd != NULL) {
+	    *fd = 0.0;
+	}
+	if (b->rows > 1) {
+	    *f += b->val[1] * x0;
+	    if (fd != NULL) {
+		*fd = b->val[1];
+	    }
+	    if (b->rows == 3) {
+		*f += b->val[2] * x0 * x0;
+		if (fd != NULL) {
+		    *fd += 2 * b->val[2] * x0;
+		}
+	    }
+	}
+    }
+
+    /* ensure matrices are at full size */
+    gretl_matrix_reuse(Xi, -1, Xic);
+    gretl_matrix_reuse(b, lo->d + 1, -1);
+
+    return err;
+}
+
+/* Compute local fits at the @m points in @xe, which must be in
+   non-decreasing order. If @exact is non-zero these are the x
+   values of the data themselves, else arbitrary points. The
+   fitted values go into @f and, if @fd is non-NULL, the slopes
+   into @fd. The points are divided into contiguous blocks, one
+   per thread, each thread having its own workspace.
+*/
+
+static int loess_fit_points (struct loess_info *lo,
+			     const double *xe, int m, int exact,
+			     const gretl_matrix *rw,
+			     double *f, double *fd)
+{
+    /* we need a minimum of two columns in Xi, in order
+       to compute the x-distance based weights */
+    int Xic = (lo->d == 0)? 2 : lo->d + 1;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+    int err = 0;
+
+#if defined(_OPENMP)
+    if (m > 1 && libset_use_openmp((guint64) m * lo->n * Xic)) {
+	nt = get_omp_n_threads();
+	if (nt > m) {
+	    nt = m;
+	}
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	struct loess_info tlo = *lo;
+	gretl_matrix_block *B;
+	int tnum = 0, ntt = 1;
+	int j, j0, j1, p = 0;
+	int terr = 0;
+
+#if defined(_OPENMP)
+	tnum = omp_get_thread_num();
+	ntt = omp_get_num_threads();
+#endif
+	j0 = (int) ((gint64) m * tnum / ntt);
+	j1 = (int) ((gint64) m * (tnum + 1) / ntt);
+
+	B = gretl_matrix_block_new(&tlo.Xi, lo->n, Xic,
+				   &tlo.yi, lo->n, 1,
+				   &tlo.wt, lo->n, 1,
+				   &tlo.b, lo->d + 1, 1,
+				   NULL);
+	if (B == NULL) {
+	    terr = E_ALLOC;
+	}
+
+	for (j=j0; j<j1 && !terr; j++) {
+	    terr = loess_local_fit(&tlo, xe[j], exact ? j : -1, &p, rw,
+				   &f[j], fd == NULL ? NULL : &fd[j]);
+	}
+
+	gretl_matrix_block_destroy(B);
+
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    err = terr;
+	}
+    }
+
     return err;
 }
 
-static int loess_count_usable_obs (const gretl_matrix *y,
-				   int N, int *amin)
+/* Recursively split the cell holding the valid observations at
+   positions @l to @u in the sorted array @xs at its median, until
+   no cell has more than @fc points, appending the cut-points to
+   @v in increasing order. If the median falls within a run of
+   tied values we split at whichever end of the run gives the
+   more even division, so that both parts shrink geometrically
+   however heavily the data are tied.
+*/
+
+static void loess_split_cell (const double *xs, int l, int u,
+			      int fc, double *v, int *nv)
+{
+    double cut;
+    int a, b, m;
+
+    if (u - l + 1 <= fc || xs[u] == xs[l]) {
+	return;
+    }
+
+    m = (l + u) / 2;
+    if (xs[m] == xs[m+1]) {
+	/* find the run of ties, xs[a] to xs[b] */
+	for (a=m; a>l && xs[a-1] == xs[m]; a--) ;
+	for (b=m+1; b<u && xs[b+1] == xs[m]; b++) ;
+	if (a == l) {
+	    m = b;
+	} else if (b == u) {
+	    m = a - 1;
+	} else {
+	    m = (m - a < b - m) ? a - 1 : b;
+	}
+    }
+
+    /* now xs[m] < xs[m+1]: the left cell takes values <= cut */
+    cut = (xs[m] + xs[m+1]) / 2;
+    if (cut >= xs[m+1]) {
+	cut = xs[m];
+    }
+
+    loess_split_cell(xs, l, m, fc, v, nv);
+    if (cut > v[*nv-1]) {
+	v[(*nv)++] = cut;
+    }
+    loess_split_cell(xs, m+1, u, fc, v, nv);
+}
+
+/* The interpolation variant of loess: fit at a set of vertices
+   and interpolate between them, writing the results into @yh.
+*/
+
+static int loess_interpolate (struct loess_info *lo,
+			      const gretl_matrix *rw,
+			      double *yh)
 {
-    int i, n_ok = 0;
+    const double *x = lo->x->val;
+    double *xs, *v, *f, *fd;
+    double h, s, x0, x1;
+    int fc, nv = 0;
+    int i, j, k, err = 0;
+
+    /* workspace for the sorted x values with valid y, and
+       the vertices with the fitted values and slopes */
+    xs = malloc(lo->n_ok * sizeof *xs);
+    v = malloc(3 * (lo->n_ok + 2) * sizeof *v);
+    if (xs == NULL || v == NULL) {
+	free(xs);
+	free(v);
+	return E_ALLOC;
+    }
+    f = v + lo->n_ok + 2;
+    fd = f + lo->n_ok + 2;
 
+    for (i=0; i<lo->n_ok; i++) {
+	xs[i] = x[lo->ok[i]];
+    }
+
+    fc = (int) floor(lo->n * LOESS_CELL);
+    if (fc < 1) {
+	fc = 1;
+    }
+
+    /* the vertices span the full range of x */
+    v[nv++] = x[0];
+    loess_split_cell(xs, 0, lo->n_ok - 1, fc, v, &nv);
+    if (x[lo->N - 1] > v[nv-1]) {
+	v[nv++] = x[lo->N - 1];
+    }
+
+#if LDEBUG
+    fprintf(stderr, "loess: %d vertices for %d points\n", nv, lo->N);
+#endif
+
+    err = loess_fit_points(lo, v, nv, 0, rw, f, fd);
+
+    if (!err && lo->d == 0 && nv > 1) {
+	/* local constant fits carry no slope information: use
+	   differences of the vertex values instead */
+	for (j=0; j<nv; j++) {
+	    i = (j == 0)? 0 : j - 1;
+	    k = (j == nv - 1)? j : j + 1;
+	    fd[j] = (f[k] - f[i]) / (v[k] - v[i]);
+	}
+    }
+
+    if (!err) {
+	/* cubic Hermite interpolation between vertices */
+	j = 0;
+	for (i=0; i<lo->N; i++) {
+	    while (j < nv - 2 && x[i] > v[j+1]) {
+		j++;
+	    }
+	    if (nv == 1 || x[i] == v[j]) {
+		yh[i] = f[j];
+	    } else {
+		x0 = v[j];
+		x1 = v[j+1];
+		h = x1 - x0;
+		s = (x[i] - x0) / h;
+		yh[i] = (1 + 2*s) * (1 - s) * (1 - s) * f[j] +
+		    s * (1 - s) * (1 - s) * h * fd[j] +
+		    s * s * (3 - 2*s) * f[j+1] +
+		    s * s * (s - 1) * h * fd[j+1];
+	    }
+	}
+    }
+
+    free(xs);
+    free(v);
+
+    return err;
+}
+
+/* Returns an array holding the indices of the observations
+   with valid y, or NULL on failure.
+*/
+
+static int *loess_usable_obs (const gretl_matrix *y,
+			      int N, int *n_ok)
+{
+    int *ok;
+    int i;
+
+    *n_ok = 0;
     for (i=0; i<N; i++) {
 	if (!na(y->val[i])) {
-	    if (n_ok == 0) {
-		/* record the first usable obs index */
-		*amin = i;
+	    *n_ok += 1;
+	}
+    }
+
+    if (*n_ok == 0) {
+	return NULL;
+    }
+
+    ok = malloc(*n_ok * sizeof *ok);
+    if (ok != NULL) {
+	*n_ok = 0;
+	for (i=0; i<N; i++) {
+	    if (!na(y->val[i])) {
+		ok[*n_ok] = i;
+		*n_ok += 1;
 	    }
-	    n_ok++;
 	}
     }
 
-    return n_ok;
+    return ok;
 }
 
 /**
@@ -1744,6 +2125,10 @@ static int loess_count_usable_obs (const gretl_matrix *y,
  * error is flagged if this is not the case.  See also
  * sort_pairs_by_x().
  *
+ * For large samples the local fits are computed at a set of
+ * vertices only, and the fitted values at the data points are
+ * obtained by interpolation, as in Cleveland's "lowesd".
+ *
  * Returns: allocated vector containing the loess fitted values, or
  * %NULL on failure.
  */
@@ -1751,13 +2136,12 @@ static int loess_count_usable_obs (const gretl_matrix *y,
 gretl_matrix *loess_fit (const gretl_matrix *x, const gretl_matrix *y,
 			 int d, double q, gretlopt opt, int *err)
 {
-    struct loess_info lo;
-    gretl_matrix_block *B;
-    gretl_matrix *Xi, *yi, *wt, *b;
+    struct loess_info lo = {0};
     gretl_matrix *yh = NULL;
     gretl_matrix *rw = NULL;
     int N = gretl_vector_get_length(y);
-    int k, iters, Xic, amin = 0;
+    int *ok = NULL;
+    int k, iters;
     int n_ok, robust = 0, loo = 0;
     int i, n;
 
@@ -1773,9 +2157,10 @@ gretl_matrix *loess_fit (const gretl_matrix *x, const gretl_matrix *y,
     }
 
     /* check for usable data points */
-    n_ok = loess_count_usable_obs(y, N, &amin);
+    ok = loess_usable_obs(y, N, &n_ok);
     if (n_ok < 4) {
-	*err = E_TOOFEW;
+	*err = (n_ok > 0 && ok == NULL)? E_ALLOC : E_TOOFEW;
+	free(ok);
 	return NULL;
     }
 
@@ -1792,20 +2177,6 @@ gretl_matrix *loess_fit (const gretl_matrix *x, const gretl_matrix *y,
     /* set the local sub-sample size */
     n = (int) ceil(q * n_ok);
 
-    /* we need a minimum of two columns in Xi, in order
-       to compute the x-distance based weights */
-    Xic = (d == 0)? 2 : d + 1;
-
-    B = gretl_matrix_block_new(&Xi, n, Xic,
-			       &yi, n, 1,
-			       &wt, n, 1,
-			       &b, d+1, 1,
-			       NULL);
-    if (B == NULL) {
-	*err = E_ALLOC;
-	return NULL;
-    }
-
     /* vector to hold the fitted values */
     yh = gretl_column_vector_alloc(N);
     if (yh == NULL) {
@@ -1826,92 +2197,45 @@ gretl_matrix *loess_fit (const gretl_matrix *x, const gretl_matrix *y,
 	iters = 1;
     }
 
-    /* fill out the convenience struct */
+    /* fill out the convenience struct (the workspace
+       matrices are allocated per thread) */
     lo.y = y;
     lo.x = x;
-    lo.Xi = Xi;
-    lo.yi = yi;
-    lo.wt = wt;
+    lo.ok = ok;
     lo.d = d;
     lo.n = n;
     lo.N = N;
+    lo.n_ok = n_ok;
     lo.loo = loo;
 
     for (k=0; k<iters && !*err; k++) {
 	/* iterations for robustness, if wanted */
-	int a = amin;
-
-	lo.n_ok = n_ok;
-
-	for (i=0; i<N && !*err; i++) {
-	    /* iterate across points in full sample */
-	    double xi = x->val[i];
-	    int xconst = 0;
+	const gretl_matrix *rwk = (k > 0)? rw : NULL;
 
-	    /* a is the leftmost possible index for starting to
-	       read the n nearest neighbors of xi.
-	    */
-	    *err = loess_get_local_data(i, &a, &lo, &xconst);
-	    if (*err) {
-		break;
-	    }
-
-	    if (k > 0) {
-		/* We have robustness weights, rw, based on the residuals
-		   from the last round, which should be used to adjust
-		   the wt as computed in loess_get_local_data().
-		*/
-		adjust_weights(rw, wt, a);
-	    }
-
-	    /* apply weights to the local data */
-	    weight_local_data(&lo);
-
-	    if (d == 0 || xconst) {
-		/* not using x in the regressions: mask the x column(s) */
-		gretl_matrix_reuse(Xi, -1, 1);
-		if (b->rows > 1) {
-		    gretl_matrix_reuse(b, 1, 1);
-		}
-	    }
+	if (N >= LOESS_INTERP_MIN && !loo) {
+	    *err = loess_interpolate(&lo, rwk, yh->val);
+	} else {
+	    *err = loess_fit_points(&lo, x->val, N, 1, rwk,
+				    yh->val, NULL);
+	}
 
-	    /* run local WLS */
-	    *err = gretl_matrix_SVD_ols(yi, Xi, b, NULL, NULL, NULL);
-
-	    if (!*err) {
-		/* yh: evaluate the polynomial at xi */
-		yh->val[i] = b->val[0];
-		if (b->rows > 1) {
-		    yh->val[i] += b->val[1] * xi;
-		    if (b->rows == 3) {
-			yh->val[i] += b->val[2] * xi * xi;
-		    }
-		}
-		if (robust && k < iters - 1) {
-		    /* save residual for robustness weights */
-		    if (na(y->val[i])) {
-			rw->val[i] = NADBL;
-		    } else {
-			rw->val[i] = y->val[i] - yh->val[i];
-		    }
+	if (!*err && robust && k < iters - 1) {
+	    /* save residuals for robustness weights */
+	    for (i=0; i<N; i++) {
+		if (na(y->val[i])) {
+		    rw->val[i] = NADBL;
+		} else {
+		    rw->val[i] = y->val[i] - yh->val[i];
 		}
 	    }
-
-	    /* ensure matrices are at full size */
-	    gretl_matrix_reuse(Xi, -1, Xic);
-	    gretl_matrix_reuse(b, d+1, -1);
-
-	} /* end loop over sample */
-
-	if (!*err && robust && k < iters - 1) {
 	    *err = make_robustness_weights(rw, N);
 	}
     } /* end robustness iterations */
 
  bailout:
 
-    gretl_matrix_block_destroy(B);
     gretl_matrix_free(rw);
+    free(ok);
 
     if (*err) {
 	gretl_matrix_free(yh);
@@ -522,6 +522,24 @@ int gretl_rand_normal_full (double *a, int t1, int t2,
     return 0;
 }
 
+/* Return the predecessor of the greatest multiple of @dist
+   less than or equal to 2^32, for use in rejection sampling
+   of integers in the range [0, dist-1]
+*/
+
+static guint32 range_maxval (guint32 dist)
+{
+    if (dist <= 0x80000000u) { /* 2^31 */
+	/* maxval = 2^32 - 1 - (2^32 % dist) */
+	guint32 rem = (0x80000000u % dist) * 2;
+
+	if (rem >= dist) rem -= dist;
+	return 0xffffffffu - rem;
+    } else {
+	return dist - 1;
+    }
+}
+
 static guint32 mt_int_range (guint32 begin,
 			     guint32 end,
 			     int alt)
@@ -530,20 +548,7 @@ static guint32 mt_int_range (guint32 begin,
     guint32 rval = 0;
 
     if (dist > 0) {
-	/* maxval is set to the predecessor of the greatest
-	   multiple of dist less than or equal to 2^32
-	*/
-	guint32 maxval;
-
-	if (dist <= 0x80000000u) { /* 2^31 */
-	    /* maxval = 2^32 - 1 - (2^32 % dist) */
-	    guint32 rem = (0x80000000u % dist) * 2;
-
-	    if (rem >= dist) rem -= dist;
-	    maxval = 0xffffffffu - rem;
-	} else {
-	    maxval = dist - 1;
-	}
+	guint32 maxval = range_maxval(dist);
 
 	if (use_dcmt) {
 	    do {
@@ -1466,6 +1471,106 @@ unsigned int gretl_alt_rand_int (void)
     return sfmt_alt_rand32();
 }
 
+/* Independent generators, for use when random draws are wanted
+   within parallelized code: each thread should have its own
+   stream. The SFMT state may require 16-byte alignment, which
+   malloc does not guarantee on all platforms, hence the extra
+   bytes in the allocation.
+*/
+
+struct gretl_rand_stream_ {
+    void *mem;
+    sfmt_t *sfmt;
+};
+
+/**
+ * gretl_rand_stream_new:
+ * @seed: seed for the new stream.
+ *
+ * Allocates an SFMT generator which is independent of the
+ * libgretl PRNG proper, and which can therefore be used
+ * safely within a thread while other threads use their own
+ * streams. Note that the state of the main generator is not
+ * touched.
+ *
+ * Returns: newly allocated stream, or NULL on failure.
+ */
+
+gretl_rand_stream *gretl_rand_stream_new (unsigned int seed)
+{
+    gretl_rand_stream *s = malloc(sizeof *s);
+
+    if (s != NULL) {
+	s->mem = malloc(sizeof(sfmt_t) + 16);
+	if (s->mem == NULL) {
+	    free(s);
+	    s = NULL;
+	} else {
+	    guintptr a = ((guintptr) s->mem + 15) & ~((guintptr) 15);
+
+	    s->sfmt = (sfmt_t *) a;
+	    sfmt_init_gen_rand(s->sfmt, seed);
+	}
+    }
+
+    return s;
+}
+
+/**
+ * gretl_rand_stream_set_seed:
+ * @s: stream.
+ * @seed: the chosen seed value.
+ *
+ * Re-initializes the stream @s using @seed.
+ */
+
+void gretl_rand_stream_set_seed (gretl_rand_stream *s,
+				 unsigned int seed)
+{
+    sfmt_init_gen_rand(s->sfmt, seed);
+}
+
+/**
+ * gretl_rand_stream_int_max:
+ * @s: stream.
+ * @max: the maximum value (open)
+ *
+ * Returns: a pseudo-random unsigned int in the interval
+ * [0, max-1], drawn from @s.
+ */
+
+unsigned int gretl_rand_stream_int_max (gretl_rand_stream *s,
+					unsigned int max)
+{
+    guint32 rval = 0;
+
+    if (max > 0) {
+	guint32 maxval = range_maxval(max);
+
+	do {
+	    rval = sfmt_genrand_uint32(s->sfmt);
+	} while (rval > maxval);
+	rval %= max;
+    }
+
+    return rval;
+}
+
+/**
+ * gretl_rand_stream_free:
+ * @s: stream.
+ *
+ * Frees the stream @s.
+ */
+
+void gretl_rand_stream_free (gretl_rand_stream *s)
+{
+    if (s != NULL) {
+	free(s->mem);
+	free(s);
+    }
+}
+
 static double halton (int i, int base)
 {
     double f = 1.0 / base;
@@ -102,6 +102,18 @@ gretl_matrix *inverse_wishart_sequence (const gretl_matrix *S,
 					int v, int replics, 
 					int *err);
 
+typedef struct gretl_rand_stream_ gretl_rand_stream;
+
+gretl_rand_stream *gretl_rand_stream_new (unsigned int seed);
+
+void gretl_rand_stream_set_seed (gretl_rand_stream *s,
+				 unsigned int seed);
+
+unsigned int gretl_rand_stream_int_max (gretl_rand_stream *s,
+					unsigned int max);
+
+void gretl_rand_stream_free (gretl_rand_stream *s);
+
 unsigned int gretl_rand_get_seed (void);
 
 int gretl_rand_set_dcmt (int s);
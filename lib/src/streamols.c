@@ -0,0 +1,1322 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* streamols.c: OLS and WLS on data read from file in chunks, for
+   datasets too large to be loaded into memory. Only the moment
+   matrices (or a triangular factor) are held in memory, so the
+   memory requirement does not depend on the number of
+   observations.
+*/
+
+#include "libgretl.h"
+#include "libset.h"
+#include "matrix_extra.h"
+#include "gretl_xml.h"
+#include "gretl_zip.h"
+#include "swap_bytes.h"
+#include "streamols.h"
+
+#include <errno.h>
+
+#define OLS_CHUNK 65536   /* default number of rows per chunk */
+#define BIN_HDRLEN 24     /* length of header on gretl binary data */
+#define ESSZERO 1e-22     /* SSR less than this counts as zero */
+
+#ifdef WIN32
+# define ols_fseek(f,o) _fseeki64(f,o,SEEK_SET)
+# define ols_fsize(f) (_fseeki64(f,0,SEEK_END) ? -1 : _ftelli64(f))
+#else
+# define ols_fseek(f,o) fseeko(f,(off_t) (o),SEEK_SET)
+# define ols_fsize(f) (fseeko(f,0,SEEK_END) ? -1 : (gint64) ftello(f))
+#endif
+
+enum {
+    SRC_CSV,
+    SRC_GDTB
+};
+
+typedef struct ols_source_ ols_source;
+typedef struct ols_info_ ols_info;
+
+/* a data file opened for reading by chunks */
+
+struct ols_source_ {
+    int type;         /* SRC_CSV or SRC_GDTB */
+    FILE *fp;         /* the data file */
+    int nwant;        /* number of columns wanted */
+    int *pos;         /* positions of the wanted columns in the file */
+    int strcol;       /* CSV: column (in wanted order) that may be
+			 string-valued, or -1 */
+    GHashTable *sht;  /* CSV: codes for string values in @strcol */
+    char delim;       /* CSV: column separator */
+    char *line;       /* CSV: line buffer */
+    int linelen;      /* CSV: size of line buffer */
+    char **fields;    /* CSV: pointers into the current line */
+    int nf;           /* CSV: number of fields in header */
+    gint64 T;         /* gdtb: observations per series */
+    gint64 t;         /* gdtb: next observation to read */
+    int swap;         /* gdtb: reverse byte order? */
+    gchar *zdir;      /* gdtb: temporary directory */
+};
+
+/* specification of the regression */
+
+struct ols_info_ {
+    int k;            /* number of regressors */
+    int k1;           /* k + 1 (regressors plus y) */
+    int *xpos;        /* columns of regressors in chunk, or -1 for const */
+    int ycol;         /* column of dependent variable in chunk */
+    int wcol;         /* column of weight variable, or -1 */
+    int ccol;         /* column of cluster variable, or -1 */
+};
+
+static void ols_source_destroy (ols_source *src)
+{
+    if (src == NULL) {
+	return;
+    }
+
+    if (src->fp != NULL) {
+	fclose(src->fp);
+    }
+    if (src->zdir != NULL) {
+	gretl_deltree(src->zdir);
+	g_free(src->zdir);
+    }
+    if (src->sht != NULL) {
+	g_hash_table_destroy(src->sht);
+    }
+
+    free(src->pos);
+    free(src->line);
+    free(src->fields);
+    free(src);
+}
+
+/* Read a line of arbitrary length into src->line, trimming any
+   trailing newline. Returns 1 if a line was read, 0 at end of
+   file, or -1 on allocation failure.
+*/
+
+static int csv_read_line (ols_source *src)
+{
+    int n;
+
+    if (fgets(src->line, src->linelen, src->fp) == NULL) {
+	return 0;
+    }
+
+    n = strlen(src->line);
+
+    while (n == src->linelen - 1 && src->line[n-1] != '\n') {
+	char *tmp = realloc(src->line, 2 * src->linelen);
+
+	if (tmp == NULL) {
+	    return -1;
+	}
+	src->line = tmp;
+	src->linelen *= 2;
+	if (fgets(src->line + n, src->linelen - n, src->fp) == NULL) {
+	    break;
+	}
+	n += strlen(src->line + n);
+    }
+
+    while (n > 0 && (src->line[n-1] == '\n' || src->line[n-1] == '\r')) {
+	src->line[--n] = '\0';
+    }
+
+    return 1;
+}
+
+static int is_csv_sep (char c, char delim)
+{
+    return c == delim || (delim == ' ' && c == '\t');
+}
+
+/* Split @s in place into at most @maxf fields separated by @delim,
+   stripping double quotes. If @delim is a space, runs of white
+   space count as a single separator.
+*/
+
+static int csv_split_line (char *s, char delim, char **fields,
+			   int maxf)
+{
+    int nf = 0;
+
+    while (nf < maxf) {
+	if (delim == ' ') {
+	    s += strspn(s, " \t");
+	    if (*s == '\0') {
+		break;
+	    }
+	}
+	if (*s == '"') {
+	    fields[nf++] = ++s;
+	    s += strcspn(s, "\"");
+	    if (*s == '"') {
+		*s++ = '\0';
+	    }
+	    while (*s != '\0' && !is_csv_sep(*s, delim)) {
+		s++;
+	    }
+	} else {
+	    fields[nf++] = s;
+	    while (*s != '\0' && !is_csv_sep(*s, delim)) {
+		s++;
+	    }
+	}
+	if (*s == '\0') {
+	    break;
+	}
+	*s++ = '\0';
+    }
+
+    return nf;
+}
+
+static char csv_guess_delim (const char *s)
+{
+    int nc = 0, nt = 0, ns = 0;
+    int quoted = 0;
+
+    for ( ; *s; s++) {
+	if (*s == '"') {
+	    quoted = !quoted;
+	} else if (!quoted) {
+	    nc += (*s == ',');
+	    nt += (*s == '\t');
+	    ns += (*s == ';');
+	}
+    }
+
+    if (nc == 0 && nt == 0 && ns == 0) {
+	return ' ';
+    } else if (nc >= nt && nc >= ns) {
+	return ',';
+    } else {
+	return (nt >= ns)? '\t' : ';';
+    }
+}
+
+static double csv_value (ols_source *src, const char *s, int j)
+{
+    char *test;
+    double x;
+
+    s += strspn(s, " ");
+
+    if (*s == '\0' || !strcmp(s, "NA") || !strcmp(s, "na") ||
+	!strcmp(s, ".") || !strcmp(s, "NaN") || !strcmp(s, "nan")) {
+	return NADBL;
+    }
+
+    errno = 0;
+    x = strtod(s, &test);
+    test += strspn(test, " ");
+
+    if (*test == '\0' && errno != ERANGE) {
+	return x;
+    } else if (j == src->strcol) {
+	/* string-valued cluster identifier: code the values */
+	gpointer p = g_hash_table_lookup(src->sht, s);
+
+	if (p == NULL) {
+	    p = GINT_TO_POINTER(g_hash_table_size(src->sht) + 1);
+	    g_hash_table_insert(src->sht, g_strdup(s), p);
+	}
+	return (double) GPOINTER_TO_INT(p);
+    } else {
+	return NADBL;
+    }
+}
+
+static int find_wanted_columns (ols_source *src, char **fnames,
+				int nf, char **want)
+{
+    int i, j;
+
+    for (j=0; j<src->nwant; j++) {
+	src->pos[j] = -1;
+	for (i=0; i<nf; i++) {
+	    if (!strcmp(fnames[i], want[j])) {
+		src->pos[j] = i;
+		break;
+	    }
+	}
+	if (src->pos[j] < 0) {
+	    gretl_errmsg_sprintf(_("%s: no such column"), want[j]);
+	    return E_UNKVAR;
+	}
+    }
+
+    return 0;
+}
+
+static int csv_source_open (ols_source *src, const char *fname,
+			    char **want)
+{
+    char **fnames;
+    int i, n, err = 0;
+
+    src->fp = gretl_fopen(fname, "r");
+    if (src->fp == NULL) {
+	return E_FOPEN;
+    }
+
+    src->linelen = 8192;
+    src->line = malloc(src->linelen);
+    if (src->line == NULL) {
+	return E_ALLOC;
+    }
+
+    n = csv_read_line(src);
+    if (n <= 0) {
+	gretl_errmsg_set(_("No data were found"));
+	return (n < 0)? E_ALLOC : E_DATA;
+    }
+
+    src->delim = csv_guess_delim(src->line);
+
+    /* one field per separator, plus one */
+    src->nf = 1;
+    for (i=0; src->line[i]; i++) {
+	src->nf += (src->line[i] != ' ' && is_csv_sep(src->line[i], src->delim));
+    }
+    if (src->delim == ' ') {
+	src->nf = strlen(src->line) / 2 + 1;
+    }
+
+    /* allow one extra field so that any surplus on a data line
+       is kept out of the last wanted field */
+    src->fields = malloc((src->nf + 1) * sizeof *src->fields);
+    if (src->fields == NULL) {
+	return E_ALLOC;
+    }
+
+    n = csv_split_line(src->line, src->delim, src->fields, src->nf);
+    fnames = src->fields;
+
+    for (i=0; i<n; i++) {
+	g_strstrip(fnames[i]);
+    }
+
+    err = find_wanted_columns(src, fnames, n, want);
+    src->nf = n;
+
+    return err;
+}
+
+static int gdtb_check_header (ols_source *src)
+{
+    char hdr[BIN_HDRLEN] = {0};
+    int order = 0;
+
+    if (fread(hdr, 1, BIN_HDRLEN, src->fp) == BIN_HDRLEN &&
+	!strncmp(hdr, "gretl-bin:", 10)) {
+	if (!strcmp(hdr + 10, "little-endian")) {
+	    order = G_LITTLE_ENDIAN;
+	} else if (!strcmp(hdr + 10, "big-endian")) {
+	    order = G_BIG_ENDIAN;
+	}
+    }
+
+    if (order == 0) {
+	gretl_errmsg_set("Error reading binary data file");
+	return E_DATA;
+    }
+
+    src->swap = (order != G_BYTE_ORDER);
+
+    return 0;
+}
+
+/* The binary payload of a .gdtb file holds the series one after
+   the other, so we unzip it and read each wanted series by
+   seeking to the current chunk.
+*/
+
+static int gdtb_source_open (ols_source *src, const char *fname,
+			     char **want)
+{
+    char path[FILENAME_MAX];
+    char **vnames = NULL;
+    int nv = 0, T = 0;
+    int err;
+
+    /* unzip into a private directory, so that concurrent calls
+       (e.g. under MPI) don't clobber each other */
+    src->zdir = g_strdup_printf("%solsfile-XXXXXX", gretl_dotdir());
+    if (g_mkdtemp(src->zdir) == NULL) {
+	gretl_errmsg_sprintf("%s: %s", src->zdir, g_strerror(errno));
+	g_free(src->zdir);
+	src->zdir = NULL;
+	err = E_FOPEN;
+    } else {
+	err = 0;
+    }
+
+    if (!err) {
+	err = gretl_unzip_into(fname, src->zdir);
+	if (err) {
+	    gretl_errmsg_ensure("Problem opening data file");
+	}
+    }
+
+    if (!err) {
+	gretl_build_path(path, src->zdir, "data.xml", NULL);
+	err = gretl_read_gdt_varnames(path, &vnames, &nv);
+    }
+
+    if (!err) {
+	/* with skip-padding this is the number of rows stored,
+	   and the unit and time indices are among @vnames */
+	err = gretl_read_gdt_nobs(path, &T);
+    }
+
+    if (!err) {
+	gretl_build_path(path, src->zdir, "data.bin", NULL);
+	src->fp = gretl_fopen(path, "rb");
+	if (src->fp == NULL) {
+	    err = E_FOPEN;
+	}
+    }
+
+    if (!err) {
+	err = gdtb_check_header(src);
+    }
+
+    if (!err) {
+	/* check the payload against the header */
+	gint64 sz = ols_fsize(src->fp) - BIN_HDRLEN;
+
+	src->T = T;
+	if (nv < 2 || sz != (gint64) (nv - 1) * T * sizeof(double)) {
+	    gretl_errmsg_set("Error reading binary data file");
+	    err = E_DATA;
+	}
+    }
+
+    if (!err) {
+	/* skip "const" at position 0 */
+	err = find_wanted_columns(src, vnames + 1, nv - 1, want);
+    }
+
+    strings_array_free(vnames, nv);
+
+    return err;
+}
+
+static ols_source *ols_source_open (const char *fname, char **want,
+				    int nwant, int strcol, int *err)
+{
+    ols_source *src = calloc(1, sizeof *src);
+
+    if (src == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    src->nwant = nwant;
+    src->strcol = -1;
+    src->pos = malloc(nwant * sizeof *src->pos);
+
+    if (src->pos == NULL) {
+	*err = E_ALLOC;
+    } else if (has_suffix(fname, ".gdtb")) {
+	src->type = SRC_GDTB;
+	*err = gdtb_source_open(src, fname, want);
+    } else if (has_suffix(fname, ".gdt")) {
+	gretl_errmsg_set(_("Please save the data in binary (.gdtb) "
+			   "or CSV format"));
+	*err = E_DATA;
+    } else {
+	src->type = SRC_CSV;
+	if (strcol >= 0) {
+	    src->strcol = strcol;
+	    src->sht = g_hash_table_new_full(g_str_hash, g_str_equal,
+					     g_free, NULL);
+	}
+	*err = csv_source_open(src, fname, want);
+    }
+
+    if (*err) {
+	ols_source_destroy(src);
+	src = NULL;
+    }
+
+    return src;
+}
+
+static int ols_source_rewind (ols_source *src)
+{
+    if (src->type == SRC_GDTB) {
+	src->t = 0;
+	return 0;
+    } else {
+	/* reposition past the header line */
+	rewind(src->fp);
+	return csv_read_line(src) > 0 ? 0 : E_DATA;
+    }
+}
+
+/* Read up to D->rows observations on the wanted columns into @D.
+   Returns the number of rows read, which is 0 at end of data.
+*/
+
+static int ols_source_read (ols_source *src, gretl_matrix *D,
+			    int *err)
+{
+    int i, j, n = 0;
+
+    if (src->type == SRC_GDTB) {
+	gint64 left = src->T - src->t;
+	double *x;
+
+	n = (left < D->rows)? (int) left : D->rows;
+
+	for (j=0; j<src->nwant && n > 0 && !*err; j++) {
+	    gint64 off = BIN_HDRLEN + 8 * (src->pos[j] * src->T + src->t);
+
+	    x = D->val + j * D->rows;
+	    if (ols_fseek(src->fp, off) != 0 ||
+		fread(x, sizeof *x, n, src->fp) != n) {
+		gretl_errmsg_set("Error reading binary data file");
+		*err = E_DATA;
+	    }
+	    for (i=0; i<n && !*err; i++) {
+		if (src->swap) {
+		    reverse_double(x[i]);
+		}
+		if (x[i] == DBL_MAX) {
+		    /* old-style NA */
+		    x[i] = NADBL;
+		}
+	    }
+	}
+	src->t += n;
+    } else {
+	int m, r;
+
+	while (n < D->rows && !*err) {
+	    r = csv_read_line(src);
+	    if (r < 0) {
+		*err = E_ALLOC;
+	    } else if (r == 0) {
+		break;
+	    } else if (src->line[strspn(src->line, " \t")] == '\0') {
+		/* skip blank line */
+		continue;
+	    }
+	    if (*err) {
+		break;
+	    }
+	    m = csv_split_line(src->line, src->delim, src->fields,
+			       src->nf + 1);
+	    for (j=0; j<src->nwant; j++) {
+		i = src->pos[j];
+		D->val[j * D->rows + n] = (i < m) ?
+		    csv_value(src, src->fields[i], j) : NADBL;
+	    }
+	    n++;
+	}
+    }
+
+    return n;
+}
+
+/* Record in @ok the rows of the first @nd in @D that are usable:
+   all wanted values present and weight (if any) positive.
+*/
+
+static int ols_usable_rows (const gretl_matrix *D, int nd,
+			    const ols_info *oi, int *ok, int *err)
+{
+    double w;
+    int i, j, skip, nr = 0;
+
+    for (i=0; i<nd; i++) {
+	skip = 0;
+	for (j=0; j<D->cols && !skip; j++) {
+	    skip = na(D->val[j * D->rows + i]);
+	}
+	if (!skip && oi->wcol >= 0) {
+	    w = D->val[oi->wcol * D->rows + i];
+	    if (w < 0.0) {
+		gretl_errmsg_set(_("Weight variable contains negative values"));
+		*err = E_DATA;
+		return 0;
+	    }
+	    skip = (w == 0.0);
+	}
+	if (!skip) {
+	    ok[nr++] = i;
+	}
+    }
+
+    return nr;
+}
+
+/* Write the (weighted) regressors and dependent variable for
+   the usable rows of @D into rows @r0 onward of @C.
+*/
+
+static void ols_fill_rows (const gretl_matrix *D, const int *ok,
+			   int nr, const ols_info *oi,
+			   gretl_matrix *C, int r0)
+{
+    double x, sw = 1.0;
+    int i, j, t;
+
+    for (i=0; i<nr; i++) {
+	t = ok[i];
+	if (oi->wcol >= 0) {
+	    sw = sqrt(D->val[oi->wcol * D->rows + t]);
+	}
+	for (j=0; j<oi->k; j++) {
+	    if (oi->xpos[j] < 0) {
+		x = 1.0;
+	    } else {
+		x = D->val[oi->xpos[j] * D->rows + t];
+	    }
+	    gretl_matrix_set(C, r0 + i, j, sw * x);
+	}
+	x = D->val[oi->ycol * D->rows + t];
+	gretl_matrix_set(C, r0 + i, oi->k, sw * x);
+    }
+}
+
+/* per-cluster cumulator for clustered standard errors */
+
+typedef struct {
+    double key;
+    double s[1]; /* actually k values */
+} csum;
+
+static int cluster_add (GHashTable *ht, double key,
+			const double *v, int k)
+{
+    csum *c = g_hash_table_lookup(ht, &key);
+    int j;
+
+    if (c == NULL) {
+	c = calloc(1, sizeof *c + (k - 1) * sizeof(double));
+	if (c == NULL) {
+	    return E_ALLOC;
+	}
+	c->key = key;
+	g_hash_table_insert(ht, &c->key, c);
+    }
+
+    for (j=0; j<k; j++) {
+	c->s[j] += v[j];
+    }
+
+    return 0;
+}
+
+/* Second pass through the data, to form the "meat" of the
+   HCCME or cluster-robust variance matrix.
+*/
+
+static int ols_robust_pass (ols_source *src, const ols_info *oi,
+			    gretl_matrix *D, gretl_matrix *C,
+			    int *ok, const gretl_matrix *b,
+			    const gretl_matrix *Ri, int hc,
+			    gretl_matrix *W, int *ncl)
+{
+    GHashTable *ht = NULL;
+    double *xu = NULL;
+    int k = oi->k;
+    int nd, nr, i, j, l;
+    double u, h, q, f;
+    int err;
+
+    err = ols_source_rewind(src);
+    if (err) {
+	return err;
+    }
+
+    if (oi->ccol >= 0) {
+	ht = g_hash_table_new_full(g_double_hash, g_double_equal,
+				   NULL, free);
+	xu = malloc(k * sizeof *xu);
+	if (xu == NULL) {
+	    g_hash_table_destroy(ht);
+	    return E_ALLOC;
+	}
+    }
+
+    gretl_matrix_zero(W);
+
+    while (!err && (nd = ols_source_read(src, D, &err)) > 0) {
+	nr = ols_usable_rows(D, nd, oi, ok, &err);
+	if (err || nr == 0) {
+	    continue;
+	}
+	gretl_matrix_reuse(C, nr, oi->k1);
+	ols_fill_rows(D, ok, nr, oi, C, 0);
+
+	for (i=0; i<nr && !err; i++) {
+	    u = gretl_matrix_get(C, i, k);
+	    for (j=0; j<k; j++) {
+		u -= gretl_matrix_get(C, i, j) * b->val[j];
+	    }
+	    f = u;
+	    if (hc > 1 && ht == NULL) {
+		/* leverage: x_t' (X'X)^{-1} x_t = |Ri' x_t|^2 */
+		h = 0.0;
+		for (j=0; j<k; j++) {
+		    q = 0.0;
+		    for (l=0; l<=j; l++) {
+			q += gretl_matrix_get(C, i, l) *
+			    gretl_matrix_get(Ri, l, j);
+		    }
+		    h += q * q;
+		}
+		f = (hc == 2)? u / sqrt(1.0 - h) : u / (1.0 - h);
+	    }
+	    if (ht != NULL) {
+		for (j=0; j<k; j++) {
+		    xu[j] = gretl_matrix_get(C, i, j) * u;
+		}
+		err = cluster_add(ht, D->val[oi->ccol * D->rows + ok[i]],
+				  xu, k);
+	    } else {
+		for (j=0; j<k; j++) {
+		    C->val[j * nr + i] *= f;
+		}
+	    }
+	}
+
+	if (!err && ht == NULL) {
+	    /* the scaled regressors occupy the first k columns */
+	    gretl_matrix_reuse(C, nr, k);
+	    gretl_matrix_multiply_mod(C, GRETL_MOD_TRANSPOSE,
+				      C, GRETL_MOD_NONE,
+				      W, GRETL_MOD_CUMULATE);
+	}
+    }
+
+    if (!err && ht != NULL) {
+	GHashTableIter iter;
+	gpointer key, val;
+
+	g_hash_table_iter_init(&iter, ht);
+	while (g_hash_table_iter_next(&iter, &key, &val)) {
+	    csum *c = val;
+
+	    for (i=0; i<k; i++) {
+		for (j=0; j<k; j++) {
+		    W->val[j * k + i] += c->s[i] * c->s[j];
+		}
+	    }
+	}
+	*ncl = g_hash_table_size(ht);
+    }
+
+    if (ht != NULL) {
+	g_hash_table_destroy(ht);
+    }
+    free(xu);
+
+    return err;
+}
+
+/* Wald-type F-test for the slope coefficients, based on a
+   robust variance matrix */
+
+static double robust_ftest (const MODEL *pmod, const ols_info *oi,
+			    const gretl_matrix *V)
+{
+    gretl_matrix *Vs, *bs;
+    int i, j, ii, jj, m = pmod->dfn;
+    double F = NADBL;
+    int err = 0;
+
+    if (m < 1) {
+	return NADBL;
+    }
+
+    Vs = gretl_matrix_alloc(m, m);
+    bs = gretl_column_vector_alloc(m);
+
+    if (Vs != NULL && bs != NULL) {
+	for (i=0, ii=0; i<oi->k; i++) {
+	    if (oi->xpos[i] < 0) {
+		continue;
+	    }
+	    bs->val[ii] = pmod->coeff[i];
+	    for (j=0, jj=0; j<oi->k; j++) {
+		if (oi->xpos[j] >= 0) {
+		    gretl_matrix_set(Vs, ii, jj++, gretl_matrix_get(V, i, j));
+		}
+	    }
+	    ii++;
+	}
+	err = gretl_invert_symmetric_matrix(Vs);
+	if (!err) {
+	    F = gretl_scalar_qform(bs, Vs, &err) / m;
+	}
+    }
+
+    gretl_matrix_free(Vs);
+    gretl_matrix_free(bs);
+
+    return err ? NADBL : F;
+}
+
+/* On input @R holds the cross-products of [X y], with X having
+   @k columns; on output it holds the upper Cholesky factor of
+   that matrix. The factorization is done for X'X and extended
+   by hand to the last column, so that a perfect fit, which makes
+   [X y]'[X y] singular, gives a zero in the bottom right-hand
+   corner (as with QR) rather than failure.
+*/
+
+static int xy_cholesky (gretl_matrix *R, int k)
+{
+    gretl_matrix *L = gretl_matrix_alloc(k, k);
+    double x, ssr;
+    int i, j;
+
+    if (L == NULL) {
+	return E_ALLOC;
+    }
+
+    for (j=0; j<k; j++) {
+	for (i=0; i<k; i++) {
+	    gretl_matrix_set(L, i, j, gretl_matrix_get(R, i, j));
+	}
+    }
+
+    if (gretl_matrix_cholesky_decomp(L)) {
+	gretl_matrix_free(L);
+	return E_SINGULAR;
+    }
+
+    /* solve L r = X'y, and get y'y - r'r */
+    ssr = gretl_matrix_get(R, k, k);
+    for (i=0; i<k; i++) {
+	x = gretl_matrix_get(R, i, k);
+	for (j=0; j<i; j++) {
+	    x -= gretl_matrix_get(L, i, j) * gretl_matrix_get(R, j, k);
+	}
+	x /= gretl_matrix_get(L, i, i);
+	gretl_matrix_set(R, i, k, x);
+	ssr -= x * x;
+    }
+
+    for (j=0; j<k; j++) {
+	for (i=0; i<=k; i++) {
+	    x = (i <= j)? gretl_matrix_get(L, j, i) : 0.0;
+	    gretl_matrix_set(R, i, j, x);
+	}
+    }
+    gretl_matrix_set(R, k, k, ssr > 0 ? sqrt(ssr) : 0.0);
+
+    gretl_matrix_free(L);
+
+    return 0;
+}
+
+/* Estimate a linear regression by least squares, reading the
+   data from @fname (CSV or gretl binary, .gdtb) chunk by chunk,
+   so that the memory required does not depend on the number of
+   observations. @vnames holds the dependent variable followed by
+   the regressors, where "const" stands for an intercept; @wname
+   and @cname optionally name a weight series for WLS and a
+   cluster series; @chunk gives the number of rows to read at a
+   time (0 for the default).
+
+   Observations with missing values for any of the series named,
+   or a weight of zero, are skipped. Either X'X and X'y are
+   cumulated and solved via Cholesky, or (if @opt includes OPT_Q
+   or the "force_qr" setting is on) the triangular factor R from
+   the QR decomposition of [X y] is updated chunk by chunk.
+
+   If robust standard errors are wanted (OPT_R), or @cname is
+   given, the data are read a second time to compute the required
+   "meat" matrix: in the clustered case memory use is proportional
+   to the number of clusters.
+
+   Since the data are not in the current dataset the returned
+   model has no list, residual or fitted-value series: the
+   parameters are identified by name.
+*/
+
+static MODEL ols_from_file (const char *fname, char **vnames,
+			    int nv, const char *wname,
+			    const char *cname, int chunk,
+			    gretlopt opt)
+{
+    MODEL mod;
+    ols_info oi = {0};
+    ols_source *src = NULL;
+    gretl_matrix *D = NULL;
+    gretl_matrix *C = NULL;
+    gretl_matrix *R = NULL;
+    gretl_matrix *Ri = NULL;
+    gretl_matrix *b = NULL;
+    gretl_matrix *V = NULL;
+    gretl_matrix *W = NULL;
+    char fullname[MAXLEN];
+    char **want = NULL;
+    int *ok = NULL;
+    double y, ysum = 0.0, yysum = 0.0;
+    double wy = 0.0, wsum = 0.0;
+    double rmax, tss, ess, yy;
+    gint64 n = 0;
+    int use_qr, robust;
+    int ifc = 0, hc = 0, ncl = 0;
+    int i, j, k, nd, nr, nwant = 0;
+    int err = 0;
+
+    gretl_model_init(&mod, NULL);
+
+    if (fname == NULL || vnames == NULL || nv < 2) {
+	mod.errcode = E_ARGS;
+	return mod;
+    }
+
+    if (chunk <= 0) {
+	chunk = OLS_CHUNK;
+    }
+
+    /* search for @fname as the "open" command does */
+    err = get_full_filename(fname, fullname, OPT_NONE);
+    if (err) {
+	mod.errcode = err;
+	return mod;
+    }
+
+    k = oi.k = nv - 1;
+    oi.k1 = k + 1;
+    use_qr = (opt & OPT_Q) || libset_get_bool(USE_QR);
+    robust = (opt & OPT_R) || cname != NULL;
+
+    oi.xpos = malloc(k * sizeof *oi.xpos);
+    want = malloc((k + 3) * sizeof *want);
+    ok = malloc(chunk * sizeof *ok);
+
+    if (oi.xpos == NULL || want == NULL || ok == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    /* work out which columns we need */
+    for (i=0; i<k; i++) {
+	if (!strcmp(vnames[i+1], "const")) {
+	    if (ifc) {
+		err = E_DATA;
+		goto bailout;
+	    }
+	    oi.xpos[i] = -1;
+	    ifc = 1;
+	} else {
+	    oi.xpos[i] = nwant;
+	    want[nwant++] = vnames[i+1];
+	}
+    }
+    oi.ycol = nwant;
+    want[nwant++] = vnames[0];
+    oi.wcol = oi.ccol = -1;
+    if (wname != NULL) {
+	oi.wcol = nwant;
+	want[nwant++] = (char *) wname;
+    }
+    if (cname != NULL) {
+	oi.ccol = nwant;
+	want[nwant++] = (char *) cname;
+    }
+
+    src = ols_source_open(fullname, want, nwant, oi.ccol, &err);
+    if (err) {
+	goto bailout;
+    }
+
+    /* C has room for R on top of a chunk, for the QR update */
+    D = gretl_matrix_alloc(chunk, nwant);
+    C = gretl_matrix_alloc(chunk + oi.k1, oi.k1);
+    R = gretl_zero_matrix_new(oi.k1, oi.k1);
+
+    if (D == NULL || C == NULL || R == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    gretl_push_c_numeric_locale();
+
+    /* first pass: cumulate R, or the cross-products of [X y] */
+    while (!err && (nd = ols_source_read(src, D, &err)) > 0) {
+	int r0 = use_qr ? oi.k1 : 0;
+
+	nr = ols_usable_rows(D, nd, &oi, ok, &err);
+	if (err || nr == 0) {
+	    continue;
+	}
+	gretl_matrix_reuse(C, r0 + nr, oi.k1);
+	ols_fill_rows(D, ok, nr, &oi, C, r0);
+
+	for (i=0; i<nr; i++) {
+	    double sw = 1.0;
+
+	    y = D->val[oi.ycol * D->rows + ok[i]];
+	    ysum += y;
+	    yysum += y * y;
+	    if (oi.wcol >= 0) {
+		sw = sqrt(D->val[oi.wcol * D->rows + ok[i]]);
+	    }
+	    wy += sw * gretl_matrix_get(C, r0 + i, k);
+	    wsum += sw * sw;
+	}
+	n += nr;
+
+	if (use_qr) {
+	    for (j=0; j<oi.k1; j++) {
+		for (i=0; i<oi.k1; i++) {
+		    gretl_matrix_set(C, i, j, gretl_matrix_get(R, i, j));
+		}
+	    }
+	    err = gretl_matrix_QR_decomp(C, R);
+	} else {
+	    gretl_matrix_multiply_mod(C, GRETL_MOD_TRANSPOSE,
+				      C, GRETL_MOD_NONE,
+				      R, GRETL_MOD_CUMULATE);
+	}
+    }
+
+    if (!err && n <= k) {
+	err = E_DF;
+    } else if (!err && n > INT_MAX) {
+	gretl_errmsg_set(_("Too many observations"));
+	err = E_DATA;
+    }
+
+    if (!err && !use_qr) {
+	/* R <- upper Cholesky factor of [X y]'[X y] */
+	err = xy_cholesky(R, k);
+    }
+
+    if (!err) {
+	/* check for collinearity */
+	rmax = 0.0;
+	for (i=0; i<k; i++) {
+	    if (fabs(gretl_matrix_get(R, i, i)) > rmax) {
+		rmax = fabs(gretl_matrix_get(R, i, i));
+	    }
+	}
+	for (i=0; i<k && !err; i++) {
+	    if (fabs(gretl_matrix_get(R, i, i)) < 1.0e-9 * rmax) {
+		err = E_SINGULAR;
+	    }
+	}
+    }
+
+    if (!err) {
+	/* Ri = R_{11}^{-1}, b = Ri * r, (X'X)^{-1} = Ri * Ri' */
+	Ri = gretl_matrix_alloc(k, k);
+	b = gretl_column_vector_alloc(k);
+	V = gretl_matrix_alloc(k, k);
+	if (Ri == NULL || b == NULL || V == NULL) {
+	    err = E_ALLOC;
+	}
+    }
+
+    if (!err) {
+	for (j=0; j<k; j++) {
+	    for (i=0; i<k; i++) {
+		gretl_matrix_set(Ri, i, j, gretl_matrix_get(R, i, j));
+	    }
+	}
+	err = gretl_invert_triangular_matrix(Ri, 'U');
+    }
+
+    if (!err) {
+	for (i=0; i<k; i++) {
+	    b->val[i] = 0.0;
+	    for (j=i; j<k; j++) {
+		b->val[i] += gretl_matrix_get(Ri, i, j) *
+		    gretl_matrix_get(R, j, k);
+	    }
+	}
+	gretl_matrix_multiply_mod(Ri, GRETL_MOD_NONE,
+				  Ri, GRETL_MOD_TRANSPOSE,
+				  V, GRETL_MOD_NONE);
+	ess = gretl_matrix_get(R, k, k);
+	ess *= ess;
+	if (ess < ESSZERO) {
+	    /* perfect fit */
+	    ess = 0.0;
+	}
+	/* y'y for the (weighted) data */
+	yy = ess;
+	for (i=0; i<k; i++) {
+	    yy += gretl_matrix_get(R, i, k) * gretl_matrix_get(R, i, k);
+	}
+    }
+
+    if (!err) {
+	mod.ci = (wname != NULL)? WLS : OLS;
+	mod.ncoeff = k;
+	mod.nobs = (int) n;
+	mod.t1 = 0;
+	mod.t2 = mod.nobs - 1;
+	mod.ifc = ifc;
+	mod.dfn = k - ifc;
+	mod.dfd = mod.nobs - k;
+	mod.ess = ess;
+	mod.sigma = sqrt(ess / mod.dfd);
+	mod.ybar = ysum / n;
+	mod.sdy = sqrt((yysum - n * mod.ybar * mod.ybar) / (n - 1));
+	mod.coeff = malloc(k * sizeof *mod.coeff);
+	if (mod.coeff == NULL) {
+	    err = E_ALLOC;
+	}
+    }
+
+    if (!err) {
+	for (i=0; i<k; i++) {
+	    mod.coeff[i] = b->val[i];
+	}
+	if (ifc) {
+	    tss = yy - wy * wy / wsum;
+	} else {
+	    tss = yy;
+	}
+	mod.tss = tss;
+	mod.rsq = 1.0 - ess / tss;
+	mod.adjrsq = 1.0 - (1.0 - mod.rsq) * (mod.nobs - 1) / mod.dfd;
+	if (mod.dfn > 0 && ess > 0) {
+	    mod.fstt = ((tss - ess) * mod.dfd) / (mod.dfn * ess);
+	}
+	ls_criteria(&mod);
+    }
+
+    if (!err && robust) {
+	W = gretl_matrix_alloc(k, k);
+	if (W == NULL) {
+	    err = E_ALLOC;
+	} else {
+	    hc = libset_get_int(HC_VERSION);
+	    if (hc < 0 || hc > 3) {
+		hc = 1;
+	    }
+	    err = ols_robust_pass(src, &oi, D, C, ok, b, Ri, hc, W, &ncl);
+	}
+	if (!err && cname != NULL && ncl < 2) {
+	    gretl_errmsg_set("Invalid clustering variable");
+	    err = E_DATA;
+	}
+	if (!err) {
+	    /* V <- (X'X)^{-1} W (X'X)^{-1}, with df adjustment */
+	    gretl_matrix *XXi = gretl_matrix_copy(V);
+	    double dfadj = 1.0;
+
+	    if (XXi == NULL) {
+		err = E_ALLOC;
+	    } else {
+		gretl_matrix_qform(XXi, GRETL_MOD_NONE, W,
+				   V, GRETL_MOD_NONE);
+		gretl_matrix_free(XXi);
+	    }
+	    if (cname != NULL) {
+		dfadj = (ncl / (ncl - 1.0)) * (n - 1.0) / mod.dfd;
+	    } else if (hc == 1) {
+		dfadj = n / (double) mod.dfd;
+	    }
+	    gretl_matrix_multiply_by_scalar(V, dfadj);
+	}
+    } else if (!err) {
+	gretl_matrix_multiply_by_scalar(V, mod.sigma * mod.sigma);
+    }
+
+    gretl_pop_c_numeric_locale();
+
+    if (!err) {
+	err = gretl_model_write_vcv(&mod, V);
+    }
+
+    if (!err && robust) {
+	mod.opt |= OPT_R;
+	mod.fstt = robust_ftest(&mod, &oi, V);
+	if (cname != NULL) {
+	    gretl_model_set_vcv_info(&mod, VCV_CLUSTER, 0);
+	    gretl_model_set_int(&mod, "n_clusters", ncl);
+	} else {
+	    gretl_model_set_vcv_info(&mod, VCV_HC, hc);
+	}
+    }
+
+    if (!err) {
+	mod.depvar = gretl_strdup(vnames[0]);
+	err = gretl_model_allocate_param_names(&mod, k);
+	for (i=0; i<k && !err; i++) {
+	    err = gretl_model_set_param_name(&mod, i, vnames[i+1]);
+	}
+    }
+
+ bailout:
+
+    mod.errcode = err;
+
+    ols_source_destroy(src);
+    gretl_matrix_free(D);
+    gretl_matrix_free(C);
+    gretl_matrix_free(R);
+    gretl_matrix_free(Ri);
+    gretl_matrix_free(b);
+    gretl_matrix_free(V);
+    gretl_matrix_free(W);
+    free(oi.xpos);
+    free(want);
+    free(ok);
+
+    return mod;
+}
+
+static int bundle_stream_model (gretl_bundle *b, MODEL *pmod)
+{
+    gretl_matrix *m;
+    gretl_array *A;
+    int i, k = pmod->ncoeff;
+    int err = 0;
+
+    gretl_bundle_set_string(b, "command", "ols");
+    gretl_bundle_set_string(b, "depvar", pmod->depvar);
+    gretl_bundle_set_int(b, "T", pmod->nobs);
+    gretl_bundle_set_int(b, "ncoeff", k);
+    gretl_bundle_set_int(b, "df", pmod->dfd);
+    gretl_bundle_set_scalar(b, "ess", pmod->ess);
+    gretl_bundle_set_scalar(b, "sigma", pmod->sigma);
+    gretl_bundle_set_scalar(b, "rsq", pmod->rsq);
+    gretl_bundle_set_scalar(b, "adjrsq", pmod->adjrsq);
+    gretl_bundle_set_scalar(b, "Fstat", pmod->fstt);
+    gretl_bundle_set_scalar(b, "lnl", pmod->lnL);
+    gretl_bundle_set_scalar(b, "aic", pmod->criterion[C_AIC]);
+    gretl_bundle_set_scalar(b, "bic", pmod->criterion[C_BIC]);
+    gretl_bundle_set_scalar(b, "hqc", pmod->criterion[C_HQC]);
+    gretl_bundle_set_scalar(b, "ybar", pmod->ybar);
+    gretl_bundle_set_scalar(b, "sdy", pmod->sdy);
+    gretl_bundle_set_int(b, "robust", (pmod->opt & OPT_R)? 1 : 0);
+
+    if (gretl_model_get_int(pmod, "n_clusters") > 0) {
+	gretl_bundle_set_int(b, "n_clusters",
+			     gretl_model_get_int(pmod, "n_clusters"));
+    }
+
+    m = gretl_coeff_vector_from_model(pmod, NULL, &err);
+    if (!err) {
+	err = gretl_bundle_donate_data(b, "coeff", m, GRETL_TYPE_MATRIX, 0);
+    }
+    if (!err) {
+	m = gretl_column_vector_alloc(k);
+	if (m == NULL) {
+	    err = E_ALLOC;
+	} else {
+	    for (i=0; i<k; i++) {
+		m->val[i] = pmod->sderr[i];
+	    }
+	    err = gretl_bundle_donate_data(b, "stderr", m, GRETL_TYPE_MATRIX, 0);
+	}
+    }
+    if (!err) {
+	m = gretl_vcv_matrix_from_model(pmod, NULL, &err);
+	if (!err) {
+	    err = gretl_bundle_donate_data(b, "vcv", m, GRETL_TYPE_MATRIX, 0);
+	}
+    }
+    if (!err) {
+	A = gretl_array_from_strings(pmod->params, k, 1, &err);
+	if (!err) {
+	    err = gretl_bundle_donate_data(b, "parnames", A, GRETL_TYPE_ARRAY, 0);
+	}
+    }
+
+    return err;
+}
+
+/**
+ * olsfile_bundle:
+ * @fname: name of data file, CSV or gretl binary (.gdtb).
+ * @vnames: array of series names: the dependent variable followed
+ * by the regressors, where "const" stands for an intercept.
+ * @nv: number of elements in @vnames.
+ * @opts: bundle of options, or NULL. Recognized keys are
+ * "weights" and "cluster" (series names), "robust" (boolean),
+ * "qr" (boolean) and "chunk" (rows per chunk).
+ * @err: location to receive error code.
+ *
+ * Backs the hansl function olsfile(): runs ols_from_file() and
+ * packs the results into a bundle.
+ *
+ * Returns: newly allocated bundle, or NULL on failure.
+ */
+
+gretl_bundle *olsfile_bundle (const char *fname, char **vnames,
+			      int nv, gretl_bundle *opts,
+			      int *err)
+{
+    const char *wname = NULL;
+    const char *cname = NULL;
+    gretlopt opt = OPT_NONE;
+    gretl_bundle *b = NULL;
+    int chunk = 0;
+    MODEL mod;
+
+    if (opts != NULL) {
+	if (gretl_bundle_has_key(opts, "weights")) {
+	    wname = gretl_bundle_get_string(opts, "weights", err);
+	}
+	if (!*err && gretl_bundle_has_key(opts, "cluster")) {
+	    cname = gretl_bundle_get_string(opts, "cluster", err);
+	}
+	if (gretl_bundle_get_bool(opts, "robust", 0)) {
+	    opt |= OPT_R;
+	}
+	if (gretl_bundle_get_bool(opts, "qr", 0)) {
+	    opt |= OPT_Q;
+	}
+	chunk = gretl_bundle_get_int_deflt(opts, "chunk", 0);
+	if (*err) {
+	    return NULL;
+	}
+    }
+
+    mod = ols_from_file(fname, vnames, nv, wname, cname, chunk, opt);
+
+    if (mod.errcode) {
+	*err = mod.errcode;
+    } else {
+	b = gretl_bundle_new();
+	if (b == NULL) {
+	    *err = E_ALLOC;
+	} else {
+	    *err = bundle_stream_model(b, &mod);
+	    if (*err) {
+		gretl_bundle_destroy(b);
+		b = NULL;
+	    }
+	}
+    }
+
+    clear_model(&mod);
+
+    return b;
+}
@@ -30,6 +30,10 @@
 #include "matrix_extra.h"
 #include "system.h"
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 #define VDEBUG 0
 
 #define VAR_SE_DFCORR 1
@@ -1633,17 +1637,62 @@ gretl_matrix *reorder_responses (const GRETL_VAR *var, int *err)
     return C;
 }
 
+/* Write the response of @targ to @shock over @periods into
+   @resp. A single shock needs only column @shock of A^t C, so
+   the recursion is on a vector rather than the full matrix;
+   the threaded VAR_all_responses() is for when all the shocks
+   are wanted.
+*/
+
+int VAR_shock_response (const GRETL_VAR *var, int targ, int shock,
+			int periods, double *resp)
+{
+    int rows = var->neqns * effective_order(var);
+    gretl_matrix *rt, *ct, *tmp;
+    gretl_matrix *C = var->C;
+    int t, err = 0;
+
+    if (var->ord != NULL) {
+	C = reorder_responses(var, &err);
+	if (err) {
+	    return err;
+	}
+    }
+
+    rt = gretl_column_vector_alloc(rows);
+    ct = gretl_column_vector_alloc(rows);
+
+    if (rt == NULL || ct == NULL) {
+	err = E_ALLOC;
+    } else {
+	memcpy(rt->val, C->val + (size_t) shock * rows,
+	       rows * sizeof(double));
+	for (t=0; t<periods; t++) {
+	    if (t > 0) {
+		gretl_matrix_multiply(var->A, rt, ct);
+		tmp = rt;
+		rt = ct;
+		ct = tmp;
+	    }
+	    resp[t] = rt->val[targ];
+	}
+    }
+
+    gretl_matrix_free(rt);
+    gretl_matrix_free(ct);
+
+    if (C != var->C) {
+	gretl_matrix_free(C);
+    }
+
+    return err;
+}
+
 static gretl_matrix *
 gretl_VAR_get_point_responses (GRETL_VAR *var, int targ, int shock,
 			       int periods, int *err)
 {
-    int rows = var->neqns * effective_order(var);
-    gretl_matrix *rtmp = NULL;
-    gretl_matrix *ctmp = NULL;
     gretl_matrix *resp = NULL;
-    gretl_matrix *C = var->C;
-    double x;
-    int t;
 
     if (shock >= var->neqns) {
 	fprintf(stderr, "Shock variable out of bounds\n");
@@ -1663,47 +1712,16 @@ gretl_VAR_get_point_responses (GRETL_VAR *var, int targ, int shock,
 	return NULL;
     }
 
-    if (var->ord != NULL) {
-	C = reorder_responses(var, err);
-	if (*err) {
-	    return NULL;
-	}
-    }
-
     resp = gretl_matrix_alloc(periods, 1);
-    rtmp = gretl_matrix_alloc(rows, var->neqns);
-    ctmp = gretl_matrix_alloc(rows, var->neqns);
 
-    if (resp == NULL || rtmp == NULL || ctmp == NULL) {
+    if (resp == NULL) {
 	*err = E_ALLOC;
-	goto bailout;
-    }
-
-    for (t=0; t<periods; t++) {
-	if (t == 0) {
-	    /* initial estimated responses */
-	    gretl_matrix_copy_values(rtmp, C);
-	} else {
-	    /* calculate further estimated responses */
-	    gretl_matrix_multiply(var->A, rtmp, ctmp);
-	    gretl_matrix_copy_values(rtmp, ctmp);
+    } else {
+	*err = VAR_shock_response(var, targ, shock, periods, resp->val);
+	if (*err) {
+	    gretl_matrix_free(resp);
+	    resp = NULL;
 	}
-	x = gretl_matrix_get(rtmp, targ, shock);
-	gretl_matrix_set(resp, t, 0, x);
-    }
-
- bailout:
-
-    gretl_matrix_free(rtmp);
-    gretl_matrix_free(ctmp);
-
-    if (C != var->C) {
-	gretl_matrix_free(C);
-    }
-
-    if (*err && resp != NULL) {
-	gretl_matrix_free(resp);
-	resp = NULL;
     }
 
     return resp;
@@ -1842,34 +1860,110 @@ gretl_VAR_get_fcast_se (GRETL_VAR *var, int periods)
     return se;
 }
 
-gretl_matrix *
-gretl_VAR_get_fcast_decomp (const GRETL_VAR *var,
-			    int targ, int periods,
-			    int *err)
+/* Compute the responses of all the variables in @var to each of
+   the structural shocks given by the columns of @C, over @periods:
+   row t of the returned matrix holds vec(Theta_t)', where Theta_t
+   is the leading n x n block of A^t C, so column shock * n + targ
+   holds the response of @targ to @shock. The recursion over the
+   horizon is sequential but the shocks are independent of each
+   other, so if it's worth it they're shared out among threads.
+*/
+
+static gretl_matrix *VAR_all_responses (const GRETL_VAR *var,
+					const gretl_matrix *C,
+					int periods, int *err)
 {
     int n = var->neqns;
-    int k = n * effective_order(var);
-    gretl_matrix_block *B;
-    gretl_matrix *idx, *vtmp;
-    gretl_matrix *cic, *vt;
-    gretl_matrix *vd = NULL;
-    gretl_matrix *C = var->C;
-    int i, t;
-
-    *err = 0;
+    int rows = n * effective_order(var);
+    gretl_matrix *R;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
 
-    if (targ >= n) {
-	fprintf(stderr, "Target variable out of bounds\n");
-	*err = E_DATA;
+    R = gretl_matrix_alloc(periods, n * n);
+    if (R == NULL) {
+	*err = E_ALLOC;
 	return NULL;
     }
 
-    if (periods <= 0) {
-	fprintf(stderr, "Invalid number of periods\n");
-	*err = E_DATA;
-	return NULL;
+#if defined(_OPENMP)
+    if (n > 1 && libset_use_openmp((guint64) periods * rows * rows * n)) {
+	nt = get_omp_n_threads();
+	if (nt > n) {
+	    nt = n;
+	}
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	gretl_matrix *rt = NULL, *ct = NULL, *tmp;
+	int tid = 0, nth = 1;
+	int s0, ns, s, i, t;
+	int terr = 0;
+
+#if defined(_OPENMP)
+	tid = omp_get_thread_num();
+	nth = omp_get_num_threads();
+#endif
+	/* this thread's block of shocks */
+	s0 = n * tid / nth;
+	ns = n * (tid + 1) / nth - s0;
+
+	if (ns > 0) {
+	    rt = gretl_matrix_alloc(rows, ns);
+	    ct = gretl_matrix_alloc(rows, ns);
+	    if (rt == NULL || ct == NULL) {
+		terr = E_ALLOC;
+	    }
+	}
+
+	if (ns > 0 && !terr) {
+	    memcpy(rt->val, C->val + (size_t) s0 * rows,
+		   (size_t) rows * ns * sizeof(double));
+	    for (t=0; t<periods; t++) {
+		if (t > 0) {
+		    gretl_matrix_multiply(var->A, rt, ct);
+		    tmp = rt;
+		    rt = ct;
+		    ct = tmp;
+		}
+		for (s=0; s<ns; s++) {
+		    for (i=0; i<n; i++) {
+			gretl_matrix_set(R, t, (s0 + s) * n + i,
+					 gretl_matrix_get(rt, i, s));
+		    }
+		}
+	    }
+	}
+
+	gretl_matrix_free(rt);
+	gretl_matrix_free(ct);
+
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    *err = terr;
+	}
+    }
+
+    if (*err) {
+	gretl_matrix_free(R);
+	R = NULL;
     }
 
+    return R;
+}
+
+/* As VAR_all_responses(), taking into account any non-default
+   ordering of the variables for the Cholesky decomposition */
+
+static gretl_matrix *VAR_structural_responses (const GRETL_VAR *var,
+					       int periods, int *err)
+{
+    gretl_matrix *C = var->C;
+    gretl_matrix *R;
+
     if (var->ord != NULL) {
 	C = reorder_responses(var, err);
 	if (*err) {
@@ -1877,56 +1971,39 @@ gretl_VAR_get_fcast_decomp (const GRETL_VAR *var,
 	}
     }
 
-    B = gretl_matrix_block_new(&idx, n, n,
-			       &cic, k, k,
-			       &vt,  k, k,
-			       &vtmp, k, k,
-			       NULL);
-    if (B == NULL) {
-	*err = E_ALLOC;
-	goto bailout;
-    }
+    R = VAR_all_responses(var, C, periods, err);
 
-    vd = gretl_zero_matrix_new(periods, n + 1);
-    if (vd == NULL) {
-	*err = E_ALLOC;
-	goto bailout;
+    if (C != var->C) {
+	gretl_matrix_free(C);
     }
 
-    gretl_matrix_zero(idx);
+    return R;
+}
 
-    for (i=0; i<n && !*err; i++) {
-	double vti;
+/* Fill @vd, of dimension periods x (n + 1), with the forecast
+   error variance decomposition for variable @targ, given the
+   structural responses @R: the variance contributed by a shock
+   up to horizon t is the sum of its squared responses.
+*/
 
-	/* adjust index matrix */
-	if (i > 0) {
-	    gretl_matrix_set(idx, i-1, i-1, 0.0);
-	}
-	gretl_matrix_set(idx, i, i, 1.0);
+static void fevd_from_responses (const gretl_matrix *R, int n,
+				 int targ, gretl_matrix *vd)
+{
+    int periods = R->rows;
+    double x, vi, vtot;
+    int i, t;
 
-	for (t=0; t<periods && !*err; t++) {
-	    if (t == 0) {
-		/* calculate initial variances */
-		*err = gretl_matrix_qform(C, GRETL_MOD_NONE,
-					  idx, cic, GRETL_MOD_NONE);
-		gretl_matrix_copy_values(vt, cic);
-	    } else {
-		/* calculate further variances */
-		gretl_matrix_copy_values(vtmp, vt);
-		*err = gretl_matrix_qform(var->A, GRETL_MOD_NONE,
-					  vtmp, vt, GRETL_MOD_NONE);
-		gretl_matrix_add_to(vt, cic);
-	    }
-	    if (!*err) {
-		vti = gretl_matrix_get(vt, targ, targ);
-		gretl_matrix_set(vd, t, i, vti);
-	    }
+    for (i=0; i<n; i++) {
+	vi = 0.0;
+	for (t=0; t<periods; t++) {
+	    x = gretl_matrix_get(R, t, i * n + targ);
+	    vi += x * x;
+	    gretl_matrix_set(vd, t, i, vi);
 	}
     }
 
-    for (t=0; t<periods && !*err; t++) {
-	double vi, vtot = 0.0;
-
+    for (t=0; t<periods; t++) {
+	vtot = 0.0;
 	for (i=0; i<n; i++) {
 	    vtot += gretl_matrix_get(vd, t, i);
 	}
@@ -1935,23 +2012,47 @@ gretl_VAR_get_fcast_decomp (const GRETL_VAR *var,
 	    vi = gretl_matrix_get(vd, t, i);
 	    gretl_matrix_set(vd, t, i, 100.0 * vi / vtot);
 	}
-
-	gretl_matrix_set(vd, t, var->neqns, sqrt(vtot));
+	gretl_matrix_set(vd, t, n, sqrt(vtot));
     }
+}
 
- bailout:
+gretl_matrix *
+gretl_VAR_get_fcast_decomp (const GRETL_VAR *var,
+			    int targ, int periods,
+			    int *err)
+{
+    int n = var->neqns;
+    gretl_matrix *vd = NULL;
+    gretl_matrix *R;
 
-    gretl_matrix_block_destroy(B);
+    *err = 0;
 
-    if (C != var->C) {
-	gretl_matrix_free(C);
+    if (targ >= n) {
+	fprintf(stderr, "Target variable out of bounds\n");
+	*err = E_DATA;
+	return NULL;
     }
 
-    if (*err && vd != NULL) {
-	gretl_matrix_free(vd);
-	vd = NULL;
+    if (periods <= 0) {
+	fprintf(stderr, "Invalid number of periods\n");
+	*err = E_DATA;
+	return NULL;
     }
 
+    R = VAR_structural_responses(var, periods, err);
+    if (R == NULL) {
+	return NULL;
+    }
+
+    vd = gretl_zero_matrix_new(periods, n + 1);
+    if (vd == NULL) {
+	*err = E_ALLOC;
+    } else {
+	fevd_from_responses(R, n, targ, vd);
+    }
+
+    gretl_matrix_free(R);
+
     return vd;
 }
 
@@ -1962,7 +2063,7 @@ gretl_VAR_get_FEVD_matrix (const GRETL_VAR *var,
 			   const DATASET *dset,
 			   int *err)
 {
-    gretl_matrix *vd, *V;
+    gretl_matrix *vd, *V, *R;
     double vjk;
     int h = horizon;
     int n = var->neqns;
@@ -1978,6 +2079,10 @@ gretl_VAR_get_FEVD_matrix (const GRETL_VAR *var,
 	k = n * n;
 	imin = 0;
 	imax = n;
+    } else if (targ >= n) {
+	fprintf(stderr, "Target variable out of bounds\n");
+	*err = E_DATA;
+	return NULL;
     } else {
 	/* got a specific target */
 	k = n;
@@ -1985,27 +2090,37 @@ gretl_VAR_get_FEVD_matrix (const GRETL_VAR *var,
 	imax = targ + 1;
     }
 
+    /* the responses are common to all targets */
+    R = VAR_structural_responses(var, h, err);
+    if (R == NULL) {
+	return NULL;
+    }
+
     V = gretl_matrix_alloc(h, k);
-    if (V == NULL) {
+    vd = gretl_matrix_alloc(h, n + 1);
+    if (V == NULL || vd == NULL) {
+	gretl_matrix_free(R);
+	gretl_matrix_free(V);
+	gretl_matrix_free(vd);
 	*err = E_ALLOC;
 	return NULL;
     }
 
     kk = 0;
-    for (i=imin; i<imax && !*err; i++) {
-	vd = gretl_VAR_get_fcast_decomp(var, i, h, err);
-	if (!*err) {
-	    for (k=0; k<n; k++) {
-		for (j=0; j<h; j++) {
-		    vjk = gretl_matrix_get(vd, j, k);
-		    gretl_matrix_set(V, j, kk, vjk / 100.0);
-		}
-		kk++;
+    for (i=imin; i<imax; i++) {
+	fevd_from_responses(R, n, i, vd);
+	for (k=0; k<n; k++) {
+	    for (j=0; j<h; j++) {
+		vjk = gretl_matrix_get(vd, j, k);
+		gretl_matrix_set(V, j, kk, vjk / 100.0);
 	    }
-	    gretl_matrix_free(vd);
+	    kk++;
 	}
     }
 
+    gretl_matrix_free(R);
+    gretl_matrix_free(vd);
+
     /* If @shock is specific, not all, we now proceed to carve
        out the columns of @V that are actually wanted. This is
        not as efficient as it might be -- we're computing more
@@ -724,6 +724,116 @@ static int lagsel_get_min_lag (int p, int *err)
     return m;
 }
 
+/* Compute the log-determinants of the residual covariance matrices
+   of the VARs of order @minlag to @p - 1 nested within @var, which
+   has been estimated at order @p, without running the regressions.
+   The columns of X are arranged as deterministic terms followed by
+   lag 1 of all the endogenous variables, lag 2, and so on, so that
+   the regressors for each order form a leading block. A single
+   Cholesky decomposition of the cross-product matrix of [X Y] then
+   does the job: if W is the block of the factor below X'X, the
+   residual sum of squares and cross-products for an order-j VAR is
+   Y'Y - W_j W_j', where W_j holds the leading columns of W.
+
+   Returns non-zero if this doesn't work out (X'X not positive
+   definite, say) in which case the caller should run the regressions
+   after all.
+*/
+
+static int lagsel_ldets_from_moments (GRETL_VAR *var, int minlag,
+				      double *ldets)
+{
+    gretl_matrix_block *B;
+    gretl_matrix *Z, *G, *S, *V;
+    const gretl_matrix *X = var->X;
+    int n = var->neqns;
+    int p = var->order;
+    int T = var->T;
+    int K = var->ncoeff;
+    int nd = K - n * p; /* columns that are not Y lags */
+    int m = K + n;
+    int c0 = var->ifc;
+    int i, j, k, l, src;
+    double wik, wjk;
+    int err = 0;
+
+    if (nd < c0 || X == NULL || X->cols < K) {
+	return E_DATA;
+    }
+
+    B = gretl_matrix_block_new(&Z, T, m,
+			       &G, m, m,
+			       &S, n, n,
+			       &V, n, n,
+			       NULL);
+    if (B == NULL) {
+	return E_ALLOC;
+    }
+
+    /* compose Z = [X Y], with the columns of X reordered */
+    for (k=0; k<K; k++) {
+	if (k < nd) {
+	    /* constant first, if present, then the other
+	       deterministic or exogenous terms */
+	    src = (k < c0)? k : c0 + n * p + k - c0;
+	} else {
+	    /* lag l of variable i */
+	    l = (k - nd) / n + 1;
+	    i = (k - nd) % n;
+	    src = c0 + i * p + l - 1;
+	}
+	memcpy(Z->val + (size_t) k * T, X->val + (size_t) src * T,
+	       T * sizeof(double));
+    }
+    memcpy(Z->val + (size_t) K * T, var->Y->val,
+	   (size_t) n * T * sizeof(double));
+
+    gretl_matrix_multiply_mod(Z, GRETL_MOD_TRANSPOSE,
+			      Z, GRETL_MOD_NONE,
+			      G, GRETL_MOD_NONE);
+
+    /* grab Y'Y before the decomposition */
+    for (j=0; j<n; j++) {
+	for (i=0; i<n; i++) {
+	    gretl_matrix_set(S, i, j, gretl_matrix_get(G, K+i, K+j));
+	}
+    }
+
+    if (gretl_matrix_cholesky_decomp(G)) {
+	err = E_SINGULAR;
+    }
+
+    /* subtract the contributions of the columns of X, in blocks:
+       first the non-lag terms, then each lag in turn */
+    for (l=0, k=0; l<p && !err; l++) {
+	int kmax = nd + l * n;
+
+	for (; k<kmax; k++) {
+	    for (j=0; j<n; j++) {
+		wjk = gretl_matrix_get(G, K+j, k);
+		for (i=j; i<n; i++) {
+		    wik = gretl_matrix_get(G, K+i, k);
+		    S->val[j*n+i] -= wik * wjk;
+		}
+	    }
+	}
+	if (l >= minlag) {
+	    /* the lower triangle of S now holds the SSCP matrix
+	       for order l */
+	    for (j=0; j<n; j++) {
+		for (i=j; i<n; i++) {
+		    V->val[j*n+i] = V->val[i*n+j] = S->val[j*n+i] / T;
+		}
+	    }
+	    ldets[l - minlag] = gretl_vcv_log_determinant(V, &err);
+	}
+    }
+
+    gretl_matrix_block_destroy(B);
+
+    return err;
+}
+
 /* apparatus for selecting the optimal lag length for a VAR */
 
 int VAR_do_lagsel (GRETL_VAR *var, const DATASET *dset,
@@ -732,6 +842,7 @@ int VAR_do_lagsel (GRETL_VAR *var, const DATASET *dset,
     gretl_matrix *crittab = NULL;
     gretl_matrix *lltab = NULL;
     gretl_matrix *E = NULL;
+    double *ldets = NULL;
     int p = var->order;
     int r = p - 1;
     int T = var->T;
@@ -776,10 +887,23 @@ int VAR_do_lagsel (GRETL_VAR *var, const DATASET *dset,
 	use_QR = 1;
     }
 
+    if (!use_QR && var->lags == NULL) {
+	/* try getting all the criteria from the moments of the
+	   maximal-order VAR */
+	ldets = malloc((p - minlag) * sizeof *ldets);
+	if (ldets != NULL &&
+	    lagsel_ldets_from_moments(var, minlag, ldets) != 0) {
+	    free(ldets);
+	    ldets = NULL;
+	}
+    }
+
     for (j=minlag; j<p && !err; j++) {
 	int jxcols = cols0 + j * n;
 
-	if (jxcols == 0) {
+	if (ldets != NULL) {
+	    ldet = ldets[j - minlag];
+	} else if (jxcols == 0) {
 	    gretl_matrix_copy_values(E, var->Y);
 	} else {
 	    VAR_fill_X(var, j, dset);
@@ -796,7 +920,7 @@ int VAR_do_lagsel (GRETL_VAR *var, const DATASET *dset,
 	    }
 	}
 
-	if (!err) {
+	if (!err && ldets == NULL) {
 	    ldet = gretl_VAR_ldet(var, E, &err);
 	}
 
@@ -849,6 +973,7 @@ int VAR_do_lagsel (GRETL_VAR *var, const DATASET *dset,
     gretl_matrix_free(crittab);
     gretl_matrix_free(lltab);
     gretl_matrix_free(E);
+    free(ldets);
 
     return err;
 }
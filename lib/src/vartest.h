@@ -47,6 +47,9 @@ gretl_matrix *VAR_coeff_matrix_from_VECM (GRETL_VAR *var);
 
 gretl_matrix *reorder_responses (const GRETL_VAR *var, int *err);
 
+int VAR_shock_response (const GRETL_VAR *var, int targ, int shock,
+			int periods, double *resp);
+
 gretl_matrix *irf_bootstrap (GRETL_VAR *var, 
 			     int targ, int shock,
 			     int periods, double alpha,
@@ -42,6 +42,7 @@ enum {
 typedef struct ddset_ ddset;
 typedef struct unit_info_ unit_info;
 typedef struct diag_info_ diag_info;
+typedef struct zblock_ zblock;
 
 struct unit_info_ {
     int t1;      /* first usable obs in differences for unit */
@@ -62,6 +63,19 @@ struct diag_info_ {
     int tbase;   /* first obs with potentially available instruments */
 };
 
+/* Sparse storage for one unit's share of the transposed instrument
+   matrix (used by dpanel in place of the dense ZT): the nonzero
+   instrument values for each of the unit's observations are held
+   in compressed-column form.
+*/
+
+struct zblock_ {
+    int nobs;     /* number of observations (columns) for the unit */
+    int *cp;      /* column pointers: nobs + 1 */
+    int *rows;    /* instrument (row) indices of nonzero values */
+    double *val;  /* the nonzero values */
+};
+
 struct ddset_ {
     int ci;               /* ARBOND or DPANEL */
     int flags;            /* option flags */
@@ -109,6 +123,7 @@ struct ddset_ {
     gretl_matrix *Acpy;   /* back-up of A matrix */
     gretl_matrix *V;      /* covariance matrix */
     gretl_matrix *ZT;     /* transpose of full instrument matrix */
+    zblock *Zs;           /* per-unit sparse alternative to ZT */
     gretl_matrix *Zi;     /* per-unit instrument matrix */
     gretl_matrix *Y;      /* transformed dependent var */
     gretl_matrix *X;      /* lagged differences of y, indep vars, etc. */
@@ -154,6 +169,18 @@ static void ddset_free (ddset *dpd)
     gretl_matrix_block_destroy(dpd->B2);
 
     gretl_matrix_free(dpd->V);
+    gretl_matrix_free(dpd->ZT);
+
+    if (dpd->Zs != NULL) {
+	int i;
+
+	for (i=0; i<dpd->N; i++) {
+	    free(dpd->Zs[i].cp);
+	    free(dpd->Zs[i].rows);
+	    free(dpd->Zs[i].val);
+	}
+	free(dpd->Zs);
+    }
 
     free(dpd->xlist);
     free(dpd->ilist);
@@ -173,7 +200,6 @@ static int dpd_allocate_matrices (ddset *dpd)
     dpd->B1 = gretl_matrix_block_new(&dpd->beta,  dpd->k, 1,
 				     &dpd->vbeta, dpd->k, dpd->k,
 				     &dpd->uhat,  dpd->totobs, 1,
-				     &dpd->ZT,    dpd->nz, dpd->totobs,
 				     &dpd->H,     T, T,
 				     &dpd->A,     dpd->nz, dpd->nz,
 				     &dpd->Acpy,  dpd->nz, dpd->nz,
@@ -198,9 +224,180 @@ static int dpd_allocate_matrices (ddset *dpd)
 	return E_ALLOC;
     }
 
+    if (dpd->ci == DPANEL) {
+	/* instruments are stored sparsely, per unit */
+	dpd->Zs = calloc(dpd->N, sizeof *dpd->Zs);
+	if (dpd->Zs == NULL) {
+	    return E_ALLOC;
+	}
+    } else {
+	dpd->ZT = gretl_matrix_alloc(dpd->nz, dpd->totobs);
+	if (dpd->ZT == NULL) {
+	    return E_ALLOC;
+	}
+    }
+
+    return 0;
+}
+
+/* Write into @z the values of the instruments at column @s of
+   the (transposed) instrument matrix, where @s is the @k-th
+   observation for unit @i.
+*/
+
+static void dpd_ZT_column (ddset *dpd, int i, int k, int s,
+			   double *z)
+{
+    if (dpd->Zs != NULL) {
+	const zblock *zb = &dpd->Zs[i];
+	int p;
+
+	memset(z, 0, dpd->nz * sizeof *z);
+	for (p=zb->cp[k]; p<zb->cp[k+1]; p++) {
+	    z[zb->rows[p]] = zb->val[p];
+	}
+    } else {
+	memcpy(z, dpd->ZT->val + (size_t) s * dpd->ZT->rows,
+	       dpd->nz * sizeof *z);
+    }
+}
+
+/* Fill @Zi (ni x nz) with the instruments for unit @i, whose
+   observations start at column @c of the instrument matrix.
+*/
+
+static void dpd_unit_Zi (ddset *dpd, int i, int c, gretl_matrix *Zi)
+{
+    if (dpd->Zs != NULL) {
+	const zblock *zb = &dpd->Zs[i];
+	int k, p;
+
+	gretl_matrix_zero(Zi);
+	for (k=0; k<zb->nobs; k++) {
+	    for (p=zb->cp[k]; p<zb->cp[k+1]; p++) {
+		gretl_matrix_set(Zi, k, zb->rows[p], zb->val[p]);
+	    }
+	}
+    } else {
+	gretl_matrix_extract_matrix(Zi, dpd->ZT, 0, c,
+				    GRETL_MOD_TRANSPOSE);
+    }
+}
+
+/* Compute Z'U, where U has dpd->totobs rows, writing the result
+   into @targ, or (Z'U)' = U'Z if @tmod is GRETL_MOD_TRANSPOSE.
+*/
+
+static void dpd_ZT_multiply (ddset *dpd, const gretl_matrix *U,
+			     gretl_matrix *targ, GretlMatrixMod tmod)
+{
+    const zblock *zb;
+    double x, z;
+    int i, j, k, p, r;
+    int s = 0;
+
+    if (dpd->Zs == NULL) {
+	if (tmod == GRETL_MOD_TRANSPOSE) {
+	    gretl_matrix_multiply_mod(U, GRETL_MOD_TRANSPOSE,
+				      dpd->ZT, GRETL_MOD_TRANSPOSE,
+				      targ, GRETL_MOD_NONE);
+	} else {
+	    gretl_matrix_multiply(dpd->ZT, U, targ);
+	}
+	return;
+    }
+
+    gretl_matrix_zero(targ);
+
+    for (i=0; i<dpd->N; i++) {
+	zb = &dpd->Zs[i];
+	for (k=0; k<zb->nobs; k++, s++) {
+	    for (p=zb->cp[k]; p<zb->cp[k+1]; p++) {
+		r = zb->rows[p];
+		z = zb->val[p];
+		for (j=0; j<U->cols; j++) {
+		    x = z * gretl_matrix_get(U, s, j);
+		    if (tmod == GRETL_MOD_TRANSPOSE) {
+			targ->val[r * targ->rows + j] += x;
+		    } else {
+			targ->val[j * targ->rows + r] += x;
+		    }
+		}
+	    }
+	}
+    }
+}
+
+/* Drop the instruments flagged in @mask from the sparse
+   instrument store, renumbering those that remain.
+*/
+
+static int zblocks_cut_rows (ddset *dpd, const char *mask)
+{
+    int *rmap;
+    int i, j, k, p, q;
+
+    rmap = malloc(dpd->nz * sizeof *rmap);
+    if (rmap == NULL) {
+	return E_ALLOC;
+    }
+
+    for (j=0, k=0; j<dpd->nz; j++) {
+	rmap[j] = mask[j] ? -1 : k++;
+    }
+
+    for (i=0; i<dpd->N; i++) {
+	zblock *zb = &dpd->Zs[i];
+	int c0;
+
+	for (k=0, q=0; k<zb->nobs; k++) {
+	    c0 = q;
+	    for (p=zb->cp[k]; p<zb->cp[k+1]; p++) {
+		if (rmap[zb->rows[p]] >= 0) {
+		    zb->rows[q] = rmap[zb->rows[p]];
+		    zb->val[q++] = zb->val[p];
+		}
+	    }
+	    zb->cp[k] = c0;
+	}
+	if (zb->nobs > 0) {
+	    zb->cp[zb->nobs] = q;
+	}
+    }
+
+    free(rmap);
+
     return 0;
 }
 
+/* Dense copy of the transposed instrument matrix, for saving
+   on the model when extra data are wanted.
+*/
+
+static gretl_matrix *dpd_dense_ZT (ddset *dpd)
+{
+    gretl_matrix *Z;
+    int i, k, p, s = 0;
+
+    if (dpd->Zs == NULL) {
+	return gretl_matrix_copy(dpd->ZT);
+    }
+
+    Z = gretl_zero_matrix_new(dpd->nz, dpd->totobs);
+
+    for (i=0; i<dpd->N && Z != NULL; i++) {
+	const zblock *zb = &dpd->Zs[i];
+
+	for (k=0; k<zb->nobs; k++, s++) {
+	    for (p=zb->cp[k]; p<zb->cp[k+1]; p++) {
+		gretl_matrix_set(Z, zb->rows[p], s, zb->val[p]);
+	    }
+	}
+    }
+
+    return Z;
+}
+
 static int dpd_add_unit_info (ddset *dpd)
 {
     int i, err = 0;
@@ -277,6 +474,8 @@ static ddset *ddset_new (int ci, int *list, const int *ylags,
     /* set pointer members to NULL just in case */
     dpd->B1 = dpd->B2 = NULL;
     dpd->V = NULL;
+    dpd->ZT = NULL;
+    dpd->Zs = NULL;
     dpd->ui = NULL;
     dpd->used = NULL;
     dpd->xlist = NULL;
@@ -1002,7 +1201,7 @@ static int dpd_sargan_test (ddset *dpd)
     save_cols = gretl_matrix_cols(dpd->L1);
 
     Zu = gretl_matrix_reuse(dpd->L1, dpd->nz, 1);
-    gretl_matrix_multiply(dpd->ZT, dpd->uhat, Zu);
+    dpd_ZT_multiply(dpd, dpd->uhat, Zu, GRETL_MOD_NONE);
     gretl_matrix_divide_by_scalar(dpd->A, dpd->effN);
     dpd->sargan = gretl_scalar_qform(Zu, dpd->A, &err);
 
@@ -1023,7 +1222,7 @@ static int dpd_sargan_test (ddset *dpd)
 #if ADEBUG
     fprintf(stderr, "Sargan (or Hansen) test: Chi-square(%d-%d) = %g\n",
 	    dpd->nz, dpd->k, dpd->sargan);
-    if (1) {
+    if (dpd->ZT != NULL) {
 	/* try to replicate the xtabond2 'Sargan test' */
 	double sg;
 
@@ -1117,6 +1316,7 @@ static int dpd_ar_test (ddset *dpd)
     gretl_matrix *Hi, *ZU;
     gretl_matrix *wX, *ZHw;
     gretl_matrix *Tmp;
+    gretl_matrix *zs;
     char *hmask = NULL;
     int HT, T = dpd->maxTi;
     int save_rows, save_cols;
@@ -1155,6 +1355,7 @@ static int dpd_ar_test (ddset *dpd)
 			       &wX,  1, dpd->k,
 			       &ZHw, nz, 1,
 			       &Tmp, dpd->k, nz,
+			       &zs,  nz, 1,
 			       NULL);
 
     if (B == NULL) {
@@ -1229,9 +1430,9 @@ static int dpd_ar_test (ddset *dpd)
 		    x = gretl_matrix_get(dpd->X, s, j);
 		    gretl_matrix_set(Xi, k, j, x);
 		}
+		dpd_ZT_column(dpd, i, k, s, zs->val);
 		for (j=0; j<nz; j++) {
-		    x = gretl_matrix_get(dpd->ZT, j, s);
-		    gretl_matrix_set(Zi, k, j, x);
+		    gretl_matrix_set(Zi, k, j, zs->val[j]);
 		}
 		k++;
 		s++;
@@ -1277,9 +1478,9 @@ static int dpd_ar_test (ddset *dpd)
 				      ZU, GRETL_MOD_NONE);
 	    for (t=0; t<unit->nlev; t++) {
 		/* catch the levels terms */
+		dpd_ZT_column(dpd, i, Ti + t, s, zs->val);
 		for (j=0; j<nz; j++) {
-		    x = gretl_matrix_get(dpd->ZT, j, s);
-		    ZU->val[j] += x * dpd->uhat->val[s];
+		    ZU->val[j] += zs->val[j] * dpd->uhat->val[s];
 		}
 		s++;
 	    }
@@ -1385,8 +1586,7 @@ static int windmeijer_correct (ddset *dpd, const gretl_matrix *uhat1,
     gretl_matrix *dWj; /* one component of the above */
     gretl_matrix *ui;  /* per-unit residuals */
     gretl_matrix *xij; /* per-unit X_j values */
-    gretl_matrix *mT;  /* workspace follows */
-    gretl_matrix *km;
+    gretl_matrix *km;  /* workspace follows */
     gretl_matrix *k1;
     gretl_matrix *R1;
     gretl_matrix *Zui;
@@ -1403,7 +1603,6 @@ static int windmeijer_correct (ddset *dpd, const gretl_matrix *uhat1,
 			       &dWj, dpd->nz, dpd->nz,
 			       &ui,  dpd->max_ni, 1,
 			       &xij, dpd->max_ni, 1,
-			       &mT,  dpd->nz, dpd->totobs,
 			       &km,  dpd->k, dpd->nz,
 			       &k1,  dpd->k, 1,
 			       &Zui, dpd->nz, 1,
@@ -1421,8 +1620,8 @@ static int windmeijer_correct (ddset *dpd, const gretl_matrix *uhat1,
     gretl_matrix_multiply_by_scalar(dpd->kmtmp, -1.0 / dpd->effN);
 
     /* form W^{-1}Z'v_2 */
-    gretl_matrix_multiply(dpd->A, dpd->ZT, mT);
-    gretl_matrix_multiply(mT, dpd->uhat, R1);
+    dpd_ZT_multiply(dpd, dpd->uhat, Zui, GRETL_MOD_NONE);
+    gretl_matrix_multiply(dpd->A, Zui, R1);
 
     for (j=0; j<dpd->k; j++) { /* loop across the X's */
 	int s = 0;
@@ -1452,8 +1651,7 @@ static int windmeijer_correct (ddset *dpd, const gretl_matrix *uhat1,
 					GRETL_MOD_NONE);
 
 	    /* extract Zi */
-	    gretl_matrix_extract_matrix(dpd->Zi, dpd->ZT, 0, s - ni,
-					GRETL_MOD_TRANSPOSE);
+	    dpd_unit_Zi(dpd, i, s - ni, dpd->Zi);
 
 	    gretl_matrix_multiply_mod(dpd->Zi, GRETL_MOD_TRANSPOSE,
 				      ui, GRETL_MOD_NONE,
@@ -1582,8 +1780,7 @@ static int dpd_variance_1 (ddset *dpd)
 	/* get per-unit instruments matrix, Zi */
 	gretl_matrix_reuse(dpd->Zi, ni, dpd->nz);
 	gretl_matrix_reuse(ui, ni, 1);
-	gretl_matrix_extract_matrix(dpd->Zi, dpd->ZT, 0, c,
-				    GRETL_MOD_TRANSPOSE);
+	dpd_unit_Zi(dpd, i, c, dpd->Zi);
 	c += ni;
 
 	/* load residuals into the ui vector */
@@ -1871,8 +2068,8 @@ static int dpd_finalize_model (MODEL *pmod,
 		gretl_model_set_matrix_as_data(pmod, "wgtmat", A);
 	    }
 	}
-	if (keep_extra && dpd->ZT != NULL) {
-	    gretl_matrix *Z = gretl_matrix_copy(dpd->ZT);
+	if (keep_extra && (dpd->ZT != NULL || dpd->Zs != NULL)) {
+	    gretl_matrix *Z = dpd_dense_ZT(dpd);
 
 	    gretl_model_set_matrix_as_data(pmod, "GMMinst", Z);
 	}
@@ -1970,7 +2167,11 @@ static void dpd_shrink_matrices (ddset *dpd, const char *mask)
 	    (dpd->ci == DPANEL)? "dpanel" : "arbond",
 	    dpd->nz, dpd->A->rows);
 
-    gretl_matrix_cut_rows(dpd->ZT, mask);
+    if (dpd->Zs != NULL) {
+	zblocks_cut_rows(dpd, mask);
+    } else {
+	gretl_matrix_cut_rows(dpd->ZT, mask);
+    }
 
     dpd->nz = dpd->A->rows;
 
@@ -2489,10 +2690,8 @@ static int dpd_step_1 (ddset *dpd)
 	/* construct additional moment matrices: we waited
 	   until we knew what size these should really be
 	*/
-	gretl_matrix_multiply(dpd->ZT, dpd->Y, dpd->ZY);
-	gretl_matrix_multiply_mod(dpd->X, GRETL_MOD_TRANSPOSE,
-				  dpd->ZT, GRETL_MOD_TRANSPOSE,
-				  dpd->XZ, GRETL_MOD_NONE);
+	dpd_ZT_multiply(dpd, dpd->Y, dpd->ZY, GRETL_MOD_NONE);
+	dpd_ZT_multiply(dpd, dpd->X, dpd->XZ, GRETL_MOD_TRANSPOSE);
     }
 
 #if ADEBUG > 1
@@ -172,12 +172,11 @@ static int as_info_init (struct as_info *as,
     return err;
 }
 
-static void as_info_free (struct as_info *as)
+static void as_workspace_free (struct as_info *as)
 {
     free(as->phi);
     free(as->theta);
     free(as->e);
-    free(as->y0);
 
     if (as->algo == 154) {
 	free(as->A);
@@ -186,12 +185,110 @@ static void as_info_free (struct as_info *as)
 	free(as->evec);
 	free(as->thetab);
     }
+}
+
+static void as_info_free (struct as_info *as)
+{
+    as_workspace_free(as);
+    free(as->y0);
 
     if (as->free_X) {
 	gretl_matrix_free(as->X);
     }
 }
 
+/* Support for evaluating the loglikelihood in several threads
+   at once when computing numerical derivatives: each thread
+   gets a copy of the as_info with its own workspace, sharing the
+   read-only y0, X and arma_info. The working y array must be
+   private only if it gets rewritten from y0 on each call.
+*/
+
+static void as_info_clone_free (void *data)
+{
+    struct as_info *as = data;
+
+    as_workspace_free(as);
+    if (as->y0 != NULL) {
+	free(as->y);
+    }
+    free(as);
+}
+
+static void *as_info_clone (void *data, int *err)
+{
+    struct as_info *src = data;
+    struct as_info *as = malloc(sizeof *as);
+
+    if (as == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    *as = *src;
+    as->free_X = 0;
+    /* don't let a partial allocation leave pointers into @src */
+    as->phi = as->theta = as->e = NULL;
+    as->A = as->P0 = as->V = as->evec = as->thetab = NULL;
+
+    if (as->algo == 154) {
+	*err = as_154_alloc(as);
+    } else {
+	*err = as_197_alloc(as);
+    }
+
+    if (src->y0 != NULL) {
+	as->y = *err ? NULL : copyvec(src->y, as->n);
+	if (as->y == NULL) {
+	    *err = E_ALLOC;
+	}
+    }
+
+    if (*err) {
+	as_info_clone_free(as);
+	as = NULL;
+    }
+
+    return as;
+}
+
+static int as_numeric_gradient (double *b, double *g, int n,
+				BFGS_CRIT_FUNC func, void *data)
+{
+    return numeric_gradient_mt(b, g, n, func, data,
+			       as_info_clone,
+			       as_info_clone_free);
+}
+
+static gretl_matrix *as_hessian_inverse (double *b, int n,
+					 struct as_info *as,
+					 double d, int *err)
+{
+    gretl_matrix *H = gretl_zero_matrix_new(n, n);
+
+    if (H == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    *err = numerical_hessian_mt(b, H, as->cfunc, as,
+				as_info_clone, as_info_clone_free,
+				1, d);
+    if (!*err) {
+	*err = gretl_invert_symmetric_matrix(H);
+	if (*err) {
+	    gretl_errmsg_set(_("Failed to compute numerical Hessian"));
+	}
+    }
+
+    if (*err) {
+	gretl_matrix_free(H);
+	H = NULL;
+    }
+
+    return H;
+}
+
 static void as_write_big_phi (const double *b,
 			      struct as_info *as)
 {
@@ -637,8 +734,7 @@ static int as_arma_finish (MODEL *pmod,
 	gretl_matrix *Hinv;
 	double d = 0.0; /* adjust? */
 
-	Hinv = numerical_hessian_inverse(b, ainfo->nc, as->cfunc,
-					 as, d, &vcv_err);
+	Hinv = as_hessian_inverse(b, ainfo->nc, as, d, &vcv_err);
 	if (!vcv_err) {
 	    if (QML) {
 		vcv_err = arma_QML_vcv(pmod, Hinv, as, as->algo, b, s2,
@@ -772,7 +868,8 @@ static int as_arma (const double *coeff,
 
 	err = BFGS_max(b, ainfo->nc, maxit, toler,
 		       &ainfo->fncount, &ainfo->grcount,
-		       as.cfunc, C_LOGLIK, NULL, &as, NULL,
+		       as.cfunc, C_LOGLIK, as_numeric_gradient,
+		       &as, NULL,
 		       maxopt, ainfo->prn);
 
 	if (!err) {
@@ -19,6 +19,10 @@
 
 #include "libset.h"
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 #define DPDEBUG 0
 #define IVDEBUG 0
 
@@ -537,12 +541,12 @@ static void build_unit_D_matrix (ddset *dpd, int *goodobs, gretl_matrix *D)
 }
 
 static void build_unit_H_matrix (ddset *dpd, int *goodobs,
-				 gretl_matrix *D)
+				 gretl_matrix *D, gretl_matrix *H)
 {
     build_unit_D_matrix(dpd, goodobs, D);
     gretl_matrix_multiply_mod(D, GRETL_MOD_TRANSPOSE,
 			      D, GRETL_MOD_NONE,
-			      dpd->H, GRETL_MOD_NONE);
+			      H, GRETL_MOD_NONE);
 }
 
 static void make_dpdstyle_H (gretl_matrix *H, int nd)
@@ -1013,51 +1017,153 @@ static int trim_zero_inst (ddset *dpd)
     return err;
 }
 
+/* Per-thread workspace for do_units(): @A holds a partial sum of
+   Z_i H_i Z_i' over the units handled by the thread. On thread 0
+   A and H are just the ddset members; other threads get their own.
+*/
+
+typedef struct unit_work_ unit_work;
+
+struct unit_work_ {
+    gretl_matrix_block *B;
+    gretl_matrix *D;
+    gretl_matrix *H;
+    gretl_matrix *Yi;
+    gretl_matrix *Xi;
+    gretl_matrix *Zi;
+    gretl_matrix *A;
+    int err;
+};
+
 /* allocate temporary storage needed by do_units() */
 
-static int make_units_workspace (ddset *dpd, gretl_matrix **D,
-				 gretl_matrix **Yi, gretl_matrix **Xi)
+static int make_units_workspace (ddset *dpd, unit_work *w, int tnum)
 {
-    int err = 0;
+    int dpdstyle = (dpd->flags & DPD_DPDSTYLE);
+    int own = (tnum > 0);
+    int T = dpd->max_ni;
+    int nD = dpdstyle ? 1 : dpd->T;
+    int nH = (own && !dpdstyle)? T : 1;
+    int nA = own ? dpd->nz : 1;
+
+    w->B = gretl_matrix_block_new(&w->Yi, 1, T,
+				  &w->Xi, dpd->k, T,
+				  &w->Zi, dpd->nz, T,
+				  &w->D,  nD, T,
+				  &w->H,  nH, nH,
+				  &w->A,  nA, nA,
+				  NULL);
+    w->err = 0;
+
+    if (w->B == NULL) {
+	return E_ALLOC;
+    }
+
+    if (dpdstyle) {
+	/* Ox/DPD-style H matrix: D is not needed, and H
+	   does not vary by unit */
+	w->D = NULL;
+	w->H = dpd->H;
+    } else if (!own) {
+	w->H = dpd->H;
+    }
 
-    if (dpd->flags & DPD_DPDSTYLE) {
-	/* Ox/DPD-style H matrix: D is not needed */
-	*D = NULL;
+    if (own) {
+	gretl_matrix_zero(w->A);
     } else {
-	*D = gretl_matrix_alloc(dpd->T, dpd->max_ni);
-	if (*D == NULL) {
-	    return E_ALLOC;
+	w->A = dpd->A;
+    }
+
+    return 0;
+}
+
+/* Store the nonzero instrument values for the observations in
+   the columns of @Zi selected by @goodobs, in the sparse block
+   for unit @unum.
+*/
+
+static int store_unit_Z (ddset *dpd, const gretl_matrix *Zi,
+			 int *goodobs, int unum)
+{
+    zblock *zb = &dpd->Zs[unum];
+    int nobs = goodobs[0] - 1;
+    int *cols;
+    int i, j, k, n = 0;
+    double x;
+
+    if (gmm_sys(dpd)) {
+	nobs += goodobs[0];
+    }
+
+    cols = malloc(nobs * sizeof *cols);
+    if (cols == NULL) {
+	return E_ALLOC;
+    }
+
+    /* differences first, then levels */
+    for (i=2, k=0; i<=goodobs[0]; i++) {
+	cols[k++] = goodobs[i] - dpd->dcolskip;
+    }
+    if (gmm_sys(dpd)) {
+	for (i=1; i<=goodobs[0]; i++) {
+	    cols[k++] = goodobs[i] + dpd->lcol0;
 	}
     }
 
-    *Yi = gretl_matrix_alloc(1, dpd->max_ni);
-    *Xi = gretl_matrix_alloc(dpd->k, dpd->max_ni);
+    for (k=0; k<nobs; k++) {
+	if (cols[k] >= Zi->cols) {
+	    /* shouldn't happen: see stack_unit_data() */
+	    cols[k] = -1;
+	    continue;
+	}
+	for (j=0; j<dpd->nz; j++) {
+	    if (gretl_matrix_get(Zi, j, cols[k]) != 0.0) {
+		n++;
+	    }
+	}
+    }
 
-    if (*Yi == NULL || *Xi == NULL) {
-	gretl_matrix_free(*D);
-	gretl_matrix_free(*Yi);
-	gretl_matrix_free(*Xi);
-	err = E_ALLOC;
+    zb->cp = malloc((nobs + 1) * sizeof *zb->cp);
+    zb->rows = malloc(n * sizeof *zb->rows);
+    zb->val = malloc(n * sizeof *zb->val);
+
+    if (zb->cp == NULL || (n > 0 && (zb->rows == NULL || zb->val == NULL))) {
+	free(cols);
+	return E_ALLOC;
     }
 
-    return err;
+    for (k=0, n=0; k<nobs; k++) {
+	zb->cp[k] = n;
+	for (j=0; j<dpd->nz && cols[k] >= 0; j++) {
+	    x = gretl_matrix_get(Zi, j, cols[k]);
+	    if (x != 0.0) {
+		zb->rows[n] = j;
+		zb->val[n++] = x;
+	    }
+	}
+    }
+    zb->cp[nobs] = n;
+    zb->nobs = nobs;
+
+    free(cols);
+
+    return 0;
 }
 
 /* Stack the per-unit data matrices from unit @unum for future use,
-   skipping unused observations and recording the numbers of
-   observations in differences and in levels.
+   starting at row @s, skipping unused observations and recording
+   the numbers of observations in differences and in levels.
 */
 
 static void stack_unit_data (ddset *dpd,
 			     const gretl_matrix *Yi,
 			     const gretl_matrix *Xi,
-			     const gretl_matrix *Zi,
 			     int *goodobs, int unum,
-			     int *row)
+			     int s)
 {
     unit_info *unit = &dpd->ui[unum];
     double x;
-    int i, j, k, s = *row;
+    int i, j, k;
 
     for (i=2; i<=goodobs[0]; i++) {
 	k = goodobs[i] - dpd->dcolskip;
@@ -1066,10 +1172,6 @@ static void stack_unit_data (ddset *dpd,
 	    x = gretl_matrix_get(Xi, j, k);
 	    gretl_matrix_set(dpd->X, s, j, x);
 	}
-	for (j=0; j<dpd->nz; j++) {
-	    x = gretl_matrix_get(Zi, j, k);
-	    gretl_matrix_set(dpd->ZT, j, s, x);
-	}
 	s++;
     }
 
@@ -1088,6 +1190,7 @@ static void stack_unit_data (ddset *dpd,
 		fprintf(stderr, "*** stack_unit_data: reading off "
 			"end of Yi (k=%d, Yi->cols=%d)\n", k, Yi->cols);
 		fprintf(stderr, " at goodobs[%d] = %d\n", i, goodobs[i]);
+		s++;
 		continue;
 	    }
 	    gretl_vector_set(dpd->Y, s, Yi->val[k]);
@@ -1095,10 +1198,6 @@ static void stack_unit_data (ddset *dpd,
 		x = gretl_matrix_get(Xi, j, k);
 		gretl_matrix_set(dpd->X, s, j, x);
 	    }
-	    for (j=0; j<dpd->nz; j++) {
-		x = gretl_matrix_get(Zi, j, k);
-		gretl_matrix_set(dpd->ZT, j, s, x);
-	    }
 	    s++;
 	}
 
@@ -1106,12 +1205,42 @@ static void stack_unit_data (ddset *dpd,
 	unit->nlev = goodobs[0];
 	unit->nobs += unit->nlev;
     }
+}
 
-#if WRITE_MATRICES
-    gretl_matrix_write_as_text(dpd->ZT, "dpdZT.mat", 0);
+/* Process unit @i: build its data and instrument matrices,
+   add Z_i H_i Z_i' into the accumulator in @w, and stack
+   the data starting at row @s.
+*/
+
+static int do_one_unit (ddset *dpd, const DATASET *dset,
+			int *goodobs, int i, int s,
+			unit_work *w)
+{
+    int t = data_index(dpd, i);
+    int err;
+
+    err = build_Y(dpd, goodobs, dset, t, w->Yi);
+    if (err) {
+	return err;
+    }
+
+    build_X(dpd, goodobs, dset, t, w->Xi);
+    build_Z(dpd, goodobs, dset, t, w->Zi);
+#if DPDEBUG
+    gretl_matrix_print(w->Yi, "do_units: Yi");
+    gretl_matrix_print(w->Xi, "do_units: Xi");
+    gretl_matrix_print(w->Zi, "do_units: Zi");
 #endif
+    if (w->D != NULL) {
+	build_unit_H_matrix(dpd, goodobs, w->D, w->H);
+    }
+    gretl_matrix_qform(w->Zi, GRETL_MOD_NONE,
+		       w->H, w->A, GRETL_MOD_CUMULATE);
+
+    /* store the individual data matrices for future use */
+    stack_unit_data(dpd, w->Yi, w->Xi, goodobs, i, s);
 
-    *row = s;
+    return store_unit_Z(dpd, w->Zi, goodobs, i);
 }
 
 /* Main driver for system GMM: the core is a loop across
@@ -1120,30 +1249,62 @@ static void stack_unit_data (ddset *dpd,
 
    At this point we have already done the observations
    accounts, which are recorded in the Goodobs lists.
+
+   Since the units are independent we can farm them out
+   to threads when OpenMP is available: each thread cumulates
+   its own share of A, and the partial sums are added at the
+   end. Each unit's starting row in the stacked data is worked
+   out in advance.
 */
 
 static int do_units (ddset *dpd, const DATASET *dset,
 		     int **Goodobs)
 {
-#if DPDEBUG
-    char ystr[16];
+    unit_work *uw;
+    int *srow;
+    int nt = 1;
+    int i, s, err = 0;
+
+#if defined(_OPENMP)
+    if (dpd->N > 1) {
+	guint64 fpm = (guint64) dpd->N * dpd->nz * dpd->nz * dpd->max_ni;
+
+	if (libset_use_openmp(fpm)) {
+	    nt = get_omp_n_threads();
+	}
+    }
 #endif
-    gretl_matrix *D = NULL;
-    gretl_matrix *Yi = NULL;
-    gretl_matrix *Xi = NULL;
-    gretl_matrix *Zi = NULL;
-    int i, t, Yrow;
-    int err = 0;
 
-    err = make_units_workspace(dpd, &D, &Yi, &Xi);
-    if (err) {
-	return err;
+    srow = malloc(dpd->N * sizeof *srow);
+    uw = calloc(nt, sizeof *uw);
+    if (srow == NULL || uw == NULL) {
+	free(srow);
+	free(uw);
+	return E_ALLOC;
+    }
+
+    for (i=0, s=0; i<dpd->N; i++) {
+	int *goodobs = Goodobs[i];
+
+	srow[i] = s;
+	if (goodobs[0] > 1) {
+	    s += goodobs[0] - 1;
+	    if (gmm_sys(dpd)) {
+		s += goodobs[0];
+	    }
+	}
     }
 
-    Zi = dpd->Zi;
-    gretl_matrix_reuse(Zi, dpd->nz, dpd->max_ni);
+    /* initialize cumulators */
+    gretl_matrix_zero(dpd->XZ);
+    gretl_matrix_zero(dpd->A);
+    gretl_matrix_zero(dpd->ZY);
+
+    for (i=0; i<nt && !err; i++) {
+	err = make_units_workspace(dpd, &uw[i], i);
+    }
 
-    if (D == NULL) {
+    if (!err && uw[0].D == NULL) {
 	/* the H matrix will not vary by unit */
 	int tau = dpd->t2max - dpd->t1min + 1;
 
@@ -1154,50 +1315,38 @@ static int do_units (ddset *dpd, const DATASET *dset,
 	make_dpdstyle_H(dpd->H, tau);
     }
 
-    /* initialize cumulators */
-    gretl_matrix_zero(dpd->XZ);
-    gretl_matrix_zero(dpd->A);
-    gretl_matrix_zero(dpd->ZY);
-
-    /* initialize data stacker */
-    Yrow = 0;
-
 #if DPDEBUG
     /* this should not be necessary if stack_unit_data() is
        working correctly */
     gretl_matrix_zero(dpd->Y);
     gretl_matrix_zero(dpd->X);
-    gretl_matrix_zero(dpd->ZT);
 #endif
 
-    for (i=0; i<dpd->N; i++) {
-	int *goodobs = Goodobs[i];
-	int Ti = goodobs[0] - 1;
+    if (!err && nt > 1) {
+#if defined(_OPENMP)
+#pragma omp parallel for private(i) schedule(dynamic, 64) num_threads(nt)
+	for (i=0; i<dpd->N; i++) {
+	    unit_work *w = &uw[omp_get_thread_num()];
 
-	if (Ti == 0) {
-	    continue;
-	}
-
-	t = data_index(dpd, i);
-	err = build_Y(dpd, goodobs, dset, t, Yi);
-	if (err) {
-	    break;
+	    if (!w->err && Goodobs[i][0] > 1) {
+		w->err = do_one_unit(dpd, dset, Goodobs[i], i, srow[i], w);
+	    }
 	}
-	build_X(dpd, goodobs, dset, t, Xi);
-	build_Z(dpd, goodobs, dset, t, Zi);
-#if DPDEBUG
-	sprintf(ystr, "do_units: Y_%d", i);
-	gretl_matrix_print(Yi, ystr);
-	gretl_matrix_print(Xi, "do_units: Xi");
-	gretl_matrix_print(Zi, "do_units: Zi");
 #endif
-	if (D != NULL) {
-	    build_unit_H_matrix(dpd, goodobs, D);
+	for (i=0; i<nt; i++) {
+	    if (uw[i].err && !err) {
+		err = uw[i].err;
+	    }
+	    if (i > 0 && !err) {
+		gretl_matrix_add_to(dpd->A, uw[i].A);
+	    }
+	}
+    } else if (!err) {
+	for (i=0; i<dpd->N && !err; i++) {
+	    if (Goodobs[i][0] > 1) {
+		err = do_one_unit(dpd, dset, Goodobs[i], i, srow[i], &uw[0]);
+	    }
 	}
-	gretl_matrix_qform(Zi, GRETL_MOD_NONE,
-			   dpd->H, dpd->A, GRETL_MOD_CUMULATE);
-	/* stack the individual data matrices for future use */
-	stack_unit_data(dpd, Yi, Xi, Zi, goodobs, i, &Yrow);
     }
 
 #if DPDEBUG
@@ -1210,9 +1359,11 @@ static int do_units (ddset *dpd, const DATASET *dset,
     gretl_matrix_write_as_text(dpd->X, "dpdX.mat", 0);
 #endif
 
-    gretl_matrix_free(D);
-    gretl_matrix_free(Yi);
-    gretl_matrix_free(Xi);
+    for (i=0; i<nt; i++) {
+	gretl_matrix_block_destroy(uw[i].B);
+    }
+    free(uw);
+    free(srow);
 
     return err;
 }
@@ -20,6 +20,8 @@
 #include "libgretl.h"
 #include "version.h"
 #include "nonparam.h"
+#include "libset.h"
+#include "gretl_cmatrix.h"
 
 #define KDEBUG 0
 
@@ -30,6 +32,30 @@
 #define ROOT5  2.23606797749979     /* sqrt(5) */
 #define EPMULT 0.3354101966249685   /* 3 over (4 * sqrt(5)) */
 
+/* Settings for the binned approximation, which is used (unless
+   "kdensity_binned" is set to off) when the number of observations
+   is at least KBIN_MINOBS. The data are linearly binned onto a grid
+   with step d no greater than h / KBIN_RATIO (h being the bandwidth),
+   subject to the grid having at most KBIN_MAXGRID points, and the
+   bin counts are convolved with the kernel via FFT. The Gaussian
+   kernel is truncated at KBIN_GCUT standard deviations.
+
+   Linear binning amounts to linear interpolation of each kernel
+   term between grid points, so the absolute error in the estimated
+   density is bounded by d^2 max|K''| / (8 h^3). For the Gaussian
+   kernel max|K''| = K(0), so with d = h/20 the error is at most
+   1/3200 of K(0)/h, the largest value the estimate could take. The
+   Epanechnikov kernel has max|K''| = 2 * EPMULT / 5 except at its
+   end-points, where the contribution of the few observations lying
+   within d of the end of the support adds an error of the same
+   order.
+*/
+
+#define KBIN_MINOBS  10000
+#define KBIN_RATIO   20
+#define KBIN_MAXGRID (1 << 20)
+#define KBIN_GCUT    8.0
+
 enum {
     GAUSSIAN_KERNEL,
     EPANECHNIKOV_KERNEL
@@ -86,15 +112,168 @@ static double kernel (kernel_info *kinfo, double x0)
     return den;
 }
 
+static double kernel_weight (kernel_info *kinfo, double z)
+{
+    if (kinfo->type == GAUSSIAN_KERNEL) {
+	return fabs(z) > KBIN_GCUT ? 0.0 : normal_pdf(z);
+    } else {
+	return ep_pdf(z);
+    }
+}
+
+/* Binned approximation to the density at the kn + 1 points
+   xmin, xmin + xstep, ..., xmax: see the comment on KBIN_MINOBS
+   above. Writes the estimates into @f.
+*/
+
+static int binned_density (kernel_info *kinfo, double *f)
+{
+    gretl_matrix *c = NULL, *k = NULL;
+    gretl_matrix *fc = NULL, *fk = NULL;
+    gretl_matrix *conv = NULL;
+    double d, pos, w, cut, ar, ai, br, bi;
+    int r, M, L, P, i, j;
+    int err = 0;
+
+    /* refinement of the output grid */
+    d = ceil(KBIN_RATIO * kinfo->xstep / kinfo->h);
+    r = (KBIN_MAXGRID - 1) / kinfo->kn;
+    if (d < r) {
+	r = d < 1 ? 1 : (int) d;
+    }
+    M = kinfo->kn * r + 1;
+    d = kinfo->xstep / r;
+
+    /* maximal kernel lag, in grid steps */
+    cut = (kinfo->type == GAUSSIAN_KERNEL)? KBIN_GCUT : ROOT5;
+    if (cut * kinfo->h / d >= M - 1) {
+	L = M - 1;
+    } else {
+	L = (int) ceil(cut * kinfo->h / d);
+    }
+
+    /* FFT length: enough to avoid wrap-around */
+    P = 2;
+    while (P < M + L) {
+	P *= 2;
+    }
+
+    c = gretl_zero_matrix_new(P, 1);
+    k = gretl_zero_matrix_new(P, 1);
+    if (c == NULL || k == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    /* linear binning */
+    for (i=0; i<kinfo->n; i++) {
+	pos = (kinfo->x[i] - kinfo->xmin) / d;
+	j = (int) floor(pos);
+	if (j < 0) {
+	    c->val[0] += 1.0;
+	} else if (j >= M - 1) {
+	    c->val[M-1] += 1.0;
+	} else {
+	    w = pos - j;
+	    c->val[j] += 1.0 - w;
+	    c->val[j+1] += w;
+	}
+    }
+
+    /* the kernel at lags -L to L, negative lags wrapped */
+    k->val[0] = kernel_weight(kinfo, 0);
+    for (j=1; j<=L; j++) {
+	k->val[j] = k->val[P-j] = kernel_weight(kinfo, j * d / kinfo->h);
+    }
+
+    fc = gretl_matrix_fft(c, 0, &err);
+    if (!err) {
+	fk = gretl_matrix_fft(k, 0, &err);
+    }
+    if (err) {
+	goto bailout;
+    }
+
+    /* complex product, written into fc */
+    for (i=0; i<P; i++) {
+	ar = gretl_matrix_get(fc, i, 0);
+	ai = gretl_matrix_get(fc, i, 1);
+	br = gretl_matrix_get(fk, i, 0);
+	bi = gretl_matrix_get(fk, i, 1);
+	gretl_matrix_set(fc, i, 0, ar * br - ai * bi);
+	gretl_matrix_set(fc, i, 1, ar * bi + ai * br);
+    }
+
+    conv = gretl_matrix_ffti(fc, &err);
+
+    if (!err) {
+	double den = kinfo->h * kinfo->n;
+
+	for (i=0; i<=kinfo->kn; i++) {
+	    /* guard against FFT round-off in the tails */
+	    f[i] = MAX(conv->val[i*r], 0.0) / den;
+	}
+    }
+
+ bailout:
+
+    gretl_matrix_free(c);
+    gretl_matrix_free(k);
+    gretl_matrix_free(fc);
+    gretl_matrix_free(fk);
+    gretl_matrix_free(conv);
+
+    return err;
+}
+
+/* Returns an array holding the estimated density at the kn + 1
+   points of the grid, computed either exactly or by binning.
+*/
+
+static double *density_values (kernel_info *kinfo, int *err)
+{
+    double *f = malloc((kinfo->kn + 1) * sizeof *f);
+    double xt;
+    int t;
+
+    if (f == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    if (kinfo->n >= KBIN_MINOBS && libset_get_bool(KDENSITY_BINNED)) {
+	*err = binned_density(kinfo, f);
+	if (!*err) {
+	    return f;
+	}
+	/* fall back on the exact calculation */
+	*err = 0;
+    }
+
+    xt = kinfo->xmin;
+    for (t=0; t<=kinfo->kn; t++) {
+	f[t] = kernel(kinfo, xt);
+	xt += kinfo->xstep;
+    }
+
+    return f;
+}
+
 static int density_plot (kernel_info *kinfo, const char *vname)
 {
     FILE *fp;
     char tmp[128];
-    double xt, xdt;
+    double *f, xt;
     int t, err = 0;
+
+    f = density_values(kinfo, &err);
+    if (err) {
+	return err;
+    }
     
     fp = open_plot_input_file(PLOT_KERNEL, 0, &err);
     if (err) {
+	free(f);
 	return err;
     }
 
@@ -117,14 +296,15 @@ static int density_plot (kernel_info *kinfo, const char *vname)
 
     xt = kinfo->xmin;
     for (t=0; t<=kinfo->kn; t++) {
-	xdt = kernel(kinfo, xt);
-	fprintf(fp, "%g %g\n", xt, xdt);
+	fprintf(fp, "%g %g\n", xt, f[t]);
 	xt += kinfo->xstep;
     }
     fputs("e\n", fp);
 
     gretl_pop_c_numeric_locale();
 
+    free(f);
+
     return finalize_plot_input_file(fp);
 }
 
@@ -132,23 +312,30 @@ static gretl_matrix *density_matrix (kernel_info *kinfo,
 				     int *err)
 {
     gretl_matrix *m;
-    double xt, xdt;
+    double *f, xt;
     int t;
 
+    f = density_values(kinfo, err);
+    if (*err) {
+	return NULL;
+    }
+
     m = gretl_matrix_alloc(kinfo->kn + 1, 2);
     if (m == NULL) {
 	*err = E_ALLOC;
+	free(f);
 	return NULL;
     }
     
     xt = kinfo->xmin;
     for (t=0; t<=kinfo->kn; t++) {
-	xdt = kernel(kinfo, xt);
 	gretl_matrix_set(m, t, 0, xt);
-	gretl_matrix_set(m, t, 1, xdt);
+	gretl_matrix_set(m, t, 1, f[t]);
 	xt += kinfo->xstep;
     }
 
+    free(f);
+
     return m;
 }
 
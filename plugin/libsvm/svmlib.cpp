@@ -198,6 +198,332 @@ void Cache::swap_index(int i, int j)
     }
 }
 
+//
+// Dense storage of data rows (gretl addition)
+//
+// When the data are not too sparse we copy the rows into a
+// contiguous l x dim array, so that the linear, polynomial, RBF
+// and sigmoid kernels can be evaluated without chasing
+// index/value pairs, and the inner loops can be vectorized
+//
+#define DENSE_MIN_FILL 0.5          // min. ratio of non-zeros to l * dim
+#define DENSE_MAX_BYTES (1L << 30)  // max. size of the dense array
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+# define OMP_SIMD_SUM _Pragma("omp simd reduction(+:sum)")
+#else
+# define OMP_SIMD_SUM
+#endif
+
+static bool dense_kernel(int kernel_type)
+{
+    return kernel_type == LINEAR || kernel_type == POLY ||
+	kernel_type == RBF || kernel_type == SIGMOID;
+}
+
+// Return the number of columns for dense storage of the @l rows
+// in @x, or 0 if the data are not suitable
+
+static int dense_dim(const svm_node * const *x, int l)
+{
+    double nnz = 0;
+    int dim = 0;
+
+    for (int i=0; i<l; i++) {
+	for (const svm_node *p = x[i]; p->index != -1; p++) {
+	    if (p->index < 1) return 0;
+	    if (p->index > dim) dim = p->index;
+	    nnz++;
+	}
+    }
+
+    if (dim == 0 || (double) l * dim * sizeof(double) > DENSE_MAX_BYTES ||
+	nnz < DENSE_MIN_FILL * l * dim)
+	return 0;
+
+    return dim;
+}
+
+// Write the row @px into @d, of length @dim; return the sum
+// of squares of any elements with indices greater than @dim
+
+static double dense_fill_row(double *d, const svm_node *px, int dim)
+{
+    double extra = 0;
+
+    memset(d, 0, dim * sizeof(double));
+    for (; px->index != -1; px++) {
+	if (px->index <= dim)
+	    d[px->index - 1] = px->value;
+	else
+	    extra += px->value * px->value;
+    }
+
+    return extra;
+}
+
+static double *dense_fill(const svm_node * const *x, int l, int dim)
+{
+    double *d = Malloc(double, (size_t) l * dim);
+
+    if (d != NULL) {
+	for (int i=0; i<l; i++)
+	    dense_fill_row(d + (size_t) i * dim, x[i], dim);
+    }
+
+    return d;
+}
+
+static inline double dense_dot(const double *px, const double *py, int n)
+{
+    double sum = 0;
+
+    OMP_SIMD_SUM
+    for (int i=0; i<n; i++)
+	sum += px[i] * py[i];
+    return sum;
+}
+
+static inline double dense_dist_2_sqr(const double *px, const double *py, int n)
+{
+    double sum = 0;
+
+    OMP_SIMD_SUM
+    for (int i=0; i<n; i++)
+	sum += (px[i] - py[i]) * (px[i] - py[i]);
+    return sum;
+}
+
+//
+// Shared kernel-row cache (gretl addition)
+//
+// In cross validation and parameter search the same rows of the
+// kernel matrix are needed by each fold and by each grid point
+// with the same kernel parameters, but the per-problem Cache
+// above is discarded along with the problem. An svm_kcache is
+// built on the full problem and is consulted (via the
+// svm_parameter member kcache) by the Kernel of any problem
+// whose rows are drawn from the full one. It holds whole rows
+// of K, keyed by (row of the full problem, kernel parameters),
+// with LRU replacement, and it can be used by several training
+// runs at once.
+//
+#define KC_MAXPAR 64    // max. number of kernel parameter sets
+#define KC_LOCAL_MB 4.0 // per-problem Cache size when sharing, in MB
+
+struct kc_entry
+{
+    kc_entry *prev, *next; // a circular list
+    Qfloat *data;          // K(x[row], x[j]) for j in [0, l)
+    int row;
+    int par;
+};
+
+struct kc_ptr
+{
+    const svm_node *x;
+    int i;
+};
+
+struct svm_kcache
+{
+    int l;                  // number of rows in the full problem
+    const svm_node **x;     // the rows (not owned)
+    kc_ptr *ptrs;           // row pointers sorted, for mapping subproblems
+    double *xd_space;       // dense copy of the rows, or NULL
+    int dim;                // number of columns in xd_space
+    double *x_square;       // squared norms, computed on demand
+    long int size;          // remaining capacity in rows
+    int npar;
+    svm_parameter par[KC_MAXPAR];
+    kc_entry **slot[KC_MAXPAR]; // slot[p][row], or NULL if not cached
+    kc_entry lru_head;
+    double requests;
+    double hits;
+#if defined(_OPENMP)
+    omp_lock_t lock;
+#endif
+};
+
+static inline void kc_lock(svm_kcache *kc)
+{
+#if defined(_OPENMP)
+    omp_set_lock(&kc->lock);
+#endif
+}
+
+static inline void kc_unlock(svm_kcache *kc)
+{
+#if defined(_OPENMP)
+    omp_unset_lock(&kc->lock);
+#endif
+}
+
+static void kc_lru_delete(kc_entry *h)
+{
+    h->prev->next = h->next;
+    h->next->prev = h->prev;
+}
+
+static void kc_lru_insert(svm_kcache *kc, kc_entry *h)
+{
+    h->next = &kc->lru_head;
+    h->prev = kc->lru_head.prev;
+    h->prev->next = h;
+    h->next->prev = h;
+}
+
+static int kc_ptr_compare(const void *a, const void *b)
+{
+    const svm_node *pa = ((const kc_ptr *) a)->x;
+    const svm_node *pb = ((const kc_ptr *) b)->x;
+
+    return (pa > pb) - (pa < pb);
+}
+
+svm_kcache *svm_kcache_new(const svm_problem *prob, double size)
+{
+    svm_kcache *kc = Malloc(svm_kcache, 1);
+    int l = prob->l;
+
+    if (kc == NULL) return NULL;
+
+    kc->l = l;
+    kc->x = (const svm_node **) prob->x;
+    kc->ptrs = Malloc(kc_ptr, l);
+    if (kc->ptrs == NULL) {
+	free(kc);
+	return NULL;
+    }
+    for (int i=0; i<l; i++) {
+	kc->ptrs[i].x = prob->x[i];
+	kc->ptrs[i].i = i;
+    }
+    qsort(kc->ptrs, l, sizeof(kc_ptr), kc_ptr_compare);
+
+    kc->dim = dense_dim(prob->x, l);
+    kc->xd_space = kc->dim > 0 ? dense_fill(prob->x, l, kc->dim) : NULL;
+    if (kc->xd_space == NULL)
+	kc->dim = 0;
+    kc->x_square = NULL;
+
+    kc->size = (long int) (size * (1<<20) / (sizeof(Qfloat) * (double) l));
+    kc->size = max(kc->size, 2L);
+    kc->npar = 0;
+    kc->lru_head.next = kc->lru_head.prev = &kc->lru_head;
+    kc->requests = kc->hits = 0;
+#if defined(_OPENMP)
+    omp_init_lock(&kc->lock);
+#endif
+
+    return kc;
+}
+
+void svm_kcache_free(svm_kcache *kc)
+{
+    if (kc == NULL) return;
+
+    for (kc_entry *h = kc->lru_head.next; h != &kc->lru_head; ) {
+	kc_entry *next = h->next;
+	free(h->data);
+	free(h);
+	h = next;
+    }
+    for (int p=0; p<kc->npar; p++)
+	free(kc->slot[p]);
+    free(kc->ptrs);
+    free(kc->xd_space);
+    free(kc->x_square);
+#if defined(_OPENMP)
+    omp_destroy_lock(&kc->lock);
+#endif
+    free(kc);
+}
+
+void svm_kcache_stats(const svm_kcache *kc, double *requests, double *hits)
+{
+    *requests = kc->requests;
+    *hits = kc->hits;
+}
+
+// Find the row of the full problem corresponding to each of the
+// @l rows in @x; return NULL if any of them is not found
+
+static int *kc_map_rows(const svm_kcache *kc, const svm_node * const *x, int l)
+{
+    int *g = new int[l];
+
+    for (int i=0; i<l; i++) {
+	kc_ptr key, *p;
+
+	key.x = x[i];
+	p = (kc_ptr *) bsearch(&key, kc->ptrs, kc->l, sizeof(kc_ptr),
+			       kc_ptr_compare);
+	if (p == NULL) {
+	    delete[] g;
+	    return NULL;
+	}
+	g[i] = p->i;
+    }
+
+    return g;
+}
+
+// Return the index of the kernel parameter set in @param,
+// registering it if need be, or -1 if there's no room
+
+static int kc_param_index(svm_kcache *kc, const svm_parameter& param)
+{
+    int p, ret = -1;
+
+    kc_lock(kc);
+    for (p=0; p<kc->npar; p++) {
+	const svm_parameter *kp = &kc->par[p];
+
+	if (kp->kernel_type == param.kernel_type &&
+	    kp->degree == param.degree &&
+	    kp->gamma == param.gamma &&
+	    kp->coef0 == param.coef0) {
+	    ret = p;
+	    break;
+	}
+    }
+    if (ret < 0 && kc->npar < KC_MAXPAR) {
+	kc_entry **slot = (kc_entry **) calloc(kc->l, sizeof(kc_entry *));
+
+	if (slot != NULL) {
+	    ret = kc->npar;
+	    kc->par[ret] = param;
+	    kc->par[ret].kcache = NULL;
+	    kc->slot[ret] = slot;
+	    kc->npar += 1;
+	}
+    }
+    if (ret >= 0 && kc->x_square == NULL &&
+	(param.kernel_type == RBF || param.kernel_type == PERC ||
+	 param.kernel_type == EXPO)) {
+	double *xsq = Malloc(double, kc->l);
+	int dim = kc->dim;
+
+	for (int i=0; xsq != NULL && i<kc->l; i++) {
+	    if (kc->xd_space != NULL) {
+		const double *xi = kc->xd_space + (size_t) i * dim;
+		xsq[i] = dense_dot(xi, xi, dim);
+	    } else {
+		xsq[i] = 0;
+		for (const svm_node *px = kc->x[i]; px->index != -1; px++)
+		    xsq[i] += px->value * px->value;
+	    }
+	}
+	kc->x_square = xsq;
+	if (xsq == NULL)
+	    ret = -1;
+    }
+    kc_unlock(kc);
+
+    return ret;
+}
+
 //
 // Kernel evaluation
 //
@@ -226,15 +552,28 @@ public:
     {
 	swap(x[i], x[j]);
 	if (x_square) swap(x_square[i], x_square[j]);
+	if (xd) swap(xd[i], xd[j]);
+	if (gidx) swap(gidx[i], gidx[j]);
     }
 protected:
 
     double (Kernel::*kernel_function)(int i, int j) const;
+    bool shared_row(int i, int start, int len, Qfloat *data) const;
 
 private:
     const svm_node **x;
     double *x_square;
 
+    // dense variant (gretl)
+    const double **xd;
+    double *xd_space;
+    int dim;
+
+    // shared cache (gretl): gidx holds the rows of the full problem
+    svm_kcache *kc;
+    int *gidx;
+    int kpar;
+
     // svm_parameter
     const int kernel_type;
     const int degree;
@@ -245,6 +584,7 @@ private:
     // next two functions added
     static double dot(const svm_node *px, const svm_node *py);
     static double dist_2_sqr(const svm_node * px, const svm_node * py);
+    static void kc_fill_row(const svm_kcache *kc, int p, int g, Qfloat *row);
 
     // also added
     inline double dist_2_sqr(int i, int j) const
@@ -285,6 +625,24 @@ private:
     {
 	return exp(-gamma*sqrt(dist_2_sqr(i, j)));
     }
+
+    // dense variants (gretl)
+    double kernel_linear_dense(int i, int j) const
+    {
+	return dense_dot(xd[i], xd[j], dim);
+    }
+    double kernel_poly_dense(int i, int j) const
+    {
+	return powi(gamma*dense_dot(xd[i], xd[j], dim)+coef0, degree);
+    }
+    double kernel_rbf_dense(int i, int j) const
+    {
+	return exp(-gamma*(x_square[i]+x_square[j]-2*dense_dot(xd[i], xd[j], dim)));
+    }
+    double kernel_sigmoid_dense(int i, int j) const
+    {
+	return tanh(gamma*dense_dot(xd[i], xd[j], dim)+coef0);
+    }
 };
 
 Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
@@ -319,10 +677,57 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 
     clone(x, x_, l);
 
+    kc = param.kcache;
+    gidx = 0;
+    kpar = -1;
+    if (kc != NULL && (gidx = kc_map_rows(kc, x_, l)) != NULL)
+	kpar = kc_param_index(kc, param);
+    if (kpar < 0) {
+	delete[] gidx;
+	gidx = 0;
+	kc = 0;
+    }
+
+    xd = 0;
+    xd_space = 0;
+    if (kc != NULL && kc->xd_space != NULL && dense_kernel(kernel_type)) {
+	// borrow the shared cache's dense rows
+	dim = kc->dim;
+	xd = new const double *[l];
+	for (int i=0; i<l; i++)
+	    xd[i] = kc->xd_space + (size_t) gidx[i] * dim;
+    } else {
+	dim = dense_kernel(kernel_type) ? dense_dim(x_, l) : 0;
+	if (dim > 0)
+	    xd_space = dense_fill(x_, l, dim);
+	if (xd_space != NULL) {
+	    xd = new const double *[l];
+	    for (int i=0; i<l; i++)
+		xd[i] = xd_space + (size_t) i * dim;
+	}
+    }
+
+    if (xd != NULL) {
+	switch(kernel_type) {
+	case LINEAR:
+	    kernel_function = &Kernel::kernel_linear_dense;
+	    break;
+	case POLY:
+	    kernel_function = &Kernel::kernel_poly_dense;
+	    break;
+	case RBF:
+	    kernel_function = &Kernel::kernel_rbf_dense;
+	    break;
+	case SIGMOID:
+	    kernel_function = &Kernel::kernel_sigmoid_dense;
+	    break;
+	}
+    }
+
     if (kernel_type == RBF || kernel_type == PERC || kernel_type == EXPO) {
 	x_square = new double[l];
 	for (int i=0; i<l; i++)
-	    x_square[i] = dot(x[i], x[i]);
+	    x_square[i] = xd ? dense_dot(xd[i], xd[i], dim) : dot(x[i], x[i]);
     } else
 	x_square = 0;
 }
@@ -331,6 +736,9 @@ Kernel::~Kernel()
 {
     delete[] x;
     delete[] x_square;
+    delete[] xd;
+    free(xd_space);
+    delete[] gidx;
 }
 
 double Kernel::dot(const svm_node *px, const svm_node *py)
@@ -444,6 +852,151 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
     }
 }
 
+// Compute row @g of the kernel matrix for the full problem held
+// by @kc, using kernel parameter set @p; the formulas match those
+// of the member functions above
+
+void Kernel::kc_fill_row(const svm_kcache *kc, int p, int g, Qfloat *row)
+{
+    const svm_parameter& kp = kc->par[p];
+    const double *xsq = kc->x_square;
+    int l = kc->l;
+    int j;
+
+    if (kc->xd_space != NULL && dense_kernel(kp.kernel_type)) {
+	int dim = kc->dim;
+	const double *xg = kc->xd_space + (size_t) g * dim;
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(j) schedule(guided)
+#endif
+	for (j=0; j<l; j++) {
+	    double d = dense_dot(xg, kc->xd_space + (size_t) j * dim, dim);
+
+	    switch(kp.kernel_type) {
+	    case LINEAR:
+		row[j] = (Qfloat) d;
+		break;
+	    case POLY:
+		row[j] = (Qfloat) powi(kp.gamma*d+kp.coef0, kp.degree);
+		break;
+	    case RBF:
+		row[j] = (Qfloat) exp(-kp.gamma*(xsq[g]+xsq[j]-2*d));
+		break;
+	    default: // SIGMOID
+		row[j] = (Qfloat) tanh(kp.gamma*d+kp.coef0);
+		break;
+	    }
+	}
+	return;
+    }
+
+    const svm_node *xg = kc->x[g];
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(j) schedule(guided)
+#endif
+    for (j=0; j<l; j++) {
+	const svm_node *xj = kc->x[j];
+	double d2;
+
+	switch(kp.kernel_type) {
+	case LINEAR:
+	    row[j] = (Qfloat) dot(xg, xj);
+	    break;
+	case POLY:
+	    row[j] = (Qfloat) powi(kp.gamma*dot(xg, xj)+kp.coef0, kp.degree);
+	    break;
+	case RBF:
+	    row[j] = (Qfloat) exp(-kp.gamma*(xsq[g]+xsq[j]-2*dot(xg, xj)));
+	    break;
+	case SIGMOID:
+	    row[j] = (Qfloat) tanh(kp.gamma*dot(xg, xj)+kp.coef0);
+	    break;
+	case STUMP:
+	    row[j] = (Qfloat) (-dist_1(xg, xj)+kp.coef0);
+	    break;
+	case LAPLACE:
+	    row[j] = (Qfloat) exp(-kp.gamma*dist_1(xg, xj));
+	    break;
+	default: // PERC, EXPO
+	    d2 = xsq[g]+xsq[j]-2*dot(xg, xj);
+	    d2 = d2 > 0.0 ? d2 : 0.0;
+	    if (kp.kernel_type == PERC)
+		row[j] = (Qfloat) (-sqrt(d2)+kp.coef0);
+	    else
+		row[j] = (Qfloat) exp(-kp.gamma*sqrt(d2));
+	    break;
+	}
+    }
+}
+
+// Write K(i, j) for j in [start, len) into @data, taking the row
+// from the shared cache if possible, otherwise computing the full
+// row and adding it to the cache. Returns false if there's no
+// shared cache.
+
+bool Kernel::shared_row(int i, int start, int len, Qfloat *data) const
+{
+    if (kc == NULL) return false;
+
+    int g = gidx[i];
+    kc_entry *h;
+    Qfloat *row;
+    int j;
+
+    kc_lock(kc);
+    kc->requests += 1;
+    h = kc->slot[kpar][g];
+    if (h != NULL) {
+	kc->hits += 1;
+	kc_lru_delete(h);
+	kc_lru_insert(kc, h);
+	for (j=start; j<len; j++)
+	    data[j] = h->data[gidx[j]];
+	kc_unlock(kc);
+	return true;
+    }
+    kc_unlock(kc);
+
+    // compute the row outside of the lock
+    row = Malloc(Qfloat, kc->l);
+    if (row == NULL) {
+	for (j=start; j<len; j++)
+	    data[j] = (Qfloat)(this->*kernel_function)(i, j);
+	return true;
+    }
+    kc_fill_row(kc, kpar, g, row);
+    for (j=start; j<len; j++)
+	data[j] = row[gidx[j]];
+
+    kc_lock(kc);
+    h = kc->slot[kpar][g] == NULL ? Malloc(kc_entry, 1) : NULL;
+    if (h != NULL) {
+	while (kc->size < 1) {
+	    kc_entry *old = kc->lru_head.next;
+
+	    kc_lru_delete(old);
+	    kc->slot[old->par][old->row] = NULL;
+	    free(old->data);
+	    free(old);
+	    kc->size += 1;
+	}
+	h->data = row;
+	h->row = g;
+	h->par = kpar;
+	kc->slot[kpar][g] = h;
+	kc_lru_insert(kc, h);
+	kc->size -= 1;
+    } else {
+	// another thread got there first, or out of memory
+	free(row);
+    }
+    kc_unlock(kc);
+
+    return true;
+}
+
 // An SMO algorithm in Fan et al., JMLR 6(2005), p. 1889--1918
 // Solves:
 //
@@ -1220,6 +1773,22 @@ double Solver_NU::calculate_rho()
     return (r1-r2)/2;
 }
 
+//
+// Size in bytes for a problem's own Cache: when a shared kernel
+// cache is in use it already takes cache_size, and several
+// problems may be running at once, so the per-problem Cache,
+// which then mostly holds rows copied from the shared one, gets
+// a small fixed budget
+//
+static long int local_cache_bytes(const svm_parameter& param)
+{
+    double mb = param.cache_size;
+
+    if (param.kcache != NULL && mb > KC_LOCAL_MB)
+	mb = KC_LOCAL_MB;
+    return (long int)(mb*(1<<20));
+}
+
 //
 // Q matrices for various formulations
 //
@@ -1229,7 +1798,7 @@ public:
     SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_)
 	:Kernel(prob.l, prob.x, param) {
 	clone(y, y_, prob.l);
-	cache = new Cache(prob.l, (long int)(param.cache_size*(1<<20)));
+	cache = new Cache(prob.l, local_cache_bytes(param));
 	QD = new double[prob.l];
 	for (int i=0; i<prob.l; i++)
 	    QD[i] = (this->*kernel_function)(i, i);
@@ -1240,6 +1809,11 @@ public:
 	Qfloat *data;
 	int start, j;
 	if ((start = cache->get_data(i, &data, len)) < len) {
+	    if (shared_row(i, start, len, data)) {
+		for (j=start; j<len; j++)
+		    data[j] *= y[i]*y[j];
+		return data;
+	    }
 #if defined(_OPENMP)
 #pragma omp parallel for private(j) schedule(guided)
 #endif
@@ -1278,7 +1852,7 @@ class ONE_CLASS_Q: public Kernel
 public:
     ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param) {
-	cache = new Cache(prob.l, (long int)(param.cache_size*(1<<20)));
+	cache = new Cache(prob.l, local_cache_bytes(param));
 	QD = new double[prob.l];
 	for (int i=0; i<prob.l; i++)
 	    QD[i] = (this->*kernel_function)(i, i);
@@ -1288,7 +1862,8 @@ public:
     {
 	Qfloat *data;
 	int start, j;
-	if ((start = cache->get_data(i, &data, len)) < len) {
+	if ((start = cache->get_data(i, &data, len)) < len &&
+	    !shared_row(i, start, len, data)) {
 	    for (j=start; j<len; j++)
 		data[j] = (Qfloat)(this->*kernel_function)(i, j);
 	}
@@ -1322,7 +1897,7 @@ public:
     SVR_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param) {
 	l = prob.l;
-	cache = new Cache(l, (long int)(param.cache_size*(1<<20)));
+	cache = new Cache(l, local_cache_bytes(param));
 	QD = new double[2*l];
 	sign = new schar[2*l];
 	index = new int[2*l];
@@ -1350,7 +1925,8 @@ public:
     {
 	Qfloat *data;
 	int j, real_i = index[i];
-	if (cache->get_data(real_i, &data, l) < l) {
+	if (cache->get_data(real_i, &data, l) < l &&
+	    !shared_row(real_i, 0, l, data)) {
 #if defined(_OPENMP)
 #pragma omp parallel for private(j) schedule(guided)
 #endif
@@ -1410,7 +1986,7 @@ public:
 
 	y = new schar[l];
 
-	cache = new Cache(l, (int)(param.cache_size*(1<<20)));
+	cache = new Cache(l, local_cache_bytes(param));
 	QD = new double[nr_thres*l];
 	index = new int[nr_thres*l];
 	sign = new schar[nr_thres*l];
@@ -1450,7 +2026,8 @@ public:
 	Qfloat *data;
 	int j, real_i = index[i];
 
-	if (cache->get_data(real_i, &data, l) < l) {
+	if (cache->get_data(real_i, &data, l) < l &&
+	    !shared_row(real_i, 0, l, data)) {
 #if defined(_OPENMP)
 #pragma omp parallel for private(j) schedule(guided)
 #endif
@@ -2176,6 +2753,7 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
     svm_model *model = Malloc(svm_model, 1);
 
     model->param = *param;
+    model->param.kcache = NULL;
     model->free_sv = 0; 	// XXX
     model->sv_indices = NULL;
 
@@ -2441,17 +3019,26 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
     return model;
 }
 
-// Stratified cross validation
+// Stratified cross validation: this is split into two parts (gretl
+// modification), so that the folds can be set up once and the
+// training/prediction for the individual folds (and for several
+// sets of parameters) can be farmed out to threads.
 
-void svm_cross_validation (const svm_problem *prob,
-			   const svm_parameter *param,
-			   int nr_fold, double *target)
+// Set up the folds: on return the data indices are grouped by fold
+// in the returned array, with fold i occupying positions
+// (*fold_start)[i] to (*fold_start)[i+1] - 1. The number of folds
+// may be reduced, if it exceeds the number of data points.
+
+int *svm_cross_validation_folds(const svm_problem *prob,
+				const svm_parameter *param,
+				int *nr_fold_ptr, int **fold_start_ptr)
 {
     int i;
     int *fold_start;
     int l = prob->l;
     int *perm = Malloc(int, l);
     int nr_class;
+    int nr_fold = *nr_fold_ptr;
 
     if (nr_fold > l) {
 	nr_fold = l;
@@ -2518,44 +3105,75 @@ void svm_cross_validation (const svm_problem *prob,
 	}
     }
 
-    for (i=0; i<nr_fold; i++) {
-	int begin = fold_start[i];
-	int end = fold_start[i+1];
-	int j, k;
-	struct svm_problem subprob;
+    *nr_fold_ptr = nr_fold;
+    *fold_start_ptr = fold_start;
+    return perm;
+}
 
-	subprob.l = l - (end-begin);
-	subprob.x = Malloc(struct svm_node*, subprob.l);
-	subprob.y = Malloc(double, subprob.l);
+// Train on the data points indexed by the elements of @perm outside
+// of positions @begin to @end - 1, and write predictions for the
+// points indexed by the elements inside this range into @target
 
-	k = 0;
-	for (j=0; j<begin; j++) {
-	    subprob.x[k] = prob->x[perm[j]];
-	    subprob.y[k] = prob->y[perm[j]];
-	    ++k;
-	}
-	for (j=end; j<l; j++) {
-	    subprob.x[k] = prob->x[perm[j]];
-	    subprob.y[k] = prob->y[perm[j]];
-	    ++k;
-	}
-	struct svm_model *submodel = svm_train(&subprob, param);
-	if (param->probability &&
-	    (param->svm_type == C_SVC || param->svm_type == NU_SVC)) {
-	    double *prob_estimates = Malloc(double, svm_get_nr_class(submodel));
-	    for (j=begin; j<end; j++)
-		target[perm[j]] = svm_predict_probability(submodel, prob->x[perm[j]],
-							  prob_estimates);
-	    free(prob_estimates);
-	} else {
-	    for (j=begin; j<end; j++) {
-		target[perm[j]] = svm_predict(submodel, prob->x[perm[j]]);
-	    }
-	}
-	svm_free_and_destroy_model(&submodel);
-	free(subprob.x);
-	free(subprob.y);
-    }
+void svm_cross_validation_fold(const svm_problem *prob,
+			       const svm_parameter *param,
+			       const int *perm, int begin, int end,
+			       double *target)
+{
+    int l = prob->l;
+    int nf = end - begin;
+    int j, k;
+    struct svm_problem subprob;
+
+    subprob.l = l - nf;
+    subprob.x = Malloc(struct svm_node*, subprob.l);
+    subprob.y = Malloc(double, subprob.l);
+
+    k = 0;
+    for (j=0; j<begin; j++) {
+	subprob.x[k] = prob->x[perm[j]];
+	subprob.y[k] = prob->y[perm[j]];
+	++k;
+    }
+    for (j=end; j<l; j++) {
+	subprob.x[k] = prob->x[perm[j]];
+	subprob.y[k] = prob->y[perm[j]];
+	++k;
+    }
+    struct svm_model *submodel = svm_train(&subprob, param);
+
+    struct svm_node **xf = Malloc(struct svm_node*, nf);
+    double *pred = Malloc(double, nf);
+    double *prob_estimates = NULL;
+
+    for (j=0; j<nf; j++)
+	xf[j] = prob->x[perm[begin+j]];
+    if (param->probability &&
+	(param->svm_type == C_SVC || param->svm_type == NU_SVC))
+	prob_estimates = Malloc(double, (size_t) nf * svm_get_nr_class(submodel));
+    svm_predict_batch(submodel, xf, nf, pred, prob_estimates);
+    for (j=0; j<nf; j++)
+	target[perm[begin+j]] = pred[j];
+
+    svm_free_and_destroy_model(&submodel);
+    free(subprob.x);
+    free(subprob.y);
+    free(xf);
+    free(pred);
+    free(prob_estimates);
+}
+
+void svm_cross_validation (const svm_problem *prob,
+			   const svm_parameter *param,
+			   int nr_fold, double *target)
+{
+    int *fold_start;
+    int *perm;
+
+    perm = svm_cross_validation_folds(prob, param, &nr_fold, &fold_start);
+
+    for (int i=0; i<nr_fold; i++)
+	svm_cross_validation_fold(prob, param, perm, fold_start[i],
+				  fold_start[i+1], target);
 
     free(fold_start);
     free(perm);
@@ -2601,23 +3219,29 @@ double svm_get_svr_probability(const svm_model *model)
     }
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x,
-			  double *dec_values)
+static bool single_decision(const svm_model *model)
 {
-    int i;
-
-    if (model->param.svm_type == ONE_CLASS ||
+    return model->param.svm_type == ONE_CLASS ||
 	model->param.svm_type == EPSILON_SVR ||
 	model->param.svm_type == NU_SVR ||
-	model->param.svm_type == C_RNK) {
+	model->param.svm_type == C_RNK;
+}
+
+// Compute the decision value(s) for a given point, given the
+// kernel values @kvalue for the point against each of the SVs
+
+static double predict_from_kvalues(const svm_model *model,
+				   const double *kvalue,
+				   double *dec_values)
+{
+    int i;
+
+    if (single_decision(model)) {
 	double *sv_coef = model->sv_coef[0];
 	double sum = 0;
 
-#if defined(_OPENMP)
-#pragma omp parallel for private(i) reduction(+:sum) schedule(guided)
-#endif
 	for (i=0; i<model->l; i++)
-	    sum += sv_coef[i] * Kernel::k_function(x, model->SV[i], model->param);
+	    sum += sv_coef[i] * kvalue[i];
 	sum -= model->rho[0];
 	*dec_values = sum;
 
@@ -2627,14 +3251,6 @@ double svm_predict_values(const svm_model *model, const svm_node *x,
 	    return sum;
     } else {
 	int nr_class = model->nr_class;
-	int l = model->l;
-
-	double *kvalue = Malloc(double, l);
-#if defined(_OPENMP)
-#pragma omp parallel for private(i) schedule(guided)
-#endif
-	for (i=0; i<l; i++)
-	    kvalue[i] = Kernel::k_function(x, model->SV[i], model->param);
 
 	int *start = Malloc(int, nr_class);
 	start[0] = 0;
@@ -2676,89 +3292,196 @@ double svm_predict_values(const svm_model *model, const svm_node *x,
 	    if (vote[i] > vote[vote_max_idx])
 		vote_max_idx = i;
 
-	free(kvalue);
 	free(start);
 	free(vote);
 	return model->label[vote_max_idx];
     }
 }
 
+double svm_predict_values(const svm_model *model, const svm_node *x,
+			  double *dec_values)
+{
+    int i, l = model->l;
+    double *kvalue = Malloc(double, l);
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(i) schedule(guided)
+#endif
+    for (i=0; i<l; i++)
+	kvalue[i] = Kernel::k_function(x, model->SV[i], model->param);
+
+    double ret = predict_from_kvalues(model, kvalue, dec_values);
+
+    free(kvalue);
+    return ret;
+}
+
+static double rnk_category(const svm_model *model, double pred_result)
+{
+    // AC: Is this code (and its placement) OK??
+    for (int j=1; j<model->nr_class; j++) {
+	if (pred_result < model->rho[j])
+	    return j;
+    }
+    return model->nr_class;
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
     int nr_class = model->nr_class;
     double *dec_values;
 
-    if (model->param.svm_type == ONE_CLASS ||
-	model->param.svm_type == EPSILON_SVR ||
-	model->param.svm_type == NU_SVR ||
-	model->param.svm_type == C_RNK)
+    if (single_decision(model))
 	dec_values = Malloc(double, 1);
     else
 	dec_values = Malloc(double, nr_class*(nr_class-1)/2);
 
     double pred_result = svm_predict_values(model, x, dec_values);
 
-    if (model->param.svm_type == C_RNK) {
-	// AC: Is this code (and its placement) OK??
-	int found = 0;
-
-	for (int j=1; j<model->nr_class; j++) {
-	    if (pred_result < model->rho[j]) {
-		pred_result = j;
-		found = 1;
-		break;
-	    }
-	}
-	if (!found) {
-	    pred_result = model->nr_class;
-	}
-    }
+    if (model->param.svm_type == C_RNK)
+	pred_result = rnk_category(model, pred_result);
 
     free(dec_values);
 
     return pred_result;
 }
 
+static bool has_probability_model(const svm_model *model)
+{
+    return (model->param.svm_type == C_SVC || model->param.svm_type == NU_SVC) &&
+	model->probA != NULL && model->probB != NULL;
+}
+
+// Given the pairwise decision values for a point, compute the
+// class probabilities and return the most probable label
+
+static double probability_from_decisions(const svm_model *model,
+					 const double *dec_values,
+					 double *prob_estimates)
+{
+    int i;
+    int nr_class = model->nr_class;
+    double min_prob = 1e-7;
+    double **pairwise_prob = Malloc(double *, nr_class);
+    for (i=0; i<nr_class; i++)
+	pairwise_prob[i] = Malloc(double, nr_class);
+    int k = 0;
+    for (i=0; i<nr_class; i++)
+	for (int j=i+1; j<nr_class; j++) {
+	    pairwise_prob[i][j] =
+		min(max(sigmoid_predict(dec_values[k], model->probA[k], model->probB[k]),
+			min_prob), 1-min_prob);
+	    pairwise_prob[j][i] = 1-pairwise_prob[i][j];
+	    k++;
+	}
+    if (nr_class == 2) {
+	prob_estimates[0] = pairwise_prob[0][1];
+	prob_estimates[1] = pairwise_prob[1][0];
+    } else
+	multiclass_probability(nr_class, pairwise_prob, prob_estimates);
+
+    int prob_max_idx = 0;
+    for (i=1; i<nr_class; i++)
+	if (prob_estimates[i] > prob_estimates[prob_max_idx])
+	    prob_max_idx = i;
+    for (i=0; i<nr_class; i++)
+	free(pairwise_prob[i]);
+    free(pairwise_prob);
+    return model->label[prob_max_idx];
+}
+
 double svm_predict_probability(const svm_model *model, const svm_node *x,
 			       double *prob_estimates)
 {
-    if ((model->param.svm_type == C_SVC || model->param.svm_type == NU_SVC) &&
-	model->probA != NULL && model->probB != NULL) {
-	int i;
+    if (has_probability_model(model)) {
 	int nr_class = model->nr_class;
 	double *dec_values = Malloc(double, nr_class*(nr_class-1)/2);
 	svm_predict_values(model, x, dec_values);
+	double ret = probability_from_decisions(model, dec_values, prob_estimates);
+	free(dec_values);
+	return ret;
+    } else
+	return svm_predict(model, x);
+}
 
-	double min_prob = 1e-7;
-	double **pairwise_prob = Malloc(double *, nr_class);
-	for (i=0; i<nr_class; i++)
-	    pairwise_prob[i] = Malloc(double, nr_class);
-	int k = 0;
-	for (i=0; i<nr_class; i++)
-	    for (int j=i+1; j<nr_class; j++) {
-		pairwise_prob[i][j] =
-		    min(max(sigmoid_predict(dec_values[k], model->probA[k], model->probB[k]),
-			    min_prob), 1-min_prob);
-		pairwise_prob[j][i] = 1-pairwise_prob[i][j];
-		k++;
+// Batched prediction (gretl addition): predict the @n points in @x,
+// writing the results into @pred and, if @prob_estimates is non-NULL
+// and the model supports it, the class probabilities into the rows
+// of @prob_estimates (n x nr_class, row-major). The points are
+// handled in parallel, and when the kernel permits, the SVs are
+// put into dense storage so that each kernel evaluation is a
+// contiguous loop.
+
+void svm_predict_batch(const svm_model *model, svm_node * const *x, int n,
+		       double *pred, double *prob_estimates)
+{
+    const svm_parameter &param = model->param;
+    int l = model->l;
+    int nr_class = model->nr_class;
+    int ndec = single_decision(model) ? 1 : nr_class*(nr_class-1)/2;
+    bool probs = prob_estimates != NULL && has_probability_model(model);
+    double *sv_dense = NULL;
+    int dim = 0;
+    int i;
+
+    if (dense_kernel(param.kernel_type))
+	dim = dense_dim(model->SV, l);
+    if (dim > 0)
+	sv_dense = dense_fill(model->SV, l, dim);
+
+#if defined(_OPENMP)
+#pragma omp parallel private(i) if (n > 1)
+#endif
+    {
+	double *kvalue = Malloc(double, l);
+	double *dec_values = Malloc(double, ndec);
+	double *xi = sv_dense != NULL ? Malloc(double, dim) : NULL;
+	double extra = 0;
+	int t;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(guided)
+#endif
+	for (t=0; t<n; t++) {
+	    if (sv_dense != NULL) {
+		extra = dense_fill_row(xi, x[t], dim);
+		for (i=0; i<l; i++) {
+		    const double *svi = sv_dense + (size_t) i * dim;
+
+		    switch(param.kernel_type) {
+		    case LINEAR:
+			kvalue[i] = dense_dot(xi, svi, dim);
+			break;
+		    case POLY:
+			kvalue[i] = powi(param.gamma*dense_dot(xi, svi, dim)+param.coef0,
+					 param.degree);
+			break;
+		    case RBF:
+			kvalue[i] = exp(-param.gamma*(dense_dist_2_sqr(xi, svi, dim) + extra));
+			break;
+		    case SIGMOID:
+			kvalue[i] = tanh(param.gamma*dense_dot(xi, svi, dim)+param.coef0);
+			break;
+		    }
+		}
+	    } else {
+		for (i=0; i<l; i++)
+		    kvalue[i] = Kernel::k_function(x[t], model->SV[i], param);
 	    }
-	if (nr_class == 2) {
-	    prob_estimates[0] = pairwise_prob[0][1];
-	    prob_estimates[1] = pairwise_prob[1][0];
-	} else
-	    multiclass_probability(nr_class, pairwise_prob, prob_estimates);
+	    pred[t] = predict_from_kvalues(model, kvalue, dec_values);
+	    if (probs)
+		pred[t] = probability_from_decisions(model, dec_values,
+						     prob_estimates + (size_t) t * nr_class);
+	    else if (param.svm_type == C_RNK)
+		pred[t] = rnk_category(model, pred[t]);
+	}
 
-	int prob_max_idx = 0;
-	for (i=1; i<nr_class; i++)
-	    if (prob_estimates[i] > prob_estimates[prob_max_idx])
-		prob_max_idx = i;
-	for (i=0; i<nr_class; i++)
-	    free(pairwise_prob[i]);
+	free(kvalue);
 	free(dec_values);
-	free(pairwise_prob);
-	return model->label[prob_max_idx];
-    } else
-	return svm_predict(model, x);
+	free(xi);
+    }
+
+    free(sv_dense);
 }
 
 static const char *svm_type_table[] = {
@@ -2998,6 +3721,7 @@ svm_model *svm_load_model(const char *model_file_name)
     // read parameters
 
     svm_model *model = Malloc(svm_model, 1);
+    model->param.kcache = NULL;
     model->rho = NULL;
     model->probA = NULL;
     model->probB = NULL;
@@ -22,6 +22,8 @@ struct svm_problem
 	struct svm_node **x;
 };
 
+struct svm_kcache;	/* shared kernel cache (gretl) */
+
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR, C_RNK };	/* svm_type */
 enum { LINEAR, POLY, RBF, SIGMOID, STUMP, PERC, LAPLACE, EXPO }; /* kernel_type */
 
@@ -44,6 +46,7 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	struct svm_kcache *kcache; /* shared kernel cache, or NULL (gretl) */
 };
 
 //
@@ -73,6 +76,12 @@ struct svm_model
 
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
 void svm_cross_validation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target);
+int *svm_cross_validation_folds(const struct svm_problem *prob, const struct svm_parameter *param, int *nr_fold, int **fold_start);
+void svm_cross_validation_fold(const struct svm_problem *prob, const struct svm_parameter *param, const int *perm, int begin, int end, double *target);
+
+struct svm_kcache *svm_kcache_new(const struct svm_problem *prob, double size);
+void svm_kcache_stats(const struct svm_kcache *kc, double *requests, double *hits);
+void svm_kcache_free(struct svm_kcache *kc);
 
 int svm_save_model(const char *model_file_name, const struct svm_model *model);
 struct svm_model *svm_load_model(const char *model_file_name);
@@ -87,6 +96,7 @@ double svm_get_svr_probability(const struct svm_model *model);
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
+void svm_predict_batch(const struct svm_model *model, struct svm_node * const *x, int n, double *pred, double *prob_estimates);
 
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
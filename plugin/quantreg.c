@@ -31,6 +31,10 @@
 
 #include <errno.h>
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 #define QDEBUG 0
 
 /* Frisch-Newton algorithm: we use this if we're not computing
@@ -50,6 +54,7 @@ extern int rqfnb_ (integer *n,    /* number of observations */
 		   double *wp,     /* work array, length p */
 		   integer *nit,   /* iteration counts */
 		   integer *info, /* exit status */
+		   int warm,      /* starting from a prior solution? */
 		   void (*callback)(void));
 
 /* Modified simplex, a la Barrodale-Roberts: this variant lets us get
@@ -122,6 +127,7 @@ struct fn_info {
     double *coeff;
     integer nit[3];
     integer info;
+    const int *perm;
     void (*callback)();
 };
 
@@ -739,6 +745,7 @@ static int fn_info_alloc (struct fn_info *rq, int n, int p,
     rq->tau = tau;
     rq->beta = .99995;
     rq->eps = 1.0e-7;
+    rq->perm = NULL;
 
     if (show_activity_func_installed()) {
 	rq->callback = show_activity_callback;
@@ -781,16 +788,385 @@ static void rq_workspace_init (struct fn_info *rq,
     }
 }
 
+/* Call Frisch-Newton code: if @warm is non-zero, rq->coeff
+   should hold the solution for a neighboring value of tau,
+   which is used as the starting point for the dual.
+*/
+
 static int rq_call_FN (integer *n, integer *p, gretl_matrix *XT,
 		       gretl_matrix *y, struct fn_info *rq,
-		       double tau)
+		       double tau, int warm)
 {
     rq_workspace_init(rq, XT, tau);
 
     return rqfnb_(n, p, XT->val, y->val, rq->rhs,
 		  rq->d, rq->u, &rq->beta, &rq->eps,
 		  rq->resid, rq->coeff, rq->nit, &rq->info,
-		  rq->callback);
+		  warm, rq->callback);
+}
+
+/* Portnoy-Koenker preprocessing for large samples, as in their
+   "The Gaussian Hare and the Laplacian Tortoise", Statistical
+   Science, 12 (1997), 279-300. A preliminary fit on a subsample
+   of size m = ((p+1)n)^{2/3} is used to identify observations
+   that are almost surely above or below the quantile regression
+   hyperplane; these are "globbed" into two pseudo-observations
+   and the problem is solved for the rest. If the signs of the
+   residuals for the globbed observations turn out to be correct
+   we have the solution to the full problem; otherwise we fix up
+   the offending observations, or retry with a bigger subsample.
+*/
+
+#define RQ_PFN_MIN 100000 /* min. observations for preprocessing */
+#define RQ_PFN_MAXFIX 3   /* max. fixups per subsample */
+#define RQ_PFN_SEED 16183 /* seed for subsample selection */
+
+/* Generate a permutation of 0 to n-1 from which nested subsamples
+   can be taken as leading segments. We use a dedicated stream with
+   a fixed seed: the subsample affects only the speed with which
+   the solution is found, and this way we leave the state of the
+   libgretl PRNG untouched.
+*/
+
+static int *rq_pfn_permutation (int n, int *err)
+{
+    gretl_rand_stream *rs;
+    int *perm;
+    int i, j, tmp;
+
+    perm = malloc(n * sizeof *perm);
+    rs = gretl_rand_stream_new(RQ_PFN_SEED);
+
+    if (perm == NULL || rs == NULL) {
+	free(perm);
+	gretl_rand_stream_free(rs);
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    for (i=0; i<n; i++) {
+	perm[i] = i;
+    }
+
+    for (i=n-1; i>0; i--) {
+	j = gretl_rand_stream_int_max(rs, i + 1);
+	tmp = perm[i];
+	perm[i] = perm[j];
+	perm[j] = tmp;
+    }
+
+    gretl_rand_stream_free(rs);
+
+    return perm;
+}
+
+/* Fit the reduced problem in which observations with @flag = 0
+   are included as is, those with @flag = -1 or 1 are summed into
+   "low" and "high" pseudo-observations respectively, and the rest
+   are ignored. The coefficients are written into @b.
+*/
+
+static int rq_pfn_reduced_fit (const gretl_matrix *y,
+			       const gretl_matrix *XT,
+			       const signed char *flag,
+			       double tau, double *b,
+			       void (*callback)())
+{
+    struct fn_info sub;
+    gretl_matrix *yr, *XTr;
+    const double *xt;
+    double *xr;
+    int n = XT->cols;
+    int p = XT->rows;
+    int nlo = 0, nhi = 0;
+    int i, k, s, t, m = 0;
+    integer ir, ip = p;
+    int err;
+
+    for (t=0; t<n; t++) {
+	if (flag[t] == 0) {
+	    m++;
+	} else if (flag[t] == -1) {
+	    nlo = 1;
+	} else if (flag[t] == 1) {
+	    nhi = 1;
+	}
+    }
+
+    ir = m + nlo + nhi;
+    yr = gretl_zero_matrix_new(ir, 1);
+    XTr = gretl_zero_matrix_new(p, ir);
+    if (yr == NULL || XTr == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    /* the globs, if any, occupy the last one or two slots */
+    k = 0;
+    for (t=0; t<n; t++) {
+	if (flag[t] == 0) {
+	    s = k++;
+	} else if (flag[t] == -1) {
+	    s = m;
+	} else if (flag[t] == 1) {
+	    s = m + nlo;
+	} else {
+	    continue;
+	}
+	xt = XT->val + (size_t) t * p;
+	xr = XTr->val + (size_t) s * p;
+	yr->val[s] += y->val[t];
+	for (i=0; i<p; i++) {
+	    xr[i] += xt[i];
+	}
+    }
+
+    err = fn_info_alloc(&sub, ir, p, tau, OPT_R);
+    if (!err) {
+	sub.callback = callback;
+	err = rq_call_FN(&ir, &ip, XTr, yr, &sub, tau, 0);
+	if (err) {
+	    fprintf(stderr, "rq_pfn_reduced_fit: info = %d\n", sub.info);
+	} else {
+	    memcpy(b, sub.coeff, p * sizeof *b);
+	}
+	fn_info_free(&sub);
+    }
+
+ bailout:
+
+    gretl_matrix_free(yr);
+    gretl_matrix_free(XTr);
+
+    return err;
+}
+
+/* Compute residuals for the full sample given coefficients @b,
+   and return the number of observations in a glob that are on
+   the wrong side of the fitted hyperplane, while unflagging
+   these observations.
+*/
+
+static int rq_pfn_check_signs (const gretl_matrix *y,
+			       const gretl_matrix *XT,
+			       const double *b, double *r,
+			       signed char *flag)
+{
+    const double *xt;
+    int n = XT->cols;
+    int p = XT->rows;
+    int i, t, nbad = 0;
+
+    for (t=0; t<n; t++) {
+	xt = XT->val + (size_t) t * p;
+	r[t] = y->val[t];
+	for (i=0; i<p; i++) {
+	    r[t] -= xt[i] * b[i];
+	}
+	if ((flag[t] == 1 && r[t] < 0) || (flag[t] == -1 && r[t] > 0)) {
+	    flag[t] = 0;
+	    nbad++;
+	}
+    }
+
+    return nbad;
+}
+
+/* Given the subsample fit, whose residuals are in @r, set @flag
+   to -1 or 1 for observations that lie well outside the band
+   around the fitted hyperplane, and 0 for the others. The band
+   is scaled by the standard error of prediction based on the
+   subsample regressors, in @V. Returns the number of observations
+   within the band.
+*/
+
+static int rq_pfn_set_flags (const gretl_matrix *XT,
+			     const gretl_matrix *V,
+			     const double *r, double *q,
+			     double *band, signed char *flag,
+			     double tau, double M, int *err)
+{
+    const double *xt;
+    double eps = calc_eps23;
+    double pq[2];
+    int n = XT->cols;
+    int p = XT->rows;
+    int i, j, t, nin = 0;
+
+    for (t=0; t<n; t++) {
+	double bt = 0.0;
+
+	xt = XT->val + (size_t) t * p;
+	for (i=0; i<p; i++) {
+	    for (j=0; j<p; j++) {
+		bt += xt[i] * gretl_matrix_get(V, i, j) * xt[j];
+	    }
+	}
+	band[t] = (bt > 0)? sqrt(bt) : 0.0;
+	q[t] = r[t] / (band[t] > eps ? band[t] : eps);
+    }
+
+    pq[0] = tau - M / (2 * n);
+    pq[1] = tau + M / (2 * n);
+    if (pq[0] < 1.0 / n) {
+	pq[0] = 1.0 / n;
+    }
+    if (pq[1] > (n - 1.0) / n) {
+	pq[1] = (n - 1.0) / n;
+    }
+
+    *err = gretl_array_quantiles(q, n, pq, 2);
+    if (!*err && (na(pq[0]) || na(pq[1]))) {
+	*err = E_DATA;
+    }
+    if (*err) {
+	return 0;
+    }
+
+    for (t=0; t<n; t++) {
+	if (r[t] < band[t] * pq[0]) {
+	    flag[t] = -1;
+	} else if (r[t] > band[t] * pq[1]) {
+	    flag[t] = 1;
+	} else {
+	    flag[t] = 0;
+	    nin++;
+	}
+    }
+
+    return nin;
+}
+
+/* Driver for the preprocessing variant of Frisch-Newton: on
+   successful completion rq->coeff holds the coefficients and
+   rq->resid the residuals for the full sample, just as if we
+   had called rq_call_FN().
+*/
+
+static int rq_pfn_fit (gretl_matrix *y, gretl_matrix *XT,
+		       struct fn_info *rq, double tau)
+{
+    gretl_matrix *V = NULL;
+    signed char *flag = NULL;
+    double *r = NULL, *q = NULL, *band = NULL;
+    double M, m, xit;
+    int n = rq->n;
+    int p = rq->p;
+    int i, j, k, t, nbad;
+    int done = 0;
+    int err = 0;
+
+    m = floor(pow((p + 1.0) * n, 2/3.0) + 0.5);
+
+    flag = malloc(n * sizeof *flag);
+    r = malloc(n * sizeof *r);
+    q = malloc(n * sizeof *q);
+    band = malloc(n * sizeof *band);
+    V = gretl_matrix_alloc(p, p);
+
+    if (flag == NULL || r == NULL || q == NULL ||
+	band == NULL || V == NULL) {
+	err = E_ALLOC;
+	goto bailout;
+    }
+
+    while (!done && !err && m < n) {
+	int mi = (int) m;
+
+	/* preliminary fit on the subsample */
+	memset(flag, 2, n * sizeof *flag);
+	for (k=0; k<mi; k++) {
+	    flag[rq->perm[k]] = 0;
+	}
+	err = rq_pfn_reduced_fit(y, XT, flag, tau, rq->coeff, rq->callback);
+	if (err) {
+	    break;
+	}
+
+	/* inverse of X'X for the subsample, for scaling the band */
+	gretl_matrix_zero(V);
+	for (k=0; k<mi; k++) {
+	    const double *xt = XT->val + (size_t) rq->perm[k] * p;
+
+	    for (i=0; i<p; i++) {
+		for (j=0; j<=i; j++) {
+		    xit = V->val[i + j * p] + xt[i] * xt[j];
+		    V->val[i + j * p] = V->val[j + i * p] = xit;
+		}
+	    }
+	}
+	if (gretl_invert_symmetric_matrix(V)) {
+	    /* try a bigger subsample */
+	    m *= 2;
+	    continue;
+	}
+
+	/* with all flags zeroed this just computes the residuals */
+	memset(flag, 0, n * sizeof *flag);
+	rq_pfn_check_signs(y, XT, rq->coeff, r, flag);
+	M = 0.8 * m;
+	rq_pfn_set_flags(XT, V, r, q, band, flag, tau, M, &err);
+	if (err) {
+	    /* fall back on the full problem */
+	    err = 0;
+	    break;
+	}
+
+	for (k=0; k<RQ_PFN_MAXFIX && !done && !err; k++) {
+	    err = rq_pfn_reduced_fit(y, XT, flag, tau, rq->coeff,
+				     rq->callback);
+	    if (!err) {
+		nbad = rq_pfn_check_signs(y, XT, rq->coeff, r, flag);
+#if QDEBUG
+		fprintf(stderr, "rq_pfn_fit: m = %g, fixup %d, nbad = %d\n",
+			m, k, nbad);
+#endif
+		if (nbad == 0) {
+		    done = 1;
+		} else if (nbad > 0.1 * M) {
+		    break;
+		}
+	    }
+	}
+
+	if (!done) {
+	    m *= 2;
+	}
+    }
+
+    if (done) {
+	for (t=0; t<n; t++) {
+	    rq->resid[t] = r[t];
+	}
+	rq->info = 0;
+    } else if (!err) {
+	/* subsample too big to be worth it: solve the full problem */
+	err = rq_call_FN(&rq->n, &rq->p, XT, y, rq, tau, 0);
+    }
+
+ bailout:
+
+    free(flag);
+    free(r);
+    free(q);
+    free(band);
+    gretl_matrix_free(V);
+
+    return err;
+}
+
+/* Get the coefficients and residuals for @tau, using preprocessing
+   if this was set up (in which case @warm is ignored).
+*/
+
+static int rq_fit_tau (gretl_matrix *y, gretl_matrix *XT,
+		       struct fn_info *rq, double tau, int warm)
+{
+    if (rq->perm != NULL) {
+	return rq_pfn_fit(y, XT, rq, tau);
+    } else {
+	return rq_call_FN(&rq->n, &rq->p, XT, y, rq, tau, warm);
+    }
 }
 
 static int rq_write_variance (const gretl_matrix *V,
@@ -901,7 +1277,7 @@ static int rq_fn_iid_VCV (MODEL *pmod, gretl_matrix *y,
 
     /* run artificial L1 regression to get sparsity measure */
 
-    err = rq_call_FN(&vn, &vp, vx, vy, rq, 0.5);
+    err = rq_call_FN(&vn, &vp, vx, vy, rq, 0.5, 0);
 
     if (err) {
 	fprintf(stderr, "rq_fn_iid_VCV: rqfn: info = %d\n", rq->info);
@@ -962,7 +1338,9 @@ static int rq_fn_nid_VCV (MODEL *pmod, gretl_matrix *y,
 	goto bailout;
     }
 
-    err = rq_call_FN(&n, &p, XT, y, rq, tau + h);
+    /* on entry rq->coeff holds the solution for @tau, which
+       gives a warm start for tau + h, and so on */
+    err = rq_fit_tau(y, XT, rq, tau + h, 1);
     if (err) {
 	fprintf(stderr, "tau + h: info = %d\n", rq->info);
 	goto bailout;
@@ -973,7 +1351,7 @@ static int rq_fn_nid_VCV (MODEL *pmod, gretl_matrix *y,
 	p1->val[i] = rq->coeff[i];
     }
 
-    err = rq_call_FN(&n, &p, XT, y, rq, tau - h);
+    err = rq_fit_tau(y, XT, rq, tau - h, 1);
     if (err) {
 	fprintf(stderr, "tau - h: info = %d\n", rq->info);
 	goto bailout;
@@ -1201,87 +1579,206 @@ static int rq_fit_br (gretl_matrix *y, gretl_matrix *X,
     return err;
 }
 
-/* sub-driver for Frisch-Newton interior point variant */
+/* Fit the tau values at positions @i0 to @i1 - 1 in @tauvec,
+   writing coefficients and standard errors into @tbeta. Each
+   fit after the first is warm-started from the solution for
+   the preceding tau.
+*/
 
-static int rq_fit_fn (gretl_matrix *y, gretl_matrix *XT,
-		      const gretl_vector *tauvec, gretlopt opt,
-		      MODEL *pmod)
+static int rq_fit_tau_range (gretl_matrix *y, gretl_matrix *XT,
+			     const gretl_vector *tauvec, gretlopt opt,
+			     const int *perm, gretl_matrix *tbeta,
+			     int i0, int i1, int threaded)
 {
     struct fn_info rq;
-    gretl_matrix *tbeta = NULL;
     double *se = NULL;
     integer n = y->rows;
     integer p = XT->rows;
+    int ntau = tbeta->rows / p;
     double tau;
-    int i, ntau;
-    int err = 0;
+    int i, k, warm, err;
 
-    ntau = gretl_vector_get_length(tauvec);
-    tau = gretl_vector_get(tauvec, 0);
-
-    err = fn_info_alloc(&rq, n, p, tau, opt);
+    err = fn_info_alloc(&rq, n, p, gretl_vector_get(tauvec, i0), opt);
     if (err) {
 	return err;
     }
 
-    if (ntau > 1) {
-	tbeta = gretl_zero_matrix_new(p * ntau, 2);
-	se = malloc(p * sizeof *se);
-	if (tbeta == NULL || se == NULL) {
-	    err = E_ALLOC;
-	}
+    rq.perm = perm;
+    if (threaded) {
+	/* the activity callback is not thread-safe */
+	rq.callback = NULL;
     }
 
-    for (i=0; i<ntau && !err; i++) {
+    se = malloc(p * sizeof *se);
+    if (se == NULL) {
+	err = E_ALLOC;
+    }
+
+    for (i=i0; i<i1 && !err; i++) {
 	tau = rq.tau = gretl_vector_get(tauvec, i);
 
 #if QDEBUG
-	fprintf(stderr, "rq_fit_fn: i = %d, tau = %g\n", i, tau);
+	fprintf(stderr, "rq_fit_tau_range: i = %d, tau = %g\n", i, tau);
 #endif
 
+	warm = (i > i0);
+	if (warm) {
+	    /* the VCV calculation will have clobbered rq.coeff */
+	    for (k=0; k<p; k++) {
+		rq.coeff[k] = gretl_matrix_get(tbeta, i - 1 + k * ntau, 0);
+		if (na(rq.coeff[k])) {
+		    warm = 0;
+		}
+	    }
+	}
+
 	/* get coefficients and residuals */
-	err = rq_call_FN(&n, &p, XT, y, &rq, tau);
+	err = rq_fit_tau(y, XT, &rq, tau, warm);
 	if (err) {
 	    fprintf(stderr, "rqfn gave info = %d\n", rq.info);
-	}
-
-	if (!err) {
-	    if (ntau == 1) {
-		/* save coeffs, residuals, etc., before computing VCV */
-		rq_transcribe_results(pmod, y, tau, rq.coeff, rq.resid,
-				      RQ_STAGE_1);
-	    } else {
-		/* write coeffs for this tau value */
-		write_tbeta_block_fn(tbeta, ntau, rq.coeff, p, i, 0);
-	    }
+	} else {
+	    /* write coeffs for this tau value */
+	    write_tbeta_block_fn(tbeta, ntau, rq.coeff, p, i, 0);
 	}
 
 	if (!err) {
 	    /* compute covariance matrix */
 	    if (opt & OPT_R) {
-		err = rq_fn_nid_VCV(pmod, y, XT, tau, &rq, se);
+		err = rq_fn_nid_VCV(NULL, y, XT, tau, &rq, se);
 	    } else {
-		err = rq_fn_iid_VCV(pmod, y, XT, tau, &rq, se);
+		err = rq_fn_iid_VCV(NULL, y, XT, tau, &rq, se);
 	    }
 	}
 
-	if (!err && ntau > 1) {
+	if (!err) {
 	    /* write std errs for this tau */
 	    write_tbeta_block_fn(tbeta, ntau, se, p, i, 1);
 	}
     }
 
-    if (tbeta != NULL) {
-	/* multiple tau values */
+    fn_info_free(&rq);
+    free(se);
+
+    return err;
+}
+
+/* Multiple tau values: the tau vector is divided into contiguous
+   blocks, one per thread, so that warm starts remain effective.
+*/
+
+static int rq_fit_multi_tau (gretl_matrix *y, gretl_matrix *XT,
+			     const gretl_vector *tauvec, gretlopt opt,
+			     const int *perm, gretl_matrix *tbeta)
+{
+    int ntau = gretl_vector_get_length(tauvec);
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+    int err = 0;
+
+#if defined(_OPENMP)
+    if (libset_use_openmp((guint64) ntau * y->rows * XT->rows * XT->rows)) {
+	nt = get_omp_n_threads();
+	if (nt > ntau) {
+	    nt = ntau;
+	}
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	int tnum = 0, ntt = 1;
+	int i0, i1, terr;
+
+#if defined(_OPENMP)
+	tnum = omp_get_thread_num();
+	ntt = omp_get_num_threads();
+#endif
+	i0 = ntau * tnum / ntt;
+	i1 = ntau * (tnum + 1) / ntt;
+
+	terr = rq_fit_tau_range(y, XT, tauvec, opt, perm, tbeta,
+				i0, i1, ntt > 1);
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    err = terr;
+	}
+    }
+
+    return err;
+}
+
+/* sub-driver for Frisch-Newton interior point variant */
+
+static int rq_fit_fn (gretl_matrix *y, gretl_matrix *XT,
+		      const gretl_vector *tauvec, gretlopt opt,
+		      MODEL *pmod)
+{
+    gretl_matrix *tbeta = NULL;
+    int *perm = NULL;
+    integer n = y->rows;
+    integer p = XT->rows;
+    double tau;
+    int ntau;
+    int err = 0;
+
+    ntau = gretl_vector_get_length(tauvec);
+    tau = gretl_vector_get(tauvec, 0);
+
+    if (n >= RQ_PFN_MIN && pow((p + 1.0) * n, 2/3.0) < n / 2.0) {
+	/* big enough to benefit from preprocessing */
+	perm = rq_pfn_permutation(n, &err);
+	if (err) {
+	    return err;
+	}
+    }
+
+    if (ntau > 1) {
+	tbeta = gretl_zero_matrix_new(p * ntau, 2);
+	if (tbeta == NULL) {
+	    err = E_ALLOC;
+	} else {
+	    err = rq_fit_multi_tau(y, XT, tauvec, opt, perm, tbeta);
+	}
 	if (err) {
 	    gretl_matrix_free(tbeta);
 	} else {
 	    err = rq_attach_multi_results(pmod, tauvec, tbeta, 0, opt);
 	}
+    } else {
+	struct fn_info rq;
+
+	err = fn_info_alloc(&rq, n, p, tau, opt);
+	if (err) {
+	    free(perm);
+	    return err;
+	}
+
+	rq.perm = perm;
+
+	/* get coefficients and residuals */
+	err = rq_fit_tau(y, XT, &rq, tau, 0);
+	if (err) {
+	    fprintf(stderr, "rqfn gave info = %d\n", rq.info);
+	}
+
+	if (!err) {
+	    /* save coeffs, residuals, etc., before computing VCV */
+	    rq_transcribe_results(pmod, y, tau, rq.coeff, rq.resid,
+				  RQ_STAGE_1);
+	    /* compute covariance matrix */
+	    if (opt & OPT_R) {
+		err = rq_fn_nid_VCV(pmod, y, XT, tau, &rq, NULL);
+	    } else {
+		err = rq_fn_iid_VCV(pmod, y, XT, tau, &rq, NULL);
+	    }
+	}
+
+	fn_info_free(&rq);
     }
 
-    fn_info_free(&rq);
-    free(se);
+    free(perm);
 
     return err;
 }
@@ -1510,20 +2007,97 @@ static int *good_observations_array (MODEL *pmod)
 
 #define ITERS 500
 
+/* Run bootstrap replications @k0 to @k1 - 1 of the LAD model,
+   writing the coefficients into @coeffs. Each replication gets
+   its own PRNG stream, seeded from @seeds, so the results do
+   not depend on how the replications are divided among threads.
+*/
+
+static int lad_bootstrap_range (MODEL *pmod, DATASET *dset,
+				const int *goodobs,
+				const unsigned int *seeds,
+				double **coeffs, int k0, int k1,
+				int threaded)
+{
+    struct br_info rq;
+    gretl_rand_stream *rs = NULL;
+    gretl_matrix *y = NULL;
+    gretl_matrix *X = NULL;
+    int *sample = NULL;
+    int nc = pmod->ncoeff;
+    int n = pmod->nobs;
+    int i, j, k;
+    int err;
+
+    err = br_info_alloc(&rq, n, nc, 0.5, 0.0, OPT_L);
+    if (err) {
+	br_info_free(&rq);
+	return err;
+    }
+
+    if (threaded) {
+	/* the activity callback is not thread-safe */
+	rq.callback = NULL;
+    }
+
+    y = gretl_matrix_alloc(n, 1);
+    X = gretl_matrix_alloc(n, nc);
+    sample = malloc(n * sizeof *sample);
+    rs = gretl_rand_stream_new(seeds[k0]);
+
+    if (y == NULL || X == NULL || sample == NULL || rs == NULL) {
+	err = E_ALLOC;
+    }
+
+    for (k=k0; k<k1 && !err; k++) {
+	gretl_rand_stream_set_seed(rs, seeds[k]);
+
+	/* create random sample index array */
+	for (i=0; i<n; i++) {
+	    j = gretl_rand_stream_int_max(rs, n);
+	    if (goodobs != NULL) {
+		sample[i] = goodobs[j];
+	    } else {
+		sample[i] = pmod->t1 + j;
+	    }
+	}
+
+	rq_refill_matrices(pmod, dset, y, X, sample);
+
+	/* re-estimate LAD model */
+	err = real_br_calc(y, X, 0.5, &rq, 0);
+
+	if (!err) {
+	    for (i=0; i<nc; i++) {
+		coeffs[i][k] = rq.coeff[i];
+	    }
+	}
+    }
+
+    br_info_free(&rq);
+    gretl_rand_stream_free(rs);
+    gretl_matrix_free(y);
+    gretl_matrix_free(X);
+    free(sample);
+
+    return err;
+}
+
 /* obtain bootstrap estimates of LAD covariance matrix */
 
-static int lad_bootstrap_vcv (MODEL *pmod, DATASET *dset,
-			      gretl_matrix *y, gretl_matrix *X,
-			      struct br_info *rq)
+static int lad_bootstrap_vcv (MODEL *pmod, DATASET *dset)
 {
     double **coeffs = NULL;
     double *meanb = NULL;
-    int *sample = NULL;
+    unsigned int *seeds = NULL;
     int *goodobs = NULL;
     double xi, xj;
     int i, j, k;
     int nc = pmod->ncoeff;
-    int nvcv, n = pmod->nobs;
+    int nvcv;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
     int err = 0;
 
     /* note: new_vcv sets all entries to zero */
@@ -1538,10 +2112,10 @@ static int lad_bootstrap_vcv (MODEL *pmod, DATASET *dset,
     /* a scalar for each coefficient mean */
     meanb = malloc(nc * sizeof *meanb);
 
-    /* resampling array of length pmod->nobs */
-    sample = malloc(n * sizeof *sample);
+    /* a PRNG seed for each replication */
+    seeds = malloc(ITERS * sizeof *seeds);
 
-    if (coeffs == NULL || meanb == NULL || sample == NULL) {
+    if (coeffs == NULL || meanb == NULL || seeds == NULL) {
 	err = E_ALLOC;
 	goto bailout;
     }
@@ -1555,26 +2129,36 @@ static int lad_bootstrap_vcv (MODEL *pmod, DATASET *dset,
 	}
     }
 
-    for (k=0; k<ITERS && !err; k++) {
-	/* create random sample index array */
-	for (i=0; i<n; i++) {
-	    j = gretl_rand_int_max(n);
-	    if (goodobs != NULL) {
-		sample[i] = goodobs[j];
-	    } else {
-		sample[i] = pmod->t1 + j;
-	    }
-	}
-
-	rq_refill_matrices(pmod, dset, y, X, sample);
+    /* the seeds come from the libgretl PRNG, so that the
+       results are governed by the user's "set seed" */
+    for (k=0; k<ITERS; k++) {
+	seeds[k] = gretl_rand_int();
+    }
 
-	/* re-estimate LAD model */
-	err = real_br_calc(y, X, 0.5, rq, 0);
+#if defined(_OPENMP)
+    if (libset_use_openmp((guint64) ITERS * pmod->nobs * nc * nc)) {
+	nt = get_omp_n_threads();
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	int tnum = 0, ntt = 1;
+	int k0, k1, terr;
 
-	if (!err) {
-	    for (i=0; i<nc; i++) {
-		coeffs[i][k] = rq->coeff[i];
-	    }
+#if defined(_OPENMP)
+	tnum = omp_get_thread_num();
+	ntt = omp_get_num_threads();
+#endif
+	k0 = ITERS * tnum / ntt;
+	k1 = ITERS * (tnum + 1) / ntt;
+
+	terr = lad_bootstrap_range(pmod, dset, goodobs, seeds, coeffs,
+				   k0, k1, ntt > 1);
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    err = terr;
 	}
     }
 
@@ -1611,7 +2195,7 @@ static int lad_bootstrap_vcv (MODEL *pmod, DATASET *dset,
 
  bailout:
 
-    free(sample);
+    free(seeds);
     free(meanb);
     doubles_array_free(coeffs, nc);
 
@@ -1665,7 +2249,7 @@ static int lad_fit_br (MODEL *pmod, DATASET *dset,
 	    /* --no-vcv */
 	    lad_scrub_vcv(pmod);
 	} else {
-	    err = lad_bootstrap_vcv(pmod, dset, y, X, &rq);
+	    err = lad_bootstrap_vcv(pmod, dset);
 	}
     }
 
@@ -93,16 +93,16 @@ static int lpfnb_ (integer *n, integer *p, double *a, double *c__,
 		   double *z__, double *w, double *dx, double *ds, 
 		   double *dy, double *dz, double *dw, double *dr, 
 		   double *rhs, double *ada, integer *nit, integer *info,
-		   void (*callback)(void))
+		   int warm, void (*callback)(void))
 {
     integer a_dim1 = *p, ada_dim1 = *p;
     integer a_offset = 1 + a_dim1, ada_offset = 1 + ada_dim1;
     double d1, d2;
-    static double g;
-    static integer i;
-    static double mu, gap;
-    static double dsdw, dxdz;
-    static double deltad, deltap;
+    double g;
+    integer i;
+    double mu, gap;
+    double dsdw, dxdz;
+    double deltad, deltap;
     int main_iters = 0;
     int err = 0;
 
@@ -131,14 +131,18 @@ static int lpfnb_ (integer *n, integer *p, double *a, double *c__,
     nit[1] = 0;
     nit[2] = 0;
     nit[3] = *n;
-    dgemv_("N", p, n, &c_b4, &a[a_offset], p, &c__[1], &one, &zero, &y[1],
-	   &one);
-    for (i = 1; i <= *n; ++i) {
-	d__[i] = 1.;
-    }
-    err = stepy_(n, p, &a[a_offset], &d__[1], &y[1], &ada[ada_offset], info);
-    if (err) {
-	return err;
+    if (!warm) {
+	/* start the dual from the least-squares solution; otherwise
+	   @y already holds the solution for a neighboring problem */
+	dgemv_("N", p, n, &c_b4, &a[a_offset], p, &c__[1], &one, &zero, &y[1],
+	       &one);
+	for (i = 1; i <= *n; ++i) {
+	    d__[i] = 1.;
+	}
+	err = stepy_(n, p, &a[a_offset], &d__[1], &y[1], &ada[ada_offset], info);
+	if (err) {
+	    return err;
+	}
     }
     dcopy_(n, &c__[1], &one, &s[1], &one);
     dgemv_("T", p, n, &c_b13, &a[a_offset], p, &y[1], &one, &c_b4, &s[1],
@@ -294,7 +298,7 @@ looptop:
 int rqfnb_ (integer *n, integer *p, double *a, double *y, 
 	    double *rhs, double *d, double *u, double *beta,
 	    double *eps, double *wn, double *wp, integer *nit, 
-	    integer *info, void (*callback)(void))
+	    integer *info, int warm, void (*callback)(void))
 {
     integer a_dim = *p, wn_dim = *n, wp_dim = *p;
     int err;
@@ -309,7 +313,7 @@ int rqfnb_ (integer *n, integer *p, double *a, double *y,
 		 &wn[wn_dim * 3 + 1], &wn[(wn_dim << 2) + 1], &wn[wn_dim * 5 + 1], 
 		 &wn[wn_dim * 6 + 1], &wp[(wp_dim << 1) + 1], &wn[wn_dim * 7 + 1],
 		 &wn[(wn_dim << 3) + 1], &wn[wn_dim * 9 + 1], &wp[wp_dim * 3 + 1], 
-		 &wp[(wp_dim << 2) + 1], nit, info, callback);
+		 &wp[(wp_dim << 2) + 1], nit, info, warm, callback);
 
     return err;
 } 
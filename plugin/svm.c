@@ -273,6 +273,7 @@ static void set_sv_parm_defaults (sv_parm *parm)
     parm->p = 0.1;             /* for EPSILON_SVR */
     parm->shrinking = 1;       /* use shrinking heuristics */
     parm->probability = 0;     /* do probability estimates */
+    parm->kcache = NULL;       /* shared kernel cache */
 }
 
 static struct sv_parm_info pinfo[N_PARMS] = {
@@ -443,6 +444,12 @@ static PRN *svm_prn;
 
 static void gretl_libsvm_print (const char *s)
 {
+#if defined(_OPENMP)
+    if (omp_in_parallel()) {
+	/* don't interleave output from concurrent training runs */
+	return;
+    }
+#endif
     if (svm_prn != NULL) {
 	pputs(svm_prn, s);
 	gretl_flush(svm_prn);
@@ -1400,7 +1407,7 @@ static int real_svm_predict (double *yhat,
     int misses = 0;
     double dev, yhi, yi;
     double *pi = NULL;
-    sv_cell *x;
+    double *pred = NULL;
     int i, j, err = 0;
 
     if (model->param.svm_type == EPSILON_SVR ||
@@ -1429,13 +1436,26 @@ static int real_svm_predict (double *yhat,
 	    if (P == NULL) {
 		err = E_ALLOC;
 	    } else {
-		pi = malloc(nr_class * sizeof *pi);
-		w->do_probs = 1;
+		pi = malloc(prob->l * nr_class * sizeof *pi);
+		if (pi == NULL) {
+		    err = E_ALLOC;
+		} else {
+		    w->do_probs = 1;
+		}
 	    }
 	}
     }
 
+    if (!err) {
+	pred = malloc(prob->l * sizeof *pred);
+	if (pred == NULL) {
+	    err = E_ALLOC;
+	}
+    }
+
     if (err) {
+	free(pi);
+	free(ls);
 	return err;
     }
 
@@ -1445,21 +1465,25 @@ static int real_svm_predict (double *yhat,
 
     pprintf(prn, "Calling prediction function (this may take a while)\n");
     gretl_flush(prn);
+
+    /* the predictions are done in parallel, as a batch */
+    svm_predict_batch(model, prob->x, prob->l, pred,
+		      w->do_probs ? pi : NULL);
+
     for (i=0; i<prob->l; i++) {
-	x = prob->x[i];
+	yhi = pred[i];
 	if (w->do_probs) {
-	    yhi = svm_predict_probability(model, x, pi);
+	    double *pij = pi + i * nr_class;
+
 	    for (j=0; j<nr_class; j++) {
 		/* transcribe probability estimates */
 		if (ls != NULL) {
 		    /* re-order the columns */
-		    gretl_matrix_set(P, i, j, pi[ls[j].pos]);
+		    gretl_matrix_set(P, i, j, pij[ls[j].pos]);
 		} else {
-		    gretl_matrix_set(P, i, j, pi[j]);
+		    gretl_matrix_set(P, i, j, pij[j]);
 		}
 	    }
-	} else {
-	    yhi = svm_predict(model, x);
 	}
 	yi = prob->y[i];
 	if (!regression) {
@@ -1487,6 +1511,8 @@ static int real_svm_predict (double *yhat,
 	}
     }
 
+    free(pred);
+
     if (pi != NULL) {
 	free(pi);
 	free(ls);
@@ -1574,94 +1600,194 @@ static int *get_fold_sizes (const sv_data *data,
     return ret;
 }
 
-/* Carry out cross validation in the case where the user has provided
-   a series to specify the "folds", or has specified a given number of
-   consecutive blocks, as opposed to the default random subsetting.
+/* Carry out cross validation for fold @i in the case where the user
+   has provided a series to specify the "folds", or has specified a
+   given number of consecutive blocks, as opposed to the default
+   random subsetting.
 */
 
-static void custom_xvalidate (const sv_data *prob,
-			      const sv_parm *parm,
-			      const sv_wrapper *w,
-			      double *targ)
-{
-    int i, vi, ni;
-
-    for (i=0; i<w->nfold; i++) {
-	struct svm_problem subprob;
-	struct svm_model *submodel;
-	int jmin = 0, jmax = 0;
-	int j, k, useobs;
+static void custom_xvalidate_fold (const sv_data *prob,
+				   const sv_parm *parm,
+				   const sv_wrapper *w,
+				   int i, double *targ)
+{
+    struct svm_problem subprob;
+    struct svm_model *submodel;
+    struct svm_node **xf;
+    double *pred;
+    int vi = i + 1;
+    int ni = w->fsize[vi];
+    int jmin = 0, jmax = 0;
+    int j, k, m, useobs;
+
+    subprob.l = prob->l - ni;
+    subprob.x = malloc(subprob.l * sizeof *subprob.x);
+    subprob.y = malloc(subprob.l * sizeof *subprob.y);
+    xf = malloc(ni * sizeof *xf);
+    pred = malloc(ni * sizeof *pred);
 
-	vi = i + 1;
-	ni = w->fsize[vi];
-	subprob.l = prob->l - ni;
-	subprob.x = malloc(subprob.l * sizeof *subprob.x);
-	subprob.y = malloc(subprob.l * sizeof *subprob.y);
+    if (w->flags & W_CONSEC) {
+	/* find start and end points for fold */
+	jmin = i * w->fsize[1];
+	jmax = jmin + ni;
+    }
 
+    /* set the training subsample, excluding fold i, and
+       gather the rows of fold i itself */
+    k = m = 0;
+    for (j=0; j<prob->l; j++) {
 	if (w->flags & W_CONSEC) {
-	    /* find start and end points for fold */
-	    jmin = i * w->fsize[1];
-	    jmax = jmin + ni;
+	    useobs = j < jmin || j >= jmax;
+	} else {
+	    useobs = w->flist[j+1] != vi;
 	}
+	if (useobs) {
+	    subprob.x[k] = prob->x[j];
+	    subprob.y[k] = prob->y[j];
+	    k++;
+	} else {
+	    xf[m++] = prob->x[j];
+	}
+    }
+
+    /* train on the given subsample */
+    submodel = svm_train(&subprob, parm);
 
-	/* set the training subsample, excluding fold i */
-	k = 0;
+    /* predict on the complementary subsample (fold i only) */
+    svm_predict_batch(submodel, xf, ni, pred, NULL);
+    m = 0;
+    if (w->flags & W_CONSEC) {
+	for (j=jmin; j<jmax; j++) {
+	    targ[j] = pred[m++];
+	}
+    } else {
+	/* the values we want may be interspersed */
 	for (j=0; j<prob->l; j++) {
-	    if (w->flags & W_CONSEC) {
-		useobs = j < jmin || j >= jmax;
-	    } else {
-		useobs = w->flist[j+1] != vi;
-	    }
-	    if (useobs) {
-		subprob.x[k] = prob->x[j];
-		subprob.y[k] = prob->y[j];
-		k++;
+	    if (w->flist[j+1] == vi) {
+		targ[j] = pred[m++];
 	    }
 	}
+    }
 
-	/* train on the given subsample */
-	submodel = svm_train(&subprob, parm);
+    svm_free_and_destroy_model(&submodel);
+    free(subprob.x);
+    free(subprob.y);
+    free(xf);
+    free(pred);
+}
 
-	/* predict on the complementary subsample (fold i only) */
-	if (w->flags & W_CONSEC) {
-	    /* we don't have to scan the whole prob->x array */
-	    for (j=jmin; j<jmax; j++) {
-		targ[j] = svm_predict(submodel, prob->x[j]);
+/* Decide how many parameter sets (grid points) to pass to
+   xvalidate_predict() at once: more than one only if we're
+   able to spread the work across threads. Probability
+   estimation draws on libsvm's shared random number
+   generator, so in that case we stay serial.
+*/
+
+static int xvalidate_batch_size (const sv_data *prob,
+				 const sv_parm *parm)
+{
+    int nb = 1;
+
+#if defined(_OPENMP)
+    if (!parm->probability &&
+	libset_use_openmp((guint64) prob->l * prob->l)) {
+	nb = get_omp_n_threads();
+    }
+#endif
+
+    return nb;
+}
+
+/* Compute cross-validation predictions for each of the @np
+   parameter sets in @parms, writing the results into the
+   corresponding element of @targs. Each (parameter set, fold)
+   pair is an independent training problem, so when threading
+   is available the pairs are shared out among threads.
+*/
+
+static void xvalidate_predict (sv_data *prob,
+			       const sv_parm *parms,
+			       int np, sv_wrapper *w,
+			       double **targs)
+{
+    int **perm = NULL;
+    int **fstart = NULL;
+    int nfold = w->nfold;
+    int ntask, task;
+#if defined(_OPENMP)
+    int nt = 1;
+#endif
+    int b;
+
+    if (w->fsize == NULL) {
+	/* random folds: generate them serially, in order,
+	   so that results don't depend on the thread count
+	*/
+	perm = malloc(np * sizeof *perm);
+	fstart = malloc(np * sizeof *fstart);
+	for (b=0; b<np; b++) {
+	    maybe_set_svm_seed(w);
+	    if (b == 0 || (w->flags & W_REFOLD)) {
+		nfold = w->nfold;
+		perm[b] = svm_cross_validation_folds(prob, &parms[b], &nfold,
+						     &fstart[b]);
+	    } else {
+		perm[b] = perm[0];
+		fstart[b] = fstart[0];
 	    }
+	}
+    }
+
+    ntask = np * nfold;
+
+#if defined(_OPENMP)
+    if (!parms[0].probability &&
+	libset_use_openmp((guint64) prob->l * prob->l)) {
+	nt = get_omp_n_threads();
+	if (nt > ntask) {
+	    nt = ntask;
+	}
+    }
+#pragma omp parallel for private(task) schedule(dynamic) if (nt > 1) num_threads(nt)
+#endif
+    for (task=0; task<ntask; task++) {
+	int bt = task / nfold;
+	int f = task % nfold;
+
+	if (perm != NULL) {
+	    svm_cross_validation_fold(prob, &parms[bt], perm[bt],
+				      fstart[bt][f], fstart[bt][f+1],
+				      targs[bt]);
 	} else {
-	    /* the values we want may be interspersed */
-	    for (j=0; j<prob->l; j++) {
-		if (w->flist[j+1] == vi) {
-		    targ[j] = svm_predict(submodel, prob->x[j]);
-		}
-	    }
+	    custom_xvalidate_fold(prob, &parms[bt], w, f, targs[bt]);
 	}
+    }
 
-	svm_free_and_destroy_model(&submodel);
-	free(subprob.x);
-	free(subprob.y);
+    if (perm != NULL) {
+	for (b=0; b<np; b++) {
+	    if (b == 0 || perm[b] != perm[0]) {
+		free(perm[b]);
+		free(fstart[b]);
+	    }
+	}
+	free(perm);
+	free(fstart);
     }
 }
 
-/* implement a single cross validation pass */
+/* compute the cross-validation criterion, given the predictions
+   in @targ */
 
-static int xvalidate_once (sv_data *prob,
-			   sv_parm *parm,
-			   sv_wrapper *w,
-			   double *targ,
-			   double *crit,
-			   int iter,
-			   PRN *prn)
+static void xvalidate_criterion (sv_data *prob,
+				 sv_parm *parm,
+				 sv_wrapper *w,
+				 const double *targ,
+				 double *crit,
+				 int iter,
+				 PRN *prn)
 {
     int i, n = prob->l;
 
-    if (w->fsize != NULL) {
-	custom_xvalidate(prob, parm, w, targ);
-    } else {
-	maybe_set_svm_seed(w);
-	svm_cross_validation(prob, parm, w->nfold, targ);
-    }
-
     if (doing_regression(parm)) {
 	double yi, yhi, dev, minimand = 0;
 
@@ -1708,6 +1834,20 @@ static int xvalidate_once (sv_data *prob,
 	}
 	*crit = pc_correct;
     }
+}
+
+/* implement a single cross validation pass */
+
+static int xvalidate_once (sv_data *prob,
+			   sv_parm *parm,
+			   sv_wrapper *w,
+			   double *targ,
+			   double *crit,
+			   int iter,
+			   PRN *prn)
+{
+    xvalidate_predict(prob, parm, 1, w, &targ);
+    xvalidate_criterion(prob, parm, w, targ, crit, iter, prn);
 
     return 0;
 }
@@ -2390,6 +2530,26 @@ static int call_mpi_cross_validation (sv_data *data,
 
 #endif /* HAVE_MPI */
 
+/* report on the use of the kernel cache shared by the
+   cross-validation runs, then free it */
+
+static void finalize_kernel_cache (sv_parm *parm,
+				   sv_wrapper *w,
+				   PRN *prn)
+{
+    if (prn != NULL && !(w->flags & W_QUIET)) {
+	double req, hits;
+
+	svm_kcache_stats(parm->kcache, &req, &hits);
+	if (req > 0) {
+	    pprintf(prn, "Shared kernel cache: %g rows requested, "
+		    "hit rate %.1f%%\n", req, 100 * hits / req);
+	}
+    }
+    svm_kcache_free(parm->kcache);
+    parm->kcache = NULL;
+}
+
 static int call_cross_validation (sv_data *data,
 				  sv_parm *parm,
 				  sv_wrapper *w,
@@ -2410,6 +2570,14 @@ static int call_cross_validation (sv_data *data,
     pputs(prn, " (may take a while)\n");
     gretl_flush(prn);
 
+    /* The training sets for the folds overlap heavily, and grid
+       points differing only in C (or epsilon, nu) share a kernel,
+       so rows of the kernel matrix are kept across the runs
+    */
+    if (w->nfold > 1) {
+	parm->kcache = svm_kcache_new(data, parm->cache_size);
+    }
+
     if (w->grid != NULL) {
 	sv_grid *grid = w->grid;
 	double cmax = -DBL_MAX;
@@ -2417,10 +2585,15 @@ static int call_cross_validation (sv_data *data,
 	int nC = grid->n[G_C];
 	int ng = grid->n[G_g];
 	int np = grid->n[G_p];
+	sv_parm *parms = NULL;
+	double **targs = NULL;
+	int *ijk = NULL;
+	int ijk1[3];
 	int ibest = 0, jbest = 0, kbest = 0;
 	int iter = 0;
 	int ncols = 3;
-	int i, j, k;
+	int i, j, k, b, m;
+	int nb;
 
 	if (prn != NULL) {
 	    print_grid(grid, parm, prn);
@@ -2438,8 +2611,33 @@ static int call_cross_validation (sv_data *data,
 	    w->xdata = gretl_matrix_alloc(nC * ng * np, ncols);
 	}
 
+	nb = xvalidate_batch_size(data, parm);
+	if (nb > 1) {
+	    parms = malloc(nb * sizeof *parms);
+	    ijk = malloc(3 * nb * sizeof *ijk);
+	    targs = doubles_array_new(nb, data->l);
+	    if (parms == NULL || ijk == NULL || targs == NULL) {
+		/* fall back to one point at a time */
+		free(parms);
+		free(ijk);
+		doubles_array_free(targs, nb);
+		nb = 1;
+	    }
+	}
+	if (nb == 1) {
+	    parms = parm;
+	    ijk = ijk1;
+	    targs = &targ;
+	}
+
 	maybe_hush(w);
 
+	/* Parameter sets are gathered in batches of @nb: the
+	   predictions for a batch are computed jointly (and
+	   possibly in parallel) but the criteria are evaluated
+	   and printed in grid order.
+	*/
+	b = 0;
 	for (i=0; i<nC; i++) {
 	    if (!grid->null[G_C]) {
 		parm->C = grid_get_C(grid, i);
@@ -2452,26 +2650,53 @@ static int call_cross_validation (sv_data *data,
 		    if (!grid->null[G_p]) {
 			*p3 = grid_get_p(grid, k);
 		    }
-		    xvalidate_once(data, parm, w, targ, &crit, iter, prn);
-		    if (crit > cmax) {
-			cmax = crit;
-			ibest = i;
-			jbest = j;
-			kbest = k;
+		    if (nb > 1) {
+			parms[b] = *parm;
+		    }
+		    ijk[3*b] = i;
+		    ijk[3*b+1] = j;
+		    ijk[3*b+2] = k;
+		    if (++b < nb && iter + b < nC * ng * np) {
+			continue;
 		    }
-		    if (w->xdata != NULL) {
-			gretl_matrix_set(w->xdata, iter, 0, parm->C);
-			gretl_matrix_set(w->xdata, iter, 1, parm->gamma);
-			if (p3 != NULL) {
-			    gretl_matrix_set(w->xdata, iter, 2, *p3);
+		    xvalidate_predict(data, parms, b, w, targs);
+		    for (m=0; m<b; m++) {
+			sv_parm *pm = &parms[m];
+
+			xvalidate_criterion(data, pm, w, targs[m], &crit,
+					    iter, prn);
+			if (crit > cmax) {
+			    cmax = crit;
+			    ibest = ijk[3*m];
+			    jbest = ijk[3*m+1];
+			    kbest = ijk[3*m+2];
 			}
-			gretl_matrix_set(w->xdata, iter, ncols - 1, fabs(crit));
+			if (w->xdata != NULL) {
+			    gretl_matrix_set(w->xdata, iter, 0, pm->C);
+			    gretl_matrix_set(w->xdata, iter, 1, pm->gamma);
+			    if (p3 != NULL) {
+				gretl_matrix_set(w->xdata, iter, 2,
+						 uses_epsilon(pm) ? pm->p : pm->nu);
+			    }
+			    gretl_matrix_set(w->xdata, iter, ncols - 1, fabs(crit));
+			}
+			iter++;
+		    }
+		    if (nb > 1 && iter == nC * ng * np) {
+			/* leave the final predictions in @targ */
+			memcpy(targ, targs[b-1], data->l * sizeof *targ);
 		    }
-		    iter++;
+		    b = 0;
 		}
 	    }
 	}
 
+	if (nb > 1) {
+	    free(parms);
+	    free(ijk);
+	    doubles_array_free(targs, nb);
+	}
+
 	maybe_resume_printing(w);
 
 	if (!grid->null[G_C]) {
@@ -2491,6 +2716,10 @@ static int call_cross_validation (sv_data *data,
 	err = xvalidate_once(data, parm, w, targ, &crit, -1, prn);
     }
 
+    if (parm->kcache != NULL) {
+	finalize_kernel_cache(parm, w, prn);
+    }
+
     return err;
 }
 
@@ -25,6 +25,10 @@
 #include "tsls.h"
 #include "sysml.h"
 
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
 #define SDEBUG 0
 
 #define sys_ols_ok(s) (s->method == SYS_METHOD_SUR || \
@@ -894,19 +898,421 @@ static gretlopt sys_ols_opt (const equation_system *sys,
     return opt;
 }
 
-static int allocate_Xi_etc (gretl_matrix **Xi,
-			    gretl_matrix **Xj,
-			    gretl_matrix **M,
-			    int T, int k)
+/* Moments for system estimation. The system matrix has the
+   structure of Sigma^{-1} (x) X'X restricted to each equation's
+   regressors, so on iteration only the weights sigma^{ij} change.
+   The cross-products of the regressors with the dependent
+   variables are gathered once; the blocks X_i'X_j, j <= i, are
+   stored only if the system matrix will be needed more than once
+   and they are not too big (SYS_XX_MAX doubles in all), otherwise
+   they are recomputed from the data block row by block row as
+   needed. The regressor data themselves are not kept.
+*/
+
+#define SYS_XX_MAX 16777216
+
+typedef struct sys_moments_ sys_moments;
+
+struct sys_moments_ {
+    equation_system *sys; /* the system */
+    DATASET *dset;        /* the dataset */
+    gretl_matrix *XY;     /* mk x m: X_i'y_l */
+    gretl_matrix **XX;    /* block rows X_i'[X_1 ... X_i], or NULL */
+    int *offs;            /* offsets of the m blocks, plus mk */
+    int kmax;             /* max. number of regressors per equation */
+};
+
+static void sys_moments_free (sys_moments *mom)
 {
-    *Xi = gretl_matrix_alloc(T, k);
-    *Xj = gretl_matrix_alloc(T, k);
-    *M = gretl_matrix_alloc(k, k);
+    int i;
 
-    if (*Xi == NULL || *Xj == NULL || *M == NULL) {
-	return E_ALLOC;
+    if (mom != NULL) {
+	gretl_matrix_free(mom->XY);
+	if (mom->XX != NULL) {
+	    for (i=0; i<mom->sys->neqns; i++) {
+		gretl_matrix_free(mom->XX[i]);
+	    }
+	    free(mom->XX);
+	}
+	free(mom->offs);
+	free(mom);
+    }
+}
+
+#if defined(_OPENMP)
+
+/* number of threads to use for work of size @work spread over
+   @n equations */
+
+static int sys_n_threads (guint64 work, int n)
+{
+    int nt = 1;
+
+    if (n > 1 && libset_use_openmp(work)) {
+	nt = get_omp_n_threads();
+	if (nt > n) {
+	    nt = n;
+	}
+    }
+
+    return nt;
+}
+
+#endif
+
+/* Compute block row @i of the system cross-products, X_i'X_j for
+   j = 0 to i (or for j = i only, if @diag_only is non-zero), in
+   @R, which must have X_i's column count for rows and room for
+   offs[i+1] columns. @Xi and @Xj are T x kmax workspace; on
+   successful return @Xi holds X_i.
+*/
+
+static int sys_block_row (const sys_moments *mom, int i,
+			  int diag_only, gretl_matrix *R,
+			  gretl_matrix *Xi, gretl_matrix *Xj)
+{
+    equation_system *sys = mom->sys;
+    MODEL **models = sys->models;
+    const gretl_matrix *Xk;
+    gretl_matrix Rj;
+    int j, err;
+
+    err = make_sys_X_block(Xi, models[i], mom->dset, sys->t1,
+			   sys->method);
+
+    for (j=(diag_only ? i : 0); j<=i && !err; j++) {
+	Xk = Xj;
+	if (j < i) {
+	    err = make_sys_X_block(Xj, models[j], mom->dset, sys->t1,
+				   sys->method);
+	} else if (sys->method == SYS_METHOD_LIML) {
+	    err = make_liml_X_block(Xj, models[i], mom->dset, sys->t1);
+	} else {
+	    Xk = Xi;
+	}
+	if (!err) {
+	    gretl_matrix_init_full(&Rj, Xi->cols, Xk->cols,
+				   R->val + (size_t) mom->offs[j] * R->rows);
+	    err = gretl_matrix_multiply_mod(Xi, GRETL_MOD_TRANSPOSE,
+					    Xk, GRETL_MOD_NONE,
+					    &Rj, GRETL_MOD_NONE);
+	}
+    }
+
+    return err;
+}
+
+/* Allocate storage for the block rows of cross-products, unless
+   the total would exceed SYS_XX_MAX; failure to allocate is not
+   an error, we just fall back on recomputation.
+*/
+
+static void sys_moments_alloc_XX (sys_moments *mom, int m)
+{
+    guint64 size = 0;
+    int i, ki;
+
+    for (i=0; i<m; i++) {
+	ki = mom->offs[i+1] - mom->offs[i];
+	size += (guint64) ki * mom->offs[i+1];
+    }
+
+    if (size > SYS_XX_MAX) {
+	return;
+    }
+
+    mom->XX = calloc(m, sizeof *mom->XX);
+    if (mom->XX == NULL) {
+	return;
+    }
+
+    for (i=0; i<m; i++) {
+	ki = mom->offs[i+1] - mom->offs[i];
+	mom->XX[i] = gretl_matrix_alloc(ki, mom->offs[i+1]);
+	if (mom->XX[i] == NULL) {
+	    for (ki=0; ki<i; ki++) {
+		gretl_matrix_free(mom->XX[ki]);
+	    }
+	    free(mom->XX);
+	    mom->XX = NULL;
+	    return;
+	}
+    }
+}
+
+/* Set up @mom: if @keep_XX is non-zero the cross-product blocks
+   X_i'X_j are computed once and stored, if that's within bounds,
+   otherwise they're computed as needed by sys_fill_X().
+*/
+
+static sys_moments *sys_moments_new (equation_system *sys,
+				     DATASET *dset, int mk,
+				     int keep_XX, int *err)
+{
+    MODEL **models = sys->models;
+    int m = sys->neqns;
+    int T = sys->T;
+    gretl_matrix *Ya = NULL;
+    sys_moments *mom;
+    const double *yi;
+    int i, t;
+#if defined(_OPENMP)
+    int nt;
+#endif
+
+    mom = calloc(1, sizeof *mom);
+    if (mom == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    mom->sys = sys;
+    mom->dset = dset;
+    mom->offs = malloc((m + 1) * sizeof *mom->offs);
+    mom->XY = gretl_matrix_alloc(mk, m);
+    Ya = gretl_matrix_alloc(T, m);
+
+    if (mom->offs == NULL || mom->XY == NULL || Ya == NULL) {
+	*err = E_ALLOC;
+	goto bailout;
+    }
+
+    mom->offs[0] = 0;
+    mom->kmax = 0;
+    for (i=0; i<m; i++) {
+	mom->offs[i+1] = mom->offs[i] + models[i]->ncoeff;
+	if (models[i]->ncoeff > mom->kmax) {
+	    mom->kmax = models[i]->ncoeff;
+	}
+    }
+
+    /* the dependent variables */
+
+    for (i=0; i<m && !*err; i++) {
+	if (sys->method == SYS_METHOD_LIML) {
+	    yi = gretl_model_get_data(models[i], "liml_y");
+	} else {
+	    yi = dset->Z[system_get_depvar(sys, i)];
+	}
+	if (yi == NULL) {
+	    *err = E_DATA;
+	} else {
+	    for (t=0; t<T; t++) {
+		gretl_matrix_set(Ya, t, i, yi[t + sys->t1]);
+	    }
+	}
+    }
+
+    if (*err) {
+	goto bailout;
+    }
+
+    if (keep_XX) {
+	sys_moments_alloc_XX(mom, m);
+    }
+
+    /* the cross-products, equation by equation */
+
+#if defined(_OPENMP)
+    nt = sys_n_threads((guint64) T * mk * (mom->XX != NULL ? mk : m), m);
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	gretl_matrix *Xi, *Xj, *M;
+	int j, l, terr = 0;
+
+	Xi = gretl_matrix_alloc(T, mom->kmax);
+	Xj = gretl_matrix_alloc(T, mom->kmax);
+	M = gretl_matrix_alloc(mom->kmax, m);
+	if (Xi == NULL || Xj == NULL || M == NULL) {
+	    terr = E_ALLOC;
+	}
+
+#if defined(_OPENMP)
+#pragma omp for private(i) schedule(dynamic)
+#endif
+	for (i=0; i<m; i++) {
+	    if (terr) {
+		continue;
+	    }
+	    if (mom->XX != NULL) {
+		terr = sys_block_row(mom, i, 0, mom->XX[i], Xi, Xj);
+	    } else {
+		terr = make_sys_X_block(Xi, models[i], dset, sys->t1,
+					sys->method);
+	    }
+	    if (!terr) {
+		M->rows = Xi->cols;
+		terr = gretl_matrix_multiply_mod(Xi, GRETL_MOD_TRANSPOSE,
+						 Ya, GRETL_MOD_NONE,
+						 M, GRETL_MOD_NONE);
+	    }
+	    for (j=0; j<Xi->cols && !terr; j++) {
+		for (l=0; l<m; l++) {
+		    gretl_matrix_set(mom->XY, mom->offs[i] + j, l,
+				     gretl_matrix_get(M, j, l));
+		}
+	    }
+	}
+
+	gretl_matrix_free(Xi);
+	gretl_matrix_free(Xj);
+	gretl_matrix_free(M);
+
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    *err = terr;
+	}
+    }
+
+ bailout:
+
+    gretl_matrix_free(Ya);
+
+    if (*err) {
+	sys_moments_free(mom);
+	mom = NULL;
+    }
+
+    return mom;
+}
+
+/* Assemble the system matrix in @X: block (i, j) is s_ij X_i'X_j
+   where s_ij is element (i, j) of @S, or 1 if @unit is non-zero.
+   If @diag_only is non-zero the off-diagonal blocks are set to
+   zero. The work is shared out by block row.
+*/
+
+static int sys_fill_X (gretl_matrix *X, const sys_moments *mom,
+		       const gretl_matrix *S, int m,
+		       int diag_only, int unit)
+{
+    int T = mom->sys->T;
+    int err = 0;
+    int i;
+#if defined(_OPENMP)
+    int nt;
+#endif
+
+#if defined(_OPENMP)
+    if (mom->XX != NULL) {
+	nt = sys_n_threads((guint64) mom->offs[m] * mom->offs[m], m);
     } else {
-	return 0;
+	nt = sys_n_threads((guint64) T * mom->offs[m] * mom->kmax, m);
+    }
+#pragma omp parallel if (nt > 1) num_threads(nt)
+#endif
+    {
+	gretl_matrix *Xi = NULL, *Xj = NULL, *R = NULL;
+	const gretl_matrix *Ri;
+	int j, r, c, terr = 0;
+
+	if (mom->XX == NULL) {
+	    Xi = gretl_matrix_alloc(T, mom->kmax);
+	    Xj = gretl_matrix_alloc(T, mom->kmax);
+	    R = gretl_matrix_alloc(mom->kmax, mom->offs[m]);
+	    if (Xi == NULL || Xj == NULL || R == NULL) {
+		terr = E_ALLOC;
+	    }
+	}
+
+#if defined(_OPENMP)
+#pragma omp for private(i) schedule(dynamic)
+#endif
+	for (i=0; i<m; i++) {
+	    int ri = mom->offs[i];
+	    int ki = mom->offs[i+1] - ri;
+
+	    if (terr) {
+		continue;
+	    }
+
+	    if (mom->XX != NULL) {
+		Ri = mom->XX[i];
+	    } else {
+		R->rows = ki;
+		R->cols = mom->offs[i+1];
+		terr = sys_block_row(mom, i, diag_only, R, Xi, Xj);
+		Ri = R;
+	    }
+
+	    for (j=0; j<=i && !terr; j++) {
+		int cj = mom->offs[j];
+		int kj = mom->offs[j+1] - cj;
+		double sij, mrc;
+
+		if (i != j && diag_only) {
+		    for (r=0; r<ki; r++) {
+			for (c=0; c<kj; c++) {
+			    gretl_matrix_set(X, ri + r, cj + c, 0.0);
+			    gretl_matrix_set(X, cj + c, ri + r, 0.0);
+			}
+		    }
+		    continue;
+		}
+
+		sij = unit ? 1.0 : gretl_matrix_get(S, i, j);
+
+		for (r=0; r<ki; r++) {
+		    for (c=0; c<kj; c++) {
+			mrc = gretl_matrix_get(Ri, r, cj + c);
+			gretl_matrix_set(X, ri + r, cj + c, mrc * sij);
+			if (i != j) {
+			    gretl_matrix_set(X, cj + c, ri + r, mrc * sij);
+			}
+		    }
+		}
+	    }
+	}
+
+	gretl_matrix_free(Xi);
+	gretl_matrix_free(Xj);
+	gretl_matrix_free(R);
+
+	if (terr) {
+#if defined(_OPENMP)
+#pragma omp critical
+#endif
+	    err = terr;
+	}
+    }
+
+    return err;
+}
+
+/* Assemble the right-hand side vector in @y: element j of block i
+   is the sum over l of s_il x_ij'y_l, where the x_ij are the
+   regressors for equation i; see sys_fill_X() for @diag_only and
+   @unit.
+*/
+
+static void sys_fill_y (gretl_matrix *y, const sys_moments *mom,
+			const gretl_matrix *S, int m,
+			int diag_only, int unit)
+{
+    double sil, yv;
+    int i, j, l;
+    int lmin, lmax;
+
+    for (i=0; i<m; i++) {
+	if (diag_only) {
+	    /* no cross terms wanted */
+	    lmin = i;
+	    lmax = i + 1;
+	} else {
+	    lmin = 0;
+	    lmax = m;
+	}
+	for (j=mom->offs[i]; j<mom->offs[i+1]; j++) {
+	    yv = 0.0;
+	    for (l=lmin; l<lmax; l++) {
+		sil = unit ? 1.0 : gretl_matrix_get(S, i, l);
+		yv += gretl_matrix_get(mom->XY, j, l) * sil;
+	    }
+	    gretl_vector_set(y, j, yv);
+	}
     }
 }
 
@@ -964,16 +1370,14 @@ static int ols_data_to_sys (equation_system *sys, int mk)
 int system_estimate (equation_system *sys, DATASET *dset,
 		     gretlopt opt, PRN *prn)
 {
-    int i, j, k, T, t;
-    int v, l, mk, krow, nr;
+    int i, T, t;
+    int mk, nr;
     int orig_t1 = dset->t1;
     int orig_t2 = dset->t2;
     gretl_matrix *X = NULL;
     gretl_matrix *y = NULL;
-    gretl_matrix *Xi = NULL;
-    gretl_matrix *Xj = NULL;
-    gretl_matrix *M = NULL;
     gretl_matrix **pX = NULL;
+    sys_moments *mom = NULL;
     gretl_matrix **py = NULL;
     MODEL **models = NULL;
     int method = sys->method;
@@ -983,6 +1387,7 @@ int system_estimate (equation_system *sys, DATASET *dset,
     int plain_ols = 0;
     int rsingle = 0;
     int do_diag = 0;
+    int diag_only, unit;
     int err = 0;
 
     sys->iters = 0;
@@ -1030,9 +1435,6 @@ int system_estimate (equation_system *sys, DATASET *dset,
     dset->t1 = sys->t1;
     dset->t2 = sys->t2;
 
-    /* max indep vars per equation */
-    k = system_max_indep_vars(sys);
-
     /* total indep vars, all equations */
     mk = system_n_indep_vars(sys);
 
@@ -1131,6 +1533,14 @@ int system_estimate (equation_system *sys, DATASET *dset,
 	goto save_etc;
     }
 
+    /* Gather the moments. The cross-products of the regressor
+       blocks are stored, within bounds, if the system matrix is
+       going to be formed more than once, with different weights.
+    */
+    mom = sys_moments_new(sys, dset, mk, !single_equation &&
+			  (do_iteration || rsingle), &err);
+    if (err) goto cleanup;
+
     /* marker for iterated versions of SUR, WLS, or 3SLS; also for
        loopback in case of restricted 3SLS, where we want to compute
        restricted TSLS estimates first
@@ -1140,11 +1550,8 @@ int system_estimate (equation_system *sys, DATASET *dset,
     gls_sigma_from_uhat(sys, sys->S, 0);
 
     if (method == SYS_METHOD_WLS) {
-	gretl_matrix_zero(X);
 	err = gretl_invert_diagonal_matrix(sys->S);
-    } else if (single_equation || rsingle) {
-	gretl_matrix_zero(X);
-    } else {
+    } else if (!single_equation && !rsingle) {
 	err = gretl_invert_symmetric_matrix(sys->S);
     }
 
@@ -1152,63 +1559,17 @@ int system_estimate (equation_system *sys, DATASET *dset,
     fprintf(stderr, "system_estimate: on invert, err=%d\n", err);
 #endif
 
-    if (!err && Xi == NULL) {
-	/* the test against NULL here allows for the possibility
-	   that we're iterating
-	*/
-	err = allocate_Xi_etc(&Xi, &Xj, &M, T, k);
-    }
-
     if (err) goto cleanup;
 
-    /* form the big stacked X matrix: Xi = data matrix for equation i,
-       specified in lists[i]
-    */
-
-    krow = 0;
-    for (i=0; i<sys->neqns && !err; i++) {
-	int kcol = 0;
+    /* form the system X'X matrix and X'y vector: if we're doing
+       a single-equation method (or restricted single-equation
+       estimates as a starting point) these are block-diagonal
+       and unweighted, except for WLS */
 
-	err = make_sys_X_block(Xi, models[i], dset, sys->t1, method);
-
-	for (j=0; j<=i && !err; j++) {
-	    const gretl_matrix *Xk;
-	    double sij;
-
-	    if (i != j) {
-		if (single_equation || rsingle) {
-		    kcol += models[j]->ncoeff;
-		    continue;
-		}
-		err = make_sys_X_block(Xj, models[j], dset, sys->t1, method);
-		Xk = Xj;
-	    } else if (method == SYS_METHOD_LIML) {
-		err = make_liml_X_block(Xj, models[i], dset, sys->t1);
-		Xk = Xj;
-	    } else {
-		Xk = Xi;
-	    }
-
-	    M->rows = Xi->cols;
-	    M->cols = Xk->cols;
-
-	    err = gretl_matrix_multiply_mod(Xi, GRETL_MOD_TRANSPOSE,
-					    Xk, GRETL_MOD_NONE,
-					    M, GRETL_MOD_NONE);
-
-	    if (rsingle || (single_equation && method != SYS_METHOD_WLS)) {
-		sij = 1.0;
-	    } else {
-		sij = gretl_matrix_get(sys->S, i, j);
-	    }
-
-	    insert_sys_X_block(X, M, krow, kcol, sij);
-	    kcol += models[j]->ncoeff;
-	}
-
-	krow += models[i]->ncoeff;
-    }
+    diag_only = single_equation || rsingle;
+    unit = rsingle || (single_equation && method != SYS_METHOD_WLS);
 
+    err = sys_fill_X(X, mom, sys->S, sys->neqns, diag_only, unit);
     if (err) {
 	fprintf(stderr, "after trying to make X matrix: err = %d\n", err);
 	goto cleanup;
@@ -1219,61 +1580,7 @@ int system_estimate (equation_system *sys, DATASET *dset,
 	augment_X_with_restrictions(X, mk, sys);
     }
 
-    if (!do_iteration && !rsingle) {
-	/* we're not coming back this way, so free some storage */
-	gretl_matrix_free(Xj);
-	Xj = NULL;
-	gretl_matrix_free(M);
-	M = NULL;
-    }
-
-    /* form stacked Y column vector (m x k) */
-
-    v = 0;
-    for (i=0; i<sys->neqns; i++) {
-
-	/* loop over the m vertically-arranged blocks */
-	make_sys_X_block(Xi, models[i], dset, sys->t1, method);
-
-	for (j=0; j<models[i]->ncoeff; j++) {
-	    /* loop over the rows within each of the m blocks */
-	    double yv = 0.0;
-	    int lmin = 0, lmax = sys->neqns;
-
-	    if (single_equation || rsingle) {
-		/* no cross terms wanted */
-		lmin = i;
-		lmax = i + 1;
-	    }
-
-	    for (l=lmin; l<lmax; l++) {
-		/* loop over the components that must be
-		   added to form each element */
-		const double *yl = NULL;
-		double sil, xx = 0.0;
-
-		if (method == SYS_METHOD_LIML) {
-		    yl = gretl_model_get_data(models[l], "liml_y");
-		} else {
-		    yl = dset->Z[system_get_depvar(sys, l)];
-		}
-
-		/* multiply X'[l] into y */
-		for (t=0; t<T; t++) {
-		    xx += gretl_matrix_get(Xi, t, j) * yl[t + sys->t1];
-		}
-
-		if (rsingle || (single_equation && method != SYS_METHOD_WLS)) {
-		    sil = 1.0;
-		} else {
-		    sil = gretl_matrix_get(sys->S, i, l);
-		}
-
-		yv += xx * sil;
-	    }
-	    gretl_vector_set(y, v++, yv);
-	}
-    }
+    sys_fill_y(y, mom, sys->S, sys->neqns, diag_only, unit);
 
     if (nr > 0) {
 	/* there are restrictions */
@@ -1329,9 +1636,7 @@ int system_estimate (equation_system *sys, DATASET *dset,
 
  cleanup:
 
-    gretl_matrix_free(Xi);
-    gretl_matrix_free(Xj);
-    gretl_matrix_free(M);
+    sys_moments_free(mom);
     gretl_matrix_free(X);
     gretl_matrix_free(y);
 
@@ -0,0 +1,737 @@
+/*
+ *  gretl -- Gnu Regression, Econometrics and Time-series Library
+ *  Copyright (C) 2001 Allin Cottrell and Riccardo "Jack" Lucchetti
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* gretlbench -- timing harness for some of the performance-critical
+   parts of libgretl: matrix kernels, genr evaluation (including the
+   compiled-genr path used in loops), CSV and gdtb I/O, and a few
+   estimators, all run on synthetic data of configurable size.
+
+   Each benchmark is run several times and the best time is
+   reported. Results are written as JSON; if a baseline file (a
+   JSON file written by a previous run with the same data sizes) is
+   given, the times are compared against it and the exit status is
+   non-zero if any benchmark has slowed down by more than the
+   specified tolerance.
+*/
+
+#include "libgretl.h"
+#include "version.h"
+#include "uservar.h"
+#include "kalman.h"
+#include "matrix_extra.h"
+#include "gretl_xml.h"
+
+#include <string.h>
+#include <float.h>
+
+typedef struct bench_data_ bench_data;
+typedef struct bench_info_ bench_info;
+
+struct bench_data_ {
+    int n;             /* number of observations */
+    int k;             /* number of series */
+    int m;             /* dimension of square matrices */
+    DATASET *dset;     /* synthetic dataset */
+    int *list;         /* regression list: x1 on const, x2...xk */
+    gretl_matrix *A;   /* m x m */
+    gretl_matrix *B;   /* m x m */
+    gretl_matrix *X;   /* n x k */
+    const char *dir;   /* directory for temporary files */
+    PRN *prn;          /* buffer for discarded output */
+};
+
+struct bench_info_ {
+    const char *name;
+    int (*func) (bench_data *, double *);
+};
+
+struct bench_result {
+    const char *name;
+    double secs;
+    double base;
+    int err;
+};
+
+static double now (void)
+{
+    return g_get_monotonic_time() / 1.0e6;
+}
+
+/* matrix kernels */
+
+static int bench_matrix_multiply (bench_data *bd, double *secs)
+{
+    gretl_matrix *C = gretl_matrix_alloc(bd->m, bd->m);
+    double t0;
+    int err;
+
+    if (C == NULL) {
+	return E_ALLOC;
+    }
+
+    t0 = now();
+    err = gretl_matrix_multiply(bd->A, bd->B, C);
+    *secs = now() - t0;
+
+    gretl_matrix_free(C);
+
+    return err;
+}
+
+static int bench_matrix_xtx (bench_data *bd, double *secs)
+{
+    gretl_matrix *XTX = gretl_matrix_alloc(bd->k, bd->k);
+    double t0;
+    int err;
+
+    if (XTX == NULL) {
+	return E_ALLOC;
+    }
+
+    t0 = now();
+    err = gretl_matrix_multiply_mod(bd->X, GRETL_MOD_TRANSPOSE,
+				    bd->X, GRETL_MOD_NONE,
+				    XTX, GRETL_MOD_NONE);
+    *secs = now() - t0;
+
+    gretl_matrix_free(XTX);
+
+    return err;
+}
+
+/* form the positive definite matrix A'A + I */
+
+static gretl_matrix *make_pd_matrix (bench_data *bd, int *err)
+{
+    gretl_matrix *S = gretl_matrix_alloc(bd->m, bd->m);
+    int i;
+
+    if (S == NULL) {
+	*err = E_ALLOC;
+	return NULL;
+    }
+
+    *err = gretl_matrix_multiply_mod(bd->A, GRETL_MOD_TRANSPOSE,
+				     bd->A, GRETL_MOD_NONE,
+				     S, GRETL_MOD_NONE);
+    for (i=0; i<bd->m; i++) {
+	S->val[i * bd->m + i] += 1.0;
+    }
+
+    return S;
+}
+
+static int bench_matrix_invert (bench_data *bd, double *secs)
+{
+    gretl_matrix *S;
+    double t0;
+    int err = 0;
+
+    S = make_pd_matrix(bd, &err);
+
+    if (!err) {
+	t0 = now();
+	err = gretl_invert_symmetric_matrix(S);
+	*secs = now() - t0;
+    }
+
+    gretl_matrix_free(S);
+
+    return err;
+}
+
+static int bench_matrix_eigen (bench_data *bd, double *secs)
+{
+    gretl_matrix *S, *lam = NULL;
+    double t0;
+    int err = 0;
+
+    S = make_pd_matrix(bd, &err);
+
+    if (!err) {
+	t0 = now();
+	lam = gretl_symmetric_matrix_eigenvals(S, 1, &err);
+	*secs = now() - t0;
+    }
+
+    gretl_matrix_free(S);
+    gretl_matrix_free(lam);
+
+    return err;
+}
+
+/* genr */
+
+static int bench_genr_series (bench_data *bd, double *secs)
+{
+    const char *formula =
+	"bench_y = log(abs(x1) + 1) + sqrt(x2^2 + x3^2) * exp(-abs(x4))";
+    double t0;
+    int err;
+
+    t0 = now();
+    err = generate(formula, bd->dset, GRETL_TYPE_SERIES, OPT_Q, NULL);
+    *secs = now() - t0;
+
+    if (!err) {
+	dataset_drop_last_variables(bd->dset, 1);
+    }
+
+    return err;
+}
+
+/* the loop mechanism: a compiled generator is executed once
+   per iteration, with the index updated in between */
+
+static int bench_genr_loop (bench_data *bd, double *secs)
+{
+    GENERATOR *genr = NULL;
+    double t0;
+    int i, err;
+
+    err = gretl_scalar_add("bench_i", 1);
+    if (!err) {
+	err = gretl_scalar_add("bench_s", 0);
+    }
+    if (!err) {
+	genr = genr_compile("bench_s = bench_s + x1[bench_i] * x2[bench_i]",
+			    bd->dset, GRETL_TYPE_DOUBLE, OPT_NONE,
+			    NULL, &err);
+    }
+
+    if (!err) {
+	t0 = now();
+	for (i=1; i<=bd->n && !err; i++) {
+	    gretl_scalar_set_value("bench_i", i);
+	    err = execute_genr(genr, bd->dset, NULL);
+	}
+	*secs = now() - t0;
+    }
+
+    destroy_genr(genr);
+    user_var_delete_by_name("bench_i", NULL);
+    user_var_delete_by_name("bench_s", NULL);
+
+    return err;
+}
+
+/* data I/O: write out the synthetic dataset, then read it back */
+
+static int bench_write_data (bench_data *bd, const char *suffix,
+			     double *secs)
+{
+    char fname[FILENAME_MAX];
+    int *list;
+    double t0;
+    int err;
+
+    list = full_var_list(bd->dset, NULL);
+    if (list == NULL) {
+	return E_ALLOC;
+    }
+
+    gretl_build_path(fname, bd->dir, "gretlbench", NULL);
+    strcat(fname, suffix);
+
+    t0 = now();
+    err = write_data(fname, list, bd->dset, OPT_NONE, bd->prn);
+    *secs = now() - t0;
+
+    free(list);
+
+    return err;
+}
+
+static int bench_read_data (bench_data *bd, const char *suffix,
+			    double *secs)
+{
+    char fname[FILENAME_MAX];
+    DATASET *dset;
+    double t0;
+    int err;
+
+    dset = datainfo_new();
+    if (dset == NULL) {
+	return E_ALLOC;
+    }
+
+    gretl_build_path(fname, bd->dir, "gretlbench", NULL);
+    strcat(fname, suffix);
+
+    gretl_print_reset_buffer(bd->prn);
+
+    t0 = now();
+    if (!strcmp(suffix, ".csv")) {
+	err = import_csv(fname, dset, OPT_NONE, bd->prn);
+    } else {
+	err = gretl_read_gdt(fname, dset, OPT_NONE, bd->prn);
+    }
+    *secs = now() - t0;
+
+    if (!err && (dset->n != bd->n || dset->v != bd->dset->v)) {
+	fprintf(stderr, "%s: got %d x %d, expected %d x %d\n", fname,
+		dset->n, dset->v, bd->n, bd->dset->v);
+	err = E_DATA;
+    }
+
+    destroy_dataset(dset);
+
+    return err;
+}
+
+static int bench_csv_write (bench_data *bd, double *secs)
+{
+    return bench_write_data(bd, ".csv", secs);
+}
+
+static int bench_csv_read (bench_data *bd, double *secs)
+{
+    return bench_read_data(bd, ".csv", secs);
+}
+
+static int bench_gdtb_write (bench_data *bd, double *secs)
+{
+    return bench_write_data(bd, ".gdtb", secs);
+}
+
+static int bench_gdtb_read (bench_data *bd, double *secs)
+{
+    return bench_read_data(bd, ".gdtb", secs);
+}
+
+/* estimators */
+
+static int bench_real_ols (bench_data *bd, gretlopt opt, double *secs)
+{
+    MODEL mod;
+    double t0;
+    int err;
+
+    t0 = now();
+    mod = lsq(bd->list, bd->dset, OLS, opt);
+    *secs = now() - t0;
+
+    err = mod.errcode;
+    clear_model(&mod);
+
+    return err;
+}
+
+static int bench_ols (bench_data *bd, double *secs)
+{
+    return bench_real_ols(bd, OPT_NONE, secs);
+}
+
+static int bench_ols_hac (bench_data *bd, double *secs)
+{
+    return bench_real_ols(bd, OPT_R, secs);
+}
+
+/* local-level model for x1, via the Kalman filter */
+
+static int bench_kalman_forecast (bench_data *bd, double *secs)
+{
+    gretl_matrix *S, *P, *F, *H, *Q, *R, *y;
+    const double *x = bd->dset->Z[1];
+    kalman *K = NULL;
+    double t0;
+    int t, err = 0;
+
+    S = gretl_zero_matrix_new(1, 1);
+    P = gretl_matrix_from_scalar(1.0e7);
+    F = gretl_matrix_from_scalar(1.0);
+    H = gretl_matrix_from_scalar(1.0);
+    Q = gretl_matrix_from_scalar(0.1);
+    R = gretl_matrix_from_scalar(1.0);
+    y = gretl_column_vector_alloc(bd->n);
+
+    if (S == NULL || P == NULL || F == NULL || H == NULL ||
+	Q == NULL || R == NULL || y == NULL) {
+	err = E_ALLOC;
+    } else {
+	/* random walk plus noise */
+	y->val[0] = x[0];
+	for (t=1; t<bd->n; t++) {
+	    y->val[t] = y->val[t-1] + 0.3 * x[t];
+	}
+	K = kalman_new(S, P, F, NULL, H, Q, R, y, NULL, NULL,
+		       NULL, &err);
+    }
+
+    if (!err) {
+	t0 = now();
+	err = kalman_forecast(K, NULL);
+	*secs = now() - t0;
+    }
+
+    kalman_free(K);
+    gretl_matrix_free(S);
+    gretl_matrix_free(P);
+    gretl_matrix_free(F);
+    gretl_matrix_free(H);
+    gretl_matrix_free(Q);
+    gretl_matrix_free(R);
+    gretl_matrix_free(y);
+
+    return err;
+}
+
+/* note: the read benchmarks depend on the files produced by
+   the corresponding write benchmarks */
+
+static bench_info benchmarks[] = {
+    { "matrix_multiply", bench_matrix_multiply },
+    { "matrix_xtx",      bench_matrix_xtx },
+    { "matrix_invert",   bench_matrix_invert },
+    { "matrix_eigen",    bench_matrix_eigen },
+    { "genr_series",     bench_genr_series },
+    { "genr_loop",       bench_genr_loop },
+    { "csv_write",       bench_csv_write },
+    { "csv_read",        bench_csv_read },
+    { "gdtb_write",      bench_gdtb_write },
+    { "gdtb_read",       bench_gdtb_read },
+    { "ols",             bench_ols },
+    { "ols_hac",         bench_ols_hac },
+    { "kalman_forecast", bench_kalman_forecast }
+};
+
+static int set_up_data (bench_data *bd)
+{
+    DATASET *dset;
+    int i, j, n = bd->n;
+    int err = 0;
+
+    gretl_rand_set_seed(7654321);
+
+    dset = create_new_dataset(bd->k + 1, n, 0);
+    if (dset == NULL) {
+	return E_ALLOC;
+    }
+
+    /* make it a time series, for the HAC and Kalman cases */
+    dset->structure = TIME_SERIES;
+    dset->pd = 1;
+    dset->sd0 = 1.0;
+    strcpy(dset->stobs, "1");
+    ntodate(dset->endobs, n - 1, dset);
+
+    for (i=1; i<dset->v; i++) {
+	sprintf(dset->varname[i], "x%d", i);
+	gretl_rand_normal(dset->Z[i], 0, n - 1);
+    }
+    /* give x1 some dependence on the other series */
+    for (i=2; i<dset->v; i++) {
+	for (j=0; j<n; j++) {
+	    dset->Z[1][j] += dset->Z[i][j] / i;
+	}
+    }
+    bd->dset = dset;
+
+    bd->list = gretl_list_new(bd->k + 1);
+    if (bd->list == NULL) {
+	return E_ALLOC;
+    }
+    bd->list[1] = 1;
+    bd->list[2] = 0;
+    for (i=3; i<=bd->list[0]; i++) {
+	bd->list[i] = i - 1;
+    }
+
+    bd->A = gretl_matrix_alloc(bd->m, bd->m);
+    bd->B = gretl_matrix_alloc(bd->m, bd->m);
+    bd->X = gretl_matrix_alloc(n, bd->k);
+
+    if (bd->A == NULL || bd->B == NULL || bd->X == NULL) {
+	err = E_ALLOC;
+    } else {
+	gretl_matrix_random_fill(bd->A, D_NORMAL);
+	gretl_matrix_random_fill(bd->B, D_NORMAL);
+	for (i=0; i<bd->k; i++) {
+	    memcpy(bd->X->val + (size_t) i * n, dset->Z[i+1],
+		   n * sizeof(double));
+	}
+    }
+
+    bd->prn = gretl_print_new(GRETL_PRINT_BUFFER, &err);
+
+    return err;
+}
+
+static void clean_up_data (bench_data *bd)
+{
+    char fname[FILENAME_MAX];
+
+    destroy_dataset(bd->dset);
+    free(bd->list);
+    gretl_matrix_free(bd->A);
+    gretl_matrix_free(bd->B);
+    gretl_matrix_free(bd->X);
+    gretl_print_destroy(bd->prn);
+
+    gretl_build_path(fname, bd->dir, "gretlbench.csv", NULL);
+    gretl_remove(fname);
+    gretl_build_path(fname, bd->dir, "gretlbench.gdtb", NULL);
+    gretl_remove(fname);
+}
+
+/* Read the times from a baseline file, as written by
+   print_results() below: we rely on each benchmark having
+   its own line, with "name" preceding "seconds". Times for
+   problems of a different size are no use for comparison, so
+   if the baseline's dimensions don't match those of @bd we
+   return E_DATA and no times are recorded.
+*/
+
+static int read_baseline (const char *fname, const bench_data *bd,
+			  struct bench_result *res, int nb)
+{
+    char line[256], name[64];
+    const char *p;
+    double x;
+    FILE *fp;
+    int n = -1, k = -1, m = -1;
+    int i, err = 0;
+
+    fp = gretl_fopen(fname, "r");
+    if (fp == NULL) {
+	return E_FOPEN;
+    }
+
+    while (fgets(line, sizeof line, fp)) {
+	if (sscanf(line, " \"nobs\": %d", &n) == 1 ||
+	    sscanf(line, " \"nseries\": %d", &k) == 1 ||
+	    sscanf(line, " \"matrix_dim\": %d", &m) == 1) {
+	    continue;
+	}
+	p = strstr(line, "\"name\":");
+	if (p == NULL || sscanf(p + 7, " \"%63[^\"]\"", name) != 1) {
+	    continue;
+	}
+	p = strstr(line, "\"seconds\":");
+	if (p == NULL || sscanf(p + 10, "%lf", &x) != 1) {
+	    continue;
+	}
+	for (i=0; i<nb; i++) {
+	    if (!strcmp(res[i].name, name)) {
+		res[i].base = x;
+	    }
+	}
+    }
+
+    fclose(fp);
+
+    if (n != bd->n || k != bd->k || m != bd->m) {
+	fprintf(stderr, "baseline '%s' is for nobs = %d, nseries = %d, "
+		"matrix_dim = %d\n", fname, n, k, m);
+	for (i=0; i<nb; i++) {
+	    res[i].base = NADBL;
+	}
+	err = E_DATA;
+    }
+
+    return err;
+}
+
+static void print_results (FILE *fp, bench_data *bd, int reps,
+			   struct bench_result *res, int nb,
+			   double tol)
+{
+    int i;
+
+    gretl_push_c_numeric_locale();
+
+    fputs("{\n", fp);
+    fprintf(fp, "  \"gretl_version\": \"%s\",\n", GRETL_VERSION);
+    fprintf(fp, "  \"nobs\": %d,\n", bd->n);
+    fprintf(fp, "  \"nseries\": %d,\n", bd->k);
+    fprintf(fp, "  \"matrix_dim\": %d,\n", bd->m);
+    fprintf(fp, "  \"reps\": %d,\n", reps);
+    fputs("  \"benchmarks\": [\n", fp);
+
+    for (i=0; i<nb; i++) {
+	fprintf(fp, "    {\"name\": \"%s\", ", res[i].name);
+	if (res[i].err) {
+	    fprintf(fp, "\"status\": \"error\", \"errcode\": %d}",
+		    res[i].err);
+	} else {
+	    fprintf(fp, "\"seconds\": %.6g, \"status\": \"ok\"",
+		    res[i].secs);
+	    if (!na(res[i].base) && res[i].base > 0) {
+		double ratio = res[i].secs / res[i].base;
+
+		fprintf(fp, ", \"baseline\": %.6g, \"ratio\": %.4f, "
+			"\"regression\": %s", res[i].base, ratio,
+			ratio > 1 + tol ? "true" : "false");
+	    }
+	    fputc('}', fp);
+	}
+	fputs(i < nb - 1 ? ",\n" : "\n", fp);
+    }
+
+    fputs("  ]\n}\n", fp);
+
+    gretl_pop_c_numeric_locale();
+}
+
+static void usage (const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options]\n"
+	    " -n <obs>    number of observations (default 100000)\n"
+	    " -k <vars>   number of series (default 10)\n"
+	    " -m <dim>    dimension of square matrices (default 400)\n"
+	    " -r <reps>   repetitions per benchmark, best time taken (default 5)\n"
+	    " -f <str>    run only benchmarks whose names contain <str>\n"
+	    " -d <dir>    directory for temporary files (default .)\n"
+	    " -o <file>   write JSON results to <file> (default stdout)\n"
+	    " -b <file>   compare against baseline results in <file>\n"
+	    " -t <tol>    tolerated slowdown relative to baseline (default 0.25)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main (int argc, char *argv[])
+{
+    bench_data bd = {0};
+    struct bench_result *res;
+    const char *filter = NULL;
+    const char *outname = NULL;
+    const char *basename = NULL;
+    int nb = G_N_ELEMENTS(benchmarks);
+    int reps = 5, slow = 0;
+    double tol = 0.25;
+    FILE *fp = stdout;
+    int i, j, err;
+
+    bd.n = 100000;
+    bd.k = 10;
+    bd.m = 400;
+    bd.dir = ".";
+
+    for (i=1; i<argc; i++) {
+	if (argv[i][0] != '-' || argv[i][1] == '\0' ||
+	    argv[i][2] != '\0' || i == argc - 1) {
+	    usage(argv[0]);
+	}
+	switch (argv[i][1]) {
+	case 'n': bd.n = atoi(argv[++i]); break;
+	case 'k': bd.k = atoi(argv[++i]); break;
+	case 'm': bd.m = atoi(argv[++i]); break;
+	case 'r': reps = atoi(argv[++i]); break;
+	case 'f': filter = argv[++i]; break;
+	case 'd': bd.dir = argv[++i]; break;
+	case 'o': outname = argv[++i]; break;
+	case 'b': basename = argv[++i]; break;
+	case 't': tol = atof(argv[++i]); break;
+	default: usage(argv[0]);
+	}
+    }
+
+    if (bd.n < 10 || bd.k < 4 || bd.m < 1 || reps < 1 || tol < 0) {
+	usage(argv[0]);
+    }
+
+    libgretl_init();
+
+    err = set_up_data(&bd);
+    if (err) {
+	fprintf(stderr, "%s: failed to set up data (error %d)\n",
+		argv[0], err);
+	return EXIT_FAILURE;
+    }
+
+    res = calloc(nb, sizeof *res);
+    for (i=0; i<nb; i++) {
+	res[i].name = benchmarks[i].name;
+	res[i].secs = NADBL;
+	res[i].base = NADBL;
+    }
+
+    if (basename != NULL) {
+	err = read_baseline(basename, &bd, res, nb);
+	if (err == E_DATA) {
+	    fprintf(stderr, "%s: baseline dimensions don't match "
+		    "(nobs = %d, nseries = %d, matrix_dim = %d): "
+		    "no comparison\n", argv[0], bd.n, bd.k, bd.m);
+	} else if (err) {
+	    fprintf(stderr, "%s: couldn't read baseline '%s': "
+		    "no comparison\n", argv[0], basename);
+	}
+    }
+
+    for (i=0; i<nb; i++) {
+	double secs = 0;
+
+	if (filter != NULL && strstr(res[i].name, filter) == NULL) {
+	    continue;
+	}
+	for (j=0; j<reps && !res[i].err; j++) {
+	    res[i].err = benchmarks[i].func(&bd, &secs);
+	    if (!res[i].err && (na(res[i].secs) || secs < res[i].secs)) {
+		res[i].secs = secs;
+	    }
+	}
+	if (res[i].err) {
+	    fprintf(stderr, "%-16s error %d: %s\n", res[i].name, res[i].err,
+		    gretl_errmsg_get());
+	    gretl_error_clear();
+	} else if (!na(res[i].base) && res[i].base > 0) {
+	    double ratio = res[i].secs / res[i].base;
+
+	    fprintf(stderr, "%-16s %10.6f s  (baseline %10.6f, ratio %.3f)%s\n",
+		    res[i].name, res[i].secs, res[i].base, ratio,
+		    ratio > 1 + tol ? "  ** SLOWER **" : "");
+	    slow += (ratio > 1 + tol);
+	} else {
+	    fprintf(stderr, "%-16s %10.6f s\n", res[i].name, res[i].secs);
+	}
+    }
+
+    /* drop the benchmarks that weren't run */
+    for (i=0, j=0; i<nb; i++) {
+	if (res[i].err || !na(res[i].secs)) {
+	    res[j++] = res[i];
+	}
+    }
+    nb = j;
+
+    if (outname != NULL) {
+	fp = gretl_fopen(outname, "w");
+	if (fp == NULL) {
+	    fprintf(stderr, "%s: couldn't write to '%s'\n", argv[0], outname);
+	    fp = stdout;
+	}
+    }
+
+    print_results(fp, &bd, reps, res, nb, tol);
+
+    if (fp != stdout) {
+	fclose(fp);
+    }
+
+    if (slow > 0) {
+	fprintf(stderr, "%d benchmark(s) slower than baseline by more "
+		"than %g%%\n", slow, 100 * tol);
+    }
+
+    free(res);
+    clean_up_data(&bd);
+    libgretl_cleanup();
+
+    return slow > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}